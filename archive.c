@@ -0,0 +1,2239 @@
+///
+///	@file archive.c		@brief archive module
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup Archive The archive module.
+///
+///	Reads the members of zip (cbz), tar, tar.gz and rar (cbr) archives
+///	without unpacking them.
+///	A path "dir/file.cbz#sub/page.jpg" names the member "sub/page.jpg"
+///	of the archive "dir/file.cbz", "dir/file.cbz#" is its root
+///	directory.
+///
+///	The archive is mapped and its member index is read once into a
+///	sorted entry table: the central directory of zip, the headers of
+///	tar and rar.  A tar.gz is decompressed once, checkpoints with the
+///	decompressor state are kept every megabyte, a member is inflated
+///	from the checkpoint in front of it.  The tables of the recently used
+///	archives are cached, as long as size and modification time of the
+///	archive are unchanged.
+///
+///	Directories are listed from the table, a member is opened as stdio
+///	stream: stored members are read straight from the mapping,
+///	compressed members are inflated into memory, compressed rar members
+///	are piped from unrar.  No temporary files are written.
+///
+///	Reading a mapping behind the end of a truncated file raises SIGBUS,
+///	the size of the archive is checked before each access of it.
+///
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+
+#include <pthread.h>
+#include <zlib.h>
+
+#include <libintl.h>
+#define _(str) gettext(str)		///< gettext shortcut
+#define _N(str) str			///< gettext_noop shortcut
+
+#include "readdir.h"
+#include "archive.h"
+#include "misc.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//	Defines
+//////////////////////////////////////////////////////////////////////////////
+
+#define ARCHIVE_CACHE	8		///< max cached archives
+#define ARCHIVE_ENTRIES	(1024 * 1024)	///< max entries of an archive
+#define ARCHIVE_LENGTH	(256 * 1024 * 1024)	///< max size of a member
+
+#define ARCHIVE_SPAN	(1024 * 1024)	///< uncompressed bytes of checkpoint
+#define ARCHIVE_WINDOW	32768		///< deflate window of checkpoint
+#define ARCHIVE_EXTENSION 65536		///< max size of tar long name
+
+#define ARCHIVE_ZIP	1		///< zip archive
+#define ARCHIVE_TAR	2		///< tar archive
+#define ARCHIVE_GZIP	3		///< gzip compressed tar archive
+#define ARCHIVE_RAR	4		///< rar archive
+
+#define ZIP_LOCAL	0x04034B50	///< local file header signature
+#define ZIP_CENTRAL	0x02014B50	///< central directory signature
+#define ZIP_END		0x06054B50	///< end of central directory signature
+#define ZIP_END64	0x06064B50	///< zip64 end of central directory
+#define ZIP_LOCATOR64	0x07064B50	///< zip64 end of directory locator
+
+#define ZIP_STORED	0		///< member isn't compressed
+#define ZIP_DEFLATED	8		///< member is deflated
+
+#define RAR_STORED	0		///< member isn't compressed
+#define RAR_PACKED	1		///< member is compressed
+
+//////////////////////////////////////////////////////////////////////////////
+//	Typedefs
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Member of an archive.
+///
+typedef struct _archive_entry_
+{
+    uint64_t Offset;			///< offset of zip local header or data
+    uint64_t Size;			///< compressed size
+    uint64_t Length;			///< uncompressed size
+    int Name;				///< offset of name in names block
+    int Method;				///< compression method
+} ArchiveEntry;
+
+///
+///	Checkpoint of the decompressor of a tar.gz archive.
+///
+typedef struct _archive_point_
+{
+    uint64_t Out;			///< uncompressed offset
+    uint64_t In;			///< compressed offset of next byte
+    int Bits;				///< unused bits of byte in front
+    int WindowN;			///< bytes of window, 0 stream start
+    uint8_t *Window;			///< uncompressed bytes in front
+} ArchivePoint;
+
+///
+///	Cached entry table of an archive.
+///
+typedef struct _archive_
+{
+    struct _archive_ *Next;		///< next less recently used archive
+    char *Path;				///< path and name of archive
+    struct stat Stat;			///< status of archive at read
+    int Users;				///< open directory reads and streams
+    int Dropped;			///< outdated, not in cache list
+
+    uint8_t *Map;			///< mapped archive
+    size_t MapSize;			///< size of mapping
+    int Fd;				///< archive file, checks the mapping
+    int Format;				///< archive format
+
+    ArchiveEntry *Entries;		///< members sorted by name
+    int Count;				///< number of members
+    int Size;				///< allocated members
+    char *Names;			///< names of members
+    int NamesUsed;			///< used bytes of names
+    int NamesSize;			///< allocated bytes of names
+
+    ArchivePoint *Points;		///< checkpoints of tar.gz
+    int PointN;				///< number of checkpoints
+} Archive;
+
+///
+///	Incremental tar header parser.
+///
+///	The archive is feed in pieces of any size, a tar.gz while it is
+///	decompressed.
+///
+typedef struct _tar_parser_
+{
+    uint64_t Next;			///< offset of next header or data
+    int Want;				///< bytes of header or long name
+    int Have;				///< bytes collected
+    int Type;				///< type of collected long name, 0 header
+    uint64_t End;			///< offset behind long name member
+    uint8_t Header[512];		///< collected header
+    uint8_t *Extension;			///< collected long name member + '\0'
+    char *LongName;			///< name of next member
+    int Done;				///< end of archive
+} TarParser;
+
+///
+///	Stream of an opened archive member.
+///
+typedef struct _archive_stream_
+{
+    Archive *Archive;			///< archive of mapped member, or NULL
+    uint8_t *Buffer;			///< inflated member, or NULL
+    const uint8_t *Data;		///< data of member
+    size_t Size;			///< size of member
+    size_t Pos;				///< read position
+} ArchiveStream;
+
+//////////////////////////////////////////////////////////////////////////////
+//	Variables
+//////////////////////////////////////////////////////////////////////////////
+
+static pthread_mutex_t ArchiveMutex = PTHREAD_MUTEX_INITIALIZER;
+static Archive *ArchiveList;		///< cache, most recently used first
+
+//////////////////////////////////////////////////////////////////////////////
+//	Zip
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Get little endian 16 bit value.
+*/
+static inline uint32_t Get16(const uint8_t * p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+/**
+**	Get little endian 32 bit value.
+*/
+static inline uint32_t Get32(const uint8_t * p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/**
+**	Get little endian 64 bit value.
+*/
+static inline uint64_t Get64(const uint8_t * p)
+{
+    return Get32(p) | ((uint64_t) Get32(p + 4) << 32);
+}
+
+/**
+**	Check if the mapped archive is still complete.
+**
+**	A truncated or rewritten archive can't be read anymore.  The file
+**	can still change between the check and the access, but a short
+**	check before each piece makes it unlikely.
+**
+**	@param archive	mapped archive
+**
+**	@returns true if the mapping can be read.
+*/
+static int ArchiveMapped(const Archive * archive)
+{
+    struct stat st;
+
+    if (fstat(archive->Fd, &st) < 0
+	|| (uint64_t) st.st_size < archive->MapSize
+	|| st.st_mtim.tv_sec != archive->Stat.st_mtim.tv_sec
+	|| st.st_mtim.tv_nsec != archive->Stat.st_mtim.tv_nsec) {
+	Warning(_("archive: '%s': changed while reading\n"), archive->Path);
+	return 0;
+    }
+    return 1;
+}
+
+/**
+**	Compare the names of two archive members.
+*/
+static int ArchiveCompare(const void *a, const void *b, void *names)
+{
+    return strcmp((const char *)names + ((const ArchiveEntry *)a)->Name,
+	(const char *)names + ((const ArchiveEntry *)b)->Name);
+}
+
+/**
+**	Add a member to the entry table.
+**
+**	A leading "./" is removed, members with absolute names are skipped.
+**
+**	@param archive	archive
+**	@param name	name of member, not '\0' terminated
+**	@param n	length of name
+**	@param offset	offset of local header or data of member
+**	@param size	compressed size
+**	@param length	uncompressed size
+**	@param method	compression method
+**
+**	@retval <0	out of memory
+**	@retval 0	no errors occurs
+*/
+static int ArchiveAdd(Archive * archive, const char *name, int n,
+    uint64_t offset, uint64_t size, uint64_t length, int method)
+{
+    ArchiveEntry *entry;
+
+    while (n >= 2 && name[0] == '.' && name[1] == '/') {
+	name += 2;
+	n -= 2;
+    }
+    if (n <= 0 || name[0] == '/' || memchr(name, '\0', n)) {
+	return 0;
+    }
+    if (archive->Count >= ARCHIVE_ENTRIES) {
+	return -1;
+    }
+    if (archive->Count >= archive->Size) {
+	ArchiveEntry *new;
+	int size;
+
+	size = archive->Size ? archive->Size * 2 : 256;
+	if (!(new = realloc(archive->Entries, size * sizeof(*new)))) {
+	    return -1;
+	}
+	archive->Entries = new;
+	archive->Size = size;
+    }
+    if (archive->NamesUsed + n + 1 > archive->NamesSize) {
+	char *new;
+	int size;
+
+	size = archive->NamesSize ? archive->NamesSize * 2 : 16384;
+	while (size < archive->NamesUsed + n + 1) {
+	    size *= 2;
+	}
+	if (!(new = realloc(archive->Names, size))) {
+	    return -1;
+	}
+	archive->Names = new;
+	archive->NamesSize = size;
+    }
+    entry = archive->Entries + archive->Count++;
+    entry->Offset = offset;
+    entry->Size = size;
+    entry->Length = length;
+    entry->Name = archive->NamesUsed;
+    entry->Method = method;
+    memcpy(archive->Names + archive->NamesUsed, name, n);
+    archive->Names[archive->NamesUsed + n] = '\0';
+    archive->NamesUsed += n + 1;
+
+    return 0;
+}
+
+/**
+**	Find the end of central directory record.
+**
+**	It is behind the central directory, followed by a comment of up to
+**	64k.
+**
+**	@param map	mapped archive
+**	@param size	size of mapping
+**
+**	@returns offset of record, -1 if not found.
+*/
+static int64_t ZipFindEnd(const uint8_t * map, size_t size)
+{
+    int64_t i;
+    int64_t last;
+
+    if (size < 22) {
+	return -1;
+    }
+    last = size > 22 + 65535 ? (int64_t) size - 22 - 65535 : 0;
+    for (i = size - 22; i >= last; --i) {
+	// the comment can contain the signature, its length must fit
+	if (Get32(map + i) == ZIP_END
+	    && Get16(map + i + 20) == size - i - 22) {
+	    return i;
+	}
+    }
+    return -1;
+}
+
+/**
+**	Get the zip64 values of a central directory entry.
+**
+**	Values, which don't fit into 32 bit, are in the zip64 extra field.
+**
+**	@param extra	extra fields
+**	@param n	length of extra fields
+**	@param[in,out] length	uncompressed size
+**	@param[in,out] size	compressed size
+**	@param[in,out] offset	offset of local header
+*/
+static void ZipExtra64(const uint8_t * extra, unsigned n, uint64_t * length,
+    uint64_t * size, uint64_t * offset)
+{
+    unsigned id;
+    unsigned len;
+    unsigned i;
+
+    while (n >= 4) {
+	id = Get16(extra);
+	len = Get16(extra + 2);
+	if (len > n - 4) {
+	    return;
+	}
+	if (id == 0x0001) {
+	    i = 0;
+	    if (*length == 0xFFFFFFFF && i + 8 <= len) {
+		*length = Get64(extra + 4 + i);
+		i += 8;
+	    }
+	    if (*size == 0xFFFFFFFF && i + 8 <= len) {
+		*size = Get64(extra + 4 + i);
+		i += 8;
+	    }
+	    if (*offset == 0xFFFFFFFF && i + 8 <= len) {
+		*offset = Get64(extra + 4 + i);
+	    }
+	    return;
+	}
+	extra += 4 + len;
+	n -= 4 + len;
+    }
+}
+
+/**
+**	Read the central directory of a zip archive.
+**
+**	Encrypted members are skipped.
+**
+**	@param archive	mapped archive
+**
+**	@retval <0	if any error occurs
+**	@retval 0	no errors occurs
+*/
+static int ZipRead(Archive * archive)
+{
+    const uint8_t *map;
+    const uint8_t *end;
+    const uint8_t *p;
+    int64_t eocd;
+    uint64_t count;
+    uint64_t cd_size;
+    uint64_t cd_offset;
+    uint64_t i;
+    int n;
+
+    map = archive->Map;
+    if ((eocd = ZipFindEnd(map, archive->MapSize)) < 0) {
+	return -1;
+    }
+    count = Get16(map + eocd + 10);
+    cd_size = Get32(map + eocd + 12);
+    cd_offset = Get32(map + eocd + 16);
+    // zip64: locator in front of the end record
+    if ((count == 0xFFFF || cd_size == 0xFFFFFFFF
+	    || cd_offset == 0xFFFFFFFF) && eocd >= 20
+	&& Get32(map + eocd - 20) == ZIP_LOCATOR64) {
+	uint64_t offset;
+
+	offset = Get64(map + eocd - 20 + 8);
+	if (eocd >= 56 && offset <= (uint64_t) eocd - 56	// no overflow
+	    && Get32(map + offset) == ZIP_END64) {
+	    count = Get64(map + offset + 32);
+	    cd_size = Get64(map + offset + 40);
+	    cd_offset = Get64(map + offset + 48);
+	}
+    }
+    if (cd_offset > archive->MapSize
+	|| cd_size > archive->MapSize - cd_offset) {
+	return -1;
+    }
+
+    p = map + cd_offset;
+    end = p + cd_size;
+    for (i = 0; i < count; ++i) {
+	uint64_t length;
+	uint64_t size;
+	uint64_t offset;
+	unsigned flags;
+	unsigned m;
+	unsigned k;
+
+	if (end - p < 46 || Get32(p) != ZIP_CENTRAL) {
+	    break;
+	}
+	flags = Get16(p + 8);
+	n = Get16(p + 28);
+	m = Get16(p + 30);
+	k = Get16(p + 32);
+	if ((size_t) (end - p) < 46 + n + m + k) {
+	    break;
+	}
+	if (!(flags & 1)) {		// skip encrypted
+	    size = Get32(p + 20);
+	    length = Get32(p + 24);
+	    offset = Get32(p + 42);
+	    ZipExtra64(p + 46 + n, m, &length, &size, &offset);
+	    if (ArchiveAdd(archive, (const char *)p + 46, n, offset, size,
+		    length, Get16(p + 10)) < 0) {
+		return -1;
+	    }
+	}
+	p += 46 + n + m + k;
+    }
+    if (i < count) {
+	Warning(_("archive: '%s': broken central directory\n"),
+	    archive->Path);
+    }
+
+    return 0;
+}
+
+/**
+**	Get the data of a zip member.
+**
+**	@param archive	mapped archive
+**	@param entry	member of archive
+**
+**	@returns pointer into the mapping, NULL if broken.
+*/
+static const uint8_t *ZipData(const Archive * archive,
+    const ArchiveEntry * entry)
+{
+    const uint8_t *p;
+    uint64_t offset;
+
+    if (entry->Offset > archive->MapSize - 30) {
+	return NULL;
+    }
+    p = archive->Map + entry->Offset;
+    if (Get32(p) != ZIP_LOCAL) {
+	return NULL;
+    }
+    // local extra field can differ from the central one
+    offset = entry->Offset + 30 + Get16(p + 26) + Get16(p + 28);
+    if (offset > archive->MapSize || entry->Size > archive->MapSize - offset) {
+	return NULL;
+    }
+    return archive->Map + offset;
+}
+
+/**
+**	Inflate a deflated zip member.
+**
+**	@param data	deflated data
+**	@param size	size of deflated data
+**	@param length	size of inflated data
+**
+**	@returns malloced inflated data, NULL on errors.
+*/
+static uint8_t *ZipInflate(const uint8_t * data, uint64_t size,
+    uint64_t length)
+{
+    z_stream z;
+    uint8_t *buffer;
+    int err;
+
+    if (size > UINT32_MAX || !(buffer = malloc(length ? length : 1))) {
+	return NULL;
+    }
+    memset(&z, 0, sizeof(z));
+    if (inflateInit2(&z, -MAX_WBITS) != Z_OK) {
+	free(buffer);
+	return NULL;
+    }
+    z.next_in = (Bytef *) data;
+    z.avail_in = size;
+    z.next_out = buffer;
+    z.avail_out = length;
+    err = inflate(&z, Z_FINISH);
+    inflateEnd(&z);
+    if (err != Z_STREAM_END || z.total_out != length) {
+	free(buffer);
+	return NULL;
+    }
+    return buffer;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Tar
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Get number of a tar header field.
+**
+**	Big values are stored base-256 with the high bit set, else octal.
+**
+**	@param field	header field
+**	@param n	size of field
+*/
+static uint64_t TarNumber(const uint8_t * field, int n)
+{
+    uint64_t value;
+    int i;
+
+    value = 0;
+    if (field[0] & 0x80) {
+	for (i = 1; i < n; ++i) {
+	    value = (value << 8) | field[i];
+	}
+	return value;
+    }
+    for (i = 0; i < n && field[i] == ' '; ++i) {
+    }
+    for (; i < n && field[i] >= '0' && field[i] <= '7'; ++i) {
+	value = (value << 3) | (field[i] - '0');
+    }
+    return value;
+}
+
+/**
+**	Check the checksum of a tar header.
+**
+**	@param header	512 byte header
+*/
+static int TarChecksum(const uint8_t * header)
+{
+    unsigned sum;
+    int i;
+
+    sum = 8 * ' ';			// checksum field counts as spaces
+    for (i = 0; i < 512; ++i) {
+	if (i < 148 || i >= 156) {
+	    sum += header[i];
+	}
+    }
+    return sum == TarNumber(header + 148, 8);
+}
+
+/**
+**	Handle a complete tar header.
+**
+**	@param tar	tar parser
+**	@param archive	archive
+**	@param pos	offset behind the header
+**
+**	@retval <0	out of memory
+**	@retval 0	no errors occurs
+*/
+static int TarHeader(TarParser * tar, Archive * archive, uint64_t pos)
+{
+    const uint8_t *h;
+    uint64_t size;
+    char name[257];
+    int n;
+    int err;
+
+    h = tar->Header;
+    tar->Want = 512;
+    tar->Have = 0;
+    if (!h[0] || !TarChecksum(h)) {	// end of archive or garbage
+	tar->Done = 1;
+	return 0;
+    }
+    size = TarNumber(h + 124, 12);
+    tar->Next = pos + ((size + 511) & ~(uint64_t) 511);
+
+    switch (h[156]) {
+	case 'L':			// gnu long name
+	case 'x':			// pax extended header
+	    tar->Type = h[156];
+	    tar->Want = size < ARCHIVE_EXTENSION ? size : ARCHIVE_EXTENSION;
+	    tar->End = tar->Next;
+	    tar->Next = pos;
+	    if (!tar->Want) {
+		tar->Type = 0;
+		tar->Want = 512;
+		tar->Next = tar->End;
+	    }
+	    return 0;
+	case '\0':
+	case '0':
+	case '7':
+	case '5':
+	    break;
+	default:			// links, devices, global headers
+	    free(tar->LongName);
+	    tar->LongName = NULL;
+	    return 0;
+    }
+
+    if (tar->LongName) {
+	n = snprintf(name, sizeof(name), "%s", tar->LongName);
+	if (n >= (int)sizeof(name)) {
+	    n = sizeof(name) - 1;
+	}
+    } else if (!memcmp(h + 257, "ustar", 5) && h[345]) {
+	n = snprintf(name, sizeof(name), "%.155s/%.100s", h + 345, h);
+    } else {
+	n = snprintf(name, sizeof(name), "%.100s", h);
+    }
+    free(tar->LongName);
+    tar->LongName = NULL;
+
+    if (h[156] == '5') {		// directory: with '/', without data
+	if (n && name[n - 1] != '/' && n < (int)sizeof(name) - 1) {
+	    name[n++] = '/';
+	}
+	err = ArchiveAdd(archive, name, n, pos, 0, 0, 0);
+    } else {
+	err = ArchiveAdd(archive, name, n, pos, size, size, 0);
+    }
+    return err;
+}
+
+/**
+**	Handle a complete long name member.
+**
+**	@param tar	tar parser
+*/
+static void TarExtension(TarParser * tar)
+{
+    const char *p;
+    const char *end;
+
+    free(tar->LongName);
+    tar->LongName = NULL;
+    tar->Extension[tar->Have] = '\0';	// strtol stops at the end
+    if (tar->Type == 'L') {
+	tar->LongName = strndup((char *)tar->Extension, tar->Have);
+    } else {
+	// pax records: "length key=value\n"
+	p = (char *)tar->Extension;
+	end = p + tar->Have;
+	while (p < end) {
+	    char *next;
+	    long len;
+
+	    len = strtol(p, &next, 10);
+	    if (len <= 0 || len > end - p || *next != ' ') {
+		break;
+	    }
+	    if (len > 6 && next + 6 <= p + len - 1
+		&& !strncmp(next + 1, "path=", 5)) {
+		tar->LongName = strndup(next + 6, p + len - 1 - (next + 6));
+	    }
+	    p += len;
+	}
+    }
+    tar->Type = 0;
+    tar->Want = 512;
+    tar->Have = 0;
+    tar->Next = tar->End;
+}
+
+/**
+**	Feed a piece of a tar archive to the header parser.
+**
+**	@param tar	tar parser
+**	@param archive	archive
+**	@param data	piece of archive
+**	@param n	size of piece
+**	@param pos	offset of piece in archive
+**
+**	@retval <0	out of memory
+**	@retval 0	no errors occurs
+*/
+static int TarFeed(TarParser * tar, Archive * archive, const uint8_t * data,
+    size_t n, uint64_t pos)
+{
+    size_t i;
+
+    while (n && !tar->Done) {
+	if (pos < tar->Next) {		// skip member data
+	    i = tar->Next - pos < n ? tar->Next - pos : n;
+	    data += i;
+	    n -= i;
+	    pos += i;
+	    continue;
+	}
+	i = tar->Want - tar->Have;
+	if (i > n) {
+	    i = n;
+	}
+	if (tar->Type) {
+	    if (!tar->Extension
+		&& !(tar->Extension = malloc(ARCHIVE_EXTENSION + 1))) {
+		return -1;
+	    }
+	    memcpy(tar->Extension + tar->Have, data, i);
+	} else {
+	    memcpy(tar->Header + tar->Have, data, i);
+	}
+	tar->Have += i;
+	data += i;
+	n -= i;
+	pos += i;
+	tar->Next = pos;
+	if (tar->Have < tar->Want) {
+	    continue;
+	}
+	if (tar->Type) {
+	    TarExtension(tar);
+	} else if (TarHeader(tar, archive, pos) < 0) {
+	    return -1;
+	}
+    }
+    return 0;
+}
+
+/**
+**	Free the buffers of a tar parser.
+**
+**	@param tar	tar parser
+*/
+static void TarFree(TarParser * tar)
+{
+    free(tar->Extension);
+    free(tar->LongName);
+}
+
+/**
+**	Read the headers of a tar archive.
+**
+**	@param archive	mapped archive
+**
+**	@retval <0	if any error occurs
+**	@retval 0	no errors occurs
+*/
+static int TarRead(Archive * archive)
+{
+    TarParser tar;
+    uint64_t pos;
+    int err;
+
+    memset(&tar, 0, sizeof(tar));
+    tar.Want = 512;
+    err = 0;
+    // the mapping is checked before each piece, member data is skipped
+    for (pos = 0; !err && !tar.Done && pos < archive->MapSize;) {
+	size_t n;
+
+	if (!ArchiveMapped(archive)) {
+	    err = -1;
+	    break;
+	}
+	n = archive->MapSize - pos < ARCHIVE_SPAN ? archive->MapSize - pos :
+	    ARCHIVE_SPAN;
+	err = TarFeed(&tar, archive, archive->Map + pos, n, pos);
+	pos += n;
+	if (tar.Next > pos) {
+	    pos = tar.Next;
+	}
+    }
+    TarFree(&tar);
+
+    return err;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Gzip
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Skip the header of a gzip member.
+**
+**	@param map	mapped archive
+**	@param size	size of mapping
+**	@param offset	offset of gzip member
+**
+**	@returns offset of deflated data, 0 if there is no gzip member.
+*/
+static uint64_t GzipHeader(const uint8_t * map, uint64_t size,
+    uint64_t offset)
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    int flags;
+
+    if (offset > size || size - offset < 10) {
+	return 0;
+    }
+    p = map + offset;
+    end = map + size;
+    if (p[0] != 0x1F || p[1] != 0x8B || p[2] != 8) {
+	return 0;
+    }
+    flags = p[3];
+    p += 10;
+    if (flags & 4) {			// FEXTRA
+	if (end - p < 2 || end - p < 2 + Get16(p)) {
+	    return 0;
+	}
+	p += 2 + Get16(p);
+    }
+    if (flags & 8) {			// FNAME
+	if (!(p = memchr(p, '\0', end - p))) {
+	    return 0;
+	}
+	++p;
+    }
+    if (flags & 16) {			// FCOMMENT
+	if (!(p = memchr(p, '\0', end - p))) {
+	    return 0;
+	}
+	++p;
+    }
+    if (flags & 2) {			// FHCRC
+	p += 2;
+    }
+    if (p >= end) {
+	return 0;
+    }
+    return p - map;
+}
+
+/**
+**	Add a checkpoint of the decompressor.
+**
+**	@param archive	archive
+**	@param out	uncompressed offset
+**	@param in	compressed offset of next byte
+**	@param bits	unused bits of byte in front
+**	@param window	circular window of uncompressed data
+**	@param pos	position of next byte in window
+**	@param have	valid bytes in window
+**
+**	@retval <0	out of memory
+**	@retval 0	no errors occurs
+*/
+static int GzipPoint(Archive * archive, uint64_t out, uint64_t in, int bits,
+    const uint8_t * window, int pos, int have)
+{
+    ArchivePoint *point;
+
+    // checkpoints are added seldom, grow one by one
+    if (!(point = realloc(archive->Points,
+		(archive->PointN + 1) * sizeof(*point)))) {
+	return -1;
+    }
+    archive->Points = point;
+    point += archive->PointN;
+    point->Out = out;
+    point->In = in;
+    point->Bits = bits;
+    point->WindowN = have;
+    point->Window = NULL;
+    if (have) {
+	if (!(point->Window = malloc(have))) {
+	    return -1;
+	}
+	// unwrap the circular window
+	if (have > pos) {
+	    memcpy(point->Window, window + ARCHIVE_WINDOW - (have - pos),
+		have - pos);
+	    memcpy(point->Window + have - pos, window, pos);
+	} else {
+	    memcpy(point->Window, window + pos - have, have);
+	}
+    }
+    archive->PointN++;
+
+    return 0;
+}
+
+/**
+**	Decompress a tar.gz once, read its headers and add checkpoints.
+**
+**	A checkpoint is added at deflate block boundaries, every
+**	#ARCHIVE_SPAN bytes.  Concatenated gzip members are supported.
+**
+**	@param archive	mapped archive
+**
+**	@retval <0	if any error occurs
+**	@retval 0	no errors occurs
+*/
+static int GzipRead(Archive * archive)
+{
+    TarParser tar;
+    z_stream z;
+    uint8_t *window;
+    uint64_t in;
+    uint64_t out;
+    uint64_t last;
+    int have;
+    int err;
+
+    if (!(in = GzipHeader(archive->Map, archive->MapSize, 0))
+	|| !(window = malloc(ARCHIVE_WINDOW))) {
+	return -1;
+    }
+    memset(&z, 0, sizeof(z));
+    if (inflateInit2(&z, -MAX_WBITS) != Z_OK) {
+	free(window);
+	return -1;
+    }
+    memset(&tar, 0, sizeof(tar));
+    tar.Want = 512;
+    out = 0;
+    last = 0;
+    have = 0;
+    err = GzipPoint(archive, 0, in, 0, window, 0, 0);
+
+    z.next_in = archive->Map + in;
+    while (!err && !tar.Done) {
+	uint8_t *start;
+	int ret;
+
+	if (!z.avail_in) {
+	    in = z.next_in - archive->Map;
+	    if (in >= archive->MapSize) {
+		Warning(_("archive: '%s': truncated\n"), archive->Path);
+		break;
+	    }
+	    if (!ArchiveMapped(archive)) {
+		err = -1;
+		break;
+	    }
+	    z.avail_in = archive->MapSize - in < ARCHIVE_SPAN ?
+		archive->MapSize - in : ARCHIVE_SPAN;
+	}
+	if (!z.avail_out) {
+	    z.next_out = window;
+	    z.avail_out = ARCHIVE_WINDOW;
+	}
+	start = z.next_out;
+	ret = inflate(&z, Z_BLOCK);
+	if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+	    Warning(_("archive: '%s': broken\n"), archive->Path);
+	    break;
+	}
+	if (TarFeed(&tar, archive, start, z.next_out - start, out) < 0) {
+	    err = -1;
+	    break;
+	}
+	out += z.next_out - start;
+	have += z.next_out - start;
+	if (have > ARCHIVE_WINDOW) {
+	    have = ARCHIVE_WINDOW;
+	}
+
+	if (ret == Z_STREAM_END) {	// next concatenated member
+	    in = z.next_in - archive->Map + 8;
+	    if (!(in = GzipHeader(archive->Map, archive->MapSize, in))) {
+		break;
+	    }
+	    inflateReset(&z);
+	    z.next_in = archive->Map + in;
+	    z.avail_in = 0;
+	    have = 0;
+	    last = out;
+	    err = GzipPoint(archive, out, in, 0, window, 0, 0);
+	    continue;
+	}
+	// end of a deflate block, but not the last
+	if ((z.data_type & 128) && !(z.data_type & 64)
+	    && out - last >= ARCHIVE_SPAN) {
+	    err = GzipPoint(archive, out, z.next_in - archive->Map,
+		z.data_type & 7, window, z.next_out - window, have);
+	    last = out;
+	}
+    }
+    inflateEnd(&z);
+    TarFree(&tar);
+    free(window);
+
+    return err;
+}
+
+/**
+**	Inflate a member of a tar.gz from the checkpoint in front of it.
+**
+**	@param archive	mapped archive
+**	@param entry	member of archive
+**
+**	@returns malloced member data, NULL on errors.
+*/
+static uint8_t *GzipExtract(const Archive * archive,
+    const ArchiveEntry * entry)
+{
+    const ArchivePoint *point;
+    uint8_t *buffer;
+    uint8_t *skip;
+    uint64_t out;
+    uint64_t in;
+    z_stream z;
+    int low;
+    int high;
+    int ret;
+
+    // last checkpoint not behind the member
+    low = 0;
+    high = archive->PointN;
+    while (high - low > 1) {
+	int mid;
+
+	mid = (low + high) / 2;
+	if (archive->Points[mid].Out <= entry->Offset) {
+	    low = mid;
+	} else {
+	    high = mid;
+	}
+    }
+    point = archive->Points + low;
+
+    buffer = malloc(entry->Length ? entry->Length : 1);
+    skip = malloc(ARCHIVE_WINDOW);
+    memset(&z, 0, sizeof(z));
+    if (!buffer || !skip || inflateInit2(&z, -MAX_WBITS) != Z_OK) {
+	free(buffer);
+	free(skip);
+	return NULL;
+    }
+    if (point->Bits) {
+	inflatePrime(&z, point->Bits,
+	    archive->Map[point->In - 1] >> (8 - point->Bits));
+    }
+    if (point->WindowN) {
+	inflateSetDictionary(&z, point->Window, point->WindowN);
+    }
+    in = point->In;
+    out = point->Out;
+    z.next_in = archive->Map + in;
+    z.avail_in = 0;
+    ret = Z_OK;
+    while (out < entry->Offset + entry->Length) {
+	uint8_t *start;
+
+	if (!z.avail_in) {
+	    in = z.next_in - archive->Map;
+	    if (in >= archive->MapSize || !ArchiveMapped(archive)) {
+		break;
+	    }
+	    z.avail_in = archive->MapSize - in < ARCHIVE_SPAN ?
+		archive->MapSize - in : ARCHIVE_SPAN;
+	}
+	if (out < entry->Offset) {	// skip to member
+	    z.next_out = skip;
+	    z.avail_out = entry->Offset - out < ARCHIVE_WINDOW ?
+		entry->Offset - out : ARCHIVE_WINDOW;
+	} else {
+	    z.next_out = buffer + (out - entry->Offset);
+	    z.avail_out = entry->Offset + entry->Length - out < UINT32_MAX ?
+		entry->Offset + entry->Length - out : UINT32_MAX;
+	}
+	start = z.next_out;
+	ret = inflate(&z, Z_NO_FLUSH);
+	out += z.next_out - start;
+	if (ret == Z_STREAM_END) {	// next concatenated member
+	    in = z.next_in - archive->Map + 8;
+	    if (!(in = GzipHeader(archive->Map, archive->MapSize, in))) {
+		break;
+	    }
+	    inflateReset(&z);
+	    z.next_in = archive->Map + in;
+	    z.avail_in = 0;
+	} else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+	    break;
+	}
+    }
+    inflateEnd(&z);
+    free(skip);
+
+    if (out < entry->Offset + entry->Length) {
+	free(buffer);
+	return NULL;
+    }
+    return buffer;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Rar
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Get a rar 5 variable length number.
+**
+**	@param[in,out] p	position in header, moved behind number
+**	@param end	end of header
+**	@param[out] value	number
+**
+**	@returns true if the number is complete.
+*/
+static int RarNumber(const uint8_t ** p, const uint8_t * end,
+    uint64_t * value)
+{
+    int shift;
+
+    *value = 0;
+    for (shift = 0; *p < end && shift < 64; shift += 7) {
+	*value |= (uint64_t) (**p & 0x7F) << shift;
+	if (!(*(*p)++ & 0x80)) {
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+/**
+**	Add a rar member, its name uses the separators of the host.
+**
+**	@param archive	archive
+**	@param name	name of member, not '\0' terminated
+**	@param n	length of name
+**	@param dir	member is a directory
+**	@param offset	offset of data
+**	@param size	compressed size
+**	@param length	uncompressed size
+**	@param method	#RAR_STORED or #RAR_PACKED
+**
+**	@retval <0	out of memory
+**	@retval 0	no errors occurs
+*/
+static int RarAdd(Archive * archive, const char *name, int n, int dir,
+    uint64_t offset, uint64_t size, uint64_t length, int method)
+{
+    char *tmp;
+    int i;
+    int err;
+
+    if (!(tmp = malloc(n + 2))) {
+	return -1;
+    }
+    for (i = 0; i < n; ++i) {
+	tmp[i] = name[i] == '\\' ? '/' : name[i];
+    }
+    if (dir) {
+	tmp[n++] = '/';
+    }
+    err = ArchiveAdd(archive, tmp, n, offset, size, length, method);
+    free(tmp);
+
+    return err;
+}
+
+/**
+**	Decode the unicode name of a rar 4 file header.
+**
+**	The encoded name follows the ascii name and its '\0', it stores
+**	utf-16 characters or the differences to the ascii name.
+**
+**	@param name	ascii name
+**	@param n	length of ascii name
+**	@param enc	encoded unicode name
+**	@param size	size of encoded name
+**
+**	@returns malloced utf-8 name, NULL on errors.
+*/
+static char *Rar4Unicode(const uint8_t * name, unsigned n,
+    const uint8_t * enc, unsigned size)
+{
+    uint16_t *wide;
+    char *utf8;
+    unsigned max;
+    unsigned in;
+    unsigned out;
+    unsigned high;
+    unsigned flags;
+    unsigned bits;
+    unsigned i;
+    unsigned j;
+    unsigned u;
+
+    max = n > size ? n : size;
+    wide = malloc((max + 1) * sizeof(*wide));
+    utf8 = malloc(3 * max + 1);
+    if (!wide || !utf8) {
+	free(wide);
+	free(utf8);
+	return NULL;
+    }
+
+    in = 0;
+    out = 0;
+    flags = 0;
+    bits = 0;
+    high = in < size ? enc[in++] : 0;
+    while (in < size && out < max) {
+	if (!bits) {
+	    flags = enc[in++];
+	    bits = 8;
+	}
+	switch (flags >> 6) {
+	    case 0:			// low byte
+		if (in < size) {
+		    wide[out++] = enc[in++];
+		}
+		break;
+	    case 1:			// low byte and common high byte
+		if (in < size) {
+		    wide[out++] = enc[in++] | high << 8;
+		}
+		break;
+	    case 2:			// full character
+		if (in + 1 < size) {
+		    wide[out++] = Get16(enc + in);
+		    in += 2;
+		}
+		break;
+	    case 3:			// run of ascii name
+		if (in < size) {
+		    unsigned len;
+		    unsigned correction;
+
+		    len = enc[in++];
+		    correction = 0;
+		    if (len & 0x80) {
+			if (in >= size) {
+			    break;
+			}
+			correction = enc[in++];
+			for (len = (len & 0x7F) + 2; len && out < n; --len) {
+			    wide[out] = ((name[out] + correction) & 0xFF)
+				| high << 8;
+			    ++out;
+			}
+		    } else {
+			for (len += 2; len && out < n; --len) {
+			    wide[out] = name[out];
+			    ++out;
+			}
+		    }
+		}
+		break;
+	}
+	flags = (flags << 2) & 0xFF;
+	bits -= 2;
+    }
+
+    // utf-16 to utf-8
+    for (i = j = 0; i < out && wide[i]; ++i) {
+	u = wide[i];
+	if (u >= 0xD800 && u < 0xDC00 && i + 1 < out && wide[i + 1] >= 0xDC00
+	    && wide[i + 1] < 0xE000) {
+	    u = 0x10000 + ((u - 0xD800) << 10) + (wide[++i] - 0xDC00);
+	}
+	if (u < 0x80) {
+	    utf8[j++] = u;
+	} else if (u < 0x800) {
+	    utf8[j++] = 0xC0 | u >> 6;
+	    utf8[j++] = 0x80 | (u & 0x3F);
+	} else if (u < 0x10000) {
+	    utf8[j++] = 0xE0 | u >> 12;
+	    utf8[j++] = 0x80 | ((u >> 6) & 0x3F);
+	    utf8[j++] = 0x80 | (u & 0x3F);
+	} else {
+	    utf8[j++] = 0xF0 | u >> 18;
+	    utf8[j++] = 0x80 | ((u >> 12) & 0x3F);
+	    utf8[j++] = 0x80 | ((u >> 6) & 0x3F);
+	    utf8[j++] = 0x80 | (u & 0x3F);
+	}
+    }
+    utf8[j] = '\0';
+    free(wide);
+
+    if (!j) {
+	free(utf8);
+	return NULL;
+    }
+    return utf8;
+}
+
+/**
+**	Read the headers of a rar 1.5 - 4.x archive.
+**
+**	Encrypted and split members are skipped.
+**
+**	@param archive	mapped archive
+**	@param pos	offset behind the signature
+**
+**	@retval <0	if any error occurs
+**	@retval 0	no errors occurs
+*/
+static int Rar4Read(Archive * archive, uint64_t pos)
+{
+    const uint8_t *map;
+    uint64_t size;
+
+    map = archive->Map;
+    size = archive->MapSize;
+    while (pos + 7 <= size) {
+	const uint8_t *h;
+	uint64_t next;
+	unsigned flags;
+	unsigned hsize;
+	int type;
+
+	h = map + pos;
+	type = h[2];
+	flags = Get16(h + 3);
+	hsize = Get16(h + 5);
+	if (hsize < 7 || pos + hsize > size) {
+	    break;
+	}
+	next = pos + hsize;
+	if (type == 0x73 && hsize >= 13 && (flags & 0x80)) {
+	    Error(_("archive: '%s': encrypted headers\n"), archive->Path);
+	    return -1;
+	}
+	if (type == 0x74 && hsize >= 32) {	// file header
+	    uint64_t pack;
+	    uint64_t unpack;
+	    unsigned n;
+	    const uint8_t *name;
+	    const uint8_t *zero;
+	    char *unicode;
+
+	    pack = Get32(h + 7);
+	    unpack = Get32(h + 11);
+	    n = Get16(h + 26);
+	    name = h + 32;
+	    if (flags & 0x100) {	// 64 bit sizes
+		if (hsize < 40) {
+		    break;
+		}
+		pack |= (uint64_t) Get32(h + 32) << 32;
+		unpack |= (uint64_t) Get32(h + 36) << 32;
+		name += 8;
+	    }
+	    if (name + n > h + hsize || pack > size - next) {
+		break;
+	    }
+	    // unicode name: ascii name, '\0', encoded unicode name
+	    unicode = NULL;
+	    if ((flags & 0x200) && (zero = memchr(name, '\0', n))) {
+		unicode = Rar4Unicode(name, zero - name, zero + 1,
+		    name + n - zero - 1);
+		n = zero - name;
+	    }
+	    if (!(flags & 0x07)) {	// not split or encrypted
+		if (RarAdd(archive, unicode ? unicode : (const char *)name,
+			unicode ? strlen(unicode) : n,
+			(flags & 0xE0) == 0xE0, next, pack, unpack,
+			h[25] == 0x30 ? RAR_STORED : RAR_PACKED) < 0) {
+		    free(unicode);
+		    return -1;
+		}
+	    }
+	    free(unicode);
+	    next += pack;
+	} else if (type == 0x7B) {	// end of archive
+	    break;
+	} else if (flags & 0x8000) {	// block with data
+	    if (hsize < 11 || Get32(h + 7) > size - next) {
+		break;
+	    }
+	    next += Get32(h + 7);
+	}
+	if (next <= pos) {		// no progress
+	    break;
+	}
+	pos = next;
+    }
+    return 0;
+}
+
+/**
+**	Read the headers of a rar 5 archive.
+**
+**	Encrypted and split members are skipped.
+**
+**	@param archive	mapped archive
+**	@param pos	offset behind the signature
+**
+**	@retval <0	if any error occurs
+**	@retval 0	no errors occurs
+*/
+static int Rar5Read(Archive * archive, uint64_t pos)
+{
+    const uint8_t *map;
+    uint64_t size;
+
+    map = archive->Map;
+    size = archive->MapSize;
+    while (pos + 7 <= size) {
+	const uint8_t *p;
+	const uint8_t *end;
+	const uint8_t *extra;
+	uint64_t hsize;
+	uint64_t type;
+	uint64_t flags;
+	uint64_t extra_size;
+	uint64_t data_size;
+
+	p = map + pos + 4;		// skip crc
+	if (!RarNumber(&p, map + size, &hsize) || hsize > size
+	    || (uint64_t) (p - map) > size - hsize) {
+	    break;
+	}
+	end = p + hsize;
+	extra_size = 0;
+	data_size = 0;
+	if (!RarNumber(&p, end, &type) || !RarNumber(&p, end, &flags)
+	    || ((flags & 1) && !RarNumber(&p, end, &extra_size))
+	    || ((flags & 2) && !RarNumber(&p, end, &data_size))
+	    || extra_size > hsize || data_size > size) {
+	    break;
+	}
+	extra = end - extra_size;
+
+	if (type == 4) {
+	    Error(_("archive: '%s': encrypted headers\n"), archive->Path);
+	    return -1;
+	}
+	if (type == 2) {		// file header
+	    uint64_t file_flags;
+	    uint64_t unpack;
+	    uint64_t attr;
+	    uint64_t info;
+	    uint64_t os;
+	    uint64_t n;
+	    int encrypted;
+
+	    if (!RarNumber(&p, extra, &file_flags)
+		|| !RarNumber(&p, extra, &unpack)
+		|| !RarNumber(&p, extra, &attr)) {
+		break;
+	    }
+	    p += (file_flags & 2 ? 4 : 0) + (file_flags & 4 ? 4 : 0);
+	    if (p > extra || !RarNumber(&p, extra, &info)
+		|| !RarNumber(&p, extra, &os) || !RarNumber(&p, extra, &n)
+		|| n > (uint64_t) (extra - p)) {
+		break;
+	    }
+	    // extra area: record type 1 is encryption
+	    encrypted = 0;
+	    while (extra < end) {
+		const uint8_t *q;
+		uint64_t len;
+		uint64_t id;
+
+		q = extra;
+		if (!RarNumber(&q, end, &len) || !len
+		    || len > (uint64_t) (end - q)) {
+		    break;
+		}
+		extra = q + len;	// size counts from the type
+		if (!RarNumber(&q, extra, &id)) {
+		    break;
+		}
+		encrypted |= id == 1;
+	    }
+	    // split before or after, solid members need unrar too
+	    if (!encrypted && !(flags & 0x18)) {
+		if (RarAdd(archive, (const char *)p, n, file_flags & 1,
+			end - map, data_size, unpack,
+			(info >> 7) & 7 ? RAR_PACKED : RAR_STORED) < 0) {
+		    return -1;
+		}
+	    }
+	} else if (type == 5) {	// end of archive
+	    break;
+	}
+	pos = end - map + data_size;
+    }
+    return 0;
+}
+
+/**
+**	Read the headers of a rar archive.
+**
+**	@param archive	mapped archive
+**
+**	@retval <0	if any error occurs
+**	@retval 0	no errors occurs
+*/
+static int RarRead(Archive * archive)
+{
+    if (archive->MapSize >= 8
+	&& !memcmp(archive->Map, "Rar!\x1A\x07\x01\x00", 8)) {
+	return Rar5Read(archive, 8);
+    }
+    return Rar4Read(archive, 7);
+}
+
+/**
+**	Extract a compressed rar member with unrar.
+**
+**	unrar prints the member to a pipe, nothing is written to disk.
+**	unrar takes member names only as wildcard masks, names with '*'
+**	or '?' could select other members and aren't extracted.
+**
+**	@param archive	archive
+**	@param entry	member of archive
+**
+**	@returns malloced member data, NULL on errors.
+*/
+static uint8_t *RarExtract(const Archive * archive,
+    const ArchiveEntry * entry)
+{
+    posix_spawn_file_actions_t actions;
+    const char *args[9];
+    const char *name;
+    uint8_t *buffer;
+    uint64_t got;
+    pid_t pid;
+    int fds[2];
+    int status;
+    int err;
+
+    name = archive->Names + entry->Name;
+    if (strpbrk(name, "*?")) {
+	Debug(3, "archive: can't unrar wildcard name '%s'\n", name);
+	return NULL;
+    }
+    if (!(buffer = malloc(entry->Length ? entry->Length : 1))) {
+	return NULL;
+    }
+    if (pipe2(fds, O_CLOEXEC) < 0) {
+	free(buffer);
+	return NULL;
+    }
+    args[0] = "unrar";
+    args[1] = "p";
+    args[2] = "-inul";
+    args[3] = "-c-";
+    args[4] = "-@";			// no '@' list files
+    args[5] = "--";
+    args[6] = archive->Path;
+    args[7] = name;
+    args[8] = NULL;
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null",
+	O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+    err = posix_spawnp(&pid, args[0], &actions, NULL, (char *const *)args,
+	environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    if (err) {
+	Error(_("archive: posix_spawn of '%s' failed: %s\n"), args[0],
+	    strerror(err));
+	close(fds[0]);
+	free(buffer);
+	return NULL;
+    }
+
+    got = 0;
+    while (got < entry->Length) {
+	ssize_t n;
+
+	n = read(fds[0], buffer + got, entry->Length - got < 65536 ?
+	    entry->Length - got : 65536);
+	if (n < 0 && errno == EINTR) {
+	    continue;
+	}
+	if (n <= 0) {
+	    break;
+	}
+	got += n;
+    }
+    close(fds[0]);			// unrar gets SIGPIPE, if it has more
+    status = -1;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+
+    if (got != entry->Length || !WIFEXITED(status) || WEXITSTATUS(status)) {
+	Debug(3, "archive: unrar of '%s' failed\n", name);
+	free(buffer);
+	return NULL;
+    }
+    return buffer;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Cache
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Free an archive.
+**
+**	@param archive	archive without users
+*/
+static void ArchiveFree(Archive * archive)
+{
+    int i;
+
+    if (archive->Map) {
+	munmap(archive->Map, archive->MapSize);
+    }
+    if (archive->Fd >= 0) {
+	close(archive->Fd);
+    }
+    for (i = 0; i < archive->PointN; ++i) {
+	free(archive->Points[i].Window);
+    }
+    free(archive->Points);
+    free(archive->Entries);
+    free(archive->Names);
+    free(archive->Path);
+    free(archive);
+}
+
+/**
+**	Map an archive and read its entry table.
+**
+**	The format is detected by its content.
+**
+**	@param path	path and name of archive
+**	@param st	status of archive
+**
+**	@returns archive, NULL if any error occurs.
+*/
+static Archive *ArchiveLoad(const char *path, const struct stat *st)
+{
+    Archive *archive;
+    const uint8_t *map;
+    int err;
+
+    if (!S_ISREG(st->st_mode) || st->st_size <= 0
+	|| (uint64_t) st->st_size > SIZE_MAX) {
+	errno = EINVAL;
+	return NULL;
+    }
+    if (!(archive = calloc(1, sizeof(*archive)))
+	|| !(archive->Path = strdup(path))) {
+	free(archive);
+	errno = ENOMEM;
+	return NULL;
+    }
+    archive->Stat = *st;
+    if ((archive->Fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+	ArchiveFree(archive);
+	return NULL;
+    }
+    archive->MapSize = st->st_size;
+    archive->Map =
+	mmap(NULL, archive->MapSize, PROT_READ, MAP_SHARED, archive->Fd, 0);
+    if (archive->Map == MAP_FAILED) {
+	archive->Map = NULL;
+	ArchiveFree(archive);
+	return NULL;
+    }
+    // truncated since the stat
+    if (!ArchiveMapped(archive)) {
+	ArchiveFree(archive);
+	errno = EINVAL;
+	return NULL;
+    }
+    map = archive->Map;
+    if (archive->MapSize >= 4 && map[0] == 'P' && map[1] == 'K') {
+	archive->Format = ARCHIVE_ZIP;
+	err = ZipRead(archive);
+    } else if (archive->MapSize >= 7 && !memcmp(map, "Rar!\x1A\x07", 6)) {
+	archive->Format = ARCHIVE_RAR;
+	err = RarRead(archive);
+    } else if (archive->MapSize >= 2 && map[0] == 0x1F && map[1] == 0x8B) {
+	archive->Format = ARCHIVE_GZIP;
+	err = GzipRead(archive);
+    } else if (archive->MapSize >= 512 && TarChecksum(map)) {
+	archive->Format = ARCHIVE_TAR;
+	err = TarRead(archive);
+    } else {
+	err = -1;
+    }
+    if (err < 0) {
+	Error(_("archive: can't read '%s'\n"), path);
+	ArchiveFree(archive);
+	errno = EINVAL;
+	return NULL;
+    }
+    qsort_r(archive->Entries, archive->Count, sizeof(*archive->Entries),
+	ArchiveCompare, archive->Names);
+    Debug(3, "archive: '%s' %d entries %d checkpoints\n", path,
+	archive->Count, archive->PointN);
+
+    return archive;
+}
+
+/**
+**	Release an archive got with ArchiveGet().
+**
+**	@param archive	archive
+*/
+static void ArchiveRelease(Archive * archive)
+{
+    pthread_mutex_lock(&ArchiveMutex);
+    if (!--archive->Users && archive->Dropped) {
+	ArchiveFree(archive);
+    }
+    pthread_mutex_unlock(&ArchiveMutex);
+}
+
+/**
+**	Get the cached archive, read it, if it isn't cached or outdated.
+**
+**	@param path	path and name of archive
+**
+**	@returns archive, release with ArchiveRelease(), NULL if any error
+**	occurs.
+*/
+static Archive *ArchiveGet(const char *path)
+{
+    Archive **prev;
+    Archive *archive;
+    struct stat st;
+    int n;
+
+    if (stat(path, &st) < 0) {
+	return NULL;
+    }
+    pthread_mutex_lock(&ArchiveMutex);
+    for (prev = &ArchiveList; (archive = *prev); prev = &archive->Next) {
+	if (!strcmp(archive->Path, path)) {
+	    *prev = archive->Next;
+	    if (archive->Stat.st_dev == st.st_dev
+		&& archive->Stat.st_ino == st.st_ino
+		&& archive->Stat.st_size == st.st_size
+		&& archive->Stat.st_mtim.tv_sec == st.st_mtim.tv_sec
+		&& archive->Stat.st_mtim.tv_nsec == st.st_mtim.tv_nsec) {
+		archive->Next = ArchiveList;	// move to front
+		ArchiveList = archive;
+		archive->Users++;
+		pthread_mutex_unlock(&ArchiveMutex);
+		return archive;
+	    }
+	    // outdated
+	    if (archive->Users) {
+		archive->Dropped = 1;
+	    } else {
+		ArchiveFree(archive);
+	    }
+	    break;
+	}
+    }
+    pthread_mutex_unlock(&ArchiveMutex);
+
+    // read without lock, other archives can be used meanwhile
+    if (!(archive = ArchiveLoad(path, &st))) {
+	return NULL;
+    }
+
+    pthread_mutex_lock(&ArchiveMutex);
+    archive->Next = ArchiveList;
+    ArchiveList = archive;
+    archive->Users++;
+    // drop least recently used, a second read of the same archive too
+    n = 0;
+    prev = &archive->Next;
+    while (*prev) {
+	Archive *old;
+
+	old = *prev;
+	if (++n >= ARCHIVE_CACHE || !strcmp(old->Path, path)) {
+	    *prev = old->Next;
+	    if (old->Users) {
+		old->Dropped = 1;
+	    } else {
+		ArchiveFree(old);
+	    }
+	    continue;
+	}
+	prev = &old->Next;
+    }
+    pthread_mutex_unlock(&ArchiveMutex);
+
+    return archive;
+}
+
+/**
+**	Find the first member, whose name isn't less than a key.
+**
+**	@param archive	archive
+**	@param key	name to search
+**
+**	@returns index of member, count if all are less.
+*/
+static int ArchiveLowerBound(const Archive * archive, const char *key)
+{
+    int low;
+    int high;
+
+    low = 0;
+    high = archive->Count;
+    while (low < high) {
+	int mid;
+
+	mid = (low + high) / 2;
+	if (strcmp(archive->Names + archive->Entries[mid].Name, key) < 0) {
+	    low = mid + 1;
+	} else {
+	    high = mid;
+	}
+    }
+    return low;
+}
+
+/**
+**	Get the cached archive of an archive path.
+**
+**	@param path		path of archive member
+**	@param[out] member	name of member in archive
+**
+**	@returns archive, release with ArchiveRelease(), NULL if any error
+**	occurs.
+*/
+static Archive *ArchiveOfPath(const char *path, const char **member)
+{
+    const char *split;
+    Archive *archive;
+    char *name;
+
+    if (!(split = ArchiveSplit(path))) {
+	errno = ENOENT;
+	return NULL;
+    }
+    if (!(name = strndup(path, split - path))) {
+	return NULL;
+    }
+    archive = ArchiveGet(name);
+    free(name);
+    *member = split + 1;
+
+    return archive;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Stream
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Read from an archive member stream.
+*/
+static ssize_t ArchiveStreamRead(void *cookie, char *buf, size_t size)
+{
+    ArchiveStream *stream;
+
+    stream = cookie;
+    if (size > stream->Size - stream->Pos) {
+	size = stream->Size - stream->Pos;
+    }
+    // read from the mapping
+    if (stream->Archive && size && !ArchiveMapped(stream->Archive)) {
+	errno = EIO;
+	return -1;
+    }
+    memcpy(buf, stream->Data + stream->Pos, size);
+    stream->Pos += size;
+
+    return size;
+}
+
+/**
+**	Seek in an archive member stream.
+*/
+static int ArchiveStreamSeek(void *cookie, off64_t * offset, int whence)
+{
+    ArchiveStream *stream;
+    off64_t pos;
+
+    stream = cookie;
+    switch (whence) {
+	case SEEK_SET:
+	    pos = *offset;
+	    break;
+	case SEEK_CUR:
+	    pos = stream->Pos + *offset;
+	    break;
+	case SEEK_END:
+	    pos = stream->Size + *offset;
+	    break;
+	default:
+	    errno = EINVAL;
+	    return -1;
+    }
+    if (pos < 0 || (uint64_t) pos > stream->Size) {
+	errno = EINVAL;
+	return -1;
+    }
+    stream->Pos = pos;
+    *offset = pos;
+
+    return 0;
+}
+
+/**
+**	Close an archive member stream.
+*/
+static int ArchiveStreamClose(void *cookie)
+{
+    ArchiveStream *stream;
+
+    stream = cookie;
+    if (stream->Archive) {
+	ArchiveRelease(stream->Archive);
+    }
+    free(stream->Buffer);
+    free(stream);
+
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Functions
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Find the '#' of an archive path.
+**
+**	"dir/file.cbz#page.jpg" is the member "page.jpg" of the archive
+**	"dir/file.cbz".  A '#' in other names isn't a split.
+**
+**	@param path	path and name
+**
+**	@returns pointer to the '#' behind the archive name, NULL if path
+**	isn't in an archive.
+*/
+const char *ArchiveSplit(const char *path)
+{
+    const char *s;
+    char *name;
+    int archive;
+
+    for (s = strchr(path, '#'); s; s = strchr(s + 1, '#')) {
+	if (!(name = strndup(path, s - path))) {
+	    return NULL;
+	}
+	archive = IsArchive(name);
+	free(name);
+	if (archive) {
+	    return s;
+	}
+    }
+    return NULL;
+}
+
+/**
+**	Get status of a file, directory or archive member.
+**
+**	Members and directories of an archive have the status of the
+**	archive, with their type and size.
+**
+**	@param path	path and name
+**	@param[out] st	status
+**
+**	@retval <0	if any error occurs
+**	@retval 0	no errors occurs
+*/
+int ArchiveStat(const char *path, struct stat *st)
+{
+    Archive *archive;
+    const char *split;
+    const char *member;
+    char *key;
+    size_t len;
+    int i;
+
+    if (!(split = ArchiveSplit(path))) {
+	return stat(path, st);
+    }
+    if (!split[1]) {			// root: the index isn't needed
+	if (!(key = strndup(path, split - path))) {
+	    return -1;
+	}
+	i = stat(key, st);
+	free(key);
+	st->st_mode = (st->st_mode & ~S_IFMT) | S_IFDIR;
+	return i;
+    }
+    if (!(archive = ArchiveOfPath(path, &member))) {
+	return -1;
+    }
+    *st = archive->Stat;
+    st->st_mode = (st->st_mode & ~S_IFMT) | S_IFDIR;
+    len = strlen(member);
+    if (!(key = malloc(len + 2))) {
+	ArchiveRelease(archive);
+	return -1;
+    }
+    strcpy(key, member);
+    if (key[len - 1] != '/') {
+	i = ArchiveLowerBound(archive, key);
+	if (i < archive->Count
+	    && !strcmp(archive->Names + archive->Entries[i].Name, key)) {
+	    st->st_mode = (st->st_mode & ~S_IFMT) | S_IFREG;
+	    st->st_size = archive->Entries[i].Length;
+	    free(key);
+	    ArchiveRelease(archive);
+	    return 0;
+	}
+	strcpy(key + len, "/");
+    }
+    // directory: any member starts with "name/"
+    i = ArchiveLowerBound(archive, key);
+    if (i >= archive->Count
+	|| strncmp(archive->Names + archive->Entries[i].Name, key,
+	    strlen(key))) {
+	free(key);
+	ArchiveRelease(archive);
+	errno = ENOENT;
+	return -1;
+    }
+    free(key);
+    ArchiveRelease(archive);
+    return 0;
+}
+
+/**
+**	Read a directory of an archive.
+**
+**	Directories without own entry are listed too, the mac resource
+**	fork directory is hidden.
+**
+**	@param path	path of directory, '/' or '#' terminated
+**	@param cb_add	call back with name, length and directory flag,
+**			returns false to stop
+**	@param opaque	privat parameter for the call back
+**
+**	@retval <0	if any error occurs
+**	@retval 0	no errors occurs
+*/
+int ArchiveReadDirectory(const char *path, int (*cb_add) (void *,
+	const char *, int, int), void *opaque)
+{
+    Archive *archive;
+    const char *member;
+    const char *last;
+    int last_len;
+    size_t len;
+    int i;
+
+    if (!(archive = ArchiveOfPath(path, &member))) {
+	return -1;
+    }
+    len = strlen(member);
+    last = NULL;
+    last_len = 0;
+    // all members of a directory follow each other in the sorted table
+    for (i = ArchiveLowerBound(archive, member); i < archive->Count; ++i) {
+	const char *name;
+	const char *slash;
+	int ok;
+
+	name = archive->Names + archive->Entries[i].Name;
+	if (strncmp(name, member, len)) {
+	    break;
+	}
+	name += len;
+	if (!*name || (!len && !strncmp(name, "__MACOSX/", 9))) {
+	    continue;
+	}
+	if ((slash = strchr(name, '/'))) {
+	    // directory: list its name once
+	    if (last && slash - name == last_len
+		&& !strncmp(name, last, last_len)) {
+		continue;
+	    }
+	    last = name;
+	    last_len = slash - name;
+	    ok = cb_add(opaque, name, last_len, 1);
+	} else {
+	    ok = cb_add(opaque, name, strlen(name), 0);
+	}
+	if (!ok) {
+	    ArchiveRelease(archive);
+	    return -1;
+	}
+    }
+    ArchiveRelease(archive);
+
+    return 0;
+}
+
+/**
+**	Open a file or archive member for reading.
+**
+**	Archive members are read from memory, the stream can seek.
+**
+**	@param path	path and name
+**
+**	@returns stdio stream, NULL if any error occurs.
+*/
+FILE *ArchiveFopen(const char *path)
+{
+    static const cookie_io_functions_t functions = {
+	ArchiveStreamRead, NULL, ArchiveStreamSeek, ArchiveStreamClose
+    };
+    Archive *archive;
+    const ArchiveEntry *entry;
+    const char *member;
+    const uint8_t *data;
+    ArchiveStream *stream;
+    FILE *file;
+    int i;
+
+    if (!ArchiveSplit(path)) {
+	return fopen(path, "rbe");
+    }
+    if (!(archive = ArchiveOfPath(path, &member))) {
+	return NULL;
+    }
+    i = ArchiveLowerBound(archive, member);
+    if (i >= archive->Count
+	|| strcmp(archive->Names + archive->Entries[i].Name, member)) {
+	ArchiveRelease(archive);
+	errno = ENOENT;
+	return NULL;
+    }
+    entry = archive->Entries + i;
+    if (!(stream = calloc(1, sizeof(*stream)))) {
+	ArchiveRelease(archive);
+	return NULL;
+    }
+    stream->Size = entry->Length;
+    data = NULL;
+    if (entry->Length > ARCHIVE_LENGTH) {
+	// too big for memory
+    } else if (!ArchiveMapped(archive)) {
+	// truncated or rewritten
+    } else if (archive->Format == ARCHIVE_ZIP) {
+	if (!(data = ZipData(archive, entry))) {
+	    // broken
+	} else if (entry->Method == ZIP_DEFLATED) {
+	    stream->Buffer = ZipInflate(data, entry->Size, entry->Length);
+	    data = NULL;
+	} else if (entry->Method != ZIP_STORED
+	    || entry->Size != entry->Length) {
+	    data = NULL;
+	}
+    } else if (archive->Format == ARCHIVE_GZIP) {
+	stream->Buffer = GzipExtract(archive, entry);
+    } else if (archive->Format == ARCHIVE_RAR
+	&& entry->Method == RAR_PACKED) {
+	stream->Buffer = RarExtract(archive, entry);
+    } else if (entry->Offset <= archive->MapSize
+	&& entry->Length <= archive->MapSize - entry->Offset) {
+	data = archive->Map + entry->Offset;	// tar or stored rar
+    }
+    if (data) {
+	// read from the mapping, the archive is kept until close
+	stream->Archive = archive;
+	stream->Data = data;
+    } else {
+	stream->Data = stream->Buffer;
+    }
+    if (!stream->Archive) {
+	ArchiveRelease(archive);
+    }
+    if (!stream->Data) {
+	Debug(3, "archive: can't extract '%s'\n", path);
+	free(stream);
+	errno = EINVAL;
+	return NULL;
+    }
+    if (!(file = fopencookie(stream, "rb", functions))) {
+	ArchiveStreamClose(stream);
+	return NULL;
+    }
+    return file;
+}
+
+/**
+**	Free the cached archives.
+**
+**	Archives of open streams are freed, when they are closed.
+*/
+void ArchiveExit(void)
+{
+    Archive *archive;
+
+    pthread_mutex_lock(&ArchiveMutex);
+    while ((archive = ArchiveList)) {
+	ArchiveList = archive->Next;
+	if (archive->Users) {
+	    archive->Dropped = 1;
+	} else {
+	    ArchiveFree(archive);
+	}
+    }
+    pthread_mutex_unlock(&ArchiveMutex);
+}
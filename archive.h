@@ -0,0 +1,39 @@
+///
+///	@file archive.h		@brief archive module header file
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+struct stat;
+
+    /// find the '#' of an archive path
+extern const char *ArchiveSplit(const char *);
+
+    /// stat a file, directory or archive member
+extern int ArchiveStat(const char *, struct stat *);
+
+    /// read a directory of an archive
+extern int ArchiveReadDirectory(const char *, int (*cb_add) (void *,
+	const char *, int, int), void *);
+
+    /// open a file or archive member for reading
+extern FILE *ArchiveFopen(const char *);
+
+    /// free the cached archives
+extern void ArchiveExit(void);
@@ -0,0 +1,458 @@
+///
+///	@file exif.c		@brief exif module
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup Exif The exif module.
+///
+///	Reads the exif data (APP1 segment) of camera jpeg files: the
+///	orientation tag and the embedded jpeg thumbnail of about 160x120.
+///	The APP1 segment is limited to 64k and follows the start of image,
+///	the caller reads the head of the file (#EXIF_HEAD bytes) with a
+///	single read, no further i/o is needed.
+///
+///	A thumbnail with another aspect than the image is ignored, some
+///	cameras pad it with black bars.
+///
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "exif.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//	Defines
+//////////////////////////////////////////////////////////////////////////////
+
+#define EXIF_ORIENTATION	0x0112	///< ifd0 orientation tag
+#define EXIF_IFD_POINTER	0x8769	///< ifd0 pointer to exif ifd
+#define EXIF_THUMB_OFFSET	0x0201	///< ifd1 offset of jpeg thumbnail
+#define EXIF_THUMB_LENGTH	0x0202	///< ifd1 length of jpeg thumbnail
+#define EXIF_PIXEL_X		0xA002	///< exif ifd width of image
+#define EXIF_PIXEL_Y		0xA003	///< exif ifd height of image
+
+#define EXIF_SHORT	3		///< tiff type 16 bit unsigned
+#define EXIF_LONG	4		///< tiff type 32 bit unsigned
+
+//////////////////////////////////////////////////////////////////////////////
+//	Typedefs
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Tiff structure of the exif data.
+///
+typedef struct _exif_tiff_
+{
+    const uint8_t *Data;		///< tiff header and ifds
+    uint32_t Size;			///< bytes of tiff data
+    int BigEndian;			///< motorola byte order
+    uint32_t Width;			///< width of image, 0 unknown
+    uint32_t Height;			///< height of image, 0 unknown
+    uint32_t ThumbOffset;		///< offset of thumbnail in tiff data
+    uint32_t ThumbLength;		///< bytes of thumbnail
+} ExifTiff;
+
+//////////////////////////////////////////////////////////////////////////////
+//	Tiff
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Get 16 bit value in byte order of tiff data.
+**
+**	@param tiff	tiff data
+**	@param offset	offset of value, checked by caller
+*/
+static uint32_t ExifGet16(const ExifTiff * tiff, uint32_t offset)
+{
+    const uint8_t *p;
+
+    p = tiff->Data + offset;
+    if (tiff->BigEndian) {
+	return (p[0] << 8) | p[1];
+    }
+    return p[0] | (p[1] << 8);
+}
+
+/**
+**	Get 32 bit value in byte order of tiff data.
+**
+**	@param tiff	tiff data
+**	@param offset	offset of value, checked by caller
+*/
+static uint32_t ExifGet32(const ExifTiff * tiff, uint32_t offset)
+{
+    const uint8_t *p;
+
+    p = tiff->Data + offset;
+    if (tiff->BigEndian) {
+	return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+    }
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/**
+**	Get the value of an ifd entry of type short or long.
+**
+**	@param tiff	tiff data
+**	@param entry	offset of 12 byte ifd entry
+**
+**	@returns value, 0 for other types.
+*/
+static uint32_t ExifValue(const ExifTiff * tiff, uint32_t entry)
+{
+    switch (ExifGet16(tiff, entry + 2)) {
+	case EXIF_SHORT:
+	    return ExifGet16(tiff, entry + 8);
+	case EXIF_LONG:
+	    return ExifGet32(tiff, entry + 8);
+    }
+    return 0;
+}
+
+/**
+**	Read the tags of an ifd.
+**
+**	@param tiff	tiff data
+**	@param offset	offset of ifd
+**	@param exif	orientation is stored here
+**	@param[out] next	offset of next ifd, NULL don't care
+**	@param[out] sub	offset of exif ifd, NULL don't care
+**
+**	@returns true if the ifd is valid.
+*/
+static int ExifIfd(ExifTiff * tiff, uint32_t offset, Exif * exif,
+    uint32_t * next, uint32_t * sub)
+{
+    uint32_t entry;
+    uint32_t n;
+    uint32_t i;
+
+    if (offset < 8 || offset > tiff->Size - 2) {
+	return 0;
+    }
+    n = ExifGet16(tiff, offset);
+    if (n * 12 + 4 > tiff->Size - offset - 2) {
+	return 0;
+    }
+    for (i = 0; i < n; ++i) {
+	entry = offset + 2 + i * 12;
+	switch (ExifGet16(tiff, entry)) {
+	    case EXIF_ORIENTATION:
+		exif->Orientation = ExifValue(tiff, entry);
+		break;
+	    case EXIF_IFD_POINTER:
+		if (sub) {
+		    *sub = ExifValue(tiff, entry);
+		}
+		break;
+	    case EXIF_THUMB_OFFSET:
+		tiff->ThumbOffset = ExifValue(tiff, entry);
+		break;
+	    case EXIF_THUMB_LENGTH:
+		tiff->ThumbLength = ExifValue(tiff, entry);
+		break;
+	    case EXIF_PIXEL_X:
+		tiff->Width = ExifValue(tiff, entry);
+		break;
+	    case EXIF_PIXEL_Y:
+		tiff->Height = ExifValue(tiff, entry);
+		break;
+	}
+    }
+    if (next) {
+	*next = ExifGet32(tiff, offset + 2 + n * 12);
+    }
+    return 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Jpeg
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Find a segment of a jpeg image.
+**
+**	@param data	jpeg data starting with the start of image marker
+**	@param size	bytes of jpeg data
+**	@param match	function to test the marker of a segment
+**	@param[out] length	bytes of segment data without marker and length
+**
+**	@returns segment data, NULL if not found before the scan data.
+*/
+static const uint8_t *ExifSegment(const uint8_t * data, size_t size,
+    int (*match) (int), size_t * length)
+{
+    size_t i;
+    size_t n;
+    int marker;
+
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+	return NULL;
+    }
+    i = 2;
+    while (i + 4 <= size && data[i] == 0xFF) {
+	marker = data[i + 1];
+	if (marker == 0xFF) {		// fill byte
+	    ++i;
+	    continue;
+	}
+	if (marker == 0xDA || marker == 0xD9) {	// start of scan, end
+	    break;
+	}
+	n = (data[i + 2] << 8) | data[i + 3];
+	if (n < 2) {
+	    break;
+	}
+	if (match(marker)) {
+	    if (i + 2 + n > size) {	// truncated
+		break;
+	    }
+	    *length = n - 2;
+	    return data + i + 4;
+	}
+	i += 2 + n;
+    }
+    return NULL;
+}
+
+/**
+**	Test for the APP1 marker.
+*/
+static int ExifIsApp1(int marker)
+{
+    return marker == 0xE1;
+}
+
+/**
+**	Test for a start of frame marker.
+*/
+static int ExifIsFrame(int marker)
+{
+    return marker >= 0xC0 && marker <= 0xCF && marker != 0xC4
+	&& marker != 0xC8 && marker != 0xCC;
+}
+
+/**
+**	Check the embedded thumbnail.
+**
+**	@param tiff	tiff data with thumbnail and image size
+**
+**	@returns true if thumbnail is a jpeg with the aspect of the image.
+*/
+static int ExifThumbnailValid(const ExifTiff * tiff)
+{
+    const uint8_t *frame;
+    size_t n;
+    uint64_t a;
+    uint64_t b;
+    uint32_t width;
+    uint32_t height;
+
+    if (!(frame =
+	    ExifSegment(tiff->Data + tiff->ThumbOffset, tiff->ThumbLength,
+		ExifIsFrame, &n)) || n < 5) {
+	return 0;
+    }
+    height = (frame[1] << 8) | frame[2];
+    width = (frame[3] << 8) | frame[4];
+    if (!width || !height) {
+	return 0;
+    }
+    if (!tiff->Width || !tiff->Height) {	// size of image unknown
+	return 1;
+    }
+    // aspects may differ by rounding, black bars differ more than 3%
+    a = (uint64_t) width *tiff->Height;
+    b = (uint64_t) height *tiff->Width;
+
+    return (a > b ? a - b : b - a) * 32 <= (a > b ? a : b);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Functions
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Parse the exif data of a jpeg file head.
+**
+**	@param head	first bytes of file, #EXIF_HEAD contain all exif data
+**	@param size	bytes of head
+**	@param[out] exif	orientation and thumbnail, the thumbnail points
+**		into head
+**
+**	@returns true if exif data is found.
+*/
+int ExifParse(const uint8_t * head, size_t size, Exif * exif)
+{
+    ExifTiff tiff;
+    const uint8_t *app1;
+    size_t n;
+    uint32_t ifd1;
+    uint32_t sub;
+
+    exif->Orientation = 1;
+    exif->Thumbnail = NULL;
+    exif->ThumbnailSize = 0;
+
+    if (!(app1 = ExifSegment(head, size, ExifIsApp1, &n)) || n < 6 + 8
+	|| memcmp(app1, "Exif\0\0", 6)) {
+	return 0;
+    }
+    memset(&tiff, 0, sizeof(tiff));
+    tiff.Data = app1 + 6;
+    tiff.Size = n - 6;
+    if (!memcmp(tiff.Data, "MM\0\x2A", 4)) {
+	tiff.BigEndian = 1;
+    } else if (memcmp(tiff.Data, "II\x2A\0", 4)) {
+	return 0;
+    }
+
+    ifd1 = 0;
+    sub = 0;
+    if (!ExifIfd(&tiff, ExifGet32(&tiff, 4), exif, &ifd1, &sub)) {
+	return 0;
+    }
+    if (exif->Orientation < 1 || exif->Orientation > 8) {
+	exif->Orientation = 1;
+    }
+    if (sub) {
+	ExifIfd(&tiff, sub, exif, NULL, NULL);
+    }
+    if (ifd1 && ExifIfd(&tiff, ifd1, exif, NULL, NULL)
+	&& tiff.ThumbOffset && tiff.ThumbLength
+	&& tiff.ThumbOffset < tiff.Size
+	&& tiff.ThumbLength <= tiff.Size - tiff.ThumbOffset
+	&& ExifThumbnailValid(&tiff)) {
+	exif->Thumbnail = tiff.Data + tiff.ThumbOffset;
+	exif->ThumbnailSize = tiff.ThumbLength;
+    }
+    return 1;
+}
+
+/**
+**	Rotate and mirror pixels into the orientation of an image.
+**
+**	Orientation 5-8 swap width and height.
+**
+**	@param pixels	pixels as stored in the file
+**	@param bpp	bytes per pixel
+**	@param[in,out] width	width of pixels, width of result
+**	@param[in,out] height	height of pixels, height of result
+**	@param orientation	tiff orientation 1-8
+**
+**	@returns malloced pixels, NULL if nothing to do or out of memory.
+*/
+void *ExifOrient(const void *pixels, int bpp, int *width, int *height,
+    int orientation)
+{
+    uint8_t *out;
+    ptrdiff_t origin;
+    ptrdiff_t step_x;
+    ptrdiff_t step_y;
+    ptrdiff_t w;
+    ptrdiff_t h;
+    ptrdiff_t i;
+    int out_width;
+    int out_height;
+    int x;
+    int y;
+
+    w = *width;
+    h = *height;
+    // source pixel of the top left result pixel, steps of a result pixel
+    switch (orientation) {
+	case 2:			// mirror horizontal
+	    origin = w - 1;
+	    step_x = -1;
+	    step_y = w;
+	    break;
+	case 3:			// rotate 180
+	    origin = (h - 1) * w + w - 1;
+	    step_x = -1;
+	    step_y = -w;
+	    break;
+	case 4:			// mirror vertical
+	    origin = (h - 1) * w;
+	    step_x = 1;
+	    step_y = -w;
+	    break;
+	case 5:			// transpose
+	    origin = 0;
+	    step_x = w;
+	    step_y = 1;
+	    break;
+	case 6:			// rotate 90 clockwise
+	    origin = (h - 1) * w;
+	    step_x = -w;
+	    step_y = 1;
+	    break;
+	case 7:			// transverse
+	    origin = (h - 1) * w + w - 1;
+	    step_x = -w;
+	    step_y = -1;
+	    break;
+	case 8:			// rotate 90 counter clockwise
+	    origin = w - 1;
+	    step_x = w;
+	    step_y = -1;
+	    break;
+	default:
+	    return NULL;
+    }
+    out_width = orientation >= 5 ? h : w;
+    out_height = orientation >= 5 ? w : h;
+    if (!(out = malloc((size_t) w * h * bpp))) {
+	return NULL;
+    }
+
+    if (bpp == 4) {			// ARGB fast path
+	const uint32_t *src;
+	uint32_t *dst;
+
+	src = pixels;
+	dst = (uint32_t *) out;
+	for (y = 0; y < out_height; ++y) {
+	    for (x = 0, i = origin + y * step_y; x < out_width; ++x) {
+		*dst++ = src[i];
+		i += step_x;
+	    }
+	}
+    } else {
+	const uint8_t *src;
+	uint8_t *dst;
+
+	src = pixels;
+	dst = out;
+	for (y = 0; y < out_height; ++y) {
+	    for (x = 0, i = origin + y * step_y; x < out_width; ++x) {
+		memcpy(dst, src + i * bpp, bpp);
+		dst += bpp;
+		i += step_x;
+	    }
+	}
+    }
+    *width = out_width;
+    *height = out_height;
+
+    return out;
+}
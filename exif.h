@@ -0,0 +1,40 @@
+///
+///	@file exif.h		@brief exif module header file
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+    /// bytes of the file head, which contain the exif data
+#define EXIF_HEAD	(66 * 1024)
+
+///
+///	Exif data of a jpeg image.
+///
+typedef struct _exif_
+{
+    int Orientation;			///< tiff orientation 1-8
+    const uint8_t *Thumbnail;		///< embedded jpeg thumbnail, or NULL
+    size_t ThumbnailSize;		///< bytes of thumbnail
+} Exif;
+
+    /// parse the exif data of a jpeg file head
+extern int ExifParse(const uint8_t *, size_t, Exif *);
+
+    /// rotate and mirror pixels into the orientation of an image
+extern void *ExifOrient(const void *, int, int *, int *, int);
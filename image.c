@@ -0,0 +1,992 @@
+///
+///	@file image.c		@brief image decoder module
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup Image The image decoder module.
+///
+///	Decodes jpeg and png images for the slideshow, scaled to fit the
+///	OSD.  jpeg images are decoded with the DCT scaling of libjpeg at
+///	1/2, 1/4 or 1/8 of their size, a big photo is decoded at about the
+///	OSD size.  The rest is scaled with swscale, without swscale with a
+///	bilinear filter.  The functions are thread-safe.
+///
+///	The slideshow prefetches the next and previous images of its
+///	directory, a pool of workers decodes them into a LRU cache of
+///	display ready ARGB frames, bounded by a memory budget.
+///
+///	The exif orientation of camera jpeg files is applied.  Until the
+///	decode of a camera jpeg is done, the slideshow shows its exif
+///	thumbnail scaled up as preview.
+///
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#ifdef USE_JPG
+#include <setjmp.h>
+#include <jpeglib.h>
+#endif
+#ifdef USE_PNG
+#include <png.h>
+#endif
+#ifdef USE_SWSCALE
+#include <libswscale/swscale.h>
+#endif
+
+#include <libintl.h>
+#define _(str) gettext(str)		///< gettext shortcut
+#define _N(str) str			///< gettext_noop shortcut
+
+#include "archive.h"
+#include "exif.h"
+#include "image.h"
+#include "worker.h"
+#include "misc.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//	Defines
+//////////////////////////////////////////////////////////////////////////////
+
+#define IMAGE_PIXELS	(64 * 1024 * 1024)	///< max pixels of decode
+#define IMAGE_THREADS	2		///< number of prefetch workers
+#define IMAGE_QUEUE	16		///< size of the prefetch queue
+#define IMAGE_BUDGET	(128 * 1024 * 1024)	///< bytes of cached frames
+#define IMAGE_FRAMES	256		///< max cached frames (linear lookup)
+
+//////////////////////////////////////////////////////////////////////////////
+//	Typedefs
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Request to decode an image scaled to fit a size.
+///
+typedef struct _image_request_
+{
+    char *Filename;			///< path and name of image
+    int Width;				///< width to fit
+    int Height;				///< height to fit
+} ImageRequest;
+
+///
+///	Decoded image of the cache.
+///
+typedef struct _image_frame_
+{
+    struct _image_frame_ *Prev;		///< more recently used frame
+    struct _image_frame_ *Next;		///< less recently used frame
+    ImageRequest Request;		///< decoded image and fit size
+    int Width;				///< width of frame
+    int Height;				///< height of frame
+    uint32_t *Pixels;			///< ARGB pixels, NULL can't decode
+} ImageFrame;
+
+//////////////////////////////////////////////////////////////////////////////
+//	Variables
+//////////////////////////////////////////////////////////////////////////////
+
+static void ImageHandle(void *, unsigned);
+static int ImageSameRequest(const void *, const void *);
+
+    /// prefetch workers, an image already queued isn't queued again
+static WorkerPool ImagePool = {
+    .Name = "image",
+    .Threads = IMAGE_THREADS,
+    .Size = IMAGE_QUEUE,
+    .Handle = ImageHandle,
+    .Same = ImageSameRequest,
+    .Mutex = PTHREAD_MUTEX_INITIALIZER,
+    .Cond = PTHREAD_COND_INITIALIZER,
+};
+
+    /// protects the frame cache and the running decodes
+static pthread_mutex_t ImageMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ImageDoneCond = PTHREAD_COND_INITIALIZER;
+
+    /// running decodes of the workers, the last is of ImageFetch
+static ImageRequest ImageBusy[IMAGE_THREADS + 1];
+
+static ImageFrame *ImageFirst;		///< most recently used frame
+static ImageFrame *ImageLast;		///< least recently used frame
+static size_t ImageBytes;		///< bytes of cached frames and entries
+static int ImageFrames;			///< number of cached frames
+
+//////////////////////////////////////////////////////////////////////////////
+//	Scaler
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Calculate the size of an image scaled to fit, keeps the aspect.
+**
+**	@param width	image width
+**	@param height	image height
+**	@param[in,out] out_width	max width, scaled width
+**	@param[in,out] out_height	max height, scaled height
+*/
+static void ImageFit(int width, int height, int *out_width, int *out_height)
+{
+    if ((int64_t) width * *out_height > (int64_t) height * *out_width) {
+	*out_height = (int64_t) height * *out_width / width;
+    } else {
+	*out_width = (int64_t) width * *out_height / height;
+    }
+    if (*out_width < 1) {
+	*out_width = 1;
+    }
+    if (*out_height < 1) {
+	*out_height = 1;
+    }
+}
+
+#ifdef USE_SWSCALE
+
+/**
+**	Scale RGB pixels to ARGB pixels with swscale.
+**
+**	@param rgb	RGB pixels
+**	@param width	image width
+**	@param height	image height
+**	@param out_width	scaled width
+**	@param out_height	scaled height
+**
+**	@returns malloced ARGB pixels, NULL on errors.
+*/
+static uint32_t *ImageScale(const uint8_t * rgb, int width, int height,
+    int out_width, int out_height)
+{
+    struct SwsContext *ctx;
+    const uint8_t *src[1];
+    uint8_t *dst[1];
+    int src_stride[1];
+    int dst_stride[1];
+    uint32_t *argb;
+
+    if (!(argb = malloc(out_width * out_height * sizeof(*argb)))) {
+	return NULL;
+    }
+    // BGRA in memory is ARGB in a little endian uint32_t
+    if (!(ctx = sws_getContext(width, height, AV_PIX_FMT_RGB24, out_width,
+		out_height, AV_PIX_FMT_BGRA, SWS_BICUBIC, NULL, NULL,
+		NULL))) {
+	free(argb);
+	return NULL;
+    }
+    src[0] = rgb;
+    src_stride[0] = width * 3;
+    dst[0] = (uint8_t *) argb;
+    dst_stride[0] = out_width * 4;
+    sws_scale(ctx, src, src_stride, 0, height, dst, dst_stride);
+    sws_freeContext(ctx);
+
+    return argb;
+}
+
+#else
+
+/**
+**	Scale RGB pixels to ARGB pixels with a bilinear filter.
+**
+**	@param rgb	RGB pixels
+**	@param width	image width
+**	@param height	image height
+**	@param out_width	scaled width
+**	@param out_height	scaled height
+**
+**	@returns malloced ARGB pixels, NULL on errors.
+*/
+static uint32_t *ImageScale(const uint8_t * rgb, int width, int height,
+    int out_width, int out_height)
+{
+    uint32_t *argb;
+    uint32_t *out;
+    int x;
+    int y;
+
+    if (!(argb = malloc(out_width * out_height * sizeof(*argb)))) {
+	return NULL;
+    }
+    out = argb;
+    for (y = 0; y < out_height; ++y) {
+	const uint8_t *row0;
+	const uint8_t *row1;
+	int sy;
+	int fy;
+
+	// 16.16 fixed point source position of the pixel center
+	sy = (int)(((int64_t) y * 2 + 1) * height * 32768 / out_height) -
+	    32768;
+	if (sy < 0) {
+	    sy = 0;
+	}
+	fy = (sy >> 8) & 0xFF;
+	row0 = rgb + (sy >> 16) * width * 3;
+	row1 = (sy >> 16) + 1 < height ? row0 + width * 3 : row0;
+	for (x = 0; x < out_width; ++x) {
+	    const uint8_t *p0;
+	    const uint8_t *p1;
+	    uint32_t c;
+	    int sx;
+	    int fx;
+	    int i;
+	    int n;
+
+	    sx = (int)(((int64_t) x * 2 + 1) * width * 32768 / out_width) -
+		32768;
+	    if (sx < 0) {
+		sx = 0;
+	    }
+	    fx = (sx >> 8) & 0xFF;
+	    n = (sx >> 16) + 1 < width ? 3 : 0;
+	    p0 = row0 + (sx >> 16) * 3;
+	    p1 = row1 + (sx >> 16) * 3;
+	    c = 0xFF000000U;
+	    for (i = 0; i < 3; ++i) {
+		int top;
+		int bottom;
+
+		top = p0[i] * (256 - fx) + p0[i + n] * fx;
+		bottom = p1[i] * (256 - fx) + p1[i + n] * fx;
+		c |= ((top * (256 - fy) + bottom * fy) >> 16) << (16 - i * 8);
+	    }
+	    *out++ = c;
+	}
+    }
+
+    return argb;
+}
+
+#endif
+
+/**
+**	Apply the exif orientation to ARGB pixels.
+**
+**	@param argb	ARGB pixels as stored, freed if rotated
+**	@param[in,out] width	width of pixels
+**	@param[in,out] height	height of pixels
+**	@param orientation	tiff orientation 1-8
+**
+**	@returns ARGB pixels in orientation, unchanged if out of memory.
+*/
+static uint32_t *ImageOrient(uint32_t * argb, int *width, int *height,
+    int orientation)
+{
+    uint32_t *rotated;
+
+    if (orientation > 1 && (rotated = ExifOrient(argb, sizeof(*argb), width,
+		height, orientation))) {
+	free(argb);
+	return rotated;
+    }
+    return argb;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Decoder
+//////////////////////////////////////////////////////////////////////////////
+
+#ifdef USE_JPG
+
+///
+///	libjpeg error manager, errors jump back to the decoder.
+///
+typedef struct _image_jpeg_error_
+{
+    struct jpeg_error_mgr Manager;	///< libjpeg error manager
+    jmp_buf Jump;			///< return point of decoder
+} ImageJpegError;
+
+/**
+**	libjpeg fatal error handler.
+*/
+static void ImageJpegExit(j_common_ptr cinfo)
+{
+    longjmp(((ImageJpegError *) cinfo->err)->Jump, 1);
+}
+
+/**
+**	libjpeg message handler, the messages are dropped.
+*/
+static void ImageJpegMessage(j_common_ptr cinfo)
+{
+    (void)cinfo;
+}
+
+/**
+**	Decode a jpeg image.
+**
+**	The largest DCT scaling is used, which isn't smaller than the size
+**	to fit.
+**
+**	@param file	image file
+**	@param fit_width	width to fit
+**	@param fit_height	height to fit
+**	@param[out] width	decoded width
+**	@param[out] height	decoded height
+**
+**	@returns malloced RGB pixels, NULL on errors.
+*/
+static uint8_t *ImageDecodeJpeg(FILE * file, int fit_width, int fit_height,
+    int *width, int *height)
+{
+    struct jpeg_decompress_struct cinfo;
+    ImageJpegError jerr;
+    uint8_t *volatile rgb;
+
+    rgb = NULL;
+    cinfo.err = jpeg_std_error(&jerr.Manager);
+    jerr.Manager.error_exit = ImageJpegExit;
+    jerr.Manager.output_message = ImageJpegMessage;
+    if (setjmp(jerr.Jump)) {
+	jpeg_destroy_decompress(&cinfo);
+	free(rgb);
+	return NULL;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, file);
+    jpeg_read_header(&cinfo, TRUE);
+
+    {					// not live at setjmp, no clobber
+	int w;
+	int h;
+
+	w = fit_width;
+	h = fit_height;
+	ImageFit(cinfo.image_width, cinfo.image_height, &w, &h);
+	cinfo.scale_num = 1;
+	cinfo.scale_denom = 8;
+	while (cinfo.scale_denom > 1
+	    && (cinfo.image_width / cinfo.scale_denom < (unsigned)w
+		|| cinfo.image_height / cinfo.scale_denom < (unsigned)h)) {
+	    cinfo.scale_denom /= 2;
+	}
+    }
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+
+    if (cinfo.output_components == 3
+	&& (uint64_t) cinfo.output_width * cinfo.output_height <= IMAGE_PIXELS
+	&& (rgb = malloc((size_t) cinfo.output_width *
+		cinfo.output_height * 3))) {
+	while (cinfo.output_scanline < cinfo.output_height) {
+	    JSAMPROW rows[1];
+
+	    rows[0] = rgb + (size_t) cinfo.output_scanline *
+		cinfo.output_width * 3;
+	    jpeg_read_scanlines(&cinfo, rows, 1);
+	}
+	jpeg_finish_decompress(&cinfo);
+	*width = cinfo.output_width;
+	*height = cinfo.output_height;
+    }
+    jpeg_destroy_decompress(&cinfo);
+
+    return rgb;
+}
+
+#endif
+
+#ifdef USE_PNG
+
+/**
+**	Decode a png image.
+**
+**	Transparent images are shown on black.
+**
+**	@param file	image file
+**	@param[out] width	decoded width
+**	@param[out] height	decoded height
+**
+**	@returns malloced RGB pixels, NULL on errors.
+*/
+static uint8_t *ImageDecodePng(FILE * file, int *width, int *height)
+{
+    png_image image;
+    png_color black;
+    uint8_t *rgb;
+
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    if (!png_image_begin_read_from_stdio(&image, file)) {
+	return NULL;
+    }
+    image.format = PNG_FORMAT_RGB;
+    if ((uint64_t) image.width * image.height > IMAGE_PIXELS
+	|| !(rgb = malloc(PNG_IMAGE_SIZE(image)))) {
+	png_image_free(&image);
+	return NULL;
+    }
+    memset(&black, 0, sizeof(black));
+    if (!png_image_finish_read(&image, &black, rgb, 0, NULL)) {
+	png_image_free(&image);
+	free(rgb);
+	return NULL;
+    }
+    *width = image.width;
+    *height = image.height;
+
+    return rgb;
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+//	Functions
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Decode an image scaled to fit a size.
+**
+**	The format is detected by its content, the image can be an archive
+**	member.
+**
+**	@param filename	path and name of image
+**	@param[in,out] width	width to fit, width of image
+**	@param[in,out] height	height to fit, height of image
+**
+**	@returns malloced ARGB pixels, NULL on errors.
+*/
+uint32_t *ImageLoad(const char *filename, int *width, int *height)
+{
+    uint8_t *head;
+    uint8_t *rgb;
+    uint32_t *argb;
+    FILE *file;
+    size_t n;
+    int orientation;
+    int fit_width;
+    int fit_height;
+    int w;
+    int h;
+
+    // the head contains the magic and the exif data
+    if (!(head = malloc(EXIF_HEAD))) {
+	return NULL;
+    }
+    if (!(file = ArchiveFopen(filename))) {
+	free(head);
+	return NULL;
+    }
+    rgb = NULL;
+    orientation = 1;
+    fit_width = *width;
+    fit_height = *height;
+    if ((n = fread(head, 1, EXIF_HEAD, file)) >= 8) {
+	rewind(file);
+#ifdef USE_JPG
+	if (head[0] == 0xFF && head[1] == 0xD8) {
+	    Exif exif;
+
+	    if (ExifParse(head, n, &exif)) {
+		orientation = exif.Orientation;
+	    }
+	    if (orientation >= 5) {	// decode to fit the rotated size
+		fit_width = *height;
+		fit_height = *width;
+	    }
+	    rgb = ImageDecodeJpeg(file, fit_width, fit_height, &w, &h);
+	}
+#endif
+#ifdef USE_PNG
+	if (!png_sig_cmp(head, 0, 8)) {
+	    rgb = ImageDecodePng(file, &w, &h);
+	}
+#endif
+    }
+    fclose(file);
+    free(head);
+    if (!rgb) {
+	Debug(3, "image: can't decode '%s'\n", filename);
+	return NULL;
+    }
+
+    ImageFit(w, h, &fit_width, &fit_height);
+    argb = ImageScale(rgb, w, h, fit_width, fit_height);
+    free(rgb);
+    if (argb) {
+	argb = ImageOrient(argb, &fit_width, &fit_height, orientation);
+	*width = fit_width;
+	*height = fit_height;
+    }
+
+    return argb;
+}
+
+/**
+**	Decode the exif thumbnail of a camera jpeg scaled to fit a size.
+**
+**	Only the head of the file is read.
+**
+**	@param filename	path and name of image
+**	@param[in,out] width	width to fit, width of preview
+**	@param[in,out] height	height to fit, height of preview
+**
+**	@returns malloced ARGB pixels, NULL if there is no exif thumbnail.
+*/
+uint32_t *ImagePreview(const char *filename, int *width, int *height)
+{
+#ifdef USE_JPG
+    uint8_t *head;
+    uint8_t *rgb;
+    uint32_t *argb;
+    FILE *file;
+    Exif exif;
+    size_t n;
+    int fit_width;
+    int fit_height;
+    int w;
+    int h;
+
+    if (!(head = malloc(EXIF_HEAD))) {
+	return NULL;
+    }
+    if (!(file = ArchiveFopen(filename))) {
+	free(head);
+	return NULL;
+    }
+    n = fread(head, 1, EXIF_HEAD, file);
+    fclose(file);
+
+    rgb = NULL;
+    if (ExifParse(head, n, &exif) && exif.Thumbnail
+	&& (file = fmemopen((void *)exif.Thumbnail, exif.ThumbnailSize,
+		"rb"))) {
+	if (exif.Orientation >= 5) {	// scale to fit the rotated size
+	    fit_width = *height;
+	    fit_height = *width;
+	} else {
+	    fit_width = *width;
+	    fit_height = *height;
+	}
+	rgb = ImageDecodeJpeg(file, fit_width, fit_height, &w, &h);
+	fclose(file);
+    }
+    free(head);
+    if (!rgb) {
+	return NULL;
+    }
+
+    ImageFit(w, h, &fit_width, &fit_height);
+    argb = ImageScale(rgb, w, h, fit_width, fit_height);
+    free(rgb);
+    if (argb) {
+	argb = ImageOrient(argb, &fit_width, &fit_height, exif.Orientation);
+	*width = fit_width;
+	*height = fit_height;
+    }
+
+    return argb;
+#else
+    (void)filename;
+    (void)width;
+    (void)height;
+
+    return NULL;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Cache
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Compare two requests.
+**
+**	@param a	first request
+**	@param b	second request
+**
+**	@returns true, if both request the same image and size.
+*/
+static int ImageSame(const ImageRequest * a, const ImageRequest * b)
+{
+    return a->Filename && b->Filename && a->Width == b->Width
+	&& a->Height == b->Height && !strcmp(a->Filename, b->Filename);
+}
+
+/**
+**	Compare two queued requests.
+**
+**	@param a	first request
+**	@param b	second request
+*/
+static int ImageSameRequest(const void *a, const void *b)
+{
+    return ImageSame(a, b);
+}
+
+/**
+**	Find a cached frame and make it the most recently used.
+**
+**	Must be called with ImageMutex locked.
+**
+**	@param request	image and fit size
+**
+**	@returns frame, NULL if not cached.
+*/
+static ImageFrame *ImageFind(const ImageRequest * request)
+{
+    ImageFrame *frame;
+
+    for (frame = ImageFirst; frame; frame = frame->Next) {
+	if (ImageSame(&frame->Request, request)) {
+	    if (frame != ImageFirst) {	// move to front
+		frame->Prev->Next = frame->Next;
+		if (frame->Next) {
+		    frame->Next->Prev = frame->Prev;
+		} else {
+		    ImageLast = frame->Prev;
+		}
+		frame->Prev = NULL;
+		frame->Next = ImageFirst;
+		ImageFirst->Prev = frame;
+		ImageFirst = frame;
+	    }
+	    return frame;
+	}
+    }
+    return NULL;
+}
+
+/**
+**	Check if an image is decoded right now.
+**
+**	Must be called with ImageMutex locked.
+**
+**	@param request	image and fit size
+*/
+static int ImageIsBusy(const ImageRequest * request)
+{
+    int i;
+
+    for (i = 0; i < IMAGE_THREADS + 1; ++i) {
+	if (ImageSame(&ImageBusy[i], request)) {
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+/**
+**	Calculate the bytes of a cached frame.
+**
+**	Frames of failed decodes have no pixels, their entry and name still
+**	count against the budget.
+**
+**	@param frame	cached frame
+*/
+static size_t ImageFrameBytes(const ImageFrame * frame)
+{
+    size_t bytes;
+
+    bytes = sizeof(*frame) + strlen(frame->Request.Filename) + 1;
+    if (frame->Pixels) {
+	bytes += frame->Width * frame->Height * sizeof(*frame->Pixels);
+    }
+    return bytes;
+}
+
+/**
+**	Remove the least recently used frame.
+**
+**	Must be called with ImageMutex locked.
+*/
+static void ImageEvict(void)
+{
+    ImageFrame *frame;
+
+    frame = ImageLast;
+    ImageLast = frame->Prev;
+    if (ImageLast) {
+	ImageLast->Next = NULL;
+    } else {
+	ImageFirst = NULL;
+    }
+    ImageBytes -= ImageFrameBytes(frame);
+    --ImageFrames;
+    free(frame->Request.Filename);
+    free(frame->Pixels);
+    free(frame);
+}
+
+/**
+**	Store a decoded image as most recently used frame.
+**
+**	Least recently used frames are removed, until the cache fits the
+**	memory budget and the frame limit again.  Must be called with
+**	ImageMutex locked.
+**
+**	@param request	image and fit size, filename is taken over
+**	@param argb	decoded ARGB pixels, taken over, NULL can't decode
+**	@param width	width of frame
+**	@param height	height of frame
+*/
+static void ImageStore(ImageRequest * request, uint32_t * argb, int width,
+    int height)
+{
+    ImageFrame *frame;
+
+    if (!(frame = malloc(sizeof(*frame)))) {
+	free(request->Filename);
+	free(argb);
+	return;
+    }
+    frame->Request = *request;
+    frame->Width = width;
+    frame->Height = height;
+    frame->Pixels = argb;
+    ImageBytes += ImageFrameBytes(frame);
+    ++ImageFrames;
+
+    frame->Prev = NULL;
+    frame->Next = ImageFirst;
+    if (ImageFirst) {
+	ImageFirst->Prev = frame;
+    } else {
+	ImageLast = frame;
+    }
+    ImageFirst = frame;
+
+    // the new frame is kept, even if it alone is over budget
+    while ((ImageBytes > IMAGE_BUDGET || ImageFrames > IMAGE_FRAMES)
+	&& ImageLast != frame) {
+	ImageEvict();
+    }
+}
+
+/**
+**	Copy the pixels of a cached frame.
+**
+**	@param frame	cached frame
+**	@param[out] width	width of frame
+**	@param[out] height	height of frame
+**
+**	@returns malloced ARGB pixels, NULL on errors.
+*/
+static uint32_t *ImageCopy(const ImageFrame * frame, int *width,
+    int *height)
+{
+    uint32_t *argb;
+    size_t size;
+
+    if (!frame->Pixels) {
+	return NULL;
+    }
+    size = frame->Width * frame->Height * sizeof(*argb);
+    if ((argb = malloc(size))) {
+	memcpy(argb, frame->Pixels, size);
+	*width = frame->Width;
+	*height = frame->Height;
+    }
+    return argb;
+}
+
+/**
+**	Decode a queued image into the cache.
+**
+**	@param arg	queued request, filename stored behind it
+**	@param generation	cancel generation of the request (unused)
+*/
+static void ImageHandle(void *arg, unsigned generation)
+{
+    ImageRequest *busy;
+    ImageRequest request;
+    uint32_t *argb;
+    int width;
+    int height;
+    int i;
+
+    (void)generation;
+    pthread_mutex_lock(&ImageMutex);
+    // already cached or decoded by another thread
+    if (ImageFind(arg) || ImageIsBusy(arg)) {
+	pthread_mutex_unlock(&ImageMutex);
+	return;
+    }
+    request = *(ImageRequest *) arg;
+    if (!(request.Filename = strdup(request.Filename))) {
+	pthread_mutex_unlock(&ImageMutex);
+	return;
+    }
+    // free busy slot of the workers, the last is of ImageFetch
+    for (i = 0; i < IMAGE_THREADS - 1 && ImageBusy[i].Filename; ++i) {
+    }
+    busy = &ImageBusy[i];
+    *busy = request;
+    pthread_mutex_unlock(&ImageMutex);
+
+    width = request.Width;
+    height = request.Height;
+    argb = ImageLoad(request.Filename, &width, &height);
+
+    pthread_mutex_lock(&ImageMutex);
+    busy->Filename = NULL;
+    ImageStore(&request, argb, width, height);
+    pthread_cond_broadcast(&ImageDoneCond);
+    pthread_mutex_unlock(&ImageMutex);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Prefetch
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Get a decoded image from the cache, without waiting or decoding.
+**
+**	@param filename	path and name of image
+**	@param[in,out] width	width to fit, width of image
+**	@param[in,out] height	height to fit, height of image
+**	@param[out] done	true if the decode is done, also if it failed
+**
+**	@returns malloced ARGB pixels, NULL if not done or on errors.
+*/
+uint32_t *ImageLookup(const char *filename, int *width, int *height,
+    int *done)
+{
+    ImageFrame *frame;
+    ImageRequest request;
+    uint32_t *copy;
+
+    request.Filename = (char *)filename;
+    request.Width = *width;
+    request.Height = *height;
+
+    copy = NULL;
+    pthread_mutex_lock(&ImageMutex);
+    if ((frame = ImageFind(&request))) {
+	copy = ImageCopy(frame, width, height);
+    }
+    pthread_mutex_unlock(&ImageMutex);
+    *done = frame != NULL;
+
+    return copy;
+}
+
+/**
+**	Decode an image scaled to fit a size through the cache.
+**
+**	A cached frame is copied, an image decoded by a prefetch worker is
+**	waited for, otherwise the image is decoded and cached.
+**
+**	@param filename	path and name of image
+**	@param[in,out] width	width to fit, width of image
+**	@param[in,out] height	height to fit, height of image
+**
+**	@returns malloced ARGB pixels, NULL on errors.
+*/
+uint32_t *ImageFetch(const char *filename, int *width, int *height)
+{
+    ImageFrame *frame;
+    ImageRequest request;
+    uint32_t *argb;
+    uint32_t *copy;
+    int w;
+    int h;
+
+    request.Filename = (char *)filename;
+    request.Width = *width;
+    request.Height = *height;
+
+    pthread_mutex_lock(&ImageMutex);
+    while (!(frame = ImageFind(&request)) && ImageIsBusy(&request)) {
+	pthread_cond_wait(&ImageDoneCond, &ImageMutex);
+    }
+    if (frame) {
+	copy = ImageCopy(frame, width, height);
+	pthread_mutex_unlock(&ImageMutex);
+	return copy;
+    }
+    if (!(request.Filename = strdup(filename))) {
+	pthread_mutex_unlock(&ImageMutex);
+	return NULL;
+    }
+    ImageBusy[IMAGE_THREADS] = request;
+    pthread_mutex_unlock(&ImageMutex);
+
+    w = *width;
+    h = *height;
+    argb = ImageLoad(filename, &w, &h);
+    copy = NULL;
+    if (argb && (copy = malloc(w * h * sizeof(*copy)))) {
+	memcpy(copy, argb, w * h * sizeof(*copy));
+	*width = w;
+	*height = h;
+    }
+
+    pthread_mutex_lock(&ImageMutex);
+    ImageBusy[IMAGE_THREADS].Filename = NULL;
+    ImageStore(&request, argb, w, h);
+    pthread_cond_broadcast(&ImageDoneCond);
+    pthread_mutex_unlock(&ImageMutex);
+
+    return copy;
+}
+
+/**
+**	Queue an image to decode in the background.
+**
+**	If the queue is full, the oldest request is dropped.  An image
+**	already queued isn't queued again.
+**
+**	@param filename	path and name of image
+**	@param width	width to fit
+**	@param height	height to fit
+*/
+void ImagePrefetch(const char *filename, int width, int height)
+{
+    ImageRequest *request;
+
+    // one allocation, the pool frees it
+    if (!(request = malloc(sizeof(*request) + strlen(filename) + 1))) {
+	return;
+    }
+    request->Filename = strcpy((char *)(request + 1), filename);
+    request->Width = width;
+    request->Height = height;
+    WorkerQueue(&ImagePool, request);
+}
+
+/**
+**	Cancel all queued prefetches.
+**
+**	Running decodes are finished and cached.
+*/
+void ImageCancel(void)
+{
+    WorkerCancel(&ImagePool);
+}
+
+/**
+**	Stop prefetch threads and free the cached frames.
+*/
+void ImageExit(void)
+{
+    WorkerExit(&ImagePool);
+
+    while (ImageLast) {
+	ImageEvict();
+    }
+}
@@ -0,0 +1,42 @@
+///
+///	@file image.h		@brief image decoder module header file
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+    /// decode an image scaled to fit a size as ARGB pixels
+extern uint32_t *ImageLoad(const char *, int *, int *);
+
+    /// decode the exif thumbnail of an image as preview
+extern uint32_t *ImagePreview(const char *, int *, int *);
+
+    /// get a decoded image from the cache without waiting
+extern uint32_t *ImageLookup(const char *, int *, int *, int *);
+
+    /// decode an image scaled to fit a size through the cache
+extern uint32_t *ImageFetch(const char *, int *, int *);
+
+    /// queue an image to decode in the background
+extern void ImagePrefetch(const char *, int, int);
+
+    /// cancel all queued prefetches
+extern void ImageCancel(void);
+
+    /// stop prefetch threads and free the cache
+extern void ImageExit(void);
@@ -0,0 +1,2142 @@
+///
+///	@file library.c		@brief media library index module
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup Library The media library index module.
+///
+///	A background crawler walks the browser root and writes the tree of
+///	directories and media files into an index file, which is memory
+///	mapped by the browser.  Each directory knows the media types of its
+///	subtree, the typed views hide directories without matching files.
+///	A listing is only served from the index, if the directory mtime is
+///	unchanged, else the browser scans the directory itself.
+///
+///	After the crawl the index is kept up to date incrementally.  The
+///	directories are watched with inotify, or with fanotify filesystem
+///	marks when privileged.  Only the directories with changes are
+///	scanned again, the rest is copied from the old index.  Directories
+///	without watch are verified by throttled mtime rescans.
+///
+///	The names of the index are searched with an in-memory trigram
+///	index, built when the index file is mapped.
+///
+///	File layout: header, nodes in breadth first order, string block.
+///	The children of a directory are consecutive nodes, directories
+///	first, sorted like the scanned directories.
+///
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/inotify.h>
+#include <sys/fanotify.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <limits.h>
+
+#include <pthread.h>
+
+#include <libintl.h>
+#define _(str) gettext(str)		///< gettext shortcut
+#define _N(str) str			///< gettext_noop shortcut
+
+#include "misc.h"
+#include "readdir.h"
+#include "library.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//	Defines
+//////////////////////////////////////////////////////////////////////////////
+
+#define LIBRARY_MAGIC	0x42494C50U	///< file magic 'PLIB'
+#define LIBRARY_VERSION	1		///< file format version
+
+#define LIBRARY_LINK	1		///< node flag: symlinked directory
+
+#define LIBRARY_NONE	0xFFFFFFFFU	///< no node
+
+#define LIBRARY_STAT	1		///< dirty: directory mtime changed
+#define LIBRARY_SCAN	2		///< dirty: directory must be scanned
+
+#define LIBRARY_VERIFY_NONE	0	///< trust watched directories
+#define LIBRARY_VERIFY_UNWATCHED	1	///< stat unwatched directories
+#define LIBRARY_VERIFY_ALL	2	///< stat all directories
+
+#define LIBRARY_MOVED_FROM	1	///< change: renamed away
+#define LIBRARY_MOVED_TO	2	///< change: renamed here
+
+#define LIBRARY_DEBOUNCE	2	///< seconds without event before update
+#define LIBRARY_UPDATE_MIN	10	///< min seconds between updates
+#define LIBRARY_RESCAN	300		///< seconds between rescans
+#define LIBRARY_POLL	250		///< ms to wait for events
+#define LIBRARY_RENAMES	64		///< max renames between updates
+#define LIBRARY_DEVICES	8		///< max filesystems marked by fanotify
+
+#define LIBRARY_TRIGRAM_CHARS	38	///< boundary, letters, digits, other
+    /// number of trigrams
+#define LIBRARY_TRIGRAMS \
+	(LIBRARY_TRIGRAM_CHARS * LIBRARY_TRIGRAM_CHARS * LIBRARY_TRIGRAM_CHARS)
+#define LIBRARY_TRIGRAM_MAX	256	///< max trigrams of a name
+#define LIBRARY_QUERY_WORDS	8	///< max words of a search query
+#define LIBRARY_QUERY_GRAMS	32	///< max trigrams of a search query
+
+    /// inotify events of a watched directory
+#define LIBRARY_EVENTS	(IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO \
+	| IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK)
+
+#ifdef FAN_REPORT_DFID_NAME
+    /// fanotify events of a marked filesystem
+#define LIBRARY_FAN_EVENTS	(FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM \
+	| FAN_MOVED_TO | FAN_ONDIR)
+#endif
+
+//////////////////////////////////////////////////////////////////////////////
+//	Typedefs
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Media library index file header.
+///
+typedef struct _library_header_
+{
+    uint32_t Magic;			///< file magic #LIBRARY_MAGIC
+    uint32_t Version;			///< file format #LIBRARY_VERSION
+    uint32_t Nodes;			///< number of nodes
+    uint32_t Strings;			///< bytes of string block
+    int64_t Crawled;			///< time of crawl
+    uint32_t Reserved[2];		///< pad to node alignment
+} LibraryHeader;
+
+///
+///	Media library index node, a directory or a media file.
+///
+typedef struct _library_node_
+{
+    int64_t Mtime;			///< modification time seconds
+    uint64_t Size;			///< size of file
+    uint64_t Inode;			///< inode of file
+    uint32_t MtimeNsec;			///< modification time nanoseconds
+    uint32_t Name;			///< offset of name in string block
+    uint32_t Parent;			///< parent node index
+    uint32_t First;			///< first child node index
+    uint32_t Count;			///< number of children
+    uint32_t DirN;			///< children which are directories
+    uint8_t Type;			///< media type, 0 directory
+    uint8_t Mask;			///< media types of subtree, 1 << type
+    uint8_t Flags;			///< node flags #LIBRARY_LINK
+    uint8_t Reserved[5];		///< pad to 8 byte alignment
+} LibraryNode;
+
+///
+///	Media library index under construction.
+///
+typedef struct _library_build_
+{
+    LibraryNode *Nodes;			///< nodes
+    uint32_t *Origin;			///< old node of directories
+    uint32_t NodeN;			///< number of nodes
+    uint32_t NodeSize;			///< allocated nodes
+    char *Strings;			///< string block
+    uint32_t StringN;			///< used bytes of string block
+    uint32_t StringSize;		///< allocated bytes of string block
+} LibraryBuild;
+
+///
+///	Renamed directory, both halves of an inotify rename.
+///
+typedef struct _library_rename_
+{
+    uint32_t Cookie;			///< cookie of rename events
+    uint32_t Node;			///< old node of renamed directory
+    uint32_t Parent;			///< new parent node
+    char *Name;				///< new name
+} LibraryRename;
+
+///
+///	Filesystem marked by fanotify.
+///
+typedef struct _library_device_
+{
+    dev_t Dev;				///< device of filesystem
+    int Fd;				///< directory to open handles
+} LibraryDevice;
+
+///
+///	Trigram index of the names of an index file.
+///
+typedef struct _library_trigrams_
+{
+    uint32_t *Start;			///< first node of each trigram
+    uint32_t *Nodes;			///< ascending nodes of all trigrams
+    uint8_t *Lengths;			///< name length of nodes, max 255
+    uint8_t *Initials;			///< lower case first byte of nodes
+} LibraryTrigrams;
+
+//////////////////////////////////////////////////////////////////////////////
+//	Variables
+//////////////////////////////////////////////////////////////////////////////
+
+static char *LibraryFilename;		///< index file name
+static char *LibraryRoot;		///< crawled root, without trailing '/'
+static const NameFilter *const *LibraryTables;	///< media type tables
+
+static pthread_mutex_t LibraryMutex = PTHREAD_MUTEX_INITIALIZER;
+static void *LibraryMap;		///< mapped index file
+static size_t LibraryMapSize;		///< size of mapped index file
+static const LibraryNode *LibraryNodes;	///< nodes of mapped index
+static uint32_t LibraryNodeN;		///< number of nodes of mapped index
+static const char *LibraryStrings;	///< string block of mapped index
+static LibraryTrigrams LibraryTrigramIndex;	///< trigrams of mapped index
+
+static pthread_t LibraryThread;		///< crawler thread
+static int LibraryRunning;		///< crawler thread started
+static volatile int LibraryExiting;	///< crawler should exit
+
+static int LibraryNotifyFd = -1;	///< inotify or fanotify descriptor
+static int LibraryFanotify;		///< notify descriptor is fanotify
+static int *LibraryWatch;		///< watch of map node, -1 none
+static uint8_t *LibraryDirty;		///< dirty flags of map node
+static uint32_t LibraryWatchN;		///< map nodes of watch and dirty
+static uint32_t *LibraryWatchNode;	///< map node of inotify watch
+static int LibraryWatchNodeN;		///< size of watch node table
+static int LibraryUnwatched;		///< directories without watch
+static int LibraryOverflow;		///< events lost, verify all
+static time_t LibraryEventTime;		///< time of last change
+
+    /// renamed directories since last update
+static LibraryRename LibraryRenames[LIBRARY_RENAMES];
+static int LibraryRenameN;		///< number of renamed directories
+
+    /// filesystems marked by fanotify
+static LibraryDevice LibraryDevices[LIBRARY_DEVICES];
+static int LibraryDeviceN;		///< number of marked filesystems
+
+static int LibraryTrack(const LibraryBuild *);
+
+//////////////////////////////////////////////////////////////////////////////
+//	Trigram index
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Get trigram character of a name byte.
+**
+**	Letters are case folded, all non-ASCII bytes are one character.
+**
+**	@param c	byte of name
+**
+**	@returns trigram character 1 .. #LIBRARY_TRIGRAM_CHARS - 1,
+**	-1 for a word separator.
+*/
+static inline int LibraryTrigramChar(int c)
+{
+    if (c >= 'a' && c <= 'z') {
+	return c - 'a' + 1;
+    }
+    if (c >= 'A' && c <= 'Z') {
+	return c - 'A' + 1;
+    }
+    if (c >= '0' && c <= '9') {
+	return c - '0' + 27;
+    }
+    return c & 0x80 ? 37 : -1;
+}
+
+/**
+**	Get trigrams of a name.
+**
+**	Each word starts with two word boundaries, so the first one or two
+**	characters of a word are a trigram too.
+**
+**	@param name		file or directory name
+**	@param len		length of name
+**	@param[out] grams	trigrams, at least #LIBRARY_TRIGRAM_MAX
+**
+**	@returns number of trigrams, with duplicates.
+*/
+static int LibraryNameTrigrams(const char *name, size_t len,
+    uint32_t * grams)
+{
+    const char *end;
+    int a;
+    int b;
+    int c;
+    int n;
+
+    a = 0;
+    b = 0;
+    end = name + len;
+    for (n = 0; name < end && n < LIBRARY_TRIGRAM_MAX; ++name) {
+	if ((c = LibraryTrigramChar(*(const unsigned char *)name)) < 0) {
+	    a = 0;
+	    b = 0;
+	    continue;
+	}
+	grams[n++] = (a * LIBRARY_TRIGRAM_CHARS + b) * LIBRARY_TRIGRAM_CHARS
+	    + c;
+	a = b;
+	b = c;
+    }
+    return n;
+}
+
+/**
+**	Get length of a name without media file suffix.
+**
+**	The suffix isn't indexed, it would match most files of a type.
+**
+**	@param node	index node
+**	@param name	name of node
+**	@param len	length of name
+*/
+static size_t LibraryStem(const LibraryNode * node, const char *name,
+    size_t len)
+{
+    const char *s;
+
+    if (node->Type && (s = strrchr(name, '.')) && s != name) {
+	return s - name;
+    }
+    return len;
+}
+
+/**
+**	Build the trigram index of an index file.
+**
+**	The nodes of each trigram are ascending, a node is added only
+**	once for each trigram.
+**
+**	@param nodes		nodes of index
+**	@param n		number of nodes
+**	@param strings		string block of index
+**	@param[out] trigrams	trigram index
+**
+**	@returns false if out of memory.
+*/
+static int LibraryTrigramBuild(const LibraryNode * nodes, uint32_t n,
+    const char *strings, LibraryTrigrams * trigrams)
+{
+    uint32_t grams[LIBRARY_TRIGRAM_MAX];
+    uint8_t *lengths;
+    uint8_t *initials;
+    uint32_t *start;
+    uint32_t *last;
+    uint32_t *post;
+    uint32_t total;
+    uint32_t i;
+    int j;
+    int k;
+
+    start = calloc(LIBRARY_TRIGRAMS + 1, sizeof(*start));
+    last = calloc(LIBRARY_TRIGRAMS, sizeof(*last));
+    lengths = malloc(n);
+    initials = malloc(n);
+    if (!start || !last || !lengths || !initials) {
+	free(start);
+	free(last);
+	free(lengths);
+	free(initials);
+	return 0;
+    }
+    // count nodes of each trigram, the root node has the root path
+    lengths[0] = 255;
+    initials[0] = '\0';
+    for (i = 1; i < n; ++i) {
+	const char *name;
+	size_t len;
+
+	name = strings + nodes[i].Name;
+	len = strlen(name);
+	lengths[i] = len < 255 ? len : 255;
+	initials[i] = *name >= 'A' && *name <= 'Z' ? *name + 'a' - 'A' : *name;
+	k = LibraryNameTrigrams(name, LibraryStem(nodes + i, name, len),
+	    grams);
+	for (j = 0; j < k; ++j) {
+	    if (last[grams[j]] != i) {
+		last[grams[j]] = i;
+		start[grams[j]]++;
+	    }
+	}
+    }
+    total = 0;
+    for (i = 0; i < LIBRARY_TRIGRAMS; ++i) {
+	uint32_t count;
+
+	count = start[i];
+	start[i] = total;
+	last[i] = total;		// now fill position
+	total += count;
+    }
+    start[LIBRARY_TRIGRAMS] = total;
+
+    if (!(post = malloc(total * sizeof(*post) + 1))) {
+	free(start);
+	free(last);
+	free(lengths);
+	free(initials);
+	return 0;
+    }
+    for (i = 1; i < n; ++i) {
+	const char *name;
+
+	name = strings + nodes[i].Name;
+	k = LibraryNameTrigrams(name, LibraryStem(nodes + i, name,
+		strlen(name)), grams);
+	for (j = 0; j < k; ++j) {
+	    uint32_t t;
+
+	    t = grams[j];
+	    if (last[t] == start[t] || post[last[t] - 1] != i) {
+		post[last[t]++] = i;
+	    }
+	}
+    }
+    free(last);
+
+    trigrams->Start = start;
+    trigrams->Nodes = post;
+    trigrams->Lengths = lengths;
+    trigrams->Initials = initials;
+    return 1;
+}
+
+/**
+**	Free a trigram index.
+**
+**	@param trigrams	trigram index
+*/
+static void LibraryTrigramFree(LibraryTrigrams * trigrams)
+{
+    free(trigrams->Start);
+    free(trigrams->Nodes);
+    free(trigrams->Lengths);
+    free(trigrams->Initials);
+    trigrams->Start = NULL;
+    trigrams->Nodes = NULL;
+    trigrams->Lengths = NULL;
+    trigrams->Initials = NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Index file
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Unmap the index file.  Called with #LibraryMutex locked.
+*/
+static void LibraryUnmap(void)
+{
+    if (LibraryMap) {
+	munmap(LibraryMap, LibraryMapSize);
+	LibraryMap = NULL;
+	LibraryMapSize = 0;
+	LibraryNodes = NULL;
+	LibraryNodeN = 0;
+	LibraryStrings = NULL;
+	LibraryTrigramFree(&LibraryTrigramIndex);
+    }
+}
+
+/**
+**	Map the index file, replacing the current map.
+**
+**	The whole index is checked, a damaged or foreign file is ignored.
+**	The trigram index of its names is built before the map is replaced.
+**
+**	@returns true if mapped, false if missing or damaged.
+*/
+static int LibraryMapFile(void)
+{
+    LibraryTrigrams trigrams;
+    const LibraryHeader *header;
+    const LibraryNode *nodes;
+    const char *strings;
+    struct stat stat_buf;
+    void *map;
+    uint32_t i;
+    int fd;
+
+    if ((fd = open(LibraryFilename, O_RDONLY | O_CLOEXEC)) < 0) {
+	if (errno != ENOENT) {
+	    Error(_("play/library: can't open '%s': %s\n"), LibraryFilename,
+		strerror(errno));
+	}
+	return 0;
+    }
+    if (fstat(fd, &stat_buf) < 0
+	|| (size_t) stat_buf.st_size < sizeof(*header)) {
+	close(fd);
+	return 0;
+    }
+    map = mmap(NULL, stat_buf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+	Error(_("play/library: can't map '%s': %s\n"), LibraryFilename,
+	    strerror(errno));
+	return 0;
+    }
+
+    header = (const LibraryHeader *)map;
+    nodes = (const LibraryNode *)(header + 1);
+    strings = (const char *)(nodes + header->Nodes);
+    if (header->Magic != LIBRARY_MAGIC || header->Version != LIBRARY_VERSION
+	|| !header->Nodes || !header->Strings
+	|| sizeof(*header) + (uint64_t) header->Nodes * sizeof(*nodes)
+	+ header->Strings != (uint64_t) stat_buf.st_size
+	|| strings[header->Strings - 1]) {
+	goto damaged;
+    }
+    // children follow their parent: the path walks end at the root
+    for (i = 0; i < header->Nodes; ++i) {
+	if (nodes[i].Name >= header->Strings
+	    || (i ? nodes[i].Parent >= i : nodes[i].Parent != 0)
+	    || nodes[i].DirN > nodes[i].Count
+	    || (uint64_t) nodes[i].First + nodes[i].Count > header->Nodes) {
+	    goto damaged;
+	}
+    }
+    if (strcmp(strings + nodes[0].Name, LibraryRoot)) {
+	goto damaged;
+    }
+
+    if (!LibraryTrigramBuild(nodes, header->Nodes, strings, &trigrams)) {
+	Error(_("play/library: out of memory\n"));
+	munmap(map, stat_buf.st_size);
+	return 0;
+    }
+
+    pthread_mutex_lock(&LibraryMutex);
+    LibraryUnmap();
+    LibraryMap = map;
+    LibraryMapSize = stat_buf.st_size;
+    LibraryNodes = nodes;
+    LibraryNodeN = header->Nodes;
+    LibraryStrings = strings;
+    LibraryTrigramIndex = trigrams;
+    pthread_mutex_unlock(&LibraryMutex);
+
+    Debug(3, "play/library: mapped %u nodes\n", header->Nodes);
+    return 1;
+
+  damaged:
+    Warning(_("play/library: ignoring damaged index '%s'\n"),
+	LibraryFilename);
+    munmap(map, stat_buf.st_size);
+    return 0;
+}
+
+/**
+**	Write a new index file, it replaces the old atomically.
+**
+**	@param build	complete index
+**
+**	@returns true if written, false if any error occurs.
+*/
+static int LibraryWrite(const LibraryBuild * build)
+{
+    LibraryHeader header;
+    char *tmp;
+    FILE *f;
+    int ok;
+
+    memset(&header, 0, sizeof(header));
+    header.Magic = LIBRARY_MAGIC;
+    header.Version = LIBRARY_VERSION;
+    header.Nodes = build->NodeN;
+    header.Strings = build->StringN;
+    header.Crawled = time(NULL);
+
+    if (!(tmp = malloc(strlen(LibraryFilename) + sizeof(".tmp")))) {
+	return 0;
+    }
+    stpcpy(stpcpy(tmp, LibraryFilename), ".tmp");
+    if (!(f = fopen(tmp, "wbe"))) {
+	Error(_("play/library: can't create '%s': %s\n"), tmp,
+	    strerror(errno));
+	free(tmp);
+	return 0;
+    }
+    ok = fwrite(&header, sizeof(header), 1, f) == 1
+	&& fwrite(build->Nodes, sizeof(*build->Nodes), build->NodeN,
+	f) == build->NodeN
+	&& fwrite(build->Strings, 1, build->StringN, f) == build->StringN
+	&& !fflush(f) && !fdatasync(fileno(f));
+    if (fclose(f) || !ok || rename(tmp, LibraryFilename) < 0) {
+	Error(_("play/library: can't write '%s': %s\n"), tmp,
+	    strerror(errno));
+	unlink(tmp);
+	free(tmp);
+	return 0;
+    }
+    free(tmp);
+    return 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Crawler
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Get media type of a file name.
+**
+**	@param name	file name
+**
+**	@returns media type of the first matching table, 0 no media file.
+*/
+static int LibraryType(const char *name)
+{
+    int type;
+    int i;
+
+    for (i = 0; LibraryTables[i]; ++i) {
+	if ((type = NameFilterMatch(LibraryTables[i], name))) {
+	    return type;
+	}
+    }
+    return 0;
+}
+
+/**
+**	Add a node to the index under construction.
+**
+**	@param build	index under construction
+**	@param name	name of node
+**	@param parent	parent node index
+**
+**	@returns node index, -1 if out of memory.
+*/
+static int LibraryAddNode(LibraryBuild * build, const char *name,
+    uint32_t parent)
+{
+    LibraryNode *node;
+    size_t len;
+
+    len = strlen(name) + 1;
+    if (build->NodeN >= build->NodeSize) {
+	LibraryNode *new;
+	uint32_t *origin;
+	uint32_t size;
+
+	size = build->NodeSize ? build->NodeSize * 2 : 1024;
+	if (!(new = realloc(build->Nodes, size * sizeof(*new)))) {
+	    return -1;
+	}
+	build->Nodes = new;
+	if (!(origin = realloc(build->Origin, size * sizeof(*origin)))) {
+	    return -1;
+	}
+	build->Origin = origin;
+	build->NodeSize = size;
+    }
+    if (build->StringN + len > build->StringSize) {
+	char *new;
+	uint32_t size;
+
+	size = build->StringSize ? build->StringSize * 2 : 16384;
+	while (size < build->StringN + len) {
+	    size *= 2;
+	}
+	if (!(new = realloc(build->Strings, size))) {
+	    return -1;
+	}
+	build->Strings = new;
+	build->StringSize = size;
+    }
+
+    node = build->Nodes + build->NodeN;
+    memset(node, 0, sizeof(*node));
+    node->Name = build->StringN;
+    node->Parent = parent;
+    build->Origin[build->NodeN] = LIBRARY_NONE;
+    memcpy(build->Strings + build->StringN, name, len);
+    build->StringN += len;
+
+    return build->NodeN++;
+}
+
+/**
+**	Set identity of a node from its stat.
+**
+**	@param node	index node
+**	@param st	stat of file or directory
+*/
+static void LibraryStat(LibraryNode * node, const struct stat *st)
+{
+    node->Mtime = st->st_mtim.tv_sec;
+    node->MtimeNsec = st->st_mtim.tv_nsec;
+    node->Size = st->st_size;
+    node->Inode = st->st_ino;
+}
+
+/**
+**	Check if the identity of a node matches a stat.
+**
+**	@param node	index node
+**	@param st	stat of file or directory
+*/
+static int LibraryStatSame(const LibraryNode * node, const struct stat *st)
+{
+    return node->Mtime == st->st_mtim.tv_sec
+	&& node->MtimeNsec == (uint32_t) st->st_mtim.tv_nsec
+	&& node->Inode == st->st_ino;
+}
+
+/**
+**	Build path of a directory node.
+**
+**	@param nodes	nodes of index
+**	@param strings	string block of index
+**	@param index	node index
+**
+**	@returns malloced '/' terminated path, NULL if out of memory.
+*/
+static char *LibraryPath(const LibraryNode * nodes, const char *strings,
+    uint32_t index)
+{
+    char *path;
+    size_t len;
+    uint32_t i;
+    char *s;
+
+    len = 2;				// trailing '/' and '\0'
+    for (i = index; i; i = nodes[i].Parent) {
+	len += strlen(strings + nodes[i].Name) + 1;
+    }
+    len += strlen(LibraryRoot);
+    if (!(path = malloc(len))) {
+	return NULL;
+    }
+    // fill from the end
+    s = path + len - 1;
+    *s = '\0';
+    *--s = '/';
+    for (i = index; i; i = nodes[i].Parent) {
+	const char *name;
+	size_t n;
+
+	name = strings + nodes[i].Name;
+	n = strlen(name);
+	s -= n;
+	memcpy(s, name, n);
+	*--s = '/';
+    }
+    memcpy(path, LibraryRoot, strlen(LibraryRoot));
+
+    return path;
+}
+
+/**
+**	Find a directory in the old index, the mapped one.
+**
+**	Scanned directories are sorted like the old children, searching
+**	from behind the last match finds them at once.
+**
+**	@param old		old parent directory node index
+**	@param name		name of directory
+**	@param[in,out] hint	position of the next expected child
+**
+**	@returns old node index, #LIBRARY_NONE if not found.
+*/
+static uint32_t LibraryOldChild(uint32_t old, const char *name,
+    uint32_t * hint)
+{
+    const LibraryNode *node;
+    uint32_t i;
+
+    node = LibraryNodes + old;
+    for (i = 0; i < node->DirN; ++i) {
+	uint32_t j;
+
+	j = (*hint + i) % node->DirN;
+	if (!strcmp(LibraryStrings + LibraryNodes[node->First + j].Name,
+		name)) {
+	    *hint = j + 1;
+	    return node->First + j;
+	}
+    }
+    return LIBRARY_NONE;
+}
+
+/**
+**	Find the origin of a directory, which was renamed.
+**
+**	@param old	old parent directory node index
+**	@param name	new name of directory
+**
+**	@returns old node index, #LIBRARY_NONE if not renamed.
+*/
+static uint32_t LibraryRenamed(uint32_t old, const char *name)
+{
+    int i;
+
+    for (i = 0; i < LibraryRenameN; ++i) {
+	if (LibraryRenames[i].Parent == old
+	    && !strcmp(LibraryRenames[i].Name, name)) {
+	    return LibraryRenames[i].Node;
+	}
+    }
+    return LIBRARY_NONE;
+}
+
+/**
+**	Scan a directory of the index under construction.
+**
+**	Its children are appended as consecutive nodes, directories are
+**	scanned later, when the crawler reaches their nodes.  Files without
+**	media type are not indexed.  Directories, which are the same inode
+**	as in the old index, keep their old node as origin.
+**
+**	@param build	index under construction
+**	@param index	directory node index
+**
+**	@returns false if out of memory.
+*/
+static int LibraryScan(LibraryBuild * build, uint32_t index)
+{
+    NameArena dirs;
+    NameArena files;
+    struct stat stat_buf;
+    uint32_t old;
+    uint32_t hint;
+    char *path;
+    int fd;
+    int i;
+    int n;
+
+    if (!(path = LibraryPath(build->Nodes, build->Strings, index))) {
+	return 0;
+    }
+    if ((fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+	Debug(3, "play/library: can't open '%s': %s\n", path,
+	    strerror(errno));
+	free(path);
+	return 1;
+    }
+    // mtime taken before scan, changes while scanning make it outdated
+    if (fstat(fd, &stat_buf) < 0
+	|| ScanDirectoryAll(path, NULL, &dirs, &files) < 0) {
+	close(fd);
+	free(path);
+	return 1;
+    }
+    LibraryStat(build->Nodes + index, &stat_buf);
+    build->Nodes[index].First = build->NodeN;
+    old = build->Origin[index];
+    hint = 0;
+
+    for (i = 0; i < dirs.Count; ++i) {
+	const char *name;
+	uint32_t origin;
+
+	name = NameArenaGet(&dirs, i);
+	if ((n = LibraryAddNode(build, name, index)) < 0) {
+	    break;
+	}
+	build->Nodes[index].DirN++;
+	build->Nodes[index].Count++;
+	if (fstatat(fd, name, &stat_buf, AT_SYMLINK_NOFOLLOW) < 0) {
+	    continue;
+	}
+	// symlinked directories aren't followed, they may loop
+	if (S_ISLNK(stat_buf.st_mode)) {
+	    build->Nodes[n].Flags |= LIBRARY_LINK;
+	    if (!fstatat(fd, name, &stat_buf, 0)) {
+		LibraryStat(build->Nodes + n, &stat_buf);
+	    }
+	    continue;
+	}
+	if (old == LIBRARY_NONE) {
+	    continue;
+	}
+	if ((origin = LibraryOldChild(old, name, &hint)) == LIBRARY_NONE
+	    || LibraryNodes[origin].Inode != stat_buf.st_ino) {
+	    origin = LibraryRenamed(old, name);
+	}
+	if (origin != LIBRARY_NONE
+	    && LibraryNodes[origin].Inode == stat_buf.st_ino) {
+	    // old identity, a changed mtime is found by the update
+	    build->Origin[n] = origin;
+	    build->Nodes[n].Mtime = LibraryNodes[origin].Mtime;
+	    build->Nodes[n].MtimeNsec = LibraryNodes[origin].MtimeNsec;
+	    build->Nodes[n].Inode = LibraryNodes[origin].Inode;
+	}
+    }
+    for (i = 0; n >= 0 && i < files.Count; ++i) {
+	const char *name;
+	int type;
+
+	name = NameArenaGet(&files, i);
+	if (!(type = LibraryType(name))
+	    || fstatat(fd, name, &stat_buf, 0) < 0) {
+	    continue;
+	}
+	if ((n = LibraryAddNode(build, name, index)) < 0) {
+	    break;
+	}
+	LibraryStat(build->Nodes + n, &stat_buf);
+	build->Nodes[n].Type = type;
+	build->Nodes[n].Mask = 1 << type;
+	build->Nodes[index].Count++;
+    }
+
+    free(dirs.Block);
+    free(files.Block);
+    close(fd);
+    free(path);
+
+    return n >= 0;
+}
+
+/**
+**	Copy the children of an unchanged directory from the old index.
+**
+**	@param build	index under construction
+**	@param index	directory node index
+**
+**	@returns false if out of memory.
+*/
+static int LibraryCopy(LibraryBuild * build, uint32_t index)
+{
+    const LibraryNode *old;
+    uint32_t i;
+
+    old = LibraryNodes + build->Origin[index];
+    build->Nodes[index].First = build->NodeN;
+    build->Nodes[index].Count = old->Count;
+    build->Nodes[index].DirN = old->DirN;
+
+    for (i = old->First; i < old->First + old->Count; ++i) {
+	LibraryNode *node;
+	uint32_t name;
+	int n;
+
+	if ((n = LibraryAddNode(build, LibraryStrings + LibraryNodes[i].Name,
+		    index)) < 0) {
+	    return 0;
+	}
+	node = build->Nodes + n;
+	name = node->Name;
+	*node = LibraryNodes[i];
+	node->Name = name;
+	node->Parent = index;
+	node->First = 0;
+	node->Count = 0;
+	node->DirN = 0;
+	node->Mask = node->Type ? 1 << node->Type : 0;
+	if (!node->Type && !(node->Flags & LIBRARY_LINK)) {
+	    build->Origin[n] = i;
+	}
+    }
+    return 1;
+}
+
+/**
+**	Check if a directory of the index under construction has changed.
+**
+**	Only dirty directories and, depending on @p verify, unwatched or
+**	all directories are checked against the filesystem.
+**
+**	@param build	index under construction
+**	@param index	directory node index
+**	@param verify	#LIBRARY_VERIFY_NONE, _UNWATCHED or _ALL
+**
+**	@returns 0 unchanged, #LIBRARY_STAT only the directory itself
+**	changed, #LIBRARY_SCAN the directory must be scanned.
+*/
+static int LibraryChanged(LibraryBuild * build, uint32_t index, int verify)
+{
+    struct stat stat_buf;
+    uint32_t old;
+    char *path;
+    int dirty;
+    int err;
+
+    if ((old = build->Origin[index]) == LIBRARY_NONE) {
+	return LIBRARY_SCAN;
+    }
+    dirty = LibraryDirty ? LibraryDirty[old] : 0;
+    if (dirty & LIBRARY_SCAN) {
+	return LIBRARY_SCAN;
+    }
+    if (!dirty && verify != LIBRARY_VERIFY_ALL
+	&& (verify != LIBRARY_VERIFY_UNWATCHED || (LibraryWatch
+		&& LibraryWatch[old] >= 0))) {
+	return 0;
+    }
+
+    if (!(path = LibraryPath(build->Nodes, build->Strings, index))) {
+	return LIBRARY_SCAN;
+    }
+    err = stat(path, &stat_buf);
+    free(path);
+    if (err < 0) {
+	return LIBRARY_SCAN;
+    }
+    if (LibraryStatSame(build->Nodes + index, &stat_buf)) {
+	return 0;
+    }
+    if (dirty) {			// only files without media type changed
+	LibraryStat(build->Nodes + index, &stat_buf);
+	return LIBRARY_STAT;
+    }
+    return LIBRARY_SCAN;
+}
+
+/**
+**	Update the index of the library root and write it.
+**
+**	The nodes are built in breadth first order, this keeps the children
+**	of each directory consecutive.  Unchanged directories are copied
+**	from the old index, without a crawl there is no old index and all
+**	directories are scanned.
+**
+**	@param verify	#LIBRARY_VERIFY_NONE, _UNWATCHED or _ALL
+**
+**	@returns true if the index is up to date.
+*/
+static int LibraryUpdate(int verify)
+{
+    LibraryBuild build;
+    uint32_t scanned;
+    uint32_t i;
+    int changed;
+    int ok;
+
+    Debug(3, "play/library: update '%s' verify %d\n", LibraryRoot, verify);
+    memset(&build, 0, sizeof(build));
+
+    changed = !LibraryNodes;
+    scanned = 0;
+    ok = LibraryAddNode(&build, LibraryRoot, 0) == 0;
+    if (ok && LibraryNodes) {
+	build.Origin[0] = 0;
+	build.Nodes[0].Mtime = LibraryNodes[0].Mtime;
+	build.Nodes[0].MtimeNsec = LibraryNodes[0].MtimeNsec;
+	build.Nodes[0].Inode = LibraryNodes[0].Inode;
+    }
+    for (i = 0; ok && i < build.NodeN && !LibraryExiting; ++i) {
+	if (build.Nodes[i].Type || build.Nodes[i].Flags & LIBRARY_LINK) {
+	    continue;
+	}
+	switch (LibraryChanged(&build, i, verify)) {
+	    case LIBRARY_SCAN:
+		ok = LibraryScan(&build, i);
+		changed = 1;
+		++scanned;
+		break;
+	    case LIBRARY_STAT:
+		changed = 1;
+		// fall through
+	    default:
+		ok = LibraryCopy(&build, i);
+		break;
+	}
+    }
+    if (!ok) {
+	Error(_("play/library: out of memory\n"));
+    }
+    if (ok && !LibraryExiting && changed) {
+	// children are after their parents, collect subtree media types
+	for (i = build.NodeN - 1; i > 0; --i) {
+	    build.Nodes[build.Nodes[i].Parent].Mask |= build.Nodes[i].Mask;
+	}
+	ok = LibraryWrite(&build) && LibraryTrack(&build);
+	Debug(3, "play/library: indexed %u nodes, scanned %u directories\n",
+	    build.NodeN, scanned);
+    }
+    free(build.Nodes);
+    free(build.Origin);
+    free(build.Strings);
+
+    return ok && !LibraryExiting;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Listing
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Find the node of a directory.  Called with #LibraryMutex locked.
+**
+**	@param path	directory path and name
+**
+**	@returns node index, -1 if not in the index.
+*/
+static int LibraryFind(const char *path)
+{
+    const char *name;
+    size_t len;
+    uint32_t node;
+    uint32_t i;
+
+    len = strlen(LibraryRoot);
+    if (strncmp(path, LibraryRoot, len) || (path[len] && path[len] != '/')) {
+	return -1;
+    }
+    node = 0;
+    for (name = path + len; *name;) {
+	const char *end;
+
+	if (*name == '/') {
+	    ++name;
+	    continue;
+	}
+	if (!(end = strchr(name, '/'))) {
+	    end = name + strlen(name);
+	}
+	for (i = 0; i < LibraryNodes[node].DirN; ++i) {
+	    const char *s;
+
+	    s = LibraryStrings + LibraryNodes[LibraryNodes[node].First +
+		i].Name;
+	    if (!strncmp(s, name, end - name) && !s[end - name]) {
+		break;
+	    }
+	}
+	if (i == LibraryNodes[node].DirN) {
+	    return -1;
+	}
+	node = LibraryNodes[node].First + i;
+	if (LibraryNodes[node].Flags & LIBRARY_LINK) {
+	    return -1;			// not indexed
+	}
+	name = end;
+    }
+    return node;
+}
+
+/**
+**	Check if a node is shown in a typed view.
+**
+**	Symlinked directories aren't indexed, they are always shown.
+**
+**	@param node	index node
+**	@param name	name of node
+**	@param mask	media types of shown directories
+**	@param filter	name filter of shown files, NULL directories
+*/
+static int LibraryShow(const LibraryNode * node, const char *name, int mask,
+    const NameFilter * filter)
+{
+    if (filter) {
+	return NameFilterMatch(filter, name);
+    }
+    return (node->Mask & mask) || (node->Flags & LIBRARY_LINK);
+}
+
+/**
+**	Build a name arena of index nodes.
+**
+**	@param first		first node index
+**	@param n		number of nodes
+**	@param mask		media types of shown directories
+**	@param filter		name filter of shown files, NULL directories
+**	@param[out] arena	name arena
+**
+**	@returns false if out of memory.
+*/
+static int LibraryArena(uint32_t first, uint32_t n, int mask,
+    const NameFilter * filter, NameArena * arena)
+{
+    size_t size;
+    size_t offs;
+    uint32_t i;
+    int count;
+
+    size = 0;
+    count = 0;
+    for (i = first; i < first + n; ++i) {
+	const char *name;
+
+	name = LibraryStrings + LibraryNodes[i].Name;
+	if (LibraryShow(LibraryNodes + i, name, mask, filter)) {
+	    size += strlen(name) + 1;
+	    ++count;
+	}
+    }
+    memset(arena, 0, sizeof(*arena));
+    if (!count) {
+	return 1;
+    }
+    // same layout as scanned names: strings, then aligned offsets
+    offs = (size + sizeof(int) - 1) & ~(sizeof(int) - 1);
+    if (!(arena->Block = malloc(offs + count * sizeof(int)))) {
+	return 0;
+    }
+    arena->Offsets = (int *)(arena->Block + offs);
+
+    size = 0;
+    for (i = first; i < first + n; ++i) {
+	const char *name;
+
+	name = LibraryStrings + LibraryNodes[i].Name;
+	if (LibraryShow(LibraryNodes + i, name, mask, filter)) {
+	    arena->Offsets[arena->Count++] = size;
+	    size = stpcpy(arena->Block + size, name) - arena->Block + 1;
+	}
+    }
+    return 1;
+}
+
+/**
+**	Open a directory listing served from the library index.
+**
+**	Only directories with files of the media types of the filter are
+**	listed.  The listing is only used, if the directory is unchanged
+**	since the crawl.
+**
+**	@param path	directory path and name
+**	@param filter	list of name suffix filters, the typed view
+**
+**	@returns cache entry of the listing, close with DirCacheClose(),
+**	NULL if the directory must be scanned.
+*/
+DirCache *LibraryOpen(const char *path, const NameFilter * filter)
+{
+    const LibraryNode *node;
+    struct stat stat_buf;
+    struct timespec mtime;
+    NameArena dirs;
+    NameArena files;
+    int mask;
+    int i;
+
+    if (!filter || !LibraryFilename) {	// unfiltered view isn't indexed
+	return NULL;
+    }
+    mask = 0;
+    for (i = 0; filter[i].String; ++i) {
+	mask |= 1 << (filter[i].Type ? filter[i].Type : MEDIA_OTHER);
+    }
+    if (stat(path, &stat_buf) < 0) {
+	return NULL;
+    }
+
+    pthread_mutex_lock(&LibraryMutex);
+    if (!LibraryNodes || (i = LibraryFind(path)) < 0) {
+	pthread_mutex_unlock(&LibraryMutex);
+	return NULL;
+    }
+    node = LibraryNodes + i;
+    // lazy verify: the crawled listing must be current
+    if (node->Mtime != stat_buf.st_mtim.tv_sec
+	|| node->MtimeNsec != (uint32_t) stat_buf.st_mtim.tv_nsec
+	|| node->Inode != stat_buf.st_ino) {
+	pthread_mutex_unlock(&LibraryMutex);
+	Debug(3, "play/library: index of '%s' outdated\n", path);
+	return NULL;
+    }
+    if (!LibraryArena(node->First, node->DirN, mask, NULL, &dirs)) {
+	pthread_mutex_unlock(&LibraryMutex);
+	return NULL;
+    }
+    if (!LibraryArena(node->First + node->DirN, node->Count - node->DirN,
+	    mask, filter, &files)) {
+	pthread_mutex_unlock(&LibraryMutex);
+	free(dirs.Block);
+	return NULL;
+    }
+    pthread_mutex_unlock(&LibraryMutex);
+
+    mtime = stat_buf.st_mtim;
+    return DirCacheStore(path, filter, &mtime, &dirs, &files);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Search
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Check if a name part starts with a query word.
+**
+**	@param s	name part
+**	@param word	lower case query word
+**	@param len	length of query word
+*/
+static inline int LibraryMatch(const unsigned char *s, const char *word,
+    int len)
+{
+    int i;
+
+    for (i = 0; i < len; ++i) {
+	int c;
+
+	c = s[i];
+	if (c >= 'A' && c <= 'Z') {
+	    c += 'a' - 'A';
+	}
+	if (c != (unsigned char)word[i]) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/**
+**	Rank a query word in a name.
+**
+**	Words shorter than a trigram only match at the start of a word,
+**	like their trigram.
+**
+**	@param name	file or directory name
+**	@param word	lower case query word
+**	@param len	length of query word
+**
+**	@returns 0 match at name start, 1 at word start, 2 inside a word,
+**	-1 no match.
+*/
+static int LibraryWordRank(const char *name, const char *word, int len)
+{
+    const unsigned char *s;
+    int best;
+
+    best = -1;
+    for (s = (const unsigned char *)name; *s; ++s) {
+	int rank;
+
+	if (!LibraryMatch(s, word, len)) {
+	    continue;
+	}
+	rank = s == (const unsigned char *)name ? 0 : LibraryTrigramChar(s[-1])
+	    < 0 ? 1 : 2;
+	if (rank == 2 && len < 3) {
+	    continue;
+	}
+	if (best < 0 || rank < best) {
+	    if (!(best = rank)) {
+		break;
+	    }
+	}
+    }
+    return best;
+}
+
+/**
+**	Advance in the ascending nodes of a trigram.
+**
+**	Galloping search, the cursor only moves forward.
+**
+**	@param nodes		nodes of trigram
+**	@param n		number of nodes
+**	@param[in,out] pos	cursor
+**	@param node		wanted node
+**
+**	@returns true if the trigram has the node.
+*/
+static int LibraryTrigramSeek(const uint32_t * nodes, uint32_t n,
+    uint32_t * pos, uint32_t node)
+{
+    uint32_t lo;
+    uint32_t hi;
+    uint32_t step;
+
+    lo = *pos;
+    step = 1;
+    hi = lo;
+    while (hi < n && nodes[hi] < node) {
+	lo = hi + 1;
+	hi += step;
+	step *= 2;
+    }
+    if (hi > n) {
+	hi = n;
+    }
+    while (lo < hi) {
+	uint32_t mid;
+
+	mid = lo + (hi - lo) / 2;
+	if (nodes[mid] < node) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+    *pos = lo;
+    return lo < n && nodes[lo] == node;
+}
+
+/**
+**	Search the library index for file and directory names.
+**
+**	The query is split into words, each word must match.  Results
+**	with matches at the start of the name or of words and short names
+**	are ranked first.
+**
+**	@param query		search query
+**	@param[out] results	ranked results, free their paths
+**	@param max		max number of results
+**
+**	@returns number of results, -1 if the index isn't ready.
+*/
+int LibrarySearch(const char *query, LibraryResult * results, int max)
+{
+    char buf[256];
+    const char *words[LIBRARY_QUERY_WORDS];
+    int lens[LIBRARY_QUERY_WORDS];
+    const uint32_t *lists[LIBRARY_QUERY_GRAMS];
+    uint32_t sizes[LIBRARY_QUERY_GRAMS];
+    uint32_t pos[LIBRARY_QUERY_GRAMS];
+    uint8_t initials[256];
+    uint32_t *ranks;
+    uint32_t i;
+    int word_n;
+    int list_n;
+    int n;
+    int j;
+
+    // split into lower case words
+    word_n = 0;
+    n = 0;
+    while (*query && n < (int)sizeof(buf) - 1) {
+	int c;
+
+	c = *(const unsigned char *)query++;
+	if (LibraryTrigramChar(c) < 0) {
+	    continue;
+	}
+	if (word_n == LIBRARY_QUERY_WORDS) {
+	    break;
+	}
+	words[word_n] = buf + n;
+	for (;;) {
+	    buf[n++] = c >= 'A' && c <= 'Z' ? c + 'a' - 'A' : c;
+	    c = *(const unsigned char *)query;
+	    if (n == (int)sizeof(buf) - 1 || LibraryTrigramChar(c) < 0) {
+		break;
+	    }
+	    ++query;
+	}
+	lens[word_n] = buf + n - words[word_n];
+	buf[n++] = '\0';
+	++word_n;
+    }
+    if (!word_n || !(ranks = malloc(max * 2 * sizeof(*ranks)))) {
+	return 0;
+    }
+    memset(initials, 0, sizeof(initials));
+    for (j = 0; j < word_n; ++j) {
+	initials[(uint8_t) words[j][0]] = 1;
+    }
+
+    pthread_mutex_lock(&LibraryMutex);
+    if (!LibraryTrigramIndex.Start) {
+	pthread_mutex_unlock(&LibraryMutex);
+	free(ranks);
+	return -1;
+    }
+    // nodes of the query trigrams, the shortest first
+    list_n = 0;
+    for (j = 0; j < word_n; ++j) {
+	uint32_t grams[LIBRARY_TRIGRAM_MAX];
+	int k;
+	int l;
+
+	k = LibraryNameTrigrams(words[j], lens[j], grams);
+	// short words use their word start trigram, long inner trigrams
+	for (l = lens[j] < 3 ? lens[j] - 1 : 2; l < k; ++l) {
+	    uint32_t s;
+	    int m;
+
+	    if (list_n == LIBRARY_QUERY_GRAMS) {
+		break;			// rest is checked by the ranking
+	    }
+	    s = LibraryTrigramIndex.Start[grams[l] + 1] -
+		LibraryTrigramIndex.Start[grams[l]];
+	    for (m = list_n; m > 0 && sizes[m - 1] > s; --m) {
+		lists[m] = lists[m - 1];
+		sizes[m] = sizes[m - 1];
+	    }
+	    lists[m] = LibraryTrigramIndex.Nodes +
+		LibraryTrigramIndex.Start[grams[l]];
+	    sizes[m] = s;
+	    pos[list_n] = 0;
+	    ++list_n;
+	}
+    }
+
+    n = 0;
+    for (i = 0; i < sizes[0]; ++i) {
+	uint32_t node;
+	const char *name;
+	uint32_t rank;
+	int k;
+
+	node = lists[0][i];
+	if (n == max) {
+	    // best rank it can get: only words with its initial can
+	    // match at the name start
+	    rank = word_n;
+	    if (initials[LibraryTrigramIndex.Initials[node]]) {
+		for (j = 0; j < word_n; ++j) {
+		    if (LibraryMatch((const unsigned char *)LibraryStrings +
+			    LibraryNodes[node].Name, words[j], lens[j])) {
+			--rank;
+		    }
+		}
+	    }
+	    if ((rank << 8 | LibraryTrigramIndex.Lengths[node]) >=
+		ranks[(n - 1) * 2]) {
+		continue;
+	    }
+	}
+	for (j = 1; j < list_n; ++j) {
+	    if (!LibraryTrigramSeek(lists[j], sizes[j], pos + j, node)) {
+		break;
+	    }
+	}
+	if (j < list_n) {
+	    continue;
+	}
+	// trigrams match, check and rank the words
+	name = LibraryStrings + LibraryNodes[node].Name;
+	rank = 0;
+	for (j = 0; j < word_n; ++j) {
+	    if ((k = LibraryWordRank(name, words[j], lens[j])) < 0) {
+		break;
+	    }
+	    rank += k;
+	}
+	if (j < word_n) {
+	    continue;
+	}
+	rank = rank << 8 | LibraryTrigramIndex.Lengths[node];
+
+	// keep the best, equal ranks in index order
+	if (n == max && rank >= ranks[(n - 1) * 2]) {
+	    continue;
+	}
+	for (k = n < max ? n++ : n - 1; k > 0 && ranks[(k - 1) * 2] > rank;
+	    --k) {
+	    ranks[k * 2] = ranks[(k - 1) * 2];
+	    ranks[k * 2 + 1] = ranks[(k - 1) * 2 + 1];
+	}
+	ranks[k * 2] = rank;
+	ranks[k * 2 + 1] = node;
+    }
+
+    for (j = 0; j < n; ++j) {
+	const LibraryNode *node;
+	char *path;
+
+	node = LibraryNodes + ranks[j * 2 + 1];
+	if ((path = LibraryPath(LibraryNodes, LibraryStrings,
+		    ranks[j * 2 + 1])) && node->Type) {
+	    path[strlen(path) - 1] = '\0';	// no directory
+	}
+	results[j].Path = path;
+	results[j].Type = node->Type;
+    }
+    pthread_mutex_unlock(&LibraryMutex);
+
+    free(ranks);
+    return n;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Watcher
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Track the watches and dirty flags of a new index.
+**
+**	The new index file is mapped, watches of directories, which are in
+**	the new index, move to their new nodes.  The other are removed.
+**
+**	@param build	new index, which was written
+**
+**	@returns false if the new index couldn't be mapped.
+*/
+static int LibraryTrack(const LibraryBuild * build)
+{
+    int *watch;
+    uint8_t *dirty;
+    uint32_t i;
+
+    watch = malloc(build->NodeN * sizeof(*watch));
+    dirty = calloc(build->NodeN, sizeof(*dirty));
+    if (!watch || !dirty || !LibraryMapFile()) {
+	free(watch);
+	free(dirty);
+	return 0;
+    }
+
+    for (i = 0; i < build->NodeN; ++i) {
+	uint32_t old;
+
+	watch[i] = -1;
+	if (LibraryWatch && (old = build->Origin[i]) != LIBRARY_NONE) {
+	    watch[i] = LibraryWatch[old];
+	    LibraryWatch[old] = -1;	// moved
+	}
+	if (watch[i] > 0 && !LibraryFanotify) {
+	    LibraryWatchNode[watch[i]] = i;
+	}
+    }
+    // directories gone, or moved out of the root
+    for (i = 0; LibraryWatch && i < LibraryWatchN; ++i) {
+	if (LibraryWatch[i] > 0 && !LibraryFanotify) {
+	    if (LibraryWatchNode[LibraryWatch[i]] == i) {
+		LibraryWatchNode[LibraryWatch[i]] = LIBRARY_NONE;
+	    }
+	    inotify_rm_watch(LibraryNotifyFd, LibraryWatch[i]);
+	}
+    }
+
+    free(LibraryWatch);
+    free(LibraryDirty);
+    LibraryWatch = watch;
+    LibraryDirty = dirty;
+    LibraryWatchN = build->NodeN;
+
+    return 1;
+}
+
+/**
+**	Watch a directory with a fanotify filesystem mark.
+**
+**	One mark covers all directories of a filesystem.
+**
+**	@param path	directory path
+**	@param st	stat of directory
+**
+**	@returns 0 if watched, -1 if not.
+*/
+static int LibraryMark(const char *path, const struct stat *st)
+{
+#ifdef FAN_REPORT_DFID_NAME
+    int i;
+
+    for (i = 0; i < LibraryDeviceN; ++i) {
+	if (LibraryDevices[i].Dev == st->st_dev) {
+	    return 0;
+	}
+    }
+    if (i == LIBRARY_DEVICES) {
+	return -1;
+    }
+    if (fanotify_mark(LibraryNotifyFd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+	    LIBRARY_FAN_EVENTS, AT_FDCWD, path) < 0) {
+	Debug(3, "play/library: can't mark '%s': %s\n", path,
+	    strerror(errno));
+	return -1;
+    }
+    // handles of events are opened relative to this directory
+    if ((LibraryDevices[i].Fd =
+	    open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0) {
+	return -1;
+    }
+    LibraryDevices[i].Dev = st->st_dev;
+    LibraryDeviceN++;
+    return 0;
+#else
+    (void)path;
+    (void)st;
+    return -1;
+#endif
+}
+
+/**
+**	Add watches for all unwatched directories of the index.
+**
+**	A directory, which has changed before its watch was added, is
+**	marked dirty.  Without a watch it is checked by the rescans.
+*/
+static void LibraryWatchAll(void)
+{
+    static int warned;			// warn once about the limit
+    struct stat stat_buf;
+    uint32_t i;
+    int full;
+
+    LibraryUnwatched = 0;
+    if (!LibraryWatch) {
+	LibraryUnwatched = 1;		// no index, crawl again later
+	return;
+    }
+    full = LibraryNotifyFd < 0;
+    for (i = 0; i < LibraryNodeN && !LibraryExiting; ++i) {
+	const LibraryNode *node;
+	char *path;
+	int wd;
+
+	node = LibraryNodes + i;
+	if (node->Type || node->Flags & LIBRARY_LINK || LibraryWatch[i] >= 0) {
+	    continue;
+	}
+	if (full || !(path = LibraryPath(LibraryNodes, LibraryStrings, i))) {
+	    ++LibraryUnwatched;
+	    continue;
+	}
+	if (LibraryFanotify) {
+	    wd = stat(path, &stat_buf) < 0 ? -1 : LibraryMark(path,
+		&stat_buf);
+	} else if ((wd = inotify_add_watch(LibraryNotifyFd, path,
+		    LIBRARY_EVENTS)) >= 0) {
+	    if (wd >= LibraryWatchNodeN) {
+		uint32_t *new;
+		int n;
+
+		n = wd + 1024;
+		if (!(new = realloc(LibraryWatchNode, n * sizeof(*new)))) {
+		    inotify_rm_watch(LibraryNotifyFd, wd);
+		    free(path);
+		    ++LibraryUnwatched;
+		    continue;
+		}
+		memset(new + LibraryWatchNodeN, 0xFF,
+		    (n - LibraryWatchNodeN) * sizeof(*new));
+		LibraryWatchNode = new;
+		LibraryWatchNodeN = n;
+	    }
+	    LibraryWatchNode[wd] = i;
+	    if (stat(path, &stat_buf) < 0) {
+		memset(&stat_buf, 0, sizeof(stat_buf));
+	    }
+	} else if (errno == ENOSPC) {
+	    if (!warned) {
+		Warning(_("play/library: inotify watch limit reached,"
+			" rescanning every %d s\n"), LIBRARY_RESCAN);
+		warned = 1;
+	    }
+	    full = 1;
+	}
+	free(path);
+
+	if (wd < 0) {
+	    ++LibraryUnwatched;
+	    continue;
+	}
+	LibraryWatch[i] = wd;		// fanotify marks use 0
+	if (!LibraryStatSame(node, &stat_buf)) {
+	    LibraryDirty[i] |= LIBRARY_SCAN;
+	    LibraryEventTime = time(NULL);
+	}
+    }
+    Debug(3, "play/library: %d directories unwatched\n", LibraryUnwatched);
+}
+
+/**
+**	Record a change of a watched directory.
+**
+**	Changes of files without media type only change the directory
+**	mtime.  Renamed directories are remembered, the update keeps their
+**	old subtree.
+**
+**	@param node	node index of changed directory
+**	@param dir	change of a subdirectory
+**	@param name	name of created, deleted or renamed entry
+**	@param moved	#LIBRARY_MOVED_FROM, #LIBRARY_MOVED_TO or 0
+**	@param cookie	cookie which connects both halves of a rename
+*/
+static void LibraryChange(uint32_t node, int dir, const char *name,
+    int moved, uint32_t cookie)
+{
+    uint32_t child;
+    uint32_t hint;
+    int i;
+
+    if (node >= LibraryWatchN) {
+	return;
+    }
+    LibraryDirty[node] |= dir || LibraryType(name) ? LIBRARY_SCAN :
+	LIBRARY_STAT;
+    LibraryEventTime = time(NULL);
+
+    if (!dir || !moved) {
+	return;
+    }
+    if (moved == LIBRARY_MOVED_FROM) {
+	hint = 0;
+	child = LibraryOldChild(node, name, &hint);
+	if (child != LIBRARY_NONE && LibraryRenameN < LIBRARY_RENAMES) {
+	    LibraryRenames[LibraryRenameN].Cookie = cookie;
+	    LibraryRenames[LibraryRenameN].Node = child;
+	    LibraryRenames[LibraryRenameN].Parent = LIBRARY_NONE;
+	    LibraryRenames[LibraryRenameN].Name = NULL;
+	    LibraryRenameN++;
+	    // its mtime may change by the rename
+	    LibraryDirty[child] |= LIBRARY_STAT;
+	}
+	return;
+    }
+    for (i = 0; i < LibraryRenameN; ++i) {
+	if (LibraryRenames[i].Cookie == cookie
+	    && LibraryRenames[i].Parent == LIBRARY_NONE) {
+	    if ((LibraryRenames[i].Name = strdup(name))) {
+		LibraryRenames[i].Parent = node;
+	    }
+	    break;
+	}
+    }
+}
+
+/**
+**	Forget the recorded renames.
+*/
+static void LibraryRenamesClear(void)
+{
+    int i;
+
+    for (i = 0; i < LibraryRenameN; ++i) {
+	free(LibraryRenames[i].Name);
+    }
+    LibraryRenameN = 0;
+}
+
+/**
+**	Read the pending inotify events.
+*/
+static void LibraryInotifyRead(void)
+{
+    char buf[4096]
+	__attribute__ ((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *event;
+    ssize_t n;
+    char *s;
+
+    while ((n = read(LibraryNotifyFd, buf, sizeof(buf))) > 0) {
+	for (s = buf; s < buf + n; s += sizeof(*event) + event->len) {
+	    uint32_t node;
+	    int moved;
+
+	    event = (const struct inotify_event *)s;
+	    if (event->mask & IN_Q_OVERFLOW) {
+		LibraryOverflow = 1;
+		continue;
+	    }
+	    if (event->wd < 0 || event->wd >= LibraryWatchNodeN
+		|| (node = LibraryWatchNode[event->wd]) == LIBRARY_NONE) {
+		continue;
+	    }
+	    if (event->mask & IN_IGNORED) {	// directory is gone
+		LibraryWatchNode[event->wd] = LIBRARY_NONE;
+		if (node < LibraryWatchN) {
+		    LibraryWatch[node] = -1;
+		}
+		continue;
+	    }
+	    if (!event->len) {
+		continue;
+	    }
+	    moved = event->mask & IN_MOVED_FROM ? LIBRARY_MOVED_FROM :
+		event->mask & IN_MOVED_TO ? LIBRARY_MOVED_TO : 0;
+	    LibraryChange(node, event->mask & IN_ISDIR, event->name, moved,
+		event->cookie);
+	}
+    }
+}
+
+#ifdef FAN_REPORT_DFID_NAME
+
+/**
+**	Find the node of a fanotify directory handle.
+**
+**	A directory, which isn't in the index yet, is new.  Its nearest
+**	indexed parent gets the change.
+**
+**	@param handle		directory file handle
+**	@param[out] exact	true if the node is the directory itself
+**
+**	@returns node index, #LIBRARY_NONE if not below the root.
+*/
+static uint32_t LibraryHandleNode(struct file_handle *handle, int *exact)
+{
+    char path[PATH_MAX];
+    char link[64];
+    ssize_t n;
+    char *s;
+    int fd;
+    int i;
+
+    fd = -1;
+    for (i = 0; i < LibraryDeviceN && fd < 0; ++i) {
+	fd = open_by_handle_at(LibraryDevices[i].Fd, handle,
+	    O_PATH | O_CLOEXEC);
+    }
+    if (fd < 0) {
+	return LIBRARY_NONE;
+    }
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+    n = readlink(link, path, sizeof(path) - 1);
+    close(fd);
+    if (n <= 0) {
+	return LIBRARY_NONE;
+    }
+    path[n] = '\0';
+
+    *exact = 1;
+    while ((i = LibraryFind(path)) < 0) {
+	if (!(s = strrchr(path, '/')) || s == path) {
+	    return LIBRARY_NONE;
+	}
+	*s = '\0';
+	*exact = 0;
+    }
+    return i;
+}
+
+/**
+**	Read the pending fanotify events.
+**
+**	Fanotify events of a rename have no cookie, renamed directories are
+**	scanned again.
+*/
+static void LibraryFanotifyRead(void)
+{
+    char buf[4096] __attribute__ ((aligned(8)));
+    struct fanotify_event_metadata *event;
+    ssize_t n;
+
+    while ((n = read(LibraryNotifyFd, buf, sizeof(buf))) > 0) {
+	for (event = (struct fanotify_event_metadata *)buf;
+	    FAN_EVENT_OK(event, n); event = FAN_EVENT_NEXT(event, n)) {
+	    struct fanotify_event_info_fid *fid;
+	    struct file_handle *handle;
+	    uint32_t node;
+	    int exact;
+
+	    if (event->mask & FAN_Q_OVERFLOW) {
+		LibraryOverflow = 1;
+		continue;
+	    }
+	    fid = (struct fanotify_event_info_fid *)(event + 1);
+	    if (fid->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME) {
+		continue;
+	    }
+	    handle = (struct file_handle *)fid->handle;
+	    node = LibraryHandleNode(handle, &exact);
+	    if (node != LIBRARY_NONE) {
+		LibraryChange(node, !exact || event->mask & FAN_ONDIR,
+		    (const char *)handle->f_handle + handle->handle_bytes, 0,
+		    0);
+	    }
+	}
+    }
+}
+
+#endif
+
+/**
+**	Open the notify descriptor.
+**
+**	Privileged fanotify filesystem marks need no watch per directory,
+**	else inotify is used.
+*/
+static void LibraryNotifyOpen(void)
+{
+#ifdef FAN_REPORT_DFID_NAME
+    if ((LibraryNotifyFd =
+	    fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME |
+		FAN_NONBLOCK | FAN_CLOEXEC, O_RDONLY)) >= 0) {
+	LibraryFanotify = 1;
+	Debug(3, "play/library: using fanotify\n");
+	return;
+    }
+#endif
+    if ((LibraryNotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0) {
+	Error(_("play/library: can't init inotify: %s\n"), strerror(errno));
+    }
+}
+
+/**
+**	Crawler thread, runs with idle cpu and i/o priority.
+**
+**	The old index is verified against the filesystem, then kept up to
+**	date by the notify events.  A burst of events is collected, until
+**	no new event comes for #LIBRARY_DEBOUNCE seconds.  Directories
+**	without watch and lost events are verified by throttled rescans.
+**
+**	@param dummy	unused thread argument
+*/
+static void *LibraryCrawlerThread(void *dummy)
+{
+    struct pollfd fds[1];
+    time_t updated;
+    time_t rescan;
+
+    (void)dummy;
+
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+#ifdef SYS_ioprio_set
+    // IOPRIO_WHO_PROCESS of this thread, IOPRIO_CLASS_IDLE
+    syscall(SYS_ioprio_set, 1, 0, 3 << 13);
+#endif
+
+    LibraryMapFile();
+    LibraryNotifyOpen();
+    if (LibraryNodes) {
+	LibraryWatch = malloc(LibraryNodeN * sizeof(*LibraryWatch));
+	LibraryDirty = calloc(LibraryNodeN, sizeof(*LibraryDirty));
+	if (LibraryWatch && LibraryDirty) {
+	    memset(LibraryWatch, 0xFF, LibraryNodeN * sizeof(*LibraryWatch));
+	    LibraryWatchN = LibraryNodeN;
+	} else {
+	    free(LibraryWatch);
+	    free(LibraryDirty);
+	    LibraryWatch = NULL;
+	    LibraryDirty = NULL;
+	}
+    }
+    LibraryUpdate(LIBRARY_VERIFY_ALL);
+    LibraryWatchAll();
+
+    updated = time(NULL);
+    rescan = updated + LIBRARY_RESCAN;
+    fds[0].fd = LibraryNotifyFd;
+    fds[0].events = POLLIN;
+    while (!LibraryExiting) {
+	time_t now;
+	int verify;
+
+	if (poll(fds, 1, LIBRARY_POLL) > 0) {
+#ifdef FAN_REPORT_DFID_NAME
+	    if (LibraryFanotify) {
+		LibraryFanotifyRead();
+	    } else
+#endif
+		LibraryInotifyRead();
+	}
+
+	now = time(NULL);
+	if (now - updated < LIBRARY_UPDATE_MIN) {
+	    continue;
+	}
+	verify = LIBRARY_VERIFY_NONE;
+	if (LibraryOverflow) {
+	    verify = LIBRARY_VERIFY_ALL;
+	} else if (LibraryUnwatched && now >= rescan) {
+	    verify = LIBRARY_VERIFY_UNWATCHED;
+	} else if (!LibraryEventTime
+	    || now - LibraryEventTime < LIBRARY_DEBOUNCE) {
+	    continue;
+	}
+	if (verify != LIBRARY_VERIFY_NONE) {
+	    rescan = now + LIBRARY_RESCAN;
+	}
+	LibraryOverflow = 0;
+	LibraryEventTime = 0;
+	if (!LibraryUpdate(verify)) {
+	    // retried by the next rescan
+	    LibraryUnwatched = 1;
+	} else if (LibraryDirty) {
+	    memset(LibraryDirty, 0, LibraryWatchN * sizeof(*LibraryDirty));
+	}
+	LibraryRenamesClear();
+	LibraryWatchAll();
+	updated = time(NULL);
+    }
+
+    return NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Init/Exit
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Open the library index and start the crawler.
+**
+**	The old index is used, until the crawler has written the new one.
+**
+**	@param filename	index file name
+**	@param root	library root directory
+**	@param tables	NULL terminated media type tables
+**
+**	@returns true if the library is enabled.
+*/
+int LibraryInit(const char *filename, const char *root,
+    const NameFilter * const *tables)
+{
+    size_t len;
+
+    len = strlen(root);
+    while (len > 1 && root[len - 1] == '/') {
+	--len;
+    }
+    if (root[0] != '/' || len <= 1) {
+	Error(_("play/library: need an absolute root below '/' (-/)\n"));
+	return 0;
+    }
+    LibraryFilename = strdup(filename);
+    LibraryRoot = strndup(root, len);
+    LibraryTables = tables;
+    if (!LibraryFilename || !LibraryRoot) {
+	LibraryExit();
+	return 0;
+    }
+
+    LibraryExiting = 0;
+    if (pthread_create(&LibraryThread, NULL, LibraryCrawlerThread, NULL)) {
+	Error(_("play/library: can't create thread: %s\n"), strerror(errno));
+    } else {
+	LibraryRunning = 1;
+    }
+    return 1;
+}
+
+/**
+**	Stop the crawler and close the library index.
+*/
+void LibraryExit(void)
+{
+    if (LibraryRunning) {
+	LibraryExiting = 1;
+	pthread_join(LibraryThread, NULL);
+	LibraryRunning = 0;
+    }
+    pthread_mutex_lock(&LibraryMutex);
+    LibraryUnmap();
+    pthread_mutex_unlock(&LibraryMutex);
+
+    if (LibraryNotifyFd >= 0) {
+	close(LibraryNotifyFd);
+	LibraryNotifyFd = -1;
+    }
+    LibraryFanotify = 0;
+    while (LibraryDeviceN) {
+	close(LibraryDevices[--LibraryDeviceN].Fd);
+    }
+    LibraryRenamesClear();
+    free(LibraryWatch);
+    LibraryWatch = NULL;
+    free(LibraryDirty);
+    LibraryDirty = NULL;
+    LibraryWatchN = 0;
+    free(LibraryWatchNode);
+    LibraryWatchNode = NULL;
+    LibraryWatchNodeN = 0;
+
+    free(LibraryFilename);
+    LibraryFilename = NULL;
+    free(LibraryRoot);
+    LibraryRoot = NULL;
+}
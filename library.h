@@ -0,0 +1,42 @@
+///
+///	@file library.h		@brief media library index module header file
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Media library search result.
+///
+typedef struct _library_result_
+{
+    char *Path;				///< malloced path and name
+    int Type;				///< media type, 0 directory
+} LibraryResult;
+
+    /// open library index and start crawler
+extern int LibraryInit(const char *, const char *, const NameFilter * const *);
+
+    /// stop crawler and close library index
+extern void LibraryExit(void);
+
+    /// open a directory listing from the library index
+extern DirCache *LibraryOpen(const char *, const NameFilter *);
+
+    /// search names of the library index
+extern int LibrarySearch(const char *, LibraryResult *, int);
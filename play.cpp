@@ -36,8 +36,14 @@
 extern "C"
 {
 #include "readdir.h"
+#include "library.h"
 #include "video.h"
 #include "player.h"
+#include "prefetch.h"
+#include "probe.h"
+#include "thumb.h"
+#include "image.h"
+#include "archive.h"
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -61,6 +67,7 @@ static const char *MAINMENUENTRY = trNOOP("Play");
 
 static char ConfigHideMainMenuEntry;	///< hide main menu entry
 char ConfigDisableRemote;		///< disable remote during external play
+static char ConfigPlaylist;		///< play following files of directory
 
 static volatile int DoMakePrimary;	///< switch primary device to this
 
@@ -154,36 +161,6 @@ void RemoteEnable(void)
     cRemote::SetEnabled(true);
 }
 
-//////////////////////////////////////////////////////////////////////////////
-//	C Callbacks for diashow
-//////////////////////////////////////////////////////////////////////////////
-
-#if 0
-
-/**
-**	Draw rectangle.
-*/
-extern "C" void DrawRectangle(int x1, int y1, int x2, int y2, uint32_t argb)
-{
-    //GlobalDiashow->Osd->DrawRectangle(x1, y1, x2, y2, argb);
-}
-
-/**
-**	Draw text.
-**
-**	@param FIXME:
-*/
-extern "C" void DrawText(int x, int y, const char *s, uint32_t fg, uint32_t bg,
-    int w, int h, int align)
-{
-    const cFont *font;
-
-    font = cFont::GetFont(fontOsd);
-    //GlobalDiashow->Osd->DrawText(x, y, s, fg, bg, font, w, h, align);
-}
-
-#endif
-
 //////////////////////////////////////////////////////////////////////////////
 //	cPlayer
 //////////////////////////////////////////////////////////////////////////////
@@ -324,6 +301,9 @@ void cMyStatus::SetVolume(int volume, bool absolute)
 //	cControl
 //////////////////////////////////////////////////////////////////////////////
 
+    /// time window in ms to collect relative skips into a single seek
+#define SEEK_ACCU_TIMEOUT	500
+
 /**
 **	Our player control class.
 */
@@ -338,6 +318,13 @@ class cMyControl:public cControl
     virtual void Hide(void);		///< hide replay control
     bool infoVisible;			///< RecordingInfo visible
     time_t timeoutShow;			///< timeout shown control
+    bool SeekPending;			///< relative skips are collected
+    int SeekSeconds;			///< collected relative skip seconds
+    cTimeMs SeekTimeout;		///< timeout of seek collect window
+    int SeekTarget(void);		///< absolute target of collected skips
+    void ShowSeek(void);		///< display collected seek target
+    void Skip(int);			///< collect relative skip
+    void SkipFlush(void);		///< send collected skips
 
   public:
     cMyControl(const char *);		///< player control constructor
@@ -413,6 +400,92 @@ void cMyControl::ShowProgress(void)
     }
 }
 
+/**
+**	Get absolute target position of collected skips.
+**
+**	@returns target position in seconds, clipped to the stream length.
+*/
+int cMyControl::SeekTarget(void)
+{
+    int target;
+
+    target = PlayerCurrent + SeekSeconds;
+    if (PlayerTotal > 0 && target > PlayerTotal) {
+	target = PlayerTotal;
+    }
+    if (target < 0) {
+	target = 0;
+    }
+    return target;
+}
+
+/**
+**	Show target of collected skips.
+*/
+void cMyControl::ShowSeek(void)
+{
+    if (Display || (!cOsd::IsOpen())) {
+	bool play;
+	bool forward;
+	int speed;
+
+	if (GetReplayMode(play, forward, speed)) {
+	    int target;
+
+	    if (!Display) {
+		Display = Skins.Current()->DisplayReplay(false);
+	    }
+	    target = SeekTarget();
+	    Display->SetProgress(target, PlayerTotal);
+	    Display->SetMode(play, forward, speed);
+	    Display->SetCurrent(IndexToHMSF(target, false, 1));
+	    Display->SetTotal(IndexToHMSF(PlayerTotal, false, 1));
+	}
+	SetNeedsFastResponse(true);
+	Skins.Flush();
+    }
+}
+
+/**
+**	Collect relative skip.
+**
+**	Skips from held-down keys are summed up and send as one absolute
+**	seek, each single seek forces the player to flush and re-demux.
+**
+**	@param seconds	skip in seconds relative to current position
+*/
+void cMyControl::Skip(int seconds)
+{
+    if (!SeekPending) {			// new collect window
+	SeekPending = true;
+	SeekSeconds = 0;
+	// position is only updated, if progress is shown
+	PlayerGetCurrentPosition();
+	PlayerGetLength();
+    }
+    SeekSeconds += seconds;
+    SeekTimeout.Set(SEEK_ACCU_TIMEOUT);
+
+    ShowSeek();
+}
+
+/**
+**	Send collected skips as single absolute seek.
+*/
+void cMyControl::SkipFlush(void)
+{
+    if (SeekPending) {
+	SeekPending = false;
+	if (SeekSeconds) {
+	    PlayerSendSeekTo(PlayerCurrent = SeekTarget());
+	}
+	SeekSeconds = 0;
+	if (!infoVisible) {
+	    Hide();
+	}
+    }
+}
+
 /**
 **	Show control.
 */
@@ -436,6 +509,8 @@ cMyControl::cMyControl(const char *filename)
     Display = NULL;
     Status = new cMyStatus;		// start monitoring volume
     infoVisible = false;
+    SeekPending = false;
+    SeekSeconds = 0;
 
     //LastSkipKey = kNone;
     //LastSkipSeconds = REPLAYCONTROLSKIPSECONDS;
@@ -498,7 +573,12 @@ eOSState cMyControl::ProcessKey(eKeys key)
 	return osEnd;
     }
 
-    if (infoVisible) {			// if RecordingInfo visible then update
+    if (SeekPending && SeekTimeout.TimedOut()) {
+	SkipFlush();
+    }
+    if (SeekPending) {			// collected seek target visible
+	ShowSeek();
+    } else if (infoVisible) {		// if RecordingInfo visible then update
 	if (timeoutShow && time(0) > timeoutShow) {
 	    Hide();
 	    timeoutShow = 0;
@@ -539,11 +619,18 @@ eOSState cMyControl::ProcessKey(eKeys key)
 
 	case kFastRew | k_Release:
 	case kLeft | k_Release:
+	    SkipFlush();
 	    if (Setup.MultiSpeedMode) {
 		break;
 	    }
 	    // FIXME:
 	    break;
+	case kGreen | k_Release:
+	case kYellow | k_Release:
+	case k1 | k_Release:
+	case k3 | k_Release:
+	    SkipFlush();
+	    break;
 	case kLeft:
 	    if (PlayerDvdNav) {
 		PlayerSendDvdNavLeft();
@@ -553,7 +640,8 @@ eOSState cMyControl::ProcessKey(eKeys key)
 	    if (PlayerSpeed > 1) {
 		PlayerSendSetSpeed(PlayerSpeed /= 2);
 	    } else {
-		PlayerSendSeek(-10);
+		Skip(-10);
+		break;
 	    }
 	    Show();
 	    break;
@@ -575,48 +663,55 @@ eOSState cMyControl::ProcessKey(eKeys key)
 
 #ifdef USE_JUMPINGSECONDS
 	case kGreen | k_Repeat:
-	    PlayerSendSeek(-Setup.JumpSecondsRepeat);
+	    Skip(-Setup.JumpSecondsRepeat);
 	    break;
 	case kGreen:
-	    PlayerSendSeek(-Setup.JumpSeconds);
+	    Skip(-Setup.JumpSeconds);
 	    break;
 	case k1 | k_Repeat:
 	case k1:
-	    PlayerSendSeek(-Setup.JumpSecondsSlow);
+	    Skip(-Setup.JumpSecondsSlow);
 	    break;
 	case k3 | k_Repeat:
 	case k3:
-	    PlayerSendSeek(Setup.JumpSecondsSlow);
+	    Skip(Setup.JumpSecondsSlow);
 	    break;
 	case kYellow | k_Repeat:
-	    PlayerSendSeek(Setup.JumpSecondsRepeat);
+	    Skip(Setup.JumpSecondsRepeat);
 	    break;
 	case kYellow:
-	    PlayerSendSeek(Setup.JumpSeconds);
+	    Skip(Setup.JumpSeconds);
 	    break;
 #else
 	case kGreen | k_Repeat:
 	case kGreen:
-	    PlayerSendSeek(-60);
+	    Skip(-60);
 	    break;
 	case kYellow | k_Repeat:
 	case kYellow:
-	    PlayerSendSeek(+60);
+	    Skip(+60);
 	    break;
 #endif /* JUMPINGSECONDS */
 #ifdef USE_LIEMIKUUTIO
 #ifndef USE_JUMPINGSECONDS
 	case k1 | k_Repeat:
 	case k1:
-	    PlayerSendSeek(-20);
+	    Skip(-20);
 	    break;
 	case k3 | k_Repeat:
 	case k3:
-	    PlayerSendSeek(+20);
+	    Skip(+20);
 	    break;
 #endif /* JUMPINGSECONDS */
 #endif
 
+	case kNext:
+	    PlayerSendPlaylistStep(+1);
+	    break;
+	case kPrev:
+	    PlayerSendPlaylistStep(-1);
+	    break;
+
 	case kStop:
 	case kBlue:
 	    dsyslog("[play]: player stopped\n");
@@ -701,7 +796,7 @@ static int IsIsoImage(const char *filename)
     **	Table of supported iso image suffixes.
     */
     static const NameFilter IsoFilters[] = {
-#define FILTER(x) { sizeof(x) - 1, x }
+#define FILTER(x) { sizeof(x) - 1, x, MEDIA_ISO }
 	FILTER(".bin"),
 	FILTER(".dvd"),
 	FILTER(".img"),
@@ -709,20 +804,10 @@ static int IsIsoImage(const char *filename)
 	FILTER(".mdf"),
 	FILTER(".nrg"),
 #undef FILTER
-	{0, NULL}
+	{0, NULL, 0}
     };
-    int i;
-    int len;
-
-    len = strlen(filename);
-    for (i = 0; IsoFilters[i].String; ++i) {
-	if (len >= IsoFilters[i].Length
-	    && !strcasecmp(filename + len - IsoFilters[i].Length,
-		IsoFilters[i].String)) {
-	    return 1;
-	}
-    }
-    return 0;
+
+    return NameFilterMatch(IsoFilters, filename) == MEDIA_ISO;
 }
 
 /**
@@ -749,6 +834,8 @@ static void PlayFileHandleType(const char *filename)
 //////////////////////////////////////////////////////////////////////////////
 
 static char ShowBrowser;		///< flag show browser
+static char *ShowDiashow;		///< image to show in slideshow
+static char *ShowThumbnails;		///< entry to show in thumbnail view
 static const char *BrowserStartDir;	///< browser start directory
 static const NameFilter *BrowserFilters;	///< browser name filters
 static int DirStackSize;		///< size of directory stack
@@ -759,38 +846,63 @@ static char **DirStack;			///< current path directory stack
 **	Table of supported video suffixes.
 */
 static const NameFilter VideoFilters[] = {
-#define FILTER(x) { sizeof(x) - 1, x }
-    FILTER(".ts"), FILTER(".avi"), FILTER(".flv"), FILTER(".iso"),
-    FILTER(".m4v"), FILTER(".mkv"), FILTER(".mov"), FILTER(".mp4"),
-    FILTER(".mpg"), FILTER(".vdr"), FILTER(".vob"), FILTER(".wmv"),
+#define FILTER(x, t) { sizeof(x) - 1, x, t }
+    FILTER(".ts", MEDIA_VIDEO), FILTER(".avi", MEDIA_VIDEO),
+    FILTER(".flv", MEDIA_VIDEO), FILTER(".iso", MEDIA_ISO),
+    FILTER(".m4v", MEDIA_VIDEO), FILTER(".mkv", MEDIA_VIDEO),
+    FILTER(".mov", MEDIA_VIDEO), FILTER(".mp4", MEDIA_VIDEO),
+    FILTER(".mpg", MEDIA_VIDEO), FILTER(".vdr", MEDIA_VIDEO),
+    FILTER(".vob", MEDIA_VIDEO), FILTER(".wmv", MEDIA_VIDEO),
 #undef FILTER
     {
-	0, NULL}
+	0, NULL, 0}
 };
 
 /**
 **	Table of supported audio suffixes.
 */
 static const NameFilter AudioFilters[] = {
-#define FILTER(x) { sizeof(x) - 1, x }
+#define FILTER(x) { sizeof(x) - 1, x, MEDIA_AUDIO }
     FILTER(".flac"), FILTER(".mp3"), FILTER(".ogg"), FILTER(".wav"),
 #undef FILTER
     {
-	0, NULL}
+	0, NULL, 0}
 };
 
 /**
 **	Table of supported image suffixes.
 */
 static const NameFilter ImageFilters[] = {
-#define FILTER(x) { sizeof(x) - 1, x }
-    FILTER(".cbr"), FILTER(".cbz"), FILTER(".zip"), FILTER(".rar"),
-    FILTER(".jpg"), FILTER(".png"),
+#define FILTER(x, t) { sizeof(x) - 1, x, t }
+    FILTER(".cbr", MEDIA_ARCHIVE), FILTER(".cbz", MEDIA_ARCHIVE),
+    FILTER(".zip", MEDIA_ARCHIVE), FILTER(".rar", MEDIA_ARCHIVE),
+    FILTER(".tar", MEDIA_ARCHIVE), FILTER(".tar.gz", MEDIA_ARCHIVE),
+    FILTER(".tgz", MEDIA_ARCHIVE),
+    FILTER(".jpg", MEDIA_IMAGE), FILTER(".png", MEDIA_IMAGE),
 #undef FILTER
     {
-	0, NULL}
+	0, NULL, 0}
+};
+
+/**
+**	Tables of the media library, the first match gives the media type.
+*/
+static const NameFilter *const LibraryTables[] = {
+    VideoFilters, AudioFilters, ImageFilters, NULL
 };
 
+    /// time in ms the cursor must stay on a file to prefetch it
+#define PREFETCH_DWELL	400
+
+    /// time in ms to wait for a directory scan, before showing it partially
+#define SCAN_FIRST_WAIT	100
+
+    /// max menu items shown of a running directory scan
+#define SCAN_PARTIAL_ITEMS	100
+
+    /// menu items of a page, before the skin is known
+#define BROWSER_PAGE	20
+
 /**
 **	Menu class.
 */
@@ -798,15 +910,51 @@ class cBrowser:public cOsdMenu
 {
   private:
     const NameFilter *Filter;		///< current filter
+    int PrefetchIndex;			///< highlighted item index
+    bool PrefetchDone;			///< highlighted item prefetched
+    cTimeMs PrefetchDwell;		///< time cursor stays on item
+    ScanContext *Scan;			///< running directory scan
+    DirCache *Listing;			///< sorted entries of directory
+    int ListBase;			///< entry index of first menu item
+    int ProbeIndex;			///< entry index of probe status
+    unsigned ProbeSeen;			///< probe changes of probe status
 
     /// Create a browser menu for current directory
     void CreateMenu(void);
+    /// Append new entries of running scan
+    void ScanPoll(void);
+    /// Show sorted entries of finished scan
+    void ScanDone(const char *);
+    /// Leave current directory
+    void LeaveDir(void);
+    /// Number of menu entries
+    int Entries(void);
+    /// Text of menu entry
+    const char *Entry(int);
+    /// Entry index of current menu item
+    int CurrentEntry(void);
+    /// Find menu entry by name
+    int FindEntry(const char *);
+    /// Create menu items around an entry
+    void ShowEntries(int);
+    /// Move menu items with the cursor
+    bool ScrollEntries(eKeys);
     /// Create a browser menu for new directory
     void NewDir(const char *, const NameFilter *);
     /// Handle menu level up
     eOSState LevelUp(void);
     /// Handle menu item selection
     eOSState Selected(void);
+    /// Fill playlist with selected and following files
+    void Playlist(int, const char *);
+    /// Prefetch highlighted file
+    void Prefetch(void);
+    /// Queue probe and thumbnail of the file menu items
+    void QueueEntries(int);
+    /// Show probed information of highlighted file
+    void ProbeStatus(void);
+    /// Show the thumbnail view of the directory
+    eOSState Thumbnails(void);
 
   public:
     /// File browser constructor
@@ -818,255 +966,1881 @@ class cBrowser:public cOsdMenu
 };
 
 /**
-**	Add item to menu.  Called from C.
+**	Add item to menu.  Called from C.
+**
+**	@param obj	cBrowser object
+**	@param text	menu text
+*/
+extern "C" void cBrowser__Add(void *obj, const char *text)
+{
+    cBrowser *menu;
+
+    // fucking stupid C++ can't assign void* without warning:
+    menu = (typeof(menu)) obj;
+    menu->Add(new cOsdItem(text));
+}
+
+/**
+**	Add item of a running scan to menu.  Called from C.
+**
+**	Only the first entries are shown, until the scan is done.
+**
+**	@param obj	cBrowser object
+**	@param text	menu text
+*/
+extern "C" void cBrowser__AddPartial(void *obj, const char *text)
+{
+    cBrowser *menu;
+
+    menu = (typeof(menu)) obj;
+    if (menu->Count() < SCAN_PARTIAL_ITEMS) {
+	menu->Add(new cOsdItem(text));
+    }
+}
+
+/**
+**	Create browser directory menu.
+*/
+void cBrowser::CreateMenu(void)
+{
+    int current;
+
+    if (Scan) {				// stop scan of left directory
+	ScanDirectoryCancel(Scan);
+	Scan = NULL;
+    }
+    if (Listing) {
+	DirCacheClose(Listing);
+	Listing = NULL;
+    }
+    ListBase = 0;
+    Clear();				// start with empty directory
+    // FIXME: should show only directory name in title
+    //SetTitle(DirStack[0]);
+
+    if (!(Listing = DirCacheOpen(DirStack[0], Filter))
+	&& !(Listing = LibraryOpen(DirStack[0], Filter))
+	&& (Scan = ScanDirectoryStart(DirStack[0], Filter))) {
+	// small directories are shown complete and sorted at once
+	if (ScanDirectoryWait(Scan, SCAN_FIRST_WAIT)) {
+	    Listing = DirCacheFinish(Scan);
+	    Scan = NULL;
+	    // FIXME: handle errors!
+	} else {
+	    if (DirStackUsed > 1) {
+		// FIXME: should show only path
+		Add(new cOsdItem(DirStack[0]));
+	    }
+	    ScanDirectoryFetch(Scan, cBrowser__AddPartial, this);
+	    Skins.Message(mtStatus, tr("Scanning directory..."));
+	    Display();			// display first batch
+	    return;
+	}
+    }
+    // restore cursor of last visit
+    current = Listing ? DirCacheGetCurrent(Listing) : -1;
+    ShowEntries(current > 0 ? current : 0);
+}
+
+/**
+**	Append entries found by the running directory scan.
+**
+**	Called with every key, also with the periodic kNone.
+*/
+void cBrowser::ScanPoll(void)
+{
+    const cOsdItem *item;
+    char *select;
+    int current;
+    int n;
+
+    if (!Scan) {
+	return;
+    }
+    if (!ScanDirectoryWait(Scan, 0)) {
+	n = Count();
+	ScanDirectoryFetch(Scan, cBrowser__AddPartial, this);
+	if (n != Count()) {
+	    Display();
+	}
+	return;
+    }
+    // keep the highlighted entry, when the sorted entries replace all
+    select = NULL;
+    current = Current();
+    if ((current > 0 || DirStackUsed <= 1) && (item = Get(current))) {
+	select = strdup(item->Text());
+    }
+    ScanDone(select);
+    free(select);
+}
+
+/**
+**	Replace the partial entries with the sorted result of the scan.
+**
+**	@param select	name of entry to highlight, NULL last visit
+*/
+void cBrowser::ScanDone(const char *select)
+{
+    int current;
+
+    Listing = DirCacheFinish(Scan);
+    Scan = NULL;
+    // FIXME: handle errors!
+
+    current = -1;
+    if (select) {
+	current = FindEntry(select);
+    } else if (Listing) {
+	current = DirCacheGetCurrent(Listing);
+    }
+    ShowEntries(current > 0 ? current : 0);
+    Skins.Message(mtStatus, NULL);	// clear read message
+}
+
+/**
+**	Leave current directory, keep its cursor and stop its scan.
+*/
+void cBrowser::LeaveDir(void)
+{
+    if (Scan) {				// cursor of partial entries is useless
+	ScanDirectoryCancel(Scan);
+	Scan = NULL;
+	Skins.Message(mtStatus, NULL);
+    }
+    if (Listing) {
+	DirCacheSetCurrent(Listing, CurrentEntry());
+	DirCacheClose(Listing);
+	Listing = NULL;
+    }
+    ProbeCancel();			// requests of the left directory
+    ThumbCancel();
+}
+
+/**
+**	Get number of menu entries.
+**
+**	Only the entries around the cursor are menu items.
+**
+**	@returns number of entries, including the path entry.
+*/
+int cBrowser::Entries(void)
+{
+    return (DirStackUsed > 1) + (Listing ? DirCacheCount(Listing) : 0);
+}
+
+/**
+**	Get text of a menu entry.
+**
+**	@param i	entry index
+*/
+const char *cBrowser::Entry(int i)
+{
+    if (DirStackUsed > 1) {
+	if (!i) {
+	    // FIXME: should show only path
+	    return DirStack[0];
+	}
+	--i;
+    }
+    return DirCacheName(Listing, i);
+}
+
+/**
+**	Get entry index of the current menu item.
+**
+**	@returns entry index, -1 if the menu is empty.
+*/
+int cBrowser::CurrentEntry(void)
+{
+    int current;
+
+    if ((current = Current()) < 0) {
+	return -1;
+    }
+    return ListBase + current;
+}
+
+/**
+**	Find a menu entry by name.
+**
+**	@param name	file name
+**
+**	@returns entry index, -1 if not found.
+*/
+int cBrowser::FindEntry(const char *name)
+{
+    int i;
+    int n;
+
+    n = Entries();
+    for (i = DirStackUsed > 1; i < n; ++i) {
+	if (!strcmp(Entry(i), name)) {
+	    return i;
+	}
+    }
+    return -1;
+}
+
+/**
+**	Create the menu items around an entry and select it.
+**
+**	A page before and after the visible page are created, the cursor
+**	can move a page, before the items must be moved.
+**
+**	@param current	entry index of the cursor
+*/
+void cBrowser::ShowEntries(int current)
+{
+    cOsdItem *item;
+    int page;
+    int last;
+    int n;
+    int i;
+
+    page = DisplayMenu() ? DisplayMenu()->MaxItems() : BROWSER_PAGE;
+    n = Entries();
+    if (current >= n) {
+	current = n - 1;
+    }
+    ListBase = current - page;
+    if (ListBase + 3 * page > n) {
+	ListBase = n - 3 * page;
+    }
+    if (ListBase < 0) {
+	ListBase = 0;
+    }
+    last = ListBase + 3 * page < n ? ListBase + 3 * page : n;
+
+    Clear();
+    for (i = ListBase; i < last; ++i) {
+	Add(new cOsdItem(Entry(i)));
+    }
+    if (current >= 0 && (item = Get(current - ListBase))) {
+	SetCurrent(item);
+    }
+    Display();
+    QueueEntries(current);
+}
+
+/**
+**	Move the menu items, before the cursor leaves them.
+**
+**	@param key	cursor key
+**
+**	@returns true, if the key is handled.
+*/
+bool cBrowser::ScrollEntries(eKeys key)
+{
+    int current;
+    int page;
+    int n;
+
+    n = Entries();
+    if (!Listing || Count() >= n || (current = CurrentEntry()) < 0) {
+	return false;			// all entries are menu items
+    }
+    // wrap around at the entries, not at the menu items
+    if (Setup.MenuScrollWrap) {
+	if (key == kUp && !current) {
+	    ShowEntries(n - 1);
+	    return true;
+	}
+	if (key == kDown && current == n - 1) {
+	    ShowEntries(0);
+	    return true;
+	}
+    }
+    page = DisplayMenu() ? DisplayMenu()->MaxItems() : BROWSER_PAGE;
+    if ((Current() < page && ListBase > 0)
+	|| (Current() >= Count() - page && ListBase + Count() < n)) {
+	ShowEntries(current);
+    }
+    return false;
+}
+
+/**
+**	Create directory menu.
+**
+**	@param path	directory path file name
+**	@param filter	name selection filter
+*/
+void cBrowser::NewDir(const char *path, const NameFilter * filter)
+{
+    int n;
+    char *pathname;
+
+    if (DirStackUsed) {			// keep cursor of the left directory
+	LeaveDir();
+    }
+
+    n = strlen(path);
+#if 1
+    // FIXME: force caller to do
+    if (path[n - 1] == '/') {		// force '/' terminated
+	pathname = strdup(path);
+    } else {
+	pathname = (char *)malloc(n + 2);
+	stpcpy(stpcpy(pathname, path), "/");
+    }
+#endif
+
+    // push on directory stack
+    if (DirStackUsed >= DirStackSize) {	// increase stack size
+	DirStackSize = DirStackUsed + 1;
+	DirStack =
+	    (typeof(DirStack)) realloc(DirStack,
+	    DirStackSize * sizeof(*DirStack));
+    }
+    memmove(DirStack + 1, DirStack, DirStackUsed * sizeof(*DirStack));
+    DirStackUsed++;
+    DirStack[0] = pathname;
+
+    Filter = filter;
+
+    CreateMenu();
+}
+
+/**
+**	Menu constructor.
+**
+**	@param title	menu title
+**	@param path	directory path file name
+**	@param filter	name selection filter
+*/
+cBrowser::cBrowser(const char *title, const char *path,
+    const NameFilter * filter)
+:cOsdMenu(title)
+{
+    dsyslog("[play]%s:\n", __FUNCTION__);
+
+    PrefetchIndex = -1;
+    PrefetchDone = false;
+    Scan = NULL;
+    Listing = NULL;
+    ListBase = 0;
+    ProbeIndex = -1;
+    ProbeSeen = 0;
+    if (ConfigThumbDirectory && filter != AudioFilters) {
+	SetHelp(NULL, NULL, NULL, tr("Thumbnails"));
+    }
+
+    if (path) {				// clear stack, start new
+	int i;
+
+	// free the stored directory stack
+	for (i = 0; i < DirStackUsed; ++i) {
+	    free(DirStack[i]);
+	}
+	//free(DirStack);
+	//DirStack = NULL;		// reuse the old stack
+	DirStackUsed = 0;
+
+	NewDir(path, filter);
+	return;
+    }
+
+    Filter = filter;
+
+    CreateMenu();
+}
+
+/**
+**	Menu destructor.
+*/
+cBrowser::~cBrowser()
+{
+    dsyslog("[play]%s:\n", __FUNCTION__);
+
+    if (DirStackUsed) {			// keep cursor for the next open
+	LeaveDir();
+    }
+}
+
+/**
+**	Handle level up.
+*/
+eOSState cBrowser::LevelUp(void)
+{
+    char *down;
+    char *name;
+
+    if (DirStackUsed <= 1) {		// top level reached
+	return osEnd;
+    }
+    LeaveDir();
+    // go level up
+    --DirStackUsed;
+    down = DirStack[0];
+    memmove(DirStack, DirStack + 1, DirStackUsed * sizeof(*DirStack));
+
+    CreateMenu();
+
+    // select item, where we gone down
+    down[strlen(down) - 1] = '\0';	// remove trailing '/'
+    name = strrchr(down, '/');
+    if (name && Listing) {
+	int i;
+
+	if ((i = FindEntry(name + 1)) >= 0) {
+	    // FIXME: Display already called!
+	    ShowEntries(i);
+	}
+    } else if (name) {			// partial entries of running scan
+	cOsdItem *item;
+
+	for (item = First(); item; item = Next(item)) {
+	    if (!strcmp(item->Text(), name + 1)) {
+		SetCurrent(item);
+		Display();
+		break;
+	    }
+	}
+    }
+
+    free(down);
+
+    return osContinue;
+}
+
+/**
+**	Fill playlist with selected file and the following files.
+**
+**	Directories are sorted before files, all items after a file are files.
+**
+**	@param current	entry index of selected file
+**	@param filename	path and name of selected file
+*/
+void cBrowser::Playlist(int current, const char *filename)
+{
+    const char *text;
+    char *tmp;
+    int n;
+
+    PlayerPlaylistClear();
+    if (!ConfigPlaylist || IsIsoImage(filename)) {
+	return;
+    }
+    PlayerPlaylistAdd(filename);
+    n = Entries();
+    while (++current < n) {
+	text = Entry(current);
+	tmp = (char *)malloc(strlen(DirStack[0]) + strlen(text) + 1);
+	stpcpy(stpcpy(tmp, DirStack[0]), text);
+	if (!IsArchive(tmp) && !IsIsoImage(tmp)) {
+	    PlayerPlaylistAdd(tmp);
+	}
+	free(tmp);
+    }
+}
+
+/**
+**	Prefetch the highlighted file, when the cursor stays on it.
+**
+**	Called with every key, a cursor move cancels the prefetch.  The
+**	prefetch threads check, if it is a regular file.
+*/
+void cBrowser::Prefetch(void)
+{
+    int current;
+    const cOsdItem *item;
+    char *filename;
+
+    current = CurrentEntry();
+    if (current != PrefetchIndex) {	// cursor moved
+	if (PrefetchDone) {
+	    PrefetchCancel();
+	}
+	PrefetchIndex = current;
+	PrefetchDone = false;
+	PrefetchDwell.Set(PREFETCH_DWELL);
+	return;
+    }
+    if (PrefetchDone || !PrefetchDwell.TimedOut()
+	|| !(item = Get(current - ListBase)) || (current == 0
+	    && DirStackUsed > 1)) {
+	return;
+    }
+    PrefetchDone = true;
+
+    filename = (char *)malloc(strlen(DirStack[0]) + strlen(item->Text()) + 1);
+    stpcpy(stpcpy(filename, DirStack[0]), item->Text());
+    PrefetchFile(filename);
+    free(filename);
+}
+
+/**
+**	Queue probe and thumbnail of the files of the menu items.
+**
+**	The queued requests of the old items are cancelled, the files are
+**	queued from the cursor on, the items before it last.  Images have
+**	nothing to probe, audio files have no thumbnail.
+**
+**	@param current	entry index of the cursor
+*/
+void cBrowser::QueueEntries(int current)
+{
+    char *filename;
+    int first;
+    int i;
+    int n;
+
+    ProbeCancel();
+    ThumbCancel();
+    ProbeIndex = -2;			// new items: redraw status
+    if (!Listing || current < 0) {
+	return;
+    }
+    n = Count();
+    // directories are first in the listing, skip them
+    first = DirCacheDirs(Listing) + (DirStackUsed > 1) - ListBase;
+    if (first < 0) {
+	first = 0;
+    }
+    for (i = 0; i < n; ++i) {
+	const cOsdItem *item;
+	int index;
+
+	index = (current - ListBase + i) % n;
+	if (index < first || !(item = Get(index))) {
+	    continue;
+	}
+	filename =
+	    (char *)malloc(strlen(DirStack[0]) + strlen(item->Text()) + 1);
+	stpcpy(stpcpy(filename, DirStack[0]), item->Text());
+	if (Filter != ImageFilters) {
+	    ProbeFile(filename);
+	}
+	if (ConfigThumbDirectory && Filter != AudioFilters) {
+	    ThumbFile(filename);
+	}
+	free(filename);
+    }
+}
+
+/**
+**	Show the probed information of the highlighted file as status.
+**
+**	Called with every key, the status changes with the cursor or when
+**	new probe results are ready.
+*/
+void cBrowser::ProbeStatus(void)
+{
+    int current;
+    unsigned changes;
+    const cOsdItem *item;
+    char *filename;
+    ProbeInfo info;
+    char buf[256];
+    size_t n;
+
+    current = CurrentEntry();
+    changes = ProbeChanges();
+    if (current == ProbeIndex && changes == ProbeSeen) {
+	return;
+    }
+    ProbeIndex = current;
+    ProbeSeen = changes;
+
+    if (!Listing || current < DirCacheDirs(Listing) + (DirStackUsed > 1)
+	|| !(item = Get(current - ListBase))) {
+	SetStatus(NULL);
+	return;
+    }
+    filename = (char *)malloc(strlen(DirStack[0]) + strlen(item->Text()) + 1);
+    stpcpy(stpcpy(filename, DirStack[0]), item->Text());
+    if (!ProbeLookup(filename, &info)) {
+	free(filename);
+	SetStatus(NULL);
+	return;
+    }
+    free(filename);
+
+    n = 0;
+    buf[0] = '\0';
+    if (info.Duration >= 0) {
+	n += snprintf(buf + n, sizeof(buf) - n, "%d:%02d:%02d  ",
+	    info.Duration / 3600, info.Duration / 60 % 60, info.Duration % 60);
+    }
+    if (info.Title[0] && n < sizeof(buf)) {
+	n += snprintf(buf + n, sizeof(buf) - n, "%s%s%s%s%s  ", info.Title,
+	    info.Artist[0] ? " - " : "", info.Artist,
+	    info.Album[0] ? " - " : "", info.Album);
+    }
+    // track lists without languages show the number of tracks
+    if (info.AudioN > 1 && n < sizeof(buf)) {
+	n += info.Audio[0] ? snprintf(buf + n, sizeof(buf) - n, "%s: %s  ",
+	    tr("Audio"), info.Audio) : snprintf(buf + n, sizeof(buf) - n,
+	    "%s: %d  ", tr("Audio"), info.AudioN);
+    }
+    if (info.SubtitleN && n < sizeof(buf)) {
+	n += info.Subtitles[0] ? snprintf(buf + n, sizeof(buf) - n, "%s: %s",
+	    tr("Subtitles"), info.Subtitles) : snprintf(buf + n,
+	    sizeof(buf) - n, "%s: %d", tr("Subtitles"), info.SubtitleN);
+    }
+    SetStatus(buf[0] ? buf : NULL);
+}
+
+/**
+**	Handle selected item.
+*/
+eOSState cBrowser::Selected(void)
+{
+    int current;
+    const cOsdItem *item;
+    const char *text;
+    char *filename;
+    char *tmp;
+
+    if (Scan) {				// select in complete directory
+	ScanDirectoryWait(Scan, -1);
+	ScanPoll();
+    }
+    current = CurrentEntry();		// get current menu entry index
+    if (!(item = Get(Current()))) {	// empty directory
+	return osContinue;
+    }
+    text = item->Text();
+
+    if (current == 0 && DirStackUsed > 1) {
+	return LevelUp();
+    }
+    // +2: \0 + #
+    filename = (char *)malloc(strlen(DirStack[0]) + strlen(text) + 2);
+    // path is '/' terminated
+    tmp = stpcpy(stpcpy(filename, DirStack[0]), text);
+    if (!IsDirectory(filename)) {
+	if (IsArchive(filename)) {	// handle archives
+	    stpcpy(tmp, "#");
+	    NewDir(filename, Filter);
+	    free(filename);
+	    // FIXME: if dir fails use keep old!
+	    return osContinue;
+	}
+#if defined(USE_JPG) || defined(USE_PNG)
+	if (Filter == ImageFilters
+	    && NameFilterMatch(Filter, text) == MEDIA_IMAGE) {
+	    free(ShowDiashow);
+	    ShowDiashow = filename;
+	    return osPlugin;		// restart with slideshow
+	}
+#endif
+	Playlist(current, filename);
+	PlayFileHandleType(filename);
+	free(filename);
+	return osEnd;
+    }
+    // handle DVD image
+    if (!strcmp(text, "AUDIO_TS") || !strcmp(text, "VIDEO_TS")) {
+	free(filename);
+	tmp = (char *)malloc(sizeof("dvdnav:///") + strlen(DirStack[0]));
+	strcpy(stpcpy(tmp, "dvdnav:///"), DirStack[0]);
+	PlayFile(tmp);
+	free(tmp);
+	return osEnd;
+    }
+    stpcpy(tmp, "/");			// append '/'
+    NewDir(filename, Filter);
+    free(filename);
+    // FIXME: if dir fails use keep old!
+    return osContinue;
+}
+
+/**
+**	Show the thumbnail view of the directory.
+**
+**	The highlighted entry is highlighted in the view, back returns to
+**	the browser.
+*/
+eOSState cBrowser::Thumbnails(void)
+{
+    const cOsdItem *item;
+    const char *text;
+
+    if (!ConfigThumbDirectory || Filter == AudioFilters) {
+	return osContinue;
+    }
+    if (Scan) {				// view of the complete directory
+	ScanDirectoryWait(Scan, -1);
+	ScanPoll();
+    }
+    text = "";
+    if ((CurrentEntry() > 0 || DirStackUsed <= 1)
+	&& (item = Get(Current()))) {
+	text = item->Text();
+    }
+    free(ShowThumbnails);
+    ShowThumbnails = (char *)malloc(strlen(DirStack[0]) + strlen(text) + 1);
+    stpcpy(stpcpy(ShowThumbnails, DirStack[0]), text);
+    return osPlugin;			// restart with thumbnail view
+}
+
+/**
+**	Handle Menu key event.
+**
+**	@param key	key event
+*/
+eOSState cBrowser::ProcessKey(eKeys key)
+{
+    eOSState state;
+
+    ScanPoll();
+
+    switch (NORMALKEY(key)) {		// keep menu items around the cursor
+	case kUp:
+	case kDown:
+	case kLeft:
+	case kRight:
+	    if (ScrollEntries(NORMALKEY(key))) {
+		Prefetch();
+		ProbeStatus();
+		return osContinue;
+	    }
+	    break;
+	default:
+	    break;
+    }
+
+    // call standard function
+    state = cOsdMenu::ProcessKey(key);
+    if (state || key != kNone) {
+	dsyslog("[play]%s: state=%d key=%d\n", __FUNCTION__, state, key);
+    }
+
+    switch (state) {
+	case osUnknown:
+	    switch (key) {
+		case kOk:
+		    return Selected();
+		case kBack:
+		    return LevelUp();
+		case kBlue:
+		    return Thumbnails();
+		default:
+		    break;
+	    }
+	    break;
+	case osBack:
+	    state = LevelUp();
+	    if (state == osEnd) {	// top level reached
+		ShowBrowser = 0;
+		return osPlugin;
+	    }
+	default:
+	    break;
+    }
+    if (state == osContinue || state == osUnknown) {
+	Prefetch();
+	ProbeStatus();
+    }
+    return state;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	cOsdMenu
+//////////////////////////////////////////////////////////////////////////////
+
+    /// max results of a library search
+#define SEARCH_RESULTS	50
+
+/**
+**	Library search menu class.
+**
+**	Typed characters extend the query, each one searches again.
+*/
+class cSearchMenu:public cOsdMenu
+{
+  private:
+    char Query[64];			///< search query
+    int QueryLen;			///< length of search query
+    LibraryResult Results[SEARCH_RESULTS];	///< ranked results
+    int ResultN;			///< number of results
+
+    void FreeResults(void);
+    void Search(void);
+    eOSState Selected(void);
+  public:
+    cSearchMenu(void);
+    virtual ~ cSearchMenu();
+    virtual eOSState ProcessKey(eKeys);
+};
+
+    /// directory of the selected search result
+static char *SearchBrowserDir;
+
+/**
+**	Search menu constructor.
+*/
+cSearchMenu::cSearchMenu(void)
+:cOsdMenu(tr("Search"), 32)
+{
+    Query[0] = '\0';
+    QueryLen = 0;
+    ResultN = 0;
+    Search();
+}
+
+/**
+**	Search menu destructor.
+*/
+cSearchMenu::~cSearchMenu()
+{
+    FreeResults();
+}
+
+/**
+**	Free the results of the last search.
+*/
+void cSearchMenu::FreeResults(void)
+{
+    int i;
+
+    for (i = 0; i < ResultN; ++i) {
+	free(Results[i].Path);
+    }
+    ResultN = 0;
+}
+
+/**
+**	Search the library with the current query and show the results.
+*/
+void cSearchMenu::Search(void)
+{
+    char *title;
+    int i;
+
+    FreeResults();
+    Clear();
+
+    title = (char *)malloc(strlen(tr("Search")) + QueryLen + 4);
+    stpcpy(stpcpy(stpcpy(title, tr("Search")), ": "), Query);
+    SetTitle(title);
+    free(title);
+
+    if (QueryLen && (ResultN = LibrarySearch(Query, Results,
+		SEARCH_RESULTS)) < 0) {
+	ResultN = 0;
+	Skins.Message(mtStatus, tr("Library index not ready"));
+    }
+    for (i = 0; i < ResultN; ++i) {
+	const char *path;
+	const char *name;
+	char *text;
+	int n;
+
+	// show name, then its directory
+	path = Results[i].Path;
+	n = strlen(path);
+	if (!Results[i].Type) {		// directories are '/' terminated
+	    --n;
+	}
+	for (name = path + n; name > path && name[-1] != '/'; --name) {
+	}
+	text = (char *)malloc(n + 2);
+	memcpy(text, name, path + n - name);
+	text[path + n - name] = '\t';
+	memcpy(text + (path + n - name) + 1, path, name - path);
+	text[n + 1] = '\0';
+	Add(new cOsdItem(text));
+	free(text);
+    }
+    Display();
+}
+
+/**
+**	Play the selected file or browse the selected directory.
+*/
+eOSState cSearchMenu::Selected(void)
+{
+    int current;
+
+    if ((current = Current()) < 0 || current >= ResultN) {
+	return osContinue;
+    }
+    if (Results[current].Type) {
+	PlayFileHandleType(Results[current].Path);
+	return osEnd;
+    }
+    free(SearchBrowserDir);
+    SearchBrowserDir = strdup(Results[current].Path);
+    ShowBrowser = 1;
+    BrowserStartDir = SearchBrowserDir;
+    BrowserFilters = NULL;
+    return osPlugin;			// restart with OSD browser
+}
+
+/**
+**	Handle search menu key event.
+**
+**	Keyboard characters (KBDKEY) and digits extend the query, back
+**	removes its last character.
+**
+**	@param key	key event
+*/
+eOSState cSearchMenu::ProcessKey(eKeys key)
+{
+    int c;
+
+    c = 0;
+    if (BASICKEY(key) == kKbd) {
+	c = KEYKBD(key);
+    } else if (key >= k0 && key <= k9) {
+	c = '0' + key - k0;
+    }
+    if (c >= ' ' && c < 127) {
+	if (QueryLen < (int)sizeof(Query) - 1) {
+	    Query[QueryLen++] = c;
+	    Query[QueryLen] = '\0';
+	    Search();
+	}
+	return osContinue;
+    }
+    if ((c == '\b' || c == 127 || key == kBack) && QueryLen) {
+	Query[--QueryLen] = '\0';
+	Search();
+	return osContinue;
+    }
+    if (key == kOk) {
+	return Selected();
+    }
+    return cOsdMenu::ProcessKey(key);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	cOsdObject
+//////////////////////////////////////////////////////////////////////////////
+
+    /// time in ms an image is shown in the slideshow
+#define DIASHOW_DELAY	5000
+    /// images prefetched in the direction of the slideshow
+#define DIASHOW_AHEAD	3
+    /// images prefetched against the direction of the slideshow
+#define DIASHOW_BEHIND	1
+
+/**
+**	Image slideshow class.
+**
+**	Shows the images of a directory on a true color OSD, decoded
+**	in-process at about the OSD size.  The neighbour images are
+**	prefetched in the direction the user steps.  Camera images show
+**	their exif thumbnail at once, until the decode is done.
+*/
+class cDiashow:public cOsdObject
+{
+  private:
+    cOsd *Osd;				///< true color osd
+    char *Directory;			///< directory of images, '/' terminated
+    NameArena Names;			///< sorted names of directory
+    int Current;			///< index of shown image
+    int Direction;			///< last step +1 next, -1 previous
+    bool Paused;			///< no automatic step
+    bool Preview;			///< exif thumbnail of image is shown
+    cTimeMs Timer;			///< time of automatic step
+
+    /// Put an image centered on the OSD
+    void Put(const uint32_t *, int, int);
+    /// Show current image
+    void Draw(void);
+    /// Replace the preview by the decoded image
+    void Update(void);
+    /// Find next or previous image
+    int Find(int, int) const;
+    /// Step to next or previous image
+    bool Step(int);
+    /// Path and name of an image
+    char *Path(int) const;
+    /// Prefetch the neighbour images
+    void Prefetch(void);
+
+  public:
+    /// Slideshow constructor
+    cDiashow(const char *);
+    /// Slideshow destructor
+    virtual ~ cDiashow();
+    /// Open the OSD and show the first image
+    virtual void Show(void);
+    /// Process keyboard input
+    virtual eOSState ProcessKey(eKeys);
+};
+
+/**
+**	Slideshow constructor.
+**
+**	@param filename	path and name of first image
+*/
+cDiashow::cDiashow(const char *filename)
+{
+    const char *name;
+    const char *split;
+    int i;
+
+    Osd = NULL;
+    Current = -1;
+    Direction = 1;
+    Paused = false;
+    Preview = false;
+    memset(&Names, 0, sizeof(Names));
+
+    name = strrchr(filename, '/') + 1;
+    // image in the root of an archive: "file.cbz#page.jpg"
+    if ((split = ArchiveSplit(filename)) && split >= name) {
+	name = split + 1;
+    }
+    Directory = strndup(filename, name - filename);
+    if (ScanDirectory(Directory, 0, ImageFilters, &Names) > 0) {
+	for (i = 0; i < Names.Count; ++i) {
+	    if (!strcmp(NameArenaGet(&Names, i), name)) {
+		Current = i;
+		break;
+	    }
+	}
+    }
+}
+
+/**
+**	Slideshow destructor.
+*/
+cDiashow::~cDiashow()
+{
+    delete Osd;
+    ImageExit();			// free cached images
+
+    free(Names.Block);
+    free(Directory);
+}
+
+/**
+**	Find the next or previous image, archives are skipped.
+**
+**	@param index	index to start from
+**	@param direction	+1 next, -1 previous image
+**
+**	@returns index of image, -1 if there is no image in this direction.
+*/
+int cDiashow::Find(int index, int direction) const
+{
+    int i;
+
+    for (i = index + direction; i >= 0 && i < Names.Count; i += direction) {
+	if (NameFilterMatch(ImageFilters, NameArenaGet(&Names,
+		    i)) == MEDIA_IMAGE) {
+	    return i;
+	}
+    }
+    return -1;
+}
+
+/**
+**	Step to the next or previous image.
+**
+**	@param direction	+1 next, -1 previous image
+**
+**	@returns true, if there is an image in this direction.
+*/
+bool cDiashow::Step(int direction)
+{
+    int i;
+
+    Direction = direction;
+    if ((i = Find(Current, direction)) < 0) {
+	return false;
+    }
+    Current = i;
+    return true;
+}
+
+/**
+**	Get path and name of an image.
+**
+**	@param index	index of image
+**
+**	@returns malloced path and name.
+*/
+char *cDiashow::Path(int index) const
+{
+    char *filename;
+
+    filename =
+	(char *)malloc(strlen(Directory) + strlen(NameArenaGet(&Names,
+		index)) + 1);
+    stpcpy(stpcpy(filename, Directory), NameArenaGet(&Names, index));
+    return filename;
+}
+
+/**
+**	Prefetch the current image and its neighbour images.
+**
+**	The images in the direction of the last step are queued first, old
+**	requests are canceled.
+*/
+void cDiashow::Prefetch(void)
+{
+    char *filename;
+    int i;
+    int n;
+
+    ImageCancel();
+    filename = Path(Current);
+    ImagePrefetch(filename, cOsd::OsdWidth(), cOsd::OsdHeight());
+    free(filename);
+    for (i = Current, n = 0; n < DIASHOW_AHEAD
+	&& (i = Find(i, Direction)) >= 0; ++n) {
+	filename = Path(i);
+	ImagePrefetch(filename, cOsd::OsdWidth(), cOsd::OsdHeight());
+	free(filename);
+    }
+    for (i = Current, n = 0; n < DIASHOW_BEHIND
+	&& (i = Find(i, -Direction)) >= 0; ++n) {
+	filename = Path(i);
+	ImagePrefetch(filename, cOsd::OsdWidth(), cOsd::OsdHeight());
+	free(filename);
+    }
+}
+
+/**
+**	Put an image centered on the OSD.
+**
+**	@param argb	ARGB pixels of image
+**	@param width	width of image
+**	@param height	height of image
+*/
+void cDiashow::Put(const uint32_t * argb, int width, int height)
+{
+    cImage image(cSize(width, height), (const tColor *)argb);
+
+    Osd->DrawImage(cPoint((cOsd::OsdWidth() - width) / 2,
+	    (cOsd::OsdHeight() - height) / 2), image);
+}
+
+/**
+**	Show the current image centered on black.
+**
+**	A camera image not yet decoded shows its exif thumbnail, the
+**	workers decode the image in the background.
+*/
+void cDiashow::Draw(void)
+{
+    uint32_t *argb;
+    char *filename;
+    int width;
+    int height;
+    int done;
+
+    if (!Osd) {
+	return;
+    }
+    Preview = false;
+    Osd->DrawRectangle(0, 0, cOsd::OsdWidth() - 1, cOsd::OsdHeight() - 1,
+	clrBlack);
+    if (Current >= 0) {
+	Prefetch();
+	filename = Path(Current);
+	width = cOsd::OsdWidth();
+	height = cOsd::OsdHeight();
+	if (!(argb = ImageLookup(filename, &width, &height, &done)) && !done) {
+	    if ((argb = ImagePreview(filename, &width, &height))) {
+		Preview = true;
+	    } else {
+		argb = ImageFetch(filename, &width, &height);
+	    }
+	}
+	if (argb) {
+	    Put(argb, width, height);
+	    free(argb);
+	} else {
+	    Osd->DrawText(0, 0, tr("Can't load image"), clrWhite, clrBlack,
+		cFont::GetFont(fontOsd));
+	}
+	free(filename);
+    }
+    Osd->Flush();
+    Timer.Set(DIASHOW_DELAY);
+}
+
+/**
+**	Replace the preview by the decoded image, when its decode is done.
+**
+**	If the image can't be decoded, the preview stays.
+*/
+void cDiashow::Update(void)
+{
+    uint32_t *argb;
+    char *filename;
+    int width;
+    int height;
+    int done;
+
+    filename = Path(Current);
+    width = cOsd::OsdWidth();
+    height = cOsd::OsdHeight();
+    argb = ImageLookup(filename, &width, &height, &done);
+    free(filename);
+    if (done) {
+	Preview = false;
+	if (argb) {
+	    // the decoded size may differ from the preview by rounding
+	    Osd->DrawRectangle(0, 0, cOsd::OsdWidth() - 1,
+		cOsd::OsdHeight() - 1, clrBlack);
+	    Put(argb, width, height);
+	    Osd->Flush();
+	    free(argb);
+	}
+    }
+}
+
+/**
+**	Open the true color OSD and show the first image.
+*/
+void cDiashow::Show(void)
+{
+    tArea area;
+
+    Osd = cOsdProvider::NewOsd(cOsd::OsdLeft(), cOsd::OsdTop());
+    area.x1 = 0;
+    area.y1 = 0;
+    area.x2 = cOsd::OsdWidth() - 1;
+    area.y2 = cOsd::OsdHeight() - 1;
+    area.bpp = 32;
+    if (Osd->SetAreas(&area, 1) != oeOk) {
+	esyslog(tr("[play]: true color OSD not available\n"));
+    }
+    Draw();
+}
+
+/**
+**	Handle slideshow key event.
+**
+**	Left/right step through the images, ok pauses the slideshow.
+**
+**	@param key	key event
+*/
+eOSState cDiashow::ProcessKey(eKeys key)
+{
+    switch (NORMALKEY(key)) {
+	case kNone:
+	    if (Preview) {
+		Update();
+	    }
+	    if (Paused || !Timer.TimedOut()) {
+		break;
+	    }
+	    // fall through
+	case kRight:
+	case kDown:
+	case kNext:
+	case kFastFwd:
+	    if (Step(1)) {
+		Draw();
+	    } else {
+		Timer.Set(DIASHOW_DELAY);
+	    }
+	    break;
+	case kLeft:
+	case kUp:
+	case kPrev:
+	case kFastRew:
+	    if (Step(-1)) {
+		Draw();
+	    }
+	    break;
+	case kOk:
+	case kPlay:
+	case kPause:
+	    Paused = !Paused;
+	    Timer.Set(DIASHOW_DELAY);
+	    break;
+	case kBack:
+	case kStop:
+	    // back to the browser of the directory
+	    return ShowBrowser ? osPlugin : osEnd;
+	default:
+	    break;
+    }
+    return osContinue;
+}
+
+    /// columns of the thumbnail view
+#define THUMBS_COLUMNS	5
+    /// border in pixel around the thumbnails
+#define THUMBS_BORDER	8
+    /// background of the highlighted cell
+#define THUMBS_CURSOR	0xFF505050
+    /// placeholder of a missing thumbnail
+#define THUMBS_EMPTY	0xFF202020
+    /// placeholder of a directory
+#define THUMBS_FOLDER	0xFF203050
+
+/**
+**	Thumbnail view class.
+**
+**	Shows the cached thumbnails of a directory as grid on a true color
+**	OSD.  The thumbnails of the shown page are queued, missing cells are
+**	drawn, when the workers have finished them.  Directories and
+**	archives are entered, images start the slideshow, other files are
+**	played.
+*/
+class cThumbnails:public cOsdObject
+{
+  private:
+    cOsd *Osd;				///< true color osd
+    const NameFilter *Filter;		///< name filter of the browser
+    char *Start;			///< directory of the browser
+    char *Directory;			///< shown directory, '/' terminated
+    DirCache *Listing;			///< sorted entries of directory
+    int Current;			///< index of highlighted entry
+    int First;				///< index of first shown entry
+    int Columns;			///< cells of a row
+    int Rows;				///< rows of a page
+    int CellWidth;			///< width of a cell
+    int CellHeight;			///< height of a cell with name
+    int BoxWidth;			///< max width of a thumbnail
+    int BoxHeight;			///< max height of a thumbnail
+    char *Missing;			///< cells of page without thumbnail
+    unsigned Seen;			///< thumbnail changes drawn
+
+    /// Show a directory and highlight an entry
+    void Enter(const char *);
+    /// Go to the parent directory
+    void Up(void);
+    /// Keep the cursor on the browser entry
+    void Leave(void);
+    /// Number of entries
+    int Entries(void) const;
+    /// Path and name of an entry
+    char *Path(int) const;
+    /// Put a thumbnail scaled into its cell
+    void Put(const uint32_t *, int, int, int, int);
+    /// Draw a cell
+    void DrawCell(int);
+    /// Show the page of the cursor
+    void Draw(void);
+    /// Draw new thumbnails of missing cells
+    void Update(void);
+    /// Queue the thumbnails of the page
+    void Queue(void);
+    /// Move the cursor
+    void Move(int);
+    /// Fill playlist with selected and following files
+    void Playlist(const char *);
+    /// Handle selected entry
+    eOSState Selected(void);
+
+  public:
+    /// Thumbnail view constructor
+    cThumbnails(const char *, const NameFilter *);
+    /// Thumbnail view destructor
+    virtual ~ cThumbnails();
+    /// Open the OSD and show the first page
+    virtual void Show(void);
+    /// Process keyboard input
+    virtual eOSState ProcessKey(eKeys);
+};
+
+/**
+**	Thumbnail view constructor.
+**
+**	@param path	path and name of highlighted entry
+**	@param filter	name selection filter
+*/
+cThumbnails::cThumbnails(const char *path, const NameFilter * filter)
+{
+    Osd = NULL;
+    Filter = filter;
+    Directory = NULL;
+    Listing = NULL;
+    Columns = 1;
+    Rows = 1;
+    Missing = NULL;
+    Seen = 0;
+
+    Enter(path);
+    Start = strdup(Directory);
+}
+
+/**
+**	Thumbnail view destructor.
+*/
+cThumbnails::~cThumbnails()
+{
+    ThumbCancel();
+    delete Osd;
+
+    if (Listing) {
+	DirCacheClose(Listing);
+    }
+    free(Missing);
+    free(Directory);
+    free(Start);
+}
+
+/**
+**	Show a directory and highlight an entry.
+**
+**	The listing is read like the browser does, from the cache, the
+**	library or a scan.
+**
+**	@param path	path and name of entry, '/' terminated for the first
+*/
+void cThumbnails::Enter(const char *path)
+{
+    const char *name;
+    const char *split;
+    ScanContext *scan;
+    int i;
+
+    if (Listing) {
+	DirCacheClose(Listing);
+	Listing = NULL;
+    }
+    name = strrchr(path, '/') + 1;
+    // entry in the root of an archive: "file.cbz#page.jpg"
+    if ((split = ArchiveSplit(path)) && split >= name) {
+	name = split + 1;
+    }
+    free(Directory);
+    Directory = strndup(path, name - path);
+    if (!(Listing = DirCacheOpen(Directory, Filter))
+	&& !(Listing = LibraryOpen(Directory, Filter))
+	&& (scan = ScanDirectoryStart(Directory, Filter))) {
+	ScanDirectoryWait(scan, -1);
+	Listing = DirCacheFinish(scan);
+    }
+    Current = 0;
+    First = 0;
+    for (i = 0; i < Entries(); ++i) {
+	if (!strcmp(DirCacheName(Listing, i), name)) {
+	    Current = i;
+	    break;
+	}
+    }
+}
+
+/**
+**	Go to the parent directory, the left directory is highlighted.
+*/
+void cThumbnails::Up(void)
+{
+    char *path;
+    size_t n;
+
+    path = strdup(Directory);
+    n = strlen(path);
+    path[--n] = '\0';			// remove trailing '/'
+    // archive root "file.cbz#/": the archive is the entry
+    if (n && ArchiveSplit(path) == path + n - 1) {
+	path[--n] = '\0';
+    }
+    Enter(path);
+    free(path);
+}
+
+/**
+**	Keep the cursor for the browser, if it shows the same directory.
+*/
+void cThumbnails::Leave(void)
+{
+    if (Listing && !strcmp(Directory, Start)) {
+	// the browser counts its path entry
+	DirCacheSetCurrent(Listing, Current + (DirStackUsed > 1));
+    }
+}
+
+/**
+**	Get number of entries.
+*/
+int cThumbnails::Entries(void) const
+{
+    return Listing ? DirCacheCount(Listing) : 0;
+}
+
+/**
+**	Get path and name of an entry.
+**
+**	@param index	index of entry
+**
+**	@returns malloced path and name, with room for "#/".
+*/
+char *cThumbnails::Path(int index) const
+{
+    const char *name;
+    char *filename;
+
+    name = DirCacheName(Listing, index);
+    filename = (char *)malloc(strlen(Directory) + strlen(name) + 3);
+    stpcpy(stpcpy(filename, Directory), name);
+    return filename;
+}
+
+/**
+**	Put a thumbnail centered into its cell.
+**
+**	Thumbnails bigger than the cell are scaled down.
+**
+**	@param argb	ARGB pixels of thumbnail
+**	@param width	width of thumbnail
+**	@param height	height of thumbnail
+**	@param x	x-coordinate of thumbnail box
+**	@param y	y-coordinate of thumbnail box
+*/
+void cThumbnails::Put(const uint32_t * argb, int width, int height, int x,
+    int y)
+{
+    uint32_t *scaled;
+    int w;
+    int h;
+    int i;
+    int j;
+
+    w = width;
+    h = height;
+    if (w > BoxWidth || h > BoxHeight) {	// fit and keep aspect
+	if (width * BoxHeight > height * BoxWidth) {
+	    w = BoxWidth;
+	    h = height * BoxWidth / width;
+	} else {
+	    h = BoxHeight;
+	    w = width * BoxHeight / height;
+	}
+	if (w < 1) {
+	    w = 1;
+	}
+	if (h < 1) {
+	    h = 1;
+	}
+    }
+    scaled = NULL;
+    if (w != width || h != height) {
+	if (!(scaled = (uint32_t *) malloc(w * h * sizeof(*scaled)))) {
+	    return;
+	}
+	for (j = 0; j < h; ++j) {
+	    for (i = 0; i < w; ++i) {
+		scaled[i + j * w] =
+		    argb[i * width / w + j * height / h * width];
+	    }
+	}
+	argb = scaled;
+    }
+    cImage image(cSize(w, h), (const tColor *)argb);
+
+    Osd->DrawImage(cPoint(x + (BoxWidth - w) / 2, y + (BoxHeight - h) / 2),
+	image);
+    free(scaled);
+}
+
+/**
+**	Draw a cell with the thumbnail and the name of an entry.
 **
-**	@param obj	cBrowser object
-**	@param text	menu text
+**	@param index	index of entry on the page
 */
-extern "C" void cBrowser__Add(void *obj, const char *text)
+void cThumbnails::DrawCell(int index)
 {
-    cBrowser *menu;
-
-    // fucking stupid C++ can't assign void* without warning:
-    menu = (typeof(menu)) obj;
-    menu->Add(new cOsdItem(text));
+    const cFont *font;
+    uint32_t *argb;
+    char *filename;
+    tColor background;
+    int width;
+    int height;
+    int cell;
+    int x;
+    int y;
+
+    cell = index - First;
+    x = cell % Columns * CellWidth;
+    y = cell / Columns * CellHeight;
+    background = index == Current ? THUMBS_CURSOR : clrBlack;
+    Osd->DrawRectangle(x, y, x + CellWidth - 1, y + CellHeight - 1,
+	background);
+
+    argb = NULL;
+    if (index >= DirCacheDirs(Listing)) {
+	filename = Path(index);
+	argb = ThumbLookup(filename, &width, &height);
+	free(filename);
+    }
+    Missing[cell] = index >= DirCacheDirs(Listing) && !argb;
+    x += THUMBS_BORDER;
+    y += THUMBS_BORDER;
+    if (argb) {
+	Put(argb, width, height, x, y);
+	free(argb);
+    } else {
+	Osd->DrawRectangle(x, y, x + BoxWidth - 1, y + BoxHeight - 1,
+	    Missing[cell] ? THUMBS_EMPTY : THUMBS_FOLDER);
+    }
+    font = cFont::GetFont(fontSml);
+    Osd->DrawText(x, y + BoxHeight + THUMBS_BORDER, DirCacheName(Listing,
+	    index), clrWhite, background, font, BoxWidth, font->Height(),
+	taCenter);
 }
 
 /**
-**	Create browser directory menu.
+**	Show the page of the cursor and queue its thumbnails.
 */
-void cBrowser::CreateMenu(void)
+void cThumbnails::Draw(void)
 {
-    Clear();				// start with empty directory
-    // FIXME: should show only directory name in title
-    //SetTitle(DirStack[0]);
-    Skins.Message(mtStatus, tr("Scanning directory..."));
+    int page;
+    int i;
+    int n;
 
-    if (DirStackUsed > 1) {
-	// FIXME: should show only path
-	Add(new cOsdItem(DirStack[0]));
+    if (!Osd) {
+	return;
     }
-    ReadDirectory(DirStack[0], 1, NULL, cBrowser__Add, this);
-    ReadDirectory(DirStack[0], 0, Filter, cBrowser__Add, this);
-    // FIXME: handle errors!
-
-    Display();				// display build menu
-    Skins.Message(mtStatus, NULL);	// clear read message
+    page = Columns * Rows;
+    if (Current < First || Current >= First + page) {
+	// cursor row on top, but the last page is filled
+	First = Current - Current % Columns;
+	if (First > Entries() - page) {
+	    First = Entries() - page;
+	    First += (Columns - First % Columns) % Columns;
+	}
+	if (First < 0) {
+	    First = 0;
+	}
+    }
+    Seen = ThumbChanges();
+    Osd->DrawRectangle(0, 0, cOsd::OsdWidth() - 1, cOsd::OsdHeight() - 1,
+	clrBlack);
+    n = Entries();
+    for (i = First; i < n && i < First + page; ++i) {
+	DrawCell(i);
+    }
+    if (!n) {
+	Osd->DrawText(0, 0, tr("Empty directory"), clrWhite, clrBlack,
+	    cFont::GetFont(fontOsd));
+    }
+    Osd->Flush();
+    Queue();
 }
 
 /**
-**	Create directory menu.
+**	Draw the cells, whose thumbnails are finished since the last draw.
 **
-**	@param path	directory path file name
-**	@param filter	name selection filter
+**	Called with the periodic kNone.
 */
-void cBrowser::NewDir(const char *path, const NameFilter * filter)
+void cThumbnails::Update(void)
 {
+    unsigned changes;
+    bool drawn;
+    int i;
     int n;
-    char *pathname;
 
-    n = strlen(path);
-#if 1
-    // FIXME: force caller to do
-    if (path[n - 1] == '/') {		// force '/' terminated
-	pathname = strdup(path);
-    } else {
-	pathname = (char *)malloc(n + 2);
-	stpcpy(stpcpy(pathname, path), "/");
+    changes = ThumbChanges();
+    if (!Osd || changes == Seen) {
+	return;
     }
-#endif
-
-    // push on directory stack
-    if (DirStackUsed >= DirStackSize) {	// increase stack size
-	DirStackSize = DirStackUsed + 1;
-	DirStack =
-	    (typeof(DirStack)) realloc(DirStack,
-	    DirStackSize * sizeof(*DirStack));
+    Seen = changes;
+    drawn = false;
+    n = Entries();
+    for (i = First; i < n && i < First + Columns * Rows; ++i) {
+	if (Missing[i - First]) {
+	    DrawCell(i);
+	    drawn |= !Missing[i - First];
+	}
+    }
+    if (drawn) {
+	Osd->Flush();
     }
-    memmove(DirStack + 1, DirStack, DirStackUsed * sizeof(*DirStack));
-    DirStackUsed++;
-    DirStack[0] = pathname;
-
-    Filter = filter;
-
-    CreateMenu();
 }
 
 /**
-**	Menu constructor.
+**	Queue the thumbnails of the files of the page.
 **
-**	@param title	menu title
-**	@param path	directory path file name
-**	@param filter	name selection filter
+**	The old requests are cancelled, the files are queued from the
+**	cursor on.
 */
-cBrowser::cBrowser(const char *title, const char *path,
-    const NameFilter * filter)
-:cOsdMenu(title)
+void cThumbnails::Queue(void)
 {
-    dsyslog("[play]%s:\n", __FUNCTION__);
-
-    if (path) {				// clear stack, start new
-	int i;
-
-	// free the stored directory stack
-	for (i = 0; i < DirStackUsed; ++i) {
-	    free(DirStack[i]);
-	}
-	//free(DirStack);
-	//DirStack = NULL;		// reuse the old stack
-	DirStackUsed = 0;
+    char *filename;
+    int page;
+    int i;
+    int n;
 
-	NewDir(path, filter);
+    ThumbCancel();
+    if (!Listing) {
 	return;
     }
-
-    Filter = filter;
-
-    CreateMenu();
+    page = Columns * Rows;
+    n = Entries();
+    for (i = 0; i < page; ++i) {
+	int index;
+
+	index = First + (Current - First + i) % page;
+	if (index < DirCacheDirs(Listing) || index >= n) {
+	    continue;
+	}
+	filename = Path(index);
+	ThumbFile(filename);
+	free(filename);
+    }
 }
 
 /**
-**	Menu destructor.
+**	Move the cursor, a new page is drawn, when it leaves the page.
+**
+**	@param delta	entries to move, a row is #Columns
 */
-cBrowser::~cBrowser()
+void cThumbnails::Move(int delta)
 {
-    dsyslog("[play]%s:\n", __FUNCTION__);
+    int old;
+    int n;
+
+    n = Entries();
+    old = Current;
+    if (!n || Current + delta < 0) {
+	return;
+    }
+    // a row down into the partial last row: to the last entry
+    Current = Current + delta < n ? Current + delta : n - 1;
+    if (Current == old) {
+	return;
+    }
+    if (Current < First || Current >= First + Columns * Rows) {
+	Draw();
+	return;
+    }
+    DrawCell(old);
+    DrawCell(Current);
+    Osd->Flush();
 }
 
 /**
-**	Handle level up.
+**	Fill playlist with the selected file and the following files.
+**
+**	@param filename	path and name of selected file
 */
-eOSState cBrowser::LevelUp(void)
+void cThumbnails::Playlist(const char *filename)
 {
-    char *down;
-    char *name;
+    char *tmp;
+    int i;
 
-    if (DirStackUsed <= 1) {		// top level reached
-	return osEnd;
+    PlayerPlaylistClear();
+    if (!ConfigPlaylist || IsIsoImage(filename)) {
+	return;
     }
-    // go level up
-    --DirStackUsed;
-    down = DirStack[0];
-    memmove(DirStack, DirStack + 1, DirStackUsed * sizeof(*DirStack));
-
-    CreateMenu();
-
-    // select item, where we gone down
-    down[strlen(down) - 1] = '\0';	// remove trailing '/'
-    name = strrchr(down, '/');
-    if (name) {
-	cOsdItem *item;
-	const char *text;
-	int i;
-
-	for (i = 0; (item = Get(i)); ++i) {
-	    text = item->Text();
-	    if (!strcmp(text, name + 1)) {
-		SetCurrent(item);
-		// FIXME: Display already called!
-		Display();		// display build menu
-		break;
-	    }
+    PlayerPlaylistAdd(filename);
+    // directories are sorted before files
+    for (i = Current + 1; i < Entries(); ++i) {
+	tmp = Path(i);
+	if (!IsArchive(tmp) && !IsIsoImage(tmp)) {
+	    PlayerPlaylistAdd(tmp);
 	}
+	free(tmp);
     }
-
-    free(down);
-
-    return osContinue;
 }
 
 /**
-**	Handle selected item.
+**	Handle selected entry.
 */
-eOSState cBrowser::Selected(void)
+eOSState cThumbnails::Selected(void)
 {
-    int current;
-    const cOsdItem *item;
-    const char *text;
     char *filename;
-    char *tmp;
-
-    current = Current();		// get current menu item index
-    item = Get(current);
-    text = item->Text();
 
-    if (current == 0 && DirStackUsed > 1) {
-	return LevelUp();
+    if (Current >= Entries()) {		// empty directory
+	return osContinue;
     }
-    // +2: \0 + #
-    filename = (char *)malloc(strlen(DirStack[0]) + strlen(text) + 2);
-    // path is '/' terminated
-    tmp = stpcpy(stpcpy(filename, DirStack[0]), text);
-    if (!IsDirectory(filename)) {
-	if (IsArchive(filename)) {	// handle archives
-	    stpcpy(tmp, "#");
-	    NewDir(filename, Filter);
-	    free(filename);
-	    // FIXME: if dir fails use keep old!
-	    return osContinue;
-	}
-	PlayFileHandleType(filename);
+    filename = Path(Current);
+    if (Current < DirCacheDirs(Listing) || IsArchive(filename)) {
+	strcat(filename, Current < DirCacheDirs(Listing) ? "/" : "#/");
+	Enter(filename);
 	free(filename);
-	return osEnd;
+	Draw();
+	return osContinue;
     }
-    // handle DVD image
-    if (!strcmp(text, "AUDIO_TS") || !strcmp(text, "VIDEO_TS")) {
-	free(filename);
-	tmp = (char *)malloc(sizeof("dvdnav:///") + strlen(DirStack[0]));
-	strcpy(stpcpy(tmp, "dvdnav:///"), DirStack[0]);
-	PlayFile(tmp);
-	free(tmp);
-	return osEnd;
+    Leave();
+#if defined(USE_JPG) || defined(USE_PNG)
+    if (Filter == ImageFilters
+	&& NameFilterMatch(Filter, DirCacheName(Listing, Current))
+	== MEDIA_IMAGE) {
+	free(ShowDiashow);
+	ShowDiashow = filename;
+	return osPlugin;		// restart with slideshow
     }
-    stpcpy(tmp, "/");			// append '/'
-    NewDir(filename, Filter);
+#endif
+    Playlist(filename);
+    PlayFileHandleType(filename);
     free(filename);
-    // FIXME: if dir fails use keep old!
-    return osContinue;
+    return osEnd;
 }
 
 /**
-**	Handle Menu key event.
+**	Open the true color OSD and show the first page.
 **
-**	@param key	key event
+**	The cells fill the OSD width, the thumbnail box has the 4:3 aspect
+**	of the cached thumbnails.
 */
-eOSState cBrowser::ProcessKey(eKeys key)
+void cThumbnails::Show(void)
 {
-    eOSState state;
+    tArea area;
 
-    // call standard function
-    state = cOsdMenu::ProcessKey(key);
-    if (state || key != kNone) {
-	dsyslog("[play]%s: state=%d key=%d\n", __FUNCTION__, state, key);
+    Osd = cOsdProvider::NewOsd(cOsd::OsdLeft(), cOsd::OsdTop());
+    area.x1 = 0;
+    area.y1 = 0;
+    area.x2 = cOsd::OsdWidth() - 1;
+    area.y2 = cOsd::OsdHeight() - 1;
+    area.bpp = 32;
+    if (Osd->SetAreas(&area, 1) != oeOk) {
+	esyslog(tr("[play]: true color OSD not available\n"));
     }
+    Columns = THUMBS_COLUMNS;
+    CellWidth = cOsd::OsdWidth() / Columns;
+    BoxWidth = CellWidth - 2 * THUMBS_BORDER;
+    BoxHeight = BoxWidth * 3 / 4;
+    CellHeight =
+	BoxHeight + cFont::GetFont(fontSml)->Height() + 3 * THUMBS_BORDER;
+    Rows = cOsd::OsdHeight() / CellHeight;
+    if (Rows < 1) {
+	Rows = 1;
+    }
+    Missing = (char *)calloc(Columns * Rows, 1);
+    Draw();
+}
 
-    switch (state) {
-	case osUnknown:
-	    switch (key) {
-		case kOk:
-		    return Selected();
-		case kBack:
-		    return LevelUp();
-		default:
-		    break;
-	    }
+/**
+**	Handle thumbnail view key event.
+**
+**	The cursor keys move in the grid, back leaves the entered
+**	directories and returns to the browser.
+**
+**	@param key	key event
+*/
+eOSState cThumbnails::ProcessKey(eKeys key)
+{
+    switch (NORMALKEY(key)) {
+	case kNone:
+	    Update();
 	    break;
-	case osBack:
-	    state = LevelUp();
-	    if (state == osEnd) {	// top level reached
-		ShowBrowser = 0;
-		return osPlugin;
+	case kLeft:
+	    Move(-1);
+	    break;
+	case kRight:
+	    Move(1);
+	    break;
+	case kUp:
+	    Move(-Columns);
+	    break;
+	case kDown:
+	    Move(Columns);
+	    break;
+	case kOk:
+	    return Selected();
+	case kBack:
+	    if (strcmp(Directory, Start)) {
+		Up();
+		Draw();
+		break;
 	    }
+	    // fall through
+	case kBlue:
+	    Leave();
+	    // back to the browser of the directory
+	    return ShowBrowser ? osPlugin : osEnd;
 	default:
 	    break;
     }
-    return state;
+    return osContinue;
 }
 
-//////////////////////////////////////////////////////////////////////////////
-//	cOsdMenu
-//////////////////////////////////////////////////////////////////////////////
-
 /**
 **	Play plugin menu class.
 */
@@ -1096,6 +2870,9 @@ cPlayMenu::cPlayMenu(const char *title, int c0, int c1, int c2, int c3, int c4)
     Add(new cOsdItem(hk(tr("Browse audio")), osUser7));
     Add(new cOsdItem(hk(tr("Browse image")), osUser8));
     Add(new cOsdItem(hk(tr("Browse video")), osUser9));
+    if (ConfigLibraryFile) {
+	Add(new cOsdItem(hk(tr("Search library")), osUser10));
+    }
 }
 
 /**
@@ -1155,12 +2932,8 @@ eOSState cPlayMenu::ProcessKey(eKeys key)
 	    BrowserFilters = VideoFilters;
 	    return osPlugin;		// restart with OSD browser
 
-#if 0
-	case osUser9:
-	    free(ShowDiashow);
-	    ShowDiashow = strdup(VideoDirectory);
-	    return osPlugin;		// restart with OSD browser
-#endif
+	case osUser10:			// search library
+	    return AddSubMenu(new cSearchMenu);
 
 	default:
 	    break;
@@ -1440,6 +3213,7 @@ class cMyMenuSetupPage:public cMenuSetupPage
     /// @{
     int HideMainMenuEntry;
     int DisableRemote;
+    int Playlist;
 
     /// @}
     virtual void Store(void);
@@ -1470,11 +3244,14 @@ cMyMenuSetupPage::cMyMenuSetupPage(void)
 {
     HideMainMenuEntry = ConfigHideMainMenuEntry;
     DisableRemote = ConfigDisableRemote;
+    Playlist = ConfigPlaylist;
 
     Add(new cMenuEditBoolItem(tr("Hide main menu entry"), &HideMainMenuEntry,
 	    trVDR("no"), trVDR("yes")));
     Add(new cMenuEditBoolItem(tr("Disable remote"), &DisableRemote,
 	    trVDR("no"), trVDR("yes")));
+    Add(new cMenuEditBoolItem(tr("Play following files"), &Playlist,
+	    trVDR("no"), trVDR("yes")));
 }
 
 /**
@@ -1485,6 +3262,7 @@ void cMyMenuSetupPage::Store(void)
     SetupStore("HideMainMenuEntry", ConfigHideMainMenuEntry =
 	HideMainMenuEntry);
     SetupStore("DisableRemote", ConfigDisableRemote = DisableRemote);
+    SetupStore("Playlist", ConfigPlaylist = Playlist);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -1567,6 +3345,8 @@ class cMyPlugin:public cPlugin
     virtual const char *CommandLineHelp(void);
     virtual bool ProcessArgs(int, char *[]);
     virtual bool Initialize(void);
+    virtual bool Start(void);
+    virtual void Stop(void);
     virtual void MainThreadHook(void);
     virtual const char *MainMenuEntry(void);
     virtual cOsdObject *MainMenuAction(void);
@@ -1649,6 +3429,37 @@ bool cMyPlugin::Initialize(void)
     return true;
 }
 
+/**
+**	Start any background activities the plugin shall perform.
+*/
+bool cMyPlugin::Start(void)
+{
+    if (!::Start()) {
+	return false;
+    }
+    if (ConfigLibraryFile
+	&& !LibraryInit(ConfigLibraryFile, ConfigBrowserRoot, LibraryTables)) {
+	ConfigLibraryFile = NULL;
+    }
+    return true;
+}
+
+/**
+**	Shutdown plugin.  Stop any background activities the plugin is
+**	performing.
+*/
+void cMyPlugin::Stop(void)
+{
+    ::Stop();
+    LibraryExit();
+    ProbeExit();
+    ThumbExit();
+    ImageExit();
+    ArchiveExit();
+    DirCacheExit();
+    NameFilterExit();
+}
+
 /**
 **	Create main menu entry.
 */
@@ -1664,11 +3475,22 @@ cOsdObject *cMyPlugin::MainMenuAction(void)
 {
     //dsyslog("[play]%s:\n", __FUNCTION__);
 
-#if 0
     if (ShowDiashow) {
-	return new cDiashow(ShowDiashow);
+	cOsdObject *diashow;
+
+	diashow = new cDiashow(ShowDiashow);
+	free(ShowDiashow);
+	ShowDiashow = NULL;
+	return diashow;
+    }
+    if (ShowThumbnails) {
+	cOsdObject *thumbnails;
+
+	thumbnails = new cThumbnails(ShowThumbnails, BrowserFilters);
+	free(ShowThumbnails);
+	ShowThumbnails = NULL;
+	return thumbnails;
     }
-#endif
     if (ShowBrowser) {
 	const char *start;
 
@@ -1784,6 +3606,10 @@ bool cMyPlugin::SetupParse(const char *name, const char *value)
 	ConfigDisableRemote = atoi(value);
 	return true;
     }
+    if (!strcasecmp(name, "Playlist")) {
+	ConfigPlaylist = atoi(value);
+	return true;
+    }
 #if 0
     if (!strncasecmp(name, "Dia.", 4)) {
 	return DiaConfigParse(name + 4, value);
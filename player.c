@@ -22,16 +22,21 @@
 
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
 
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <errno.h>
 
 #include <poll.h>
 #include <pthread.h>
+#include <spawn.h>
 
 #include <libintl.h>
 #define _(str) gettext(str)		///< gettext shortcut
@@ -39,8 +44,16 @@
 
 #include "player.h"
 #include "video.h"
+#include "resume.h"
+#include "prefetch.h"
 #include "misc.h"
 
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 \
+    && __GLIBC_MINOR__ >= 34))
+    /// posix_spawn with closefrom file action (glibc uses clone vfork)
+#define USE_POSIX_SPAWN
+#endif
+
 //////////////////////////////////////////////////////////////////////////////
 
 const char *ConfigBrowserRoot = "/";	///< browser starting point
@@ -48,12 +61,16 @@ const char *ConfigBrowserRoot = "/";	///< browser starting point
 static char ConfigOsdOverlay;		///< show osd overlay
 static char ConfigUseSlave;		///< external player use slave mode
 static char ConfigFullscreen;		///< external player uses fullscreen
+static char ConfigWarmPlayer;		///< keep a warm idle player ready
 static char *ConfigVideoOut;		///< video out device
 static char *ConfigAudioOut;		///< audio out device
 static char *ConfigAudioMixer;		///< audio mixer device
 static char *ConfigMixerChannel;	///< audio mixer channel
-static const char *ConfigMplayer = "/usr/bin/mplayer";	///< mplayer executable
+static const char *ConfigMplayer;	///< mplayer executable
 static const char *ConfigMplayerArguments;	///< extra mplayer arguments
+static const char *ConfigResumeFile;	///< resume database file name
+const char *ConfigLibraryFile;		///< media library index file name
+const char *ConfigThumbDirectory;	///< thumbnail cache directory
 static const char *ConfigX11Display = ":0.0";	///< x11 display
 
     /// DVD-Drive for mplayer
@@ -124,12 +141,26 @@ void OsdDrawARGB(int x, int y, int w, int h, const uint8_t * argb)
 
 static pid_t PlayerPid;			///< player pid
 static pthread_t PlayerThread;		///< player decode thread
+    /// protects player process state against the player thread
+static pthread_mutex_t PlayerMutex = PTHREAD_MUTEX_INITIALIZER;
 
-static char PlayerPipeBuf[4096];	///< pipe buffer
+    /// size of pipe buffer, mpv track-list events can be long
+#define PLAYER_PIPE_SIZE (64 * 1024)
+
+static char PlayerPipeBuf[PLAYER_PIPE_SIZE];	///< pipe buffer
 static int PlayerPipeCnt;		///< pipe buffer count
 static int PlayerPipeIdx;		///< pipe buffer index
-static int PlayerPipeOut[2];		///< player write pipe
-static int PlayerPipeIn[2];		///< player read pipe
+static char PlayerPipeSkip;		///< drop input up to next '\n'
+static int PlayerPipeOut[2] = { -1, -1 };	///< player write pipe
+static int PlayerPipeIn[2] = { -1, -1 };	///< player read pipe
+
+static char PlayerWarm;			///< player is the warm idle instance
+static volatile char PlayerIdle;	///< warm player has no file loaded
+static volatile char PlayerLoaded;	///< warm player opened the file
+static char PlayerIdleProbe;		///< idle probe sent, answer pending
+static char PlayerLoadName[4096];	///< file of the current load
+static uint32_t PlayerWarmTick;		///< time of last warm player spawn
+static uint32_t PlayerProbeTick;	///< time of last idle probe
 
 static int PlayerVolume = -1;		///< volume 0 - 100
 
@@ -141,17 +172,88 @@ int PlayerTotal;			///< total length in seconds
 char PlayerTitle[256];			///< title from meta data
 char PlayerFilename[256];		///< filename
 
+static char **PlayerPlaylist;		///< files queued in the player
+static int PlayerPlaylistCount;		///< number of files in playlist
+int PlayerPlaylistCurrent;		///< playlist index of current file
+static char PlayerPlaylistPending;	///< queue playlist, when connected
+
+static char *PlayerResumeFile;		///< file whose position is saved
+static int PlayerResume;		///< start position of file
+static int PlayerResumePending;		///< seek to position after load
+static uint32_t PlayerPositionTick;	///< time of last position probe
+
+    /// no resume position for the first and last seconds
+#define PLAYER_RESUME_MARGIN 30
+
+#define MPLAYER_MAX_ARGS 64		///< number of arguments supported
+
+    /// width of grabbed frames, the thumbnails are scaled down from it
+#define PLAYER_FRAME_WIDTH "320"
+
+///
+///	Player backend slave commands.
+///
+///	printf format strings of the commands send to the player.  NULL, if
+///	the backend doesn't support the command or doesn't need it.
+///
+typedef struct _player_commands_
+{
+    const char *Quit;			///< quit player
+    const char *Pause;			///< toggle pause
+    const char *SetSpeed;		///< set speed (int)
+    const char *Seek;			///< relative seek seconds (int)
+    const char *SeekTo;			///< absolute seek seconds (int)
+    const char *Volume;			///< set volume 0-100 (double)
+    const char *SwitchAudio;		///< switch audio track
+    const char *SubSelect;		///< select next subtitle
+    const char *DvdNav;			///< dvdnav command (string)
+    const char *GetLength;		///< request length
+    const char *GetPosition;		///< request current position
+    const char *GetMetaTitle;		///< request title from meta data
+    const char *GetFilename;		///< request filename
+    const char *LoadFile;		///< load file into idle player (string)
+    const char *Stop;			///< stop playing, keep player idle
+    const char *GetIdle;		///< probe if player is idle
+    const char *AppendFile;		///< append file to playlist (string)
+    const char *PlaylistStep;		///< step in playlist (int)
+} PlayerCommands;
+
+///
+///	Player backend.
+///
+///	An external player and how to talk to it in slave mode.
+///
+typedef struct _player_backend_
+{
+    const char *Name;			///< backend name
+    const char *Executable;		///< default executable
+    char UsePipes;			///< slave mode through stdin/stdout
+    /// build player arguments vector
+    int (*Arguments) (const char *, const char **);
+    /// build frame grab arguments vector
+    int (*FrameArguments) (const char *, const char *, const char **);
+    /// connect slave channel, if not done through pipes
+    int (*Connect) (void);
+    /// parse a line of player output
+    void (*ParseLine) (const char *, int);
+    PlayerCommands Commands;		///< slave commands
+} PlayerBackend;
+
+static void PlayerPlaylistIndex(int);
+static int PlayerPlaylistFile(const char *);
+static void PlayerResumeSeek(void);
+
 //////////////////////////////////////////////////////////////////////////////
-//	Slave
+//	Slave mplayer
 //////////////////////////////////////////////////////////////////////////////
 
 /**
-**	Parse player output.
+**	Parse mplayer output.
 **
 **	@param data	line pointer (\0 terminated)
 **	@param size	line length
 */
-static void PlayerParseLine(const char *data, int size)
+static void MplayerParseLine(const char *data, int size)
 {
     Debug(4, "play/parse: |%.*s|\n", size, data);
     (void)size;
@@ -161,6 +263,22 @@ static void PlayerParseLine(const char *data, int size)
 	PlayerDvdNav = 1;
     } else if (!strncasecmp(data, "DVDNAV_TITLE_IS_MOVIE", 21)) {
 	PlayerDvdNav = 2;
+    } else if (!strncasecmp(data, "ID_FILENAME=", 12)) {
+	// output of an older load must not enable the idle probe
+	if (PlayerPlaylistFile(data + 12)
+	    || !strcmp(data + 12, PlayerLoadName)) {
+	    PlayerLoaded = 1;
+	}
+    } else if (!strncasecmp(data, "ANS_path=", 9)) {
+	PlayerIdleProbe = 0;		// file is still playing
+    } else if (!strncasecmp(data, "ANS_ERROR=PROPERTY_UNAVAILABLE", 30)) {
+	// only the answer to our idle probe tells the player is idle
+	if (PlayerWarm && PlayerLoaded && PlayerIdleProbe) {
+	    Debug(3, "play: warm player idle\n");
+	    PlayerIdle = 1;
+	    PlayerLoaded = 0;
+	}
+	PlayerIdleProbe = 0;
     } else if (!strncasecmp(data, "ID_DVD_VOLUME_ID=", 17)) {
 	Debug(3, "DVD_VOLUME = %s\n", data + 17);
     } else if (!strncasecmp(data, "ID_AID_", 7)) {
@@ -191,6 +309,11 @@ static void PlayerParseLine(const char *data, int size)
 	if (sscanf(data, "ANS_LENGTH=%d", &PlayerTotal) == 1) {
 	    Debug(3, "PlayerTotal=%d\n", PlayerTotal);
 	}
+    } else if (!strncasecmp(data, "ID_LENGTH=", 10)) {
+	if (sscanf(data, "ID_LENGTH=%d", &PlayerTotal) == 1) {
+	    Debug(3, "PlayerTotal=%d\n", PlayerTotal);
+	}
+	PlayerResumeSeek();		// file is opened
     } else if (!strncasecmp(data, "ANS_TIME_POSITION=", 17)) {
 	if (sscanf(data, "ANS_TIME_POSITION=%d", &PlayerCurrent) == 1) {
 	    Debug(3, "PlayerCurrent=%d\n", PlayerCurrent);
@@ -198,95 +321,53 @@ static void PlayerParseLine(const char *data, int size)
     }
 }
 
+
 /**
-**	Poll input pipe.
+**	Split extra player arguments string into words.
+**
+**	@param args	arguments vector
+**	@param argn	number of arguments already in vector
+**
+**	@returns new number of arguments in vector.
 */
-static void PlayerPollPipe(void)
+static int PlayerSplitArguments(const char **args, int argn)
 {
-    struct pollfd poll_fds[1];
-    int n;
-    int i;
-    int l;
-
-    // check if something to read
-    poll_fds[0].fd = PlayerPipeOut[0];
-    poll_fds[0].events = POLLIN;
-
-    switch (poll(poll_fds, 1, 0)) {
-	case 0:			// timeout
-	    return;
-	case -1:			// error
-	    Error(_("play/player: poll failed: %s\n"), strerror(errno));
-	    return;
-	default:			// ready
-	    break;
-    }
-
-    // fill buffer
-    if ((n = read(PlayerPipeOut[0], PlayerPipeBuf + PlayerPipeCnt,
-		sizeof(PlayerPipeBuf) - PlayerPipeCnt)) < 0) {
-	Error(_("play/player: read failed: %s\n"), strerror(errno));
-	return;
-    }
+    static char *buf;			// words point into this buffer
+    const char *sval;
+    char *s;
 
-    PlayerPipeCnt += n;
-    l = 0;
-    for (i = PlayerPipeIdx; i < PlayerPipeCnt; ++i) {
-	if (PlayerPipeBuf[i] == '\n') {
-	    PlayerPipeBuf[i] = '\0';
-	    PlayerParseLine(PlayerPipeBuf + PlayerPipeIdx, i - PlayerPipeIdx);
-	    PlayerPipeIdx = i + 1;
-	    l = PlayerPipeIdx;
-	}
+    if (!ConfigMplayerArguments) {
+	return argn;
     }
+    free(buf);
+    s = buf = strdup(ConfigMplayerArguments);
+    while ((sval = strsep(&s, " \t"))) {
+	args[argn++] = sval;
 
-    if (l) {				// remove consumed bytes
-	if (PlayerPipeCnt - l) {
-	    memmove(PlayerPipeBuf, PlayerPipeBuf + l, PlayerPipeCnt - l);
+	if (argn == MPLAYER_MAX_ARGS - 3) {	// argument overflow
+	    Error(_("play: too many arguments for player\n"));
+	    // argn = 1;
+	    break;
 	}
-	PlayerPipeCnt -= l;
-	PlayerPipeIdx -= l;
-    } else if (PlayerPipeCnt == sizeof(PlayerPipeBuf)) {
-	// no '\n' in buffer use it as single line
-	PlayerPipeBuf[sizeof(PlayerPipeBuf) - 1] = '\0';
-	PlayerParseLine(PlayerPipeBuf + PlayerPipeIdx, PlayerPipeCnt);
-	PlayerPipeIdx = 0;
-	PlayerPipeCnt = 0;
     }
+    return argn;
 }
 
-#define MPLAYER_MAX_ARGS 64		///< number of arguments supported
-
 /**
-**	Execute external player.
+**	Build mplayer arguments.
 **
-**	@param filename	path and name of file to play
+**	@param filename	path and name of file to play, NULL for idle player
+**	@param args	arguments vector, filled from index 1 and NULL terminated
+**
+**	@returns number of arguments.
 */
-static void PlayerExec(const char *filename)
+static int MplayerArguments(const char *filename, const char **args)
 {
-    const char *args[MPLAYER_MAX_ARGS];
+    static char wid_buf[32];
+    static char volume_buf[32];
+    static char resume_buf[32];
     int argn;
-    char wid_buf[32];
-    char volume_buf[32];
-    int i;
-
-    if (ConfigUseSlave) {		// connect pipe to stdin/stdout
-	dup2(PlayerPipeIn[0], STDIN_FILENO);
-	close(PlayerPipeIn[0]);
-	close(PlayerPipeIn[1]);
-	close(PlayerPipeOut[0]);
-	dup2(PlayerPipeOut[1], STDOUT_FILENO);
-	dup2(PlayerPipeOut[1], STDERR_FILENO);
-	close(PlayerPipeOut[1]);
-    }
-    // close all file handles
-    for (i = getdtablesize() - 1; i > STDERR_FILENO; i--) {
-	close(i);
-    }
-
-    // export DISPLAY=
 
-    args[0] = ConfigMplayer;
     args[1] = "-quiet";
     args[2] = "-msglevel";
     // FIXME: play with the options
@@ -311,19 +392,22 @@ static void PlayerExec(const char *filename)
     args[9] = "-nomouseinput";
     args[10] = "-nograbpointer";
     args[11] = "-noconsolecontrols";
-    args[12] = "-fixed-vo";
+    // idle player without our window must close its window after play
+    args[12] = ConfigWarmPlayer
+	&& !VideoGetPlayWindow()? "-nofixed-vo" : "-fixed-vo";
     args[13] = "-sid";			// subtitle selection
     args[14] = "0";
     args[15] = "-slang";
     args[16] = "de,en";			// FIXME: use VDR config
     args[17] = "-alang";
     args[18] = "de,en";			// FIXME: use VDR config
-    argn = 19;
+    args[19] = "-gapless-audio";	// keep audio out open for playlists
+    argn = 20;
     if (ConfigMplayerDevice) {		// dvd-device
 	args[argn++] = "-dvd-device";
 	args[argn++] = ConfigMplayerDevice;
     }
-    if (!strncasecmp(filename, "cdda://", 7)) {
+    if (filename && !strncasecmp(filename, "cdda://", 7)) {
 	args[argn++] = "-cache";	// cdrom needs cache
 	args[argn++] = "1000";
     } else {
@@ -331,7 +415,9 @@ static void PlayerExec(const char *filename)
     }
     if (ConfigUseSlave) {
 	args[argn++] = "-slave";
-	//args[argn++] = "-idle";
+	if (!filename) {		// warm player waits for loadfile
+	    args[argn++] = "-idle";
+	}
     }
     if (ConfigOsdOverlay) {		// no mplayer osd with overlay
 	args[argn++] = "-osdlevel";
@@ -385,48 +471,1125 @@ static void PlayerExec(const char *filename)
 	args[argn++] = "-volume";
 	args[argn++] = volume_buf;
     }
-    //	split X server arguments string into words
-    if (ConfigMplayerArguments) {
-	const char *sval;
-	char *buf;
-	char *s;
+    if (filename && PlayerResume) {
+	snprintf(resume_buf, sizeof(resume_buf), "%d", PlayerResume);
+	args[argn++] = "-ss";
+	args[argn++] = resume_buf;
+    }
+    argn = PlayerSplitArguments(args, argn);
+    if (filename) {
+	args[argn++] = "--";
+	args[argn++] = filename;
+    }
+    args[argn] = NULL;
 
-	sval = ConfigMplayerArguments;
-#ifndef __FreeBSD__
-	s = buf = strdupa(sval);
-#else
-	s = buf = alloca(strlen(sval) + 1);
-	strcpy(buf, sval);
-#endif
-	while ((sval = strsep(&s, " \t"))) {
-	    args[argn++] = sval;
+    return argn;
+}
 
-	    if (argn == MPLAYER_MAX_ARGS - 3) {	// argument overflow
-		Error(_("play: too many arguments for mplayer\n"));
-		// argn = 1;
-		break;
+/**
+**	Build mplayer frame grab arguments.
+**
+**	The frame is written as 00000001.ppm into the working directory.
+**	Thread-safe, the user configuration isn't used.
+**
+**	@param filename	path and name of video file
+**	@param position	position of the frame in seconds
+**	@param args	arguments vector, filled from index 1 and NULL terminated
+**
+**	@returns number of arguments.
+*/
+static int MplayerFrameArguments(const char *filename, const char *position,
+    const char **args)
+{
+    args[1] = "-noconfig";
+    args[2] = "all";
+    args[3] = "-really-quiet";
+    args[4] = "-nolirc";
+    args[5] = "-noconsolecontrols";
+    args[6] = "-nosound";
+    args[7] = "-noautosub";
+    args[8] = "-ss";
+    args[9] = position;
+    args[10] = "-frames";
+    args[11] = "1";
+    args[12] = "-vo";
+    args[13] = "pnm";
+    args[14] = "-vf";
+    args[15] = "scale=" PLAYER_FRAME_WIDTH ":-2";
+    args[16] = "--";
+    args[17] = filename;
+    args[18] = NULL;
+
+    return 18;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Slave mpv
+//////////////////////////////////////////////////////////////////////////////
+
+#define MPV_IPC_SOCKET	"/mpv.sock"	///< socket name in ipc directory
+
+static char MpvIpcPath[108];		///< mpv json ipc unix socket path
+    /// private directory of the ipc socket
+static char MpvIpcDirectory[sizeof(MpvIpcPath) - sizeof(MPV_IPC_SOCKET) +
+    1];
+
+///
+///	mpv properties observed through json ipc.
+///
+///	Index + 1 is used as observe id.
+///
+static const char *const MpvObserved[] = {
+    "time-pos", "duration", "pause", "track-list", "media-title", "filename",
+    "idle-active", "playlist-pos", NULL
+};
+
+/**
+**	Find value of a key in a json object.
+**
+**	Only flat searching, good enough for the mpv event lines.
+**
+**	@param data	json text
+**	@param key	key name
+**
+**	@returns pointer to the value, NULL if key isn't found.
+*/
+static const char *MpvJsonValue(const char *data, const char *key)
+{
+    const char *s;
+    int len;
+
+    len = strlen(key);
+    for (s = data; (s = strchr(s, '"')); ++s) {
+	if (!strncmp(s + 1, key, len) && s[len + 1] == '"') {
+	    s += len + 2;
+	    while (*s == ' ' || *s == ':') {
+		++s;
+	    }
+	    return s;
+	}
+    }
+    return NULL;
+}
+
+/**
+**	Parse the four hex digits of a json \\u escape.
+**
+**	@param s	the digits after "\\u"
+**
+**	@returns utf-16 code unit, -1 if not four hex digits.
+*/
+static int MpvJsonHex(const char *s)
+{
+    int code;
+    int i;
+
+    code = 0;
+    for (i = 0; i < 4; ++i) {
+	code <<= 4;
+	if (s[i] >= '0' && s[i] <= '9') {
+	    code |= s[i] - '0';
+	} else if ((s[i] | 0x20) >= 'a' && (s[i] | 0x20) <= 'f') {
+	    code |= (s[i] | 0x20) - 'a' + 10;
+	} else {
+	    return -1;
+	}
+    }
+    return code;
+}
+
+/**
+**	Copy a json string value.
+**
+**	Escaped control characters become spaces, \\uXXXX escapes are
+**	converted to utf-8.
+**
+**	@param value	json value, pointing to the opening quote
+**	@param buf	output buffer
+**	@param size	size of output buffer
+**
+**	@returns true if value is a string.
+*/
+static int MpvJsonString(const char *value, char *buf, int size)
+{
+    int n;
+
+    if (!value || *value != '"') {
+	return 0;
+    }
+    n = 0;
+    for (++value; *value && *value != '"' && n < size - 1; ++value) {
+	if (*value == '\\' && value[1]) {
+	    char utf8[4];
+	    int code;
+	    int low;
+	    int len;
+	    int i;
+
+	    ++value;
+	    switch (*value) {
+		case 'n':
+		case 't':
+		case 'r':
+		case 'b':
+		case 'f':
+		    buf[n++] = ' ';
+		    continue;
+		case 'u':
+		    if ((code = MpvJsonHex(value + 1)) < 0) {
+			break;		// broken escape: copy the 'u'
+		    }
+		    value += 4;
+		    // utf-16 surrogate pair
+		    if (code >= 0xD800 && code < 0xDC00 && value[1] == '\\'
+			&& value[2] == 'u'
+			&& (low = MpvJsonHex(value + 3)) >= 0xDC00
+			&& low < 0xE000) {
+			code =
+			    0x10000 + ((code - 0xD800) << 10) + low - 0xDC00;
+			value += 6;
+		    } else if (code >= 0xD800 && code < 0xE000) {
+			code = 0xFFFD;	// lone surrogate
+		    }
+		    if (code < 0x20) {
+			code = ' ';
+		    }
+		    if (code < 0x80) {
+			len = 1;
+			utf8[0] = code;
+		    } else if (code < 0x800) {
+			len = 2;
+			utf8[0] = 0xC0 | (code >> 6);
+		    } else if (code < 0x10000) {
+			len = 3;
+			utf8[0] = 0xE0 | (code >> 12);
+		    } else {
+			len = 4;
+			utf8[0] = 0xF0 | (code >> 18);
+		    }
+		    for (i = 1; i < len; ++i) {
+			utf8[i] = 0x80 | ((code >> (6 * (len - 1 - i))) & 0x3F);
+		    }
+		    if (n + len > size - 1) {	// no partial sequence
+			buf[n] = '\0';
+			return 1;
+		    }
+		    memcpy(buf + n, utf8, len);
+		    n += len;
+		    continue;
+		default:
+		    break;
 	    }
 	}
+	buf[n++] = *value;
+    }
+    buf[n] = '\0';
+    return 1;
+}
+
+/**
+**	Parse mpv track list.
+**
+**	@param data	json array of track objects
+*/
+static void MpvParseTrackList(const char *data)
+{
+    const char *s;
+
+    // each track object starts with its id
+    for (s = data; (s = MpvJsonValue(s, "id")); ) {
+	char type[16];
+	char lang[64];
+	const char *e;
+	int id;
+
+	id = atoi(s);
+	if (!(e = strchr(s, '}'))) {
+	    break;
+	}
+	if (!MpvJsonString(MpvJsonValue(s, "type"), type, sizeof(type))
+	    || MpvJsonValue(s, "type") > e) {
+	    type[0] = '\0';
+	}
+	if (!MpvJsonString(MpvJsonValue(s, "lang"), lang, sizeof(lang))
+	    || MpvJsonValue(s, "lang") > e) {
+	    strcpy(lang, "und");
+	}
+	if (!strcmp(type, "audio")) {
+	    Debug(3, "AID(%d) = %s\n", id, lang);
+	} else if (!strcmp(type, "sub")) {
+	    Debug(3, "SID(%d) = %s\n", id, lang);
+	}
+	(void)id;
+	s = e;
+    }
+}
+
+/**
+**	Parse mpv json ipc output.
+**
+**	Observed properties are pushed by mpv as property-change events.
+**
+**	@param data	line pointer (\0 terminated)
+**	@param size	line length
+*/
+static void MpvParseLine(const char *data, int size)
+{
+    const char *name;
+    const char *value;
+
+    Debug(4, "play/parse: |%.*s|\n", size, data);
+    (void)size;
+
+    if (!(value = MpvJsonValue(data, "event"))
+	|| strncmp(value, "\"property-change\"", 17)) {
+	// replies, other events
+	return;
+    }
+    if (!(name = MpvJsonValue(data, "name"))
+	|| !(value = MpvJsonValue(data, "data"))) {
+	return;
+    }
+    if (!strncmp(value, "null", 4)) {	// property unavailable
+	return;
+    }
+
+    if (!strncmp(name, "\"time-pos\"", 10)) {
+	PlayerCurrent = atoi(value);
+	Debug(4, "PlayerCurrent=%d\n", PlayerCurrent);
+    } else if (!strncmp(name, "\"duration\"", 10)) {
+	PlayerTotal = atoi(value);
+	Debug(3, "PlayerTotal=%d\n", PlayerTotal);
+	PlayerResumeSeek();		// file is opened
+    } else if (!strncmp(name, "\"pause\"", 7)) {
+	PlayerPaused = !strncmp(value, "true", 4);
+	Debug(3, "PlayerPaused=%d\n", PlayerPaused);
+    } else if (!strncmp(name, "\"track-list\"", 12)) {
+	MpvParseTrackList(value);
+    } else if (!strncmp(name, "\"media-title\"", 13)) {
+	MpvJsonString(value, PlayerTitle, sizeof(PlayerTitle));
+	Debug(3, "PlayerTitle= %s\n", PlayerTitle);
+    } else if (!strncmp(name, "\"filename\"", 10)) {
+	MpvJsonString(value, PlayerFilename, sizeof(PlayerFilename));
+	Debug(3, "PlayerFilename= %s\n", PlayerFilename);
+    } else if (!strncmp(name, "\"playlist-pos\"", 14)) {
+	if (atoi(value) >= 0) {
+	    PlayerPlaylistIndex(atoi(value));
+	}
+    } else if (!strncmp(name, "\"idle-active\"", 13)) {
+	if (PlayerWarm) {
+	    PlayerIdle = !strncmp(value, "true", 4);
+	    Debug(3, "PlayerIdle=%d\n", PlayerIdle);
+	}
+    }
+}
+
+/**
+**	Create the private directory of the mpv json ipc socket.
+**
+**	The directory is created mode 0700 under $XDG_RUNTIME_DIR or /tmp,
+**	other local users can't create, replace or connect to the socket.
+**
+**	@returns true if the socket path is set.
+*/
+static int MpvIpcCreate(void)
+{
+    const char *tmp;
+
+    tmp = getenv("XDG_RUNTIME_DIR");
+    if (!tmp || tmp[0] != '/'
+	|| strlen(tmp) + sizeof("/vdr-play-XXXXXX") >
+	sizeof(MpvIpcDirectory)) {
+	tmp = "/tmp";
+    }
+    snprintf(MpvIpcDirectory, sizeof(MpvIpcDirectory), "%s/vdr-play-XXXXXX",
+	tmp);
+    if (!mkdtemp(MpvIpcDirectory)) {
+	Error(_("play/mpv: can't create '%s': %s\n"), MpvIpcDirectory,
+	    strerror(errno));
+	MpvIpcDirectory[0] = '\0';
+	return 0;
+    }
+    snprintf(MpvIpcPath, sizeof(MpvIpcPath), "%s" MPV_IPC_SOCKET,
+	MpvIpcDirectory);
+    return 1;
+}
+
+/**
+**	Remove the mpv json ipc socket and its directory.
+*/
+static void MpvIpcRemove(void)
+{
+    if (MpvIpcPath[0]) {
+	unlink(MpvIpcPath);
+	MpvIpcPath[0] = '\0';
+    }
+    if (MpvIpcDirectory[0]) {
+	rmdir(MpvIpcDirectory);
+	MpvIpcDirectory[0] = '\0';
+    }
+}
+
+/**
+**	Build mpv arguments.
+**
+**	@param filename	path and name of file to play, NULL for idle player
+**	@param args	arguments vector, filled from index 1 and NULL terminated
+**
+**	@returns number of arguments.
+*/
+static int MpvArguments(const char *filename, const char **args)
+{
+    static char ipc_buf[sizeof(MpvIpcPath) + 32];
+    static char wid_buf[32];
+    static char volume_buf[32];
+    static char device_buf[256];
+    static char resume_buf[32];
+    int argn;
+
+    args[1] = "--no-terminal";
+    args[2] = "--no-input-default-bindings";	// disable all unwanted inputs
+    args[3] = "--input-vo-keyboard=no";
+    args[4] = "--input-cursor=no";
+    args[5] = ConfigOsdOverlay ? "--no-ontop" : "--ontop";
+    args[6] = "--no-border";
+    args[7] = "--keepaspect-window=no";
+    args[8] = "--sid=auto";
+    args[9] = "--slang=de,en";		// FIXME: use VDR config
+    args[10] = "--alang=de,en";		// FIXME: use VDR config
+    args[11] = "--prefetch-playlist=yes";	// open next file early
+    argn = 12;
+    if (ConfigMplayerDevice) {		// dvd-device
+	snprintf(device_buf, sizeof(device_buf), "--dvd-device=%s",
+	    ConfigMplayerDevice);
+	args[argn++] = device_buf;
+    }
+    if (filename && !strncasecmp(filename, "cdda://", 7)) {
+	args[argn++] = "--cache=yes";	// cdrom needs cache
+    } else {
+	args[argn++] = "--cache=no";
+    }
+    if (ConfigUseSlave) {
+	// new private socket directory for each player
+	MpvIpcRemove();
+	if (MpvIpcCreate()) {
+	    snprintf(ipc_buf, sizeof(ipc_buf), "--input-ipc-server=%s",
+		MpvIpcPath);
+	    args[argn++] = ipc_buf;
+	}
+	if (!filename) {		// warm player waits for loadfile
+	    args[argn++] = "--idle=yes";
+	}
+    }
+    if (ConfigOsdOverlay) {		// no mpv osd with overlay
+	args[argn++] = "--osd-level=0";
+    }
+    args[argn++] = ConfigFullscreen ? "--fs" : "--no-fs";
+    if (VideoGetPlayWindow()) {
+	snprintf(wid_buf, sizeof(wid_buf), "--wid=%d", VideoGetPlayWindow());
+	args[argn++] = wid_buf;
+	args[argn++] = "--force-window=immediate";
+    }
+    if (ConfigVideoOut) {
+	args[argn++] = "--vo";
+	args[argn++] = ConfigVideoOut;
+	// add options based on selected video out
+	if (!strncmp(ConfigVideoOut, "vdpau", 5)) {
+	    args[argn++] = "--hwdec=vdpau";
+	} else if (!strncmp(ConfigVideoOut, "vaapi", 5)) {
+	    args[argn++] = "--hwdec=vaapi";
+	}
+    }
+    if (ConfigAudioOut) {
+	args[argn++] = "--ao";
+	args[argn++] = ConfigAudioOut;
+    }
+    if (PlayerVolume != -1) {
+	// FIXME: here could be a problem with LANG
+	snprintf(volume_buf, sizeof(volume_buf), "--volume=%.2f",
+	    (PlayerVolume * 100.0) / 255);
+	args[argn++] = volume_buf;
+    }
+    if (filename && PlayerResume) {
+	snprintf(resume_buf, sizeof(resume_buf), "--start=%d", PlayerResume);
+	args[argn++] = resume_buf;
+    }
+    argn = PlayerSplitArguments(args, argn);
+    if (filename) {
+	args[argn++] = "--";
+	args[argn++] = filename;
     }
-    args[argn++] = "--";
-    args[argn++] = filename;
     args[argn] = NULL;
-#ifdef DEBUG
-    if (argn + 1 >= (int)(sizeof(args) / sizeof(*args))) {
-	Debug(3, "play: too many arguments %d\n", argn);
+
+    return argn;
+}
+
+/**
+**	Build mpv frame grab arguments.
+**
+**	The frame is written as 00000001.jpg (or .png without jpeg
+**	support) into the working directory.  Thread-safe, the user
+**	configuration isn't used.
+**
+**	@param filename	path and name of video file
+**	@param position	position of the frame in seconds
+**	@param args	arguments vector, filled from index 1 and NULL terminated
+**
+**	@returns number of arguments.
+*/
+static int MpvFrameArguments(const char *filename, const char *position,
+    const char **args)
+{
+    args[1] = "--no-config";
+    args[2] = "--no-terminal";
+    args[3] = "--no-audio";
+    args[4] = "--sid=no";
+    args[5] = "--start";
+    args[6] = position;
+    args[7] = "--frames=1";
+    args[8] = "--vo=image";
+#if defined(USE_PNG) && !defined(USE_JPG)
+    args[9] = "--vo-image-format=png";
+#else
+    args[9] = "--vo-image-format=jpg";
+#endif
+    args[10] = "--vf=scale=" PLAYER_FRAME_WIDTH ":-2";
+    args[11] = "--";
+    args[12] = filename;
+    args[13] = NULL;
+
+    return 13;
+}
+
+/**
+**	Connect to mpv json ipc server.
+**
+**	mpv creates the socket after startup, called until connected.
+**
+**	@retval <0	not (yet) connected
+**	@retval 0	connected, properties observed
+*/
+static int MpvConnect(void)
+{
+    struct sockaddr_un addr;
+    char buf[128];
+    int fd;
+    int i;
+    int n;
+
+    if (!MpvIpcPath[0]) {
+	return -1;
+    }
+    if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+	Error(_("play/mpv: socket failed: %s\n"), strerror(errno));
+	return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", MpvIpcPath);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+	// ENOENT, ECONNREFUSED: server not yet listening
+	close(fd);
+	return -1;
+    }
+    Debug(3, "play/mpv: connected to '%s'\n", MpvIpcPath);
+
+    // push property changes, instead of polling them
+    for (i = 0; MpvObserved[i]; ++i) {
+	n = snprintf(buf, sizeof(buf),
+	    "{\"command\":[\"observe_property\",%d,\"%s\"]}\n", i + 1,
+	    MpvObserved[i]);
+	if (write(fd, buf, n) != n) {
+	    Error(_("play/mpv: write failed: %s\n"), strerror(errno));
+	}
+    }
+    // socket is used for both directions
+    PlayerPipeIn[1] = fd;
+    PlayerPipeOut[0] = fd;
+
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Slave
+//////////////////////////////////////////////////////////////////////////////
+
+static void SendCommand(const char *, ...);
+
+///
+///	mplayer slave mode backend.
+///
+static const PlayerBackend MplayerBackend = {
+    .Name = "mplayer",
+    .Executable = "/usr/bin/mplayer",
+    .UsePipes = 1,
+    .Arguments = MplayerArguments,
+    .FrameArguments = MplayerFrameArguments,
+    .Connect = NULL,
+    .ParseLine = MplayerParseLine,
+    .Commands = {
+	.Quit = "quit\n",
+	.Pause = "pause\n",
+	.SetSpeed = "pausing_keep speed_set %d\n",
+	.Seek = "pausing_keep seek %+d 0\n",
+	.SeekTo = "pausing_keep seek %d 2\n",
+	.Volume = "pausing_keep volume %.2f 1\n",
+	.SwitchAudio = "pausing_keep switch_audio\n",
+	.SubSelect = "pausing_keep sub_select\n",
+	.DvdNav = "pausing_keep dvdnav %s\n",
+	.GetLength = "get_time_length\n",
+	.GetPosition = "get_time_pos\n",
+	.GetMetaTitle = "get_meta_title\n",
+	.GetFilename = "get_file_name\n",
+	.LoadFile = "loadfile \"%s\" 0\n",
+	.Stop = "stop\n",
+	.GetIdle = "pausing_keep_force get_property path\n",
+	.AppendFile = "loadfile \"%s\" 1\n",
+	.PlaylistStep = "pt_step %d\n",
+	},
+};
+
+///
+///	mpv json ipc backend.
+///
+///	Position, length, pause and titles are observed properties, the
+///	get commands aren't needed.
+///
+static const PlayerBackend MpvBackend = {
+    .Name = "mpv",
+    .Executable = "/usr/bin/mpv",
+    .UsePipes = 0,
+    .Arguments = MpvArguments,
+    .FrameArguments = MpvFrameArguments,
+    .Connect = MpvConnect,
+    .ParseLine = MpvParseLine,
+    .Commands = {
+	.Quit = "{\"command\":[\"quit\"]}\n",
+	.Pause = "{\"command\":[\"cycle\",\"pause\"]}\n",
+	.SetSpeed = "{\"command\":[\"set_property\",\"speed\",%d]}\n",
+	.Seek = "{\"command\":[\"seek\",%d,\"relative\"]}\n",
+	.SeekTo = "{\"command\":[\"seek\",%d,\"absolute\"]}\n",
+	.Volume = "{\"command\":[\"set_property\",\"volume\",%.2f]}\n",
+	.SwitchAudio = "{\"command\":[\"cycle\",\"audio\"]}\n",
+	.SubSelect = "{\"command\":[\"cycle\",\"sub\"]}\n",
+	.DvdNav = NULL,			// mpv has no dvd menus
+	.LoadFile = "{\"command\":[\"loadfile\",\"%s\",\"replace\"]}\n",
+	.Stop = "{\"command\":[\"stop\"]}\n",
+	.AppendFile = "{\"command\":[\"loadfile\",\"%s\",\"append\"]}\n",
+	.PlaylistStep = "{\"command\":[\"add\",\"playlist-pos\",%d]}\n",
+	},
+};
+
+    /// table of all player backends
+static const PlayerBackend *const PlayerBackends[] = {
+    &MplayerBackend, &MpvBackend, NULL
+};
+
+static const PlayerBackend *Backend = &MplayerBackend;	///< current backend
+
+//////////////////////////////////////////////////////////////////////////////
+//	Resume
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Save resume position of the current file.
+**
+**	Positions near the start or the end of the file clear it.
+**
+**	@param filename	path and name of the next current file, NULL none
+**
+**	@note must be called with #PlayerMutex locked
+*/
+static void PlayerResumeSave(const char *filename)
+{
+    int position;
+
+    if (PlayerResumeFile) {
+	position = PlayerCurrent;
+	if (position < PLAYER_RESUME_MARGIN || (PlayerTotal
+		&& position > PlayerTotal - PLAYER_RESUME_MARGIN)) {
+	    position = 0;
+	}
+	ResumeStore(PlayerResumeFile, position);
+	free(PlayerResumeFile);
+	PlayerResumeFile = NULL;
+    }
+    // urls (cdda, dvdnav) have no file identity, position needs slave
+    if (ConfigResumeFile && ConfigUseSlave && filename
+	&& !strstr(filename, "://")) {
+	PlayerResumeFile = strdup(filename);
+    }
+}
+
+/**
+**	Seek to the resume position, after the warm player opened the file.
+**
+**	@note must be called with #PlayerMutex locked
+*/
+static void PlayerResumeSeek(void)
+{
+    if (PlayerResumePending) {
+	Debug(3, "play: resume at %d\n", PlayerResumePending);
+	SendCommand(Backend->Commands.SeekTo, PlayerResumePending);
+	PlayerResumePending = 0;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Playlist
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Prefetch head and index of a playlist file.
+**
+**	@param index	playlist index of file
+*/
+static void PlayerPrefetch(int index)
+{
+    if (index < 0 || index >= PlayerPlaylistCount
+	|| strstr(PlayerPlaylist[index], "://")) {
+	return;
+    }
+    PrefetchPlaylistFile(PlayerPlaylist[index]);
+}
+
+/**
+**	Player started playlist entry.
+**
+**	@param index	playlist index of new current file
+**
+**	@note must be called with #PlayerMutex locked
+*/
+static void PlayerPlaylistIndex(int index)
+{
+    if (index == PlayerPlaylistCurrent || index >= PlayerPlaylistCount) {
+	return;
+    }
+    Debug(3, "play: playlist %d/%d\n", index + 1, PlayerPlaylistCount);
+    PlayerPlaylistCurrent = index;
+    PlayerResumeSave(PlayerPlaylist[index]);
+
+    // meta data of new file
+    PlayerTitle[0] = '\0';
+    PlayerFilename[0] = '\0';
+    PlayerTotal = 0;
+    PlayerCurrent = 0;
+    SendCommand(Backend->Commands.GetLength);
+    SendCommand(Backend->Commands.GetMetaTitle);
+    SendCommand(Backend->Commands.GetFilename);
+
+    PlayerPrefetch(index + 1);
+}
+
+/**
+**	Player started file, find it in the playlist.
+**
+**	@param filename	file name reported by the player
+**
+**	@returns true if the file is in the playlist.
+**
+**	@note must be called with #PlayerMutex locked
+*/
+static int PlayerPlaylistFile(const char *filename)
+{
+    int i;
+
+    for (i = 0; i < PlayerPlaylistCount; ++i) {
+	if (!strcmp(PlayerPlaylist[i], filename)) {
+	    PlayerPlaylistIndex(i);
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+/**
+**	Clear playlist.
+*/
+void PlayerPlaylistClear(void)
+{
+    int i;
+
+    pthread_mutex_lock(&PlayerMutex);
+    for (i = 0; i < PlayerPlaylistCount; ++i) {
+	free(PlayerPlaylist[i]);
+    }
+    free(PlayerPlaylist);
+    PlayerPlaylist = NULL;
+    PlayerPlaylistCount = 0;
+    PlayerPlaylistCurrent = 0;
+    PlayerPlaylistPending = 0;
+    pthread_mutex_unlock(&PlayerMutex);
+}
+
+/**
+**	Add file to playlist.
+**
+**	The first file of the playlist must be the file given to
+**	PlayerStart(), the others are queued in the running player.
+**
+**	@param filename	path and name of file
+*/
+void PlayerPlaylistAdd(const char *filename)
+{
+    pthread_mutex_lock(&PlayerMutex);
+    PlayerPlaylist = realloc(PlayerPlaylist,
+	(PlayerPlaylistCount + 1) * sizeof(*PlayerPlaylist));
+    PlayerPlaylist[PlayerPlaylistCount++] = strdup(filename);
+    pthread_mutex_unlock(&PlayerMutex);
+}
+
+/**
+**	Quote file name for player commands.
+**
+**	Control characters are escaped as json wants them.  mplayer can't
+**	load such a file, but the name can't split the slave command line.
+**
+**	@param buf	output buffer
+**	@param size	size of output buffer
+**	@param filename	path and name of file
+**
+**	@returns @p buf with '"', '\\' and control characters quoted.
+*/
+static const char *PlayerQuote(char *buf, int size, const char *filename)
+{
+    int n;
+
+    for (n = 0; *filename; ++filename) {
+	unsigned char c;
+
+	c = *filename;
+	if (c < 0x20) {
+	    if (n + 6 >= size) {
+		break;
+	    }
+	    if (c == '\n' || c == '\t') {
+		buf[n++] = '\\';
+		buf[n++] = c == '\n' ? 'n' : 't';
+	    } else {
+		n += sprintf(buf + n, "\\u%04x", c);
+	    }
+	    continue;
+	}
+	if (n + 2 >= size) {
+	    break;
+	}
+	if (c == '"' || c == '\\') {
+	    buf[n++] = '\\';
+	}
+	buf[n++] = c;
+    }
+    buf[n] = '\0';
+
+    return buf;
+}
+
+/**
+**	Send the files after the started file to the player.
+**
+**	@note must be called with #PlayerMutex locked
+*/
+static void PlayerPlaylistSend(void)
+{
+    char buf[4096];
+    int i;
+
+    PlayerPlaylistPending = 0;
+    for (i = 1; i < PlayerPlaylistCount; ++i) {
+	SendCommand(Backend->Commands.AppendFile, PlayerQuote(buf,
+		sizeof(buf), PlayerPlaylist[i]));
+    }
+}
+
+/**
+**	Queue playlist in the running player.
+**
+**	A player, which connects its slave channel after the start (mpv),
+**	gets the playlist from the player thread, when it is connected.
+**
+**	@param filename	path and name of started file
+**
+**	@note must be called with #PlayerMutex locked
+*/
+static void PlayerPlaylistQueue(const char *filename)
+{
+    int i;
+
+    PlayerPlaylistPending = 0;
+    if (!ConfigUseSlave || !PlayerPlaylistCount
+	|| strcmp(PlayerPlaylist[0], filename)) {
+	// not started from playlist or no slave to queue it
+	for (i = 0; i < PlayerPlaylistCount; ++i) {
+	    free(PlayerPlaylist[i]);
+	}
+	PlayerPlaylistCount = 0;
+	PlayerPlaylistCurrent = 0;
+	return;
+    }
+    PlayerPlaylistCurrent = 0;
+    if (PlayerPipeIn[1] == -1) {	// slave channel not yet connected
+	PlayerPlaylistPending = 1;
+    } else {
+	PlayerPlaylistSend();
+    }
+    PlayerPrefetch(1);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Player process
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Poll input pipe.
+*/
+static void PlayerPollPipe(void)
+{
+    struct pollfd poll_fds[1];
+    int n;
+    int i;
+    int l;
+
+    if (PlayerPipeOut[0] == -1) {	// slave channel not yet connected
+	if (Backend->Connect && !Backend->Connect()
+	    && PlayerPlaylistPending) {
+	    PlayerPlaylistSend();
+	}
+	return;
+    }
+    // check if something to read
+    poll_fds[0].fd = PlayerPipeOut[0];
+    poll_fds[0].events = POLLIN;
+
+    switch (poll(poll_fds, 1, 0)) {
+	case 0:			// timeout
+	    return;
+	case -1:			// error
+	    Error(_("play/player: poll failed: %s\n"), strerror(errno));
+	    return;
+	default:			// ready
+	    break;
+    }
+
+    // fill buffer
+    if ((n = read(PlayerPipeOut[0], PlayerPipeBuf + PlayerPipeCnt,
+		sizeof(PlayerPipeBuf) - PlayerPipeCnt)) < 0) {
+	Error(_("play/player: read failed: %s\n"), strerror(errno));
+	return;
+    }
+
+    PlayerPipeCnt += n;
+    l = 0;
+    for (i = PlayerPipeIdx; i < PlayerPipeCnt; ++i) {
+	if (PlayerPipeBuf[i] == '\n') {
+	    PlayerPipeBuf[i] = '\0';
+	    if (PlayerPipeSkip) {	// rest of an overlong line
+		PlayerPipeSkip = 0;
+	    } else {
+		Backend->ParseLine(PlayerPipeBuf + PlayerPipeIdx,
+		    i - PlayerPipeIdx);
+	    }
+	    PlayerPipeIdx = i + 1;
+	    l = PlayerPipeIdx;
+	}
+    }
+
+    if (l) {				// remove consumed bytes
+	if (PlayerPipeCnt - l) {
+	    memmove(PlayerPipeBuf, PlayerPipeBuf + l, PlayerPipeCnt - l);
+	}
+	PlayerPipeCnt -= l;
+	PlayerPipeIdx -= l;
+    } else if (PlayerPipeCnt == sizeof(PlayerPipeBuf)) {
+	// no '\n' in buffer: a truncated line would be parsed as junk
+	Debug(3, "play/player: overlong line dropped\n");
+	PlayerPipeSkip = 1;
+	PlayerPipeIdx = 0;
+	PlayerPipeCnt = 0;
+    }
+}
+
+/**
+**	Reset pipe buffer and handles for a new player.
+*/
+static void PlayerResetPipes(void)
+{
+    PlayerPipeCnt = 0;			// reset to defaults
+    PlayerPipeIdx = 0;
+    PlayerPipeSkip = 0;
+
+    PlayerPipeIn[0] = -1;
+    PlayerPipeIn[1] = -1;
+    PlayerPipeOut[0] = -1;
+    PlayerPipeOut[1] = -1;
+}
+
+/**
+**	Build environment of external player.
+**
+**	@returns environment with DISPLAY= set to the configured display.
+*/
+static char **PlayerEnviron(void)
+{
+    static char **env;
+    static char display[256];
+    int n;
+    int i;
+
+    for (n = 0; environ[n]; ++n) {
+    }
+    free(env);
+    env = malloc((n + 2) * sizeof(*env));
+    for (i = n = 0; environ[i]; ++i) {
+	if (strncmp(environ[i], "DISPLAY=", 8)) {
+	    env[n++] = environ[i];
+	}
+    }
+    if (ConfigX11Display) {		// export DISPLAY=
+	snprintf(display, sizeof(display), "DISPLAY=%s", ConfigX11Display);
+	env[n++] = display;
+    }
+    env[n] = NULL;
+
+    return env;
+}
+
+#ifdef USE_POSIX_SPAWN
+
+/**
+**	Spawn external player.
+**
+**	posix_spawn doesn't copy the page tables of the big multi-threaded
+**	vdr process and closes all file handles with a single close_range.
+**
+**	@param args	NULL terminated player arguments vector
+**	@param directory	working directory of a frame grabber, NULL
+**			for the player
+**
+**	@returns pid of the player, -1 on errors.
+*/
+static pid_t PlayerSpawn(const char **args, const char *directory)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    pid_t pid;
+    int err;
+
+    posix_spawn_file_actions_init(&actions);
+    if (directory) {			// frame grabber: no input, no display
+	posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null",
+	    O_RDONLY, 0);
+	posix_spawn_file_actions_addchdir_np(&actions, directory);
+    } else if (ConfigUseSlave && Backend->UsePipes) {	// connect pipe to stdin/stdout
+	posix_spawn_file_actions_adddup2(&actions, PlayerPipeIn[0],
+	    STDIN_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, PlayerPipeOut[1],
+	    STDOUT_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, PlayerPipeOut[1],
+	    STDERR_FILENO);
+    }
+    // close all file handles
+    posix_spawn_file_actions_addclosefrom_np(&actions, STDERR_FILENO + 1);
+
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+
+    // PlayerEnviron() isn't thread-safe, frame grabbers run in workers
+    err = posix_spawnp(&pid, args[0], &actions, &attr, (char *const *)args,
+	directory ? environ : PlayerEnviron());
+
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (err) {
+	Error(_("play: posix_spawn of '%s' failed: %s\n"), args[0],
+	    strerror(err));
+	return -1;
+    }
+    return pid;
+}
+
+#else
+
+/**
+**	Execute external player.
+**
+**	Called in the child, doesn't return.  Only async-signal-safe
+**	functions can be used after fork of the multi-threaded vdr.
+**
+**	@param args	NULL terminated player arguments vector
+**	@param directory	working directory of a frame grabber, NULL
+**			for the player
+**	@param env	environment of the player, built by the parent
+*/
+static void PlayerExec(const char **args, const char *directory,
+    char **env)
+{
+    int i;
+
+    if (directory) {			// frame grabber: no input, no display
+	if ((i = open("/dev/null", O_RDONLY)) >= 0) {
+	    dup2(i, STDIN_FILENO);
+	}
+	if (chdir(directory)) {
+	    exit(-1);
+	}
+    } else if (ConfigUseSlave && Backend->UsePipes) {	// connect pipe to stdin/stdout
+	dup2(PlayerPipeIn[0], STDIN_FILENO);
+	close(PlayerPipeIn[0]);
+	close(PlayerPipeIn[1]);
+	close(PlayerPipeOut[0]);
+	dup2(PlayerPipeOut[1], STDOUT_FILENO);
+	dup2(PlayerPipeOut[1], STDERR_FILENO);
+	close(PlayerPipeOut[1]);
+    }
+    // close all file handles
+#ifdef SYS_close_range
+    if (syscall(SYS_close_range, STDERR_FILENO + 1, ~0U, 0) < 0)
+#endif
+	for (i = getdtablesize() - 1; i > STDERR_FILENO; i--) {
+	    close(i);
+	}
+
+    environ = env;
+    execvp(args[0], (char *const *)args);
+
+    // shouldn't be reached
+    Error(_("play: execvp of '%s' failed: %s\n"), args[0], strerror(errno));
+    exit(-1);
+}
+
+/**
+**	Spawn external player.
+**
+**	@param args	NULL terminated player arguments vector
+**	@param directory	working directory of a frame grabber, NULL
+**			for the player
+**
+**	@returns pid of the player, -1 on errors.
+*/
+static pid_t PlayerSpawn(const char **args, const char *directory)
+{
+    char **env;
+    pid_t pid;
+
+    // malloc isn't allowed in the child, PlayerEnviron() isn't
+    // thread-safe and frame grabbers run in workers
+    env = directory ? environ : PlayerEnviron();
+    if ((pid = fork()) == -1) {
+	Error(_("play: fork failed: %s\n"), strerror(errno));
+	return -1;
     }
-    for (i = 0; i < argn; ++i) {
-	Debug(3, "%s", args[i]);
+    if (!pid) {				// child
+	PlayerExec(args, directory, env);
     }
-#endif
-
-    execvp(args[0], (char *const *)args);
+    setpgid(pid, 0);			// parent
 
-    // shouldn't be reached
-    Error(_("play: execvp of '%s' failed: %s\n"), args[0], strerror(errno));
-    exit(-1);
+    return pid;
 }
 
+#endif
+
 /**
 **	Execute external player.
 **
@@ -434,33 +1597,70 @@ static void PlayerExec(const char *filename)
 */
 static void PlayerForkAndExec(const char *filename)
 {
+    const char *args[MPLAYER_MAX_ARGS];
+    int argn;
     pid_t pid;
+#ifdef DEBUG
+    struct timespec ts0;
+    struct timespec ts1;
+#endif
 
-    if (ConfigUseSlave) {
-	if (pipe(PlayerPipeIn)) {
+    // build arguments in parent, backend may keep state (f.e. ipc path)
+    args[0] = ConfigMplayer ? ConfigMplayer : Backend->Executable;
+    argn = Backend->Arguments(filename, args);
+#ifdef DEBUG
+    if (argn + 1 >= (int)(sizeof(args) / sizeof(*args))) {
+	Debug(3, "play: too many arguments %d\n", argn);
+    }
+    {
+	int i;
+
+	for (i = 0; i < argn; ++i) {
+	    Debug(3, "%s", args[i]);
+	}
+    }
+#else
+    (void)argn;
+#endif
+
+    if (ConfigUseSlave && Backend->UsePipes) {
+	if (pipe2(PlayerPipeIn, O_CLOEXEC)) {
 	    Error(_("play: pipe failed: %s\n"), strerror(errno));
 	    return;
 	}
-	if (pipe(PlayerPipeOut)) {
+	if (pipe2(PlayerPipeOut, O_CLOEXEC)) {
 	    Error(_("play: pipe failed: %s\n"), strerror(errno));
 	    return;
 	}
     }
+#ifdef DEBUG
+    clock_gettime(CLOCK_MONOTONIC, &ts0);
+#endif
 
-    if ((pid = fork()) == -1) {
-	Error(_("play: fork failed: %s\n"), strerror(errno));
-	return;
-    }
-    if (!pid) {				// child
-	PlayerExec(filename);
+    if ((pid = PlayerSpawn(args, NULL)) == -1) {
+	if (ConfigUseSlave && Backend->UsePipes) {
+	    close(PlayerPipeIn[0]);
+	    close(PlayerPipeIn[1]);
+	    close(PlayerPipeOut[0]);
+	    close(PlayerPipeOut[1]);
+	    PlayerResetPipes();
+	}
 	return;
     }
-    PlayerPid = pid;			// parent
-    setpgid(pid, 0);
+    PlayerPid = pid;
 
-    if (ConfigUseSlave) {
+#ifdef DEBUG
+    clock_gettime(CLOCK_MONOTONIC, &ts1);
+    Debug(3, "play: spawn took %ldus\n",
+	(ts1.tv_sec - ts0.tv_sec) * 1000000L + (ts1.tv_nsec -
+	    ts0.tv_nsec) / 1000);
+#endif
+
+    if (ConfigUseSlave && Backend->UsePipes) {
 	close(PlayerPipeIn[0]);
 	close(PlayerPipeOut[1]);
+	PlayerPipeIn[0] = -1;
+	PlayerPipeOut[1] = -1;
     }
 
     Debug(3, "play: child pid=%d\n", pid);
@@ -472,13 +1672,106 @@ static void PlayerForkAndExec(const char *filename)
 static void PlayerClosePipes(void)
 {
     if (ConfigUseSlave) {
-	if (PlayerPipeIn[0] != -1) {
-	    close(PlayerPipeIn[0]);
+	if (PlayerPipeIn[1] != -1 && PlayerPipeIn[1] != PlayerPipeOut[0]) {
+	    close(PlayerPipeIn[1]);
 	}
-	if (PlayerPipeOut[1] != -1) {
-	    close(PlayerPipeOut[1]);
+	if (PlayerPipeOut[0] != -1) {
+	    close(PlayerPipeOut[0]);
+	}
+	PlayerPipeIn[1] = -1;
+	PlayerPipeOut[0] = -1;
+    }
+    MpvIpcRemove();
+}
+
+/**
+**	Is external player process still alive?
+**
+**	@note must be called with #PlayerMutex locked
+*/
+static int PlayerIsAlive(void)
+{
+    pid_t wpid;
+    int status;
+
+    if (!PlayerPid) {			// no player
+	return 0;
+    }
+
+    wpid = waitpid(PlayerPid, &status, WNOHANG);
+    if (wpid <= 0) {
+	return 1;
+    }
+    if (WIFEXITED(status)) {
+	Debug(3, "play: player exited (%d)\n", WEXITSTATUS(status));
+    }
+    if (WIFSIGNALED(status)) {
+	Debug(3, "play: player killed (%d)\n", WTERMSIG(status));
+    }
+    PlayerPid = 0;
+    return 0;
+}
+
+/**
+**	Kill external player, if it is still running.
+**
+**	@note must be called with #PlayerMutex locked
+*/
+static void PlayerKill(void)
+{
+    if (PlayerIsAlive()) {
+	int waittime;
+	int timeout;
+
+	waittime = 0;
+	timeout = 500;			// 0.5s
+
+	kill(PlayerPid, SIGTERM);
+	// wait for player finishing, with timeout
+	while (PlayerIsAlive() && waittime++ < timeout) {
+	    usleep(1 * 1000);
+	}
+	if (PlayerIsAlive()) {		// still running
+	    waittime = 0;
+	    timeout = 500;		// 0.5s
+
+	    kill(PlayerPid, SIGKILL);
+	    // wait for player finishing, with timeout
+	    while (PlayerIsAlive() && waittime++ < timeout) {
+		usleep(1 * 1000);
+	    }
+	    if (PlayerIsAlive()) {
+		Error(_("play: can't stop player\n"));
+	    }
 	}
     }
+    PlayerPid = 0;
+    PlayerClosePipes();
+    PlayerWarm = 0;
+    PlayerIdle = 0;
+}
+
+/**
+**	Spawn warm idle player.
+**
+**	The idle player has already loaded codecs and config, connected to
+**	X11 and is attached to the play window.  PlayerStart() only sends
+**	loadfile.
+**
+**	@note must be called with #PlayerMutex locked
+*/
+static void PlayerWarmSpawn(void)
+{
+    Debug(3, "play: spawn warm player\n");
+
+    PlayerClosePipes();			// cleanup a died player
+    PlayerResetPipes();
+    PlayerWarm = 1;
+    PlayerIdle = 1;
+    PlayerLoaded = 0;
+    PlayerWarmTick = GetMsTicks();
+
+    PlayerForkAndExec(NULL);
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -496,10 +1789,36 @@ static void *PlayerHandlerThread(void *dummy)
 
     // Need: thread for video poll: while (PlayerIsRunning())
     for (;;) {
-	if (ConfigUseSlave && PlayerIsRunning()) {
+	// don't cancel with mutex locked
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	pthread_mutex_lock(&PlayerMutex);
+	if (ConfigUseSlave && PlayerIsAlive()) {
 	    PlayerPollPipe();
 	    // FIXME: wait only if pipe not ready
+
+	    // warm player doesn't exit at end of file, probe it
+	    if (PlayerWarm && !PlayerIdle && PlayerLoaded
+		&& GetMsTicks() - PlayerProbeTick > 1000) {
+		PlayerProbeTick = GetMsTicks();
+		PlayerIdleProbe = 1;
+		SendCommand(Backend->Commands.GetIdle);
+	    }
+	    // keep the position for the resume database up to date
+	    if (PlayerResumeFile && !PlayerIdle && !PlayerPaused
+		&& GetMsTicks() - PlayerPositionTick > 2000) {
+		PlayerPositionTick = GetMsTicks();
+		SendCommand(Backend->Commands.GetPosition);
+		if (!PlayerTotal) {
+		    SendCommand(Backend->Commands.GetLength);
+		}
+	    }
+	} else if (ConfigWarmPlayer && GetMsTicks() - PlayerWarmTick > 1000) {
+	    // respawn, but not faster than once a second
+	    PlayerWarmSpawn();
 	}
+	pthread_mutex_unlock(&PlayerMutex);
+	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+
 	if (ConfigOsdOverlay) {
 	    VideoPollEvents(10);
 	} else {
@@ -544,24 +1863,26 @@ static void PlayerThreadExit(void)
 /**
 **	Send command to player.
 **
-**	@param formst	printf format string
+**	@param format	printf format string, NULL if unsupported by backend
+**	@param va	format arguments
 */
-static void SendCommand(const char *format, ...)
+static void SendCommandV(const char *format, va_list va)
 {
-    va_list va;
-    char buf[256];
+    char buf[8192];			// quoted file names up to 4096
     int n;
 
-    if (!PlayerPid) {
+    if (!PlayerPid || !format) {
 	return;
     }
     if (PlayerPipeIn[1] == -1) {
 	Error(_("play: no pipe to send command available\n"));
 	return;
     }
-    va_start(va, format);
     n = vsnprintf(buf, sizeof(buf), format, va);
-    va_end(va);
+    if (n < 0 || n >= (int)sizeof(buf)) {
+	Error(_("play: command too long\n"));
+	return;
+    }
 
     Debug(3, "play: send '%.*s'\n", n - 1, buf);
 
@@ -571,13 +1892,55 @@ static void SendCommand(const char *format, ...)
     }
 }
 
+/**
+**	Send command to player.
+**
+**	@param format	printf format string, NULL if unsupported by backend
+**
+**	@note must be called with #PlayerMutex locked
+*/
+static void SendCommand(const char *format, ...)
+{
+    va_list va;
+
+    va_start(va, format);
+    SendCommandV(format, va);
+    va_end(va);
+}
+
+/**
+**	Lock player and send command to it.
+**
+**	The player thread closes and re-creates the pipe, commands from
+**	the OSD thread must hold #PlayerMutex.
+**
+**	@param format	printf format string, NULL if unsupported by backend
+*/
+static void LockSendCommand(const char *format, ...)
+{
+    va_list va;
+
+    pthread_mutex_lock(&PlayerMutex);
+    va_start(va, format);
+    SendCommandV(format, va);
+    va_end(va);
+    pthread_mutex_unlock(&PlayerMutex);
+}
+
 /**
 **	Send player quit.
 */
 void PlayerSendQuit(void)
 {
     if (ConfigUseSlave) {
-	SendCommand("quit\n");
+	pthread_mutex_lock(&PlayerMutex);
+	if (PlayerWarm) {		// keep warm player for next start
+	    SendCommand(Backend->Commands.Stop);
+	    PlayerIdle = 1;
+	} else {
+	    SendCommand(Backend->Commands.Quit);
+	}
+	pthread_mutex_unlock(&PlayerMutex);
     }
 }
 
@@ -587,7 +1950,7 @@ void PlayerSendQuit(void)
 void PlayerSendPause(void)
 {
     if (ConfigUseSlave) {
-	SendCommand("pause\n");
+	LockSendCommand(Backend->Commands.Pause);
     }
 }
 
@@ -599,7 +1962,7 @@ void PlayerSendPause(void)
 void PlayerSendSetSpeed(int speed)
 {
     if (ConfigUseSlave) {
-	SendCommand("pausing_keep speed_set %d\n", speed);
+	LockSendCommand(Backend->Commands.SetSpeed, speed);
     }
 }
 
@@ -611,18 +1974,44 @@ void PlayerSendSetSpeed(int speed)
 void PlayerSendSeek(int seconds)
 {
     if (ConfigUseSlave) {
-	SendCommand("pausing_keep seek %+d 0\n", seconds);
+	LockSendCommand(Backend->Commands.Seek, seconds);
+    }
+}
+
+/**
+**	Send player absolute seek.
+**
+**	@param seconds	seek to absolute position in seconds
+*/
+void PlayerSendSeekTo(int seconds)
+{
+    if (ConfigUseSlave) {
+	LockSendCommand(Backend->Commands.SeekTo, seconds);
+    }
+}
+
+/**
+**	Send player playlist step.
+**
+**	@param step	number of playlist entries to skip (negative back)
+*/
+void PlayerSendPlaylistStep(int step)
+{
+    if (ConfigUseSlave) {
+	LockSendCommand(Backend->Commands.PlaylistStep, step);
     }
 }
 
 /**
 **	Send player volume.
+**
+**	@note must be called with #PlayerMutex locked
 */
-void PlayerSendVolume(void)
+static void PlayerSendVolume(void)
 {
     if (ConfigUseSlave) {
 	// FIXME: %.2f could have a problem with LANG
-	SendCommand("pausing_keep volume %.2f 1\n",
+	SendCommand(Backend->Commands.Volume,
 	    (PlayerVolume * 100.0) / 255);
     }
 }
@@ -633,7 +2022,7 @@ void PlayerSendVolume(void)
 void PlayerSendSwitchAudio(void)
 {
     if (ConfigUseSlave) {
-	SendCommand("pausing_keep switch_audio\n");
+	LockSendCommand(Backend->Commands.SwitchAudio);
     }
 }
 
@@ -643,7 +2032,7 @@ void PlayerSendSwitchAudio(void)
 void PlayerSendSubSelect(void)
 {
     if (ConfigUseSlave) {
-	SendCommand("pausing_keep sub_select\n");
+	LockSendCommand(Backend->Commands.SubSelect);
     }
 }
 
@@ -653,7 +2042,7 @@ void PlayerSendSubSelect(void)
 void PlayerSendDvdNavUp(void)
 {
     if (ConfigUseSlave) {
-	SendCommand("pausing_keep dvdnav up\n");
+	LockSendCommand(Backend->Commands.DvdNav, "up");
     }
 }
 
@@ -663,7 +2052,7 @@ void PlayerSendDvdNavUp(void)
 void PlayerSendDvdNavDown(void)
 {
     if (ConfigUseSlave) {
-	SendCommand("pausing_keep dvdnav down\n");
+	LockSendCommand(Backend->Commands.DvdNav, "down");
     }
 }
 
@@ -673,7 +2062,7 @@ void PlayerSendDvdNavDown(void)
 void PlayerSendDvdNavLeft(void)
 {
     if (ConfigUseSlave) {
-	SendCommand("pausing_keep dvdnav left\n");
+	LockSendCommand(Backend->Commands.DvdNav, "left");
     }
 }
 
@@ -683,7 +2072,7 @@ void PlayerSendDvdNavLeft(void)
 void PlayerSendDvdNavRight(void)
 {
     if (ConfigUseSlave) {
-	SendCommand("pausing_keep dvdnav right\n");
+	LockSendCommand(Backend->Commands.DvdNav, "right");
     }
 }
 
@@ -693,7 +2082,7 @@ void PlayerSendDvdNavRight(void)
 void PlayerSendDvdNavSelect(void)
 {
     if (ConfigUseSlave) {
-	SendCommand("pausing_keep dvdnav select\n");
+	LockSendCommand(Backend->Commands.DvdNav, "select");
     }
 }
 
@@ -703,7 +2092,7 @@ void PlayerSendDvdNavSelect(void)
 void PlayerSendDvdNavPrev(void)
 {
     if (ConfigUseSlave) {
-	SendCommand("pausing_keep dvdnav prev\n");
+	LockSendCommand(Backend->Commands.DvdNav, "prev");
     }
 }
 
@@ -713,7 +2102,7 @@ void PlayerSendDvdNavPrev(void)
 void PlayerSendDvdNavMenu(void)
 {
     if (ConfigUseSlave) {
-	SendCommand("pausing_keep dvdnav menu\n");
+	LockSendCommand(Backend->Commands.DvdNav, "menu");
     }
 }
 
@@ -723,7 +2112,7 @@ void PlayerSendDvdNavMenu(void)
 void PlayerGetLength(void)
 {
     if (ConfigUseSlave) {
-	SendCommand("get_time_length\n");
+	LockSendCommand(Backend->Commands.GetLength);
     }
 }
 
@@ -733,7 +2122,7 @@ void PlayerGetLength(void)
 void PlayerGetCurrentPosition(void)
 {
     if (ConfigUseSlave) {
-	SendCommand("get_time_pos\n");
+	LockSendCommand(Backend->Commands.GetPosition);
     }
 }
 
@@ -743,7 +2132,7 @@ void PlayerGetCurrentPosition(void)
 void PlayerGetMetaTitle(void)
 {
     if (ConfigUseSlave) {
-	SendCommand("get_meta_title\n");
+	LockSendCommand(Backend->Commands.GetMetaTitle);
     }
 }
 
@@ -753,7 +2142,7 @@ void PlayerGetMetaTitle(void)
 void PlayerGetFilename(void)
 {
     if (ConfigUseSlave) {
-	SendCommand("get_file_name\n");
+	LockSendCommand(Backend->Commands.GetFilename);
     }
 }
 
@@ -764,28 +2153,56 @@ void PlayerGetFilename(void)
 */
 void PlayerStart(const char *filename)
 {
-    PlayerPipeCnt = 0;			// reset to defaults
-    PlayerPipeIdx = 0;
-
-    PlayerPipeIn[0] = -1;
-    PlayerPipeIn[1] = -1;
-    PlayerPipeOut[0] = -1;
-    PlayerPipeOut[1] = -1;
-    PlayerPid = 0;
+    pthread_mutex_lock(&PlayerMutex);
 
     PlayerPaused = 0;
     PlayerSpeed = 1;
 
     PlayerDvdNav = 0;
 
+    PlayerResumeSave(filename);
+    PlayerResume = ConfigResumeFile
+	&& !strstr(filename, "://") ? ResumeLookup(filename) : 0;
+    PlayerCurrent = PlayerResume;
+    PlayerTotal = 0;
+
+    strncpy(PlayerLoadName, filename, sizeof(PlayerLoadName) - 1);
+    PlayerIdleProbe = 0;
+
     if (ConfigOsdOverlay) {		// overlay wanted
-	VideoSetColorKey(ConfigColorKey);
-	VideoInit(ConfigX11Display);
+	if (ConfigWarmPlayer) {		// video is kept for the warm player
+	    VideoPlayWindowShow();
+	} else {
+	    VideoSetColorKey(ConfigColorKey);
+	    VideoInit(ConfigX11Display);
+	}
 	EnableDummyDevice();
     }
-    PlayerForkAndExec(filename);
+    // urls (cdda, dvdnav) need other player arguments
+    if (PlayerWarm && PlayerIdle && PlayerIsAlive() && PlayerPipeIn[1] != -1
+	&& !strstr(filename, "://")) {
+	char buf[4096];
+
+	Debug(3, "play: warm player loads '%s'\n", filename);
+	PlayerIdle = 0;
+	PlayerLoaded = 0;
+	PlayerProbeTick = GetMsTicks();
+	PlayerResumePending = PlayerResume;	// loadfile has no start
+	SendCommand(Backend->Commands.LoadFile, PlayerQuote(buf, sizeof(buf),
+		filename));
+	if (PlayerVolume != -1) {	// idle player has no audio out
+	    PlayerSendVolume();
+	}
+    } else {
+	PlayerKill();			// warm player not usable
+	PlayerResetPipes();
+	PlayerForkAndExec(filename);
+    }
+    PlayerPlaylistQueue(filename);
+
+    pthread_mutex_unlock(&PlayerMutex);
 
-    if (ConfigOsdOverlay || ConfigUseSlave) {
+    if ((ConfigOsdOverlay || ConfigUseSlave) && !PlayerThread) {
 	PlayerThreadInit();
     }
 }
@@ -795,70 +2212,76 @@ void PlayerStart(const char *filename)
 */
 void PlayerStop(void)
 {
-    PlayerThreadExit();
+    if (!ConfigWarmPlayer) {		// warm player needs the thread
+	PlayerThreadExit();
+    }
 
+    pthread_mutex_lock(&PlayerMutex);
+    PlayerResumeSave(NULL);
+    PlayerResumePending = 0;
     //
     //	stop mplayer, if it is still running.
     //
-    if (PlayerIsRunning()) {
-	int waittime;
-	int timeout;
-
-	waittime = 0;
-	timeout = 500;			// 0.5s
-
-	kill(PlayerPid, SIGTERM);
-	// wait for player finishing, with timeout
-	while (PlayerIsRunning() && waittime++ < timeout) {
-	    usleep(1 * 1000);
-	}
-	if (PlayerIsRunning()) {	// still running
-	    waittime = 0;
-	    timeout = 500;		// 0.5s
-
-	    kill(PlayerPid, SIGKILL);
-	    // wait for player finishing, with timeout
-	    while (PlayerIsRunning() && waittime++ < timeout) {
-		usleep(1 * 1000);
-	    }
-	    if (PlayerIsRunning()) {
-		Error(_("play: can't stop player\n"));
-	    }
+    if (PlayerWarm && PlayerIsAlive()) {
+	if (!PlayerIdle) {		// keep it for the next start
+	    SendCommand(Backend->Commands.Stop);
+	    PlayerIdle = 1;
 	}
+    } else {
+	PlayerKill();
+	PlayerWarmTick = 0;		// respawn warm player immediately
     }
-    PlayerPid = 0;
-    PlayerClosePipes();
+    pthread_mutex_unlock(&PlayerMutex);
 
     if (ConfigOsdOverlay) {
 	DisableDummyDevice();
-	VideoExit();
+	if (ConfigWarmPlayer) {
+	    VideoPlayWindowHide();
+	} else {
+	    VideoExit();
+	}
     }
 }
 
 /**
 **	Is external player still running?
+**
+**	An idle warm player isn't running.
 */
 int PlayerIsRunning(void)
 {
-    pid_t wpid;
-    int status;
+    int running;
 
-    if (!PlayerPid) {			// no player
-	return 0;
-    }
+    pthread_mutex_lock(&PlayerMutex);
+    running = PlayerIsAlive() && !PlayerIdle;
+    pthread_mutex_unlock(&PlayerMutex);
 
-    wpid = waitpid(PlayerPid, &status, WNOHANG);
-    if (wpid <= 0) {
-	return 1;
-    }
-    if (WIFEXITED(status)) {
-	Debug(3, "play: player exited (%d)\n", WEXITSTATUS(status));
-    }
-    if (WIFSIGNALED(status)) {
-	Debug(3, "play: player killed (%d)\n", WTERMSIG(status));
-    }
-    PlayerPid = 0;
-    return 0;
+    return running;
+}
+
+/**
+**	Spawn a frame grabber.
+**
+**	The player backend writes a single scaled down frame as image file
+**	into the directory.  Called from the thumbnail workers, the child
+**	inherits their priority.
+**
+**	@param filename	path and name of video file
+**	@param position	position of the frame in seconds
+**	@param directory	empty directory for the frame
+**
+**	@returns pid of the frame grabber process group, -1 on errors.
+*/
+int PlayerGrabFrame(const char *filename, int position, const char *directory)
+{
+    const char *args[MPLAYER_MAX_ARGS];
+    char buf[32];
+
+    snprintf(buf, sizeof(buf), "%d", position);
+    args[0] = ConfigMplayer ? ConfigMplayer : Backend->Executable;
+    Backend->FrameArguments(filename, buf, args);
+
+    return PlayerSpawn(args, directory);
 }
 
 /**
@@ -870,18 +2293,60 @@ void PlayerSetVolume(int volume)
 {
     Debug(3, "player: set volume=%d\n", volume);
 
+    pthread_mutex_lock(&PlayerMutex);
     if (PlayerVolume != volume) {
 	PlayerVolume = volume;
 	if (PlayerPid) {
 	    PlayerSendVolume();
 	}
     }
+    pthread_mutex_unlock(&PlayerMutex);
 }
 
 //////////////////////////////////////////////////////////////////////////////
 //	Device/Plugin C part
 //////////////////////////////////////////////////////////////////////////////
 
+/**
+**	Start plugin, open the resume database and spawn the warm player.
+*/
+int Start(void)
+{
+    if (ConfigResumeFile && !ResumeInit(ConfigResumeFile)) {
+	ConfigResumeFile = NULL;
+    }
+    if (ConfigWarmPlayer) {
+	if (ConfigOsdOverlay) {		// idle player needs the play window
+	    VideoSetColorKey(ConfigColorKey);
+	    VideoInit(ConfigX11Display);
+	    VideoPlayWindowHide();
+	}
+	PlayerThreadInit();		// thread spawns the warm player
+    }
+    return 1;
+}
+
+/**
+**	Stop plugin, kill the warm player, close the resume database and
+**	stop the prefetch threads.
+*/
+void Stop(void)
+{
+    if (ConfigWarmPlayer) {
+	PlayerThreadExit();
+	pthread_mutex_lock(&PlayerMutex);
+	PlayerKill();
+	pthread_mutex_unlock(&PlayerMutex);
+	if (ConfigOsdOverlay) {
+	    VideoExit();
+	}
+    }
+    if (ConfigResumeFile) {
+	ResumeExit();
+    }
+    PrefetchExit();
+}
+
 /**
 **	Return command line help string.
 */
@@ -893,11 +2358,17 @@ const char *CommandLineHelp(void)
 	"  -d display\tX11 display (default :0.0) overwrites $DISPLAY\n"
 	"  -f\t\tmplayer fullscreen playback\n"
 	"  -g geometry\tx11 window geometry wxh+x+y\n"
+	"  -i file\tmedia library index of the browser root directory\n"
 	"  -k colorkey\tvideo color key (default=0x020507, mplayer2=0x76B901)\n"
 	"  -m mplayer\tfilename of mplayer executable\n"
+	"  -p player\tplayer backend mplayer (default) or mpv\n"
 	"  -M args\targuments for mplayer\n"
-	"  -o\t\tosd overlay experiments\n" "  -s\t\tmplayer slave mode\n"
-	"  -v video\tmplayer -vo (vdpau:deint=4:hqscaling=1) overwrites mplayer.conf\n";
+	"  -o\t\tosd overlay experiments\n"
+	"  -r file\tresume database, resume files at the last position\n"
+	"  -s\t\tmplayer slave mode\n"
+	"  -t dir\tthumbnail cache directory, enables thumbnails\n"
+	"  -v video\tmplayer -vo (vdpau:deint=4:hqscaling=1) overwrites mplayer.conf\n"
+	"  -w\t\tkeep a warm idle player ready (enables slave mode)\n";
 }
 
 /**
@@ -909,6 +2380,7 @@ const char *CommandLineHelp(void)
 int ProcessArgs(int argc, char *const argv[])
 {
     const char *s;
+    int i;
 
     //
     //	Parse arguments.
@@ -924,7 +2396,7 @@ int ProcessArgs(int argc, char *const argv[])
     }
 
     for (;;) {
-	switch (getopt(argc, argv, "-%:/:a:b:d:fg:k:m:M:osv:")) {
+	switch (getopt(argc, argv, "-%:/:a:b:d:fg:i:k:m:M:op:r:st:v:w")) {
 	    case '%':			// dvd-device
 		ConfigMplayerDevice = optarg;
 		continue;
@@ -943,6 +2415,9 @@ int ProcessArgs(int argc, char *const argv[])
 	    case 'g':			// geometry
 		VideoSetGeometry(optarg);
 		continue;
+	    case 'i':			// media library index
+		ConfigLibraryFile = optarg;
+		continue;
 	    case 'k':			// color key
 		ConfigColorKey = strtol(optarg, NULL, 0);
 		continue;
@@ -955,12 +2430,35 @@ int ProcessArgs(int argc, char *const argv[])
 	    case 'o':			// osd / overlay
 		ConfigOsdOverlay = 1;
 		continue;
+	    case 'p':			// player backend
+		for (i = 0; PlayerBackends[i]; ++i) {
+		    if (!strcasecmp(optarg, PlayerBackends[i]->Name)) {
+			Backend = PlayerBackends[i];
+			break;
+		    }
+		}
+		if (!PlayerBackends[i]) {
+		    fprintf(stderr, _("Unknown player backend '%s'\n"),
+			optarg);
+		    return 0;
+		}
+		continue;
+	    case 'r':			// resume database
+		ConfigResumeFile = optarg;
+		continue;
 	    case 's':			// slave mode
 		ConfigUseSlave = 1;
 		continue;
+	    case 't':			// thumbnail cache
+		ConfigThumbDirectory = optarg;
+		continue;
 	    case 'v':			// video out
 		ConfigVideoOut = optarg;
 		continue;
+	    case 'w':			// warm idle player
+		ConfigWarmPlayer = 1;
+		ConfigUseSlave = 1;
+		continue;
 	    case EOF:
 		break;
 	    case '-':
@@ -99,6 +99,10 @@ extern "C"
 
     /// Browser root=start directory
     extern const char *ConfigBrowserRoot;
+    /// Media library index file
+    extern const char *ConfigLibraryFile;
+    /// Thumbnail cache directory
+    extern const char *ConfigThumbDirectory;
     ///< Disable remote during external play
     extern char ConfigDisableRemote;
     extern const char *X11DisplayName;	///< x11 display name
@@ -109,6 +113,7 @@ extern "C"
     extern int PlayerTotal;		///< total length in seconds
     extern char PlayerTitle[256];	///< title from meta data
     extern char PlayerFilename[256];	///< filename
+    extern int PlayerPlaylistCurrent;	///< current playlist index
 
     /// Start external player
     extern void PlayerStart(const char *name);
@@ -116,6 +121,13 @@ extern "C"
     extern void PlayerStop(void);
     /// Is external player still running
     extern int PlayerIsRunning(void);
+    /// Spawn a frame grabber
+    extern int PlayerGrabFrame(const char *, int, const char *);
+
+    /// Clear playlist
+    extern void PlayerPlaylistClear(void);
+    /// Add file to playlist
+    extern void PlayerPlaylistAdd(const char *);
 
     /// Set player volume
     extern void PlayerSetVolume(int);
@@ -128,6 +140,10 @@ extern "C"
     extern void PlayerSendSetSpeed(int);
     /// Player send seek
     extern void PlayerSendSeek(int);
+    /// Player send absolute seek
+    extern void PlayerSendSeekTo(int);
+    /// Player send playlist step
+    extern void PlayerSendPlaylistStep(int);
     /// Player send switch audio track
     extern void PlayerSendSwitchAudio(void);
     /// Player send select subtitle
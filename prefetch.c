@@ -0,0 +1,504 @@
+///
+///	@file prefetch.c	@brief file prefetch module
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup Prefetch The file prefetch module.
+///
+///	Reads the parts of a media file, the player needs first, into the
+///	page cache: the head and the container index (mp4 moov atom, mkv
+///	cues, avi idx1 at the tail).  A pool of worker threads handles a
+///	small queue, PrefetchCancel() drops queued requests and stops
+///	running ones between two chunks.  The files following in the
+///	playlist have their own pool, the browser can't cancel them.
+///
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <pthread.h>
+
+#include <libintl.h>
+#define _(str) gettext(str)		///< gettext shortcut
+#define _N(str) str			///< gettext_noop shortcut
+
+#include "misc.h"
+#include "worker.h"
+#include "prefetch.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//	Defines
+//////////////////////////////////////////////////////////////////////////////
+
+#define PREFETCH_THREADS	2	///< number of prefetch workers
+#define PREFETCH_QUEUE		8	///< size of the request queue
+#define PREFETCH_PLAYLIST	4	///< size of the playlist queue
+#define PREFETCH_CHUNK	(64 * 1024)	///< bytes read between cancel checks
+#define PREFETCH_HEAD	(2 * 1024 * 1024)	///< bytes of file head
+#define PREFETCH_TAIL	(1024 * 1024)	///< bytes of file tail
+#define PREFETCH_INDEX	(16 * 1024 * 1024)	///< max bytes of an index
+
+//////////////////////////////////////////////////////////////////////////////
+//	Variables
+//////////////////////////////////////////////////////////////////////////////
+
+static void PrefetchHandle(void *, unsigned);
+static void PrefetchPlaylistHandle(void *, unsigned);
+
+    /// prefetch workers of the browser, duplicates are queued
+static WorkerPool PrefetchPool = {
+    .Name = "prefetch",
+    .Threads = PREFETCH_THREADS,
+    .Size = PREFETCH_QUEUE,
+    .Handle = PrefetchHandle,
+    .Mutex = PTHREAD_MUTEX_INITIALIZER,
+    .Cond = PTHREAD_COND_INITIALIZER,
+};
+
+    /// prefetch worker of the playlist, not cancelled by the browser
+static WorkerPool PrefetchPlaylistPool = {
+    .Name = "prefetch/playlist",
+    .Threads = 1,
+    .Size = PREFETCH_PLAYLIST,
+    .Handle = PrefetchPlaylistHandle,
+    .Same = WorkerSameFile,
+    .Mutex = PTHREAD_MUTEX_INITIALIZER,
+    .Cond = PTHREAD_COND_INITIALIZER,
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//	Container index
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Read big endian 32 bit value.
+*/
+static uint32_t PrefetchBe32(const uint8_t * p)
+{
+    return (p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/**
+**	Find moov atom of a mp4 file.
+**
+**	Walks the top level boxes, the moov atom is either before or after
+**	the media data.
+**
+**	@param fd	file descriptor
+**	@param size	size of file
+**	@param[out] offset	start of moov atom
+**	@param[out] length	length of moov atom
+**
+**	@returns true if found.
+*/
+static int PrefetchMp4Index(int fd, off_t size, off_t * offset,
+    off_t * length)
+{
+    uint8_t hdr[16];
+    uint64_t box;
+    off_t pos;
+    int i;
+
+    pos = 0;
+    for (i = 0; i < 64 && pos + 8 <= size; ++i) {
+	if (pread(fd, hdr, sizeof(hdr), pos) < 8) {
+	    break;
+	}
+	box = PrefetchBe32(hdr);
+	if (box == 1) {			// 64 bit large size
+	    box = ((uint64_t) PrefetchBe32(hdr + 8) << 32)
+		| PrefetchBe32(hdr + 12);
+	} else if (!box) {		// up to end of file
+	    box = size - pos;
+	}
+	if (box < 8) {
+	    break;
+	}
+	if (!memcmp(hdr + 4, "moov", 4)) {
+	    *offset = pos;
+	    *length = box;
+	    return 1;
+	}
+	pos += box;
+    }
+    return 0;
+}
+
+/**
+**	Parse ebml element id.
+**
+**	@param p	element data
+**	@param end	end of buffer
+**	@param[out] id	element id including length marker
+**
+**	@returns length of id, 0 on error.
+*/
+static int PrefetchEbmlId(const uint8_t * p, const uint8_t * end,
+    uint32_t * id)
+{
+    int n;
+    int i;
+
+    if (p >= end || !*p) {
+	return 0;
+    }
+    n = 1;				// leading zero bits give the length
+    while (!(*p & (0x80 >> (n - 1)))) {
+	++n;
+    }
+    if (n > 4 || p + n > end) {
+	return 0;
+    }
+    *id = 0;
+    for (i = 0; i < n; ++i) {
+	*id = (*id << 8) | p[i];
+    }
+    return n;
+}
+
+/**
+**	Parse ebml element size.
+**
+**	@param p	element data
+**	@param end	end of buffer
+**	@param[out] size	element size, UINT64_MAX for unknown
+**
+**	@returns length of size, 0 on error.
+*/
+static int PrefetchEbmlSize(const uint8_t * p, const uint8_t * end,
+    uint64_t * size)
+{
+    uint64_t mask;
+    int n;
+    int i;
+
+    if (p >= end || !*p) {
+	return 0;
+    }
+    n = 1;				// leading zero bits give the length
+    while (!(*p & (0x80 >> (n - 1)))) {
+	++n;
+    }
+    if (p + n > end) {
+	return 0;
+    }
+    *size = *p & (0xFF >> n);
+    for (i = 1; i < n; ++i) {
+	*size = (*size << 8) | p[i];
+    }
+    mask = (1ULL << (7 * n)) - 1;
+    if (*size == mask) {		// all ones: unknown size
+	*size = UINT64_MAX;
+    }
+    return n;
+}
+
+/**
+**	Find cues of a mkv file.
+**
+**	Uses the seek head at the start of the segment.
+**
+**	@param fd	file descriptor
+**	@param buf	first bytes of file
+**	@param n	number of bytes in buffer
+**	@param[out] offset	start of cues
+**	@param[out] length	length of cues
+**
+**	@returns true if found.
+*/
+static int PrefetchMkvIndex(int fd, const uint8_t * buf, int n,
+    off_t * offset, off_t * length)
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    const uint8_t *seek_end;
+    const uint8_t *entry_end;
+    uint8_t hdr[12];
+    uint32_t id;
+    uint64_t size;
+    uint64_t position;
+    off_t segment;
+    int cues;
+    int i;
+
+    p = buf;
+    end = buf + n;
+    segment = -1;
+    // EBML header, segment, seek head as first children of the segment
+    while (p < end) {
+	if (!(i = PrefetchEbmlId(p, end, &id))) {
+	    return 0;
+	}
+	p += i;
+	if (!(i = PrefetchEbmlSize(p, end, &size))) {
+	    return 0;
+	}
+	p += i;
+	if (id == 0x18538067) {		// segment: enter
+	    segment = p - buf;
+	    continue;
+	}
+	if (id == 0x114D9B74) {		// seek head
+	    break;
+	}
+	if (segment >= 0 && id != 0xEC) {	// only void before seek head
+	    return 0;
+	}
+	if (size > (uint64_t) (end - p)) {
+	    return 0;
+	}
+	p += size;
+    }
+    if (p >= end || segment < 0 || size > (uint64_t) (end - p)) {
+	return 0;
+    }
+
+    seek_end = p + size;
+    while (p < seek_end) {
+	if (!(i = PrefetchEbmlId(p, seek_end, &id))) {
+	    return 0;
+	}
+	p += i;
+	if (!(i = PrefetchEbmlSize(p, seek_end, &size))
+	    || size > (uint64_t) (seek_end - p - i)) {
+	    return 0;
+	}
+	p += i;
+	entry_end = p + size;
+	if (id != 0x4DBB) {		// not a seek entry
+	    p = entry_end;
+	    continue;
+	}
+	cues = 0;
+	position = UINT64_MAX;
+	while (p < entry_end) {
+	    if (!(i = PrefetchEbmlId(p, entry_end, &id))) {
+		return 0;
+	    }
+	    p += i;
+	    if (!(i = PrefetchEbmlSize(p, entry_end, &size))
+		|| size > (uint64_t) (entry_end - p - i)) {
+		return 0;
+	    }
+	    p += i;
+	    if (id == 0x53AB) {		// seek id
+		cues = size == 4 && PrefetchBe32(p) == 0x1C53BB6B;
+	    } else if (id == 0x53AC && size <= 8) {	// seek position
+		position = 0;
+		for (i = 0; i < (int)size; ++i) {
+		    position = (position << 8) | p[i];
+		}
+	    }
+	    p += size;
+	}
+	if (cues && position != UINT64_MAX) {
+	    *offset = segment + position;
+	    // read size of cues element
+	    if (pread(fd, hdr, sizeof(hdr), *offset) != sizeof(hdr)
+		|| !(i = PrefetchEbmlId(hdr, hdr + sizeof(hdr), &id))
+		|| id != 0x1C53BB6B
+		|| !PrefetchEbmlSize(hdr + i, hdr + sizeof(hdr), &size)
+		|| size == UINT64_MAX) {
+		return 0;
+	    }
+	    *length = size + sizeof(hdr);
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Thread
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Read range of a file into the page cache.
+**
+**	The advice is enough for local files, network filesystems may
+**	ignore it, the range is read too.
+**
+**	@param pool	worker pool of the request
+**	@param fd	file descriptor
+**	@param offset	start of range
+**	@param length	length of range
+**	@param generation	generation of the request
+**
+**	@returns true if canceled.
+*/
+static int PrefetchRange(const WorkerPool * pool, int fd, off_t offset,
+    off_t length, unsigned generation)
+{
+    char buf[PREFETCH_CHUNK];
+    ssize_t n;
+
+    posix_fadvise(fd, offset, length, POSIX_FADV_WILLNEED);
+    while (length > 0) {
+	if (WorkerCancelled(pool, generation)) {
+	    return 1;
+	}
+	n = pread(fd, buf, length < PREFETCH_CHUNK ? length : PREFETCH_CHUNK,
+	    offset);
+	if (n <= 0) {
+	    break;
+	}
+	offset += n;
+	length -= n;
+    }
+    return 0;
+}
+
+/**
+**	Prefetch head and container index of a file.
+**
+**	@param pool	worker pool of the request
+**	@param request	path and name of file
+**	@param generation	generation of the request
+*/
+static void PrefetchRequest(const WorkerPool * pool, const char *request,
+    unsigned generation)
+{
+    const char *filename;
+    uint8_t buf[4096];
+    struct stat st;
+    off_t offset;
+    off_t length;
+    int n;
+    int fd;
+
+    filename = request;
+    Debug(3, "prefetch: '%s'\n", filename);
+    if ((fd = open(filename, O_RDONLY | O_CLOEXEC)) < 0) {
+	return;
+    }
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+	close(fd);
+	return;
+    }
+    if (PrefetchRange(pool, fd, 0, st.st_size < PREFETCH_HEAD ? st.st_size :
+	    PREFETCH_HEAD, generation)
+	|| st.st_size <= PREFETCH_HEAD
+	|| (n = pread(fd, buf, sizeof(buf), 0)) < 16) {
+	close(fd);
+	return;
+    }
+
+    length = 0;
+    if (!memcmp(buf + 4, "ftyp", 4) || !memcmp(buf + 4, "moov", 4)) {
+	if (PrefetchMp4Index(fd, st.st_size, &offset, &length)
+	    && offset + length <= PREFETCH_HEAD) {
+	    length = 0;			// moov in head, already done
+	}
+    } else if (PrefetchBe32(buf) == 0x1A45DFA3) {
+	if (!PrefetchMkvIndex(fd, buf, n, &offset, &length)) {
+	    length = -1;		// cues are usually at the tail
+	}
+    } else if (!memcmp(buf, "RIFF", 4) && !memcmp(buf + 8, "AVI ", 4)) {
+	length = -1;			// idx1 is at the tail
+    }
+    if (length < 0) {
+	offset = st.st_size - PREFETCH_TAIL;
+	length = PREFETCH_TAIL;
+    }
+    if (length > 0) {
+	if (length > PREFETCH_INDEX) {
+	    length = PREFETCH_INDEX;
+	}
+	Debug(3, "prefetch: index %jd+%jd '%s'\n", (intmax_t) offset,
+	    (intmax_t) length, filename);
+	PrefetchRange(pool, fd, offset, length, generation);
+    }
+    close(fd);
+}
+
+/**
+**	Handle a prefetch request of the browser.
+**
+**	@param request	path and name of file
+**	@param generation	generation of the request
+*/
+static void PrefetchHandle(void *request, unsigned generation)
+{
+    PrefetchRequest(&PrefetchPool, request, generation);
+}
+
+/**
+**	Handle a prefetch request of the playlist.
+**
+**	@param request	path and name of file
+**	@param generation	generation of the request
+*/
+static void PrefetchPlaylistHandle(void *request, unsigned generation)
+{
+    PrefetchRequest(&PrefetchPlaylistPool, request, generation);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Functions
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Queue prefetch of file head and container index.
+**
+**	If the queue is full, the oldest request is dropped.
+**
+**	@param filename	path and name of file
+*/
+void PrefetchFile(const char *filename)
+{
+    WorkerQueueFile(&PrefetchPool, filename);
+}
+
+/**
+**	Queue prefetch of a file following in the playlist.
+**
+**	PrefetchCancel() doesn't cancel it.
+**
+**	@param filename	path and name of file
+*/
+void PrefetchPlaylistFile(const char *filename)
+{
+    WorkerQueueFile(&PrefetchPlaylistPool, filename);
+}
+
+/**
+**	Cancel all queued and running prefetches of the browser.
+*/
+void PrefetchCancel(void)
+{
+    WorkerCancel(&PrefetchPool);
+}
+
+/**
+**	Stop prefetch threads.
+*/
+void PrefetchExit(void)
+{
+    WorkerExit(&PrefetchPool);
+    WorkerExit(&PrefetchPlaylistPool);
+}
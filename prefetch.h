@@ -0,0 +1,33 @@
+///
+///	@file prefetch.h	@brief file prefetch module header file
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+    /// queue prefetch of file head and container index
+extern void PrefetchFile(const char *);
+
+    /// queue prefetch of a following playlist file
+extern void PrefetchPlaylistFile(const char *);
+
+    /// cancel all queued and running prefetches of the browser
+extern void PrefetchCancel(void);
+
+    /// stop prefetch threads
+extern void PrefetchExit(void);
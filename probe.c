@@ -0,0 +1,1380 @@
+///
+///	@file probe.c		@brief media file probe module
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup Probe The media file probe module.
+///
+///	Reads duration, tags and track lists from the container headers,
+///	without starting the player: mp4 boxes, mkv elements, mp3 ID3 tags
+///	and frame headers, flac and ogg vorbis comments.  A pool of worker
+///	threads with idle i/o priority handles a small queue.  The
+///	results are cached in memory, keyed by the file identity (device,
+///	inode, size, mtime), the oldest are replaced.
+///
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <pthread.h>
+
+#include <libintl.h>
+#define _(str) gettext(str)		///< gettext shortcut
+#define _N(str) str			///< gettext_noop shortcut
+
+#include "misc.h"
+#include "worker.h"
+#include "probe.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//	Defines
+//////////////////////////////////////////////////////////////////////////////
+
+#define PROBE_THREADS	2		///< number of probe workers
+#define PROBE_QUEUE	64		///< size of the request queue
+#define PROBE_CACHE	2048		///< cached probe results (power of 2)
+#define PROBE_HEAD	(64 * 1024)	///< bytes of file head
+#define PROBE_ELEMENT	(256 * 1024)	///< max bytes of a tag or element
+#define PROBE_BOXES	512		///< max mp4 boxes walked
+#define PROBE_DEPTH	8		///< max nesting of mkv master elements
+
+#define PROBE_LATIN1	0		///< text encoding ISO-8859-1
+#define PROBE_UTF16	1		///< text encoding UTF-16 with BOM
+#define PROBE_UTF16BE	2		///< text encoding UTF-16 big endian
+#define PROBE_UTF8	3		///< text encoding UTF-8
+
+#define PROBE_AUDIO	1		///< track type audio
+#define PROBE_SUBTITLE	2		///< track type subtitle
+
+//////////////////////////////////////////////////////////////////////////////
+//	Typedefs
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Cached probe result.
+///
+typedef struct _probe_entry_
+{
+    int Next;				///< next entry of hash chain, -1 end
+    int Used;				///< entry is used
+    uint64_t Device;			///< device of file
+    uint64_t Inode;			///< inode of file
+    uint64_t Size;			///< size of file
+    int64_t Mtime;			///< modification time of file
+    ProbeInfo Info;			///< probed information
+} ProbeEntry;
+
+///
+///	State of a mp4 box walk.
+///
+typedef struct _probe_mp4_
+{
+    int Fd;				///< file descriptor
+    int Boxes;				///< boxes walked
+    uint32_t Handler;			///< handler type of current track
+    char Language[4];			///< language of current track
+    ProbeInfo *Info;			///< probed information
+} ProbeMp4;
+
+//////////////////////////////////////////////////////////////////////////////
+//	Variables
+//////////////////////////////////////////////////////////////////////////////
+
+static void ProbeHandle(void *, unsigned);
+
+    /// probe workers, a file already queued isn't queued again
+static WorkerPool ProbePool = {
+    .Name = "probe",
+    .Threads = PROBE_THREADS,
+    .Size = PROBE_QUEUE,
+    .Idle = 1,
+    .Handle = ProbeHandle,
+    .Same = WorkerSameFile,
+    .Mutex = PTHREAD_MUTEX_INITIALIZER,
+    .Cond = PTHREAD_COND_INITIALIZER,
+};
+
+    /// protects the cache
+static pthread_mutex_t ProbeMutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile unsigned ProbeDone;	///< number of finished probes
+
+static ProbeEntry *ProbeCache;		///< cached results
+static int ProbeBuckets[PROBE_CACHE];	///< hash chains, -1 empty
+static int ProbeVictim;			///< next entry to replace
+
+//////////////////////////////////////////////////////////////////////////////
+//	Helpers
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Read big endian 16 bit value.
+*/
+static uint32_t ProbeBe16(const uint8_t * p)
+{
+    return (p[0] << 8) | p[1];
+}
+
+/**
+**	Read big endian 32 bit value.
+*/
+static uint32_t ProbeBe32(const uint8_t * p)
+{
+    return ((uint32_t) p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+/**
+**	Read big endian 64 bit value.
+*/
+static uint64_t ProbeBe64(const uint8_t * p)
+{
+    return ((uint64_t) ProbeBe32(p) << 32) | ProbeBe32(p + 4);
+}
+
+/**
+**	Read little endian 32 bit value.
+*/
+static uint32_t ProbeLe32(const uint8_t * p)
+{
+    return ((uint32_t) p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+}
+
+/**
+**	Read little endian 64 bit value.
+*/
+static uint64_t ProbeLe64(const uint8_t * p)
+{
+    return ((uint64_t) ProbeLe32(p + 4) << 32) | ProbeLe32(p);
+}
+
+/**
+**	Read ID3v2 syncsafe 28 bit value.
+*/
+static uint32_t ProbeSyncsafe(const uint8_t * p)
+{
+    return ((p[0] & 0x7F) << 21) | ((p[1] & 0x7F) << 14) | ((p[2] & 0x7F)
+	<< 7) | (p[3] & 0x7F);
+}
+
+/**
+**	Append an unicode character as UTF-8.
+**
+**	@param dst	text buffer
+**	@param n	used bytes of text buffer
+**	@param size	size of text buffer
+**	@param c	unicode character
+**
+**	@returns new used bytes, unchanged if no space.
+*/
+static size_t ProbeUtf8(char *dst, size_t n, size_t size, unsigned c)
+{
+    if (c < 0x80 && n + 1 < size) {
+	dst[n++] = c;
+    } else if (c < 0x800 && n + 2 < size) {
+	dst[n++] = 0xC0 | (c >> 6);
+	dst[n++] = 0x80 | (c & 0x3F);
+    } else if (c >= 0x800 && n + 3 < size) {
+	dst[n++] = 0xE0 | (c >> 12);
+	dst[n++] = 0x80 | ((c >> 6) & 0x3F);
+	dst[n++] = 0x80 | (c & 0x3F);
+    }
+    return n;
+}
+
+/**
+**	Copy a tag text as UTF-8.
+**
+**	The text ends at the first NUL character, a too long text is cut
+**	at a character boundary, trailing spaces are removed.
+**
+**	@param[out] dst	text buffer
+**	@param size	size of text buffer
+**	@param src	tag text
+**	@param len	length of tag text in bytes
+**	@param encoding	#PROBE_LATIN1, #PROBE_UTF16, #PROBE_UTF16BE or
+**			#PROBE_UTF8
+*/
+static void ProbeText(char *dst, size_t size, const uint8_t * src,
+    size_t len, int encoding)
+{
+    size_t n;
+    size_t i;
+    int le;
+
+    n = 0;
+    switch (encoding) {
+	case PROBE_LATIN1:
+	    for (i = 0; i < len && src[i]; ++i) {
+		n = ProbeUtf8(dst, n, size, src[i]);
+	    }
+	    break;
+	case PROBE_UTF16:
+	case PROBE_UTF16BE:
+	    le = 0;
+	    i = 0;
+	    if (encoding == PROBE_UTF16 && len >= 2) {
+		le = src[0] == 0xFF && src[1] == 0xFE;
+		if (le || (src[0] == 0xFE && src[1] == 0xFF)) {
+		    i = 2;
+		}
+	    }
+	    for (; i + 1 < len; i += 2) {
+		unsigned c;
+
+		c = le ? (unsigned)(src[i] | (src[i + 1] << 8)) : ProbeBe16(src + i);
+		if (!c) {
+		    break;
+		}
+		if (c < 0xD800 || c > 0xDFFF) {	// surrogates are dropped
+		    n = ProbeUtf8(dst, n, size, c);
+		}
+	    }
+	    break;
+	default:
+	    for (i = 0; i < len && src[i] && n + 1 < size; ++i) {
+		dst[n++] = src[i];
+	    }
+	    if (i < len && src[i] && n) {	// cut: drop partial character
+		while (n && (dst[n - 1] & 0xC0) == 0x80) {
+		    --n;
+		}
+		if (n && dst[n - 1] & 0x80) {
+		    --n;
+		}
+	    }
+	    break;
+    }
+    while (n && dst[n - 1] == ' ') {
+	--n;
+    }
+    dst[n] = '\0';
+}
+
+/**
+**	Add a track to the track lists.
+**
+**	@param info	probed information
+**	@param type	#PROBE_AUDIO or #PROBE_SUBTITLE
+**	@param language	ISO 639-2 language code, NULL or "und" unknown
+*/
+static void ProbeTrack(ProbeInfo * info, int type, const char *language)
+{
+    char *list;
+    size_t size;
+    size_t n;
+
+    if (type == PROBE_AUDIO) {
+	info->AudioN++;
+	list = info->Audio;
+	size = sizeof(info->Audio);
+    } else {
+	info->SubtitleN++;
+	list = info->Subtitles;
+	size = sizeof(info->Subtitles);
+    }
+    if (!language || !*language || !strcmp(language, "und")) {
+	return;
+    }
+    n = strlen(list);
+    if (n + strlen(language) + 2 < size) {
+	if (n) {
+	    list[n++] = ',';
+	}
+	strcpy(list + n, language);
+    }
+}
+
+/**
+**	Parse vorbis comments for the tags.
+**
+**	@param info	probed information
+**	@param p	comment header, without packet type
+**	@param len	length of comment header
+*/
+static void ProbeVorbisComment(ProbeInfo * info, const uint8_t * p,
+    size_t len)
+{
+    const uint8_t *end;
+    uint32_t n;
+    uint32_t i;
+
+    end = p + len;
+    if (len < 8 || ProbeLe32(p) > len - 8) {	// vendor string
+	return;
+    }
+    p += 4 + ProbeLe32(p);
+    n = ProbeLe32(p);
+    p += 4;
+    for (i = 0; i < n && end - p >= 4; ++i) {
+	uint32_t l;
+
+	l = ProbeLe32(p);
+	p += 4;
+	if (l > (uint32_t) (end - p)) {
+	    break;
+	}
+	if (l > 6 && !strncasecmp((const char *)p, "TITLE=", 6)) {
+	    ProbeText(info->Title, sizeof(info->Title), p + 6, l - 6,
+		PROBE_UTF8);
+	} else if (l > 7 && !strncasecmp((const char *)p, "ARTIST=", 7)) {
+	    ProbeText(info->Artist, sizeof(info->Artist), p + 7, l - 7,
+		PROBE_UTF8);
+	} else if (l > 6 && !strncasecmp((const char *)p, "ALBUM=", 6)) {
+	    ProbeText(info->Album, sizeof(info->Album), p + 6, l - 6,
+		PROBE_UTF8);
+	}
+	p += l;
+    }
+}
+
+/**
+**	Read a range of a file into a new buffer.
+**
+**	@param fd	file descriptor
+**	@param offset	start of range
+**	@param len	length of range, max #PROBE_ELEMENT
+**
+**	@returns malloced buffer, NULL on error.
+*/
+static uint8_t *ProbeRead(int fd, off_t offset, size_t len)
+{
+    uint8_t *buf;
+
+    if (len > PROBE_ELEMENT || !(buf = malloc(len + 1))) {
+	return NULL;
+    }
+    if (pread(fd, buf, len, offset) != (ssize_t) len) {
+	free(buf);
+	return NULL;
+    }
+    return buf;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	MP4
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Parse a mp4 metadata item of the iTunes list.
+**
+**	@param mp4	state of box walk
+**	@param type	type of item box
+**	@param pos	start of item payload
+**	@param end	end of item
+*/
+static void ProbeMp4Item(ProbeMp4 * mp4, uint32_t type, off_t pos, off_t end)
+{
+    uint8_t buf[16 + 256];
+    char *dst;
+    ssize_t n;
+
+    switch (type) {
+	case 0xA96E616D:		// ©nam
+	    dst = mp4->Info->Title;
+	    break;
+	case 0xA9415254:		// ©ART
+	    dst = mp4->Info->Artist;
+	    break;
+	case 0xA9616C62:		// ©alb
+	    dst = mp4->Info->Album;
+	    break;
+	default:
+	    return;
+    }
+    // data box: size, 'data', type, locale, value
+    n = pread(mp4->Fd, buf, end - pos < (off_t) sizeof(buf) ? end - pos :
+	(off_t) sizeof(buf), pos);
+    if (n < 16 || memcmp(buf + 4, "data", 4)) {
+	return;
+    }
+    if (ProbeBe32(buf) < (uint32_t) n) {
+	n = ProbeBe32(buf);
+    }
+    if (n > 16) {
+	ProbeText(dst, sizeof(mp4->Info->Title), buf + 16, n - 16, PROBE_UTF8);
+    }
+}
+
+/**
+**	Walk mp4 boxes.
+**
+**	Container boxes are entered, the header boxes of the movie and its
+**	tracks are parsed.
+**
+**	@param mp4	state of box walk
+**	@param pos	start of boxes
+**	@param end	end of boxes
+**	@param parent	type of parent box, 0 top level
+*/
+static void ProbeMp4Boxes(ProbeMp4 * mp4, off_t pos, off_t end,
+    uint32_t parent)
+{
+    uint8_t buf[16 + 34];		// large box header, version 1 'mdhd'
+    uint64_t box;
+    uint32_t type;
+    ssize_t n;
+    int hdr;
+
+    while (pos + 8 <= end && mp4->Boxes++ < PROBE_BOXES) {
+	if ((n = pread(mp4->Fd, buf, sizeof(buf), pos)) < 8) {
+	    return;
+	}
+	hdr = 8;
+	box = ProbeBe32(buf);
+	type = ProbeBe32(buf + 4);
+	if (box == 1) {			// 64 bit large size
+	    if (n < 16) {
+		return;
+	    }
+	    box = ProbeBe64(buf + 8);
+	    hdr = 16;
+	} else if (!box) {		// up to end of parent
+	    box = end - pos;
+	}
+	if (box < (uint64_t) hdr || box > (uint64_t) (end - pos)) {
+	    return;
+	}
+	n -= hdr;
+	if ((uint64_t) n > box - hdr) {	// don't parse the next box
+	    n = box - hdr;
+	}
+
+	if (parent == 0x696C7374) {	// 'ilst' item
+	    ProbeMp4Item(mp4, type, pos + hdr, pos + box);
+	    pos += box;
+	    continue;
+	}
+	switch (type) {
+	    case 0x6D6F6F76:		// 'moov'
+		if (parent) {
+		    break;
+		}
+		// fall through
+	    case 0x6D646961:		// 'mdia'
+	    case 0x75647461:		// 'udta'
+	    case 0x696C7374:		// 'ilst'
+		ProbeMp4Boxes(mp4, pos + hdr, pos + box, type);
+		break;
+	    case 0x6D657461:		// 'meta', full box in mp4
+		ProbeMp4Boxes(mp4, pos + hdr + (n >= 8
+			&& !ProbeBe32(buf + hdr) ? 4 : 0), pos + box, type);
+		break;
+	    case 0x7472616B:		// 'trak'
+		mp4->Handler = 0;
+		strcpy(mp4->Language, "und");
+		ProbeMp4Boxes(mp4, pos + hdr, pos + box, type);
+		if (mp4->Handler == 0x736F756E) {	// 'soun'
+		    ProbeTrack(mp4->Info, PROBE_AUDIO, mp4->Language);
+		} else if (mp4->Handler == 0x7362746C	// 'sbtl'
+		    || mp4->Handler == 0x73756274	// 'subt'
+		    || mp4->Handler == 0x74657874) {	// 'text'
+		    ProbeTrack(mp4->Info, PROBE_SUBTITLE, mp4->Language);
+		}
+		break;
+	    case 0x6D766864:		// 'mvhd'
+		if (buf[hdr] == 1 && n >= 32 && ProbeBe32(buf + hdr + 20)) {
+		    mp4->Info->Duration = ProbeBe64(buf + hdr + 24)
+			/ ProbeBe32(buf + hdr + 20);
+		} else if (buf[hdr] == 0 && n >= 20
+		    && ProbeBe32(buf + hdr + 12)) {
+		    mp4->Info->Duration = ProbeBe32(buf + hdr + 16)
+			/ ProbeBe32(buf + hdr + 12);
+		}
+		break;
+	    case 0x6D646864:		// 'mdhd'
+		// packed ISO 639-2: 3 * 5 bits, offset 0x60
+		if (n >= (buf[hdr] == 1 ? 34 : 22)) {
+		    uint32_t l;
+
+		    l = ProbeBe16(buf + hdr + (buf[hdr] == 1 ? 32 : 20));
+		    mp4->Language[0] = 0x60 + ((l >> 10) & 0x1F);
+		    mp4->Language[1] = 0x60 + ((l >> 5) & 0x1F);
+		    mp4->Language[2] = 0x60 + (l & 0x1F);
+		    mp4->Language[3] = '\0';
+		}
+		break;
+	    case 0x68646C72:		// 'hdlr'
+		if (parent == 0x6D646961 && n >= 12) {
+		    mp4->Handler = ProbeBe32(buf + hdr + 8);
+		}
+		break;
+	}
+	pos += box;
+    }
+}
+
+/**
+**	Probe a mp4 or QuickTime file.
+**
+**	@param fd	file descriptor
+**	@param size	size of file
+**	@param info	probed information
+*/
+static void ProbeMp4File(int fd, off_t size, ProbeInfo * info)
+{
+    ProbeMp4 mp4;
+
+    memset(&mp4, 0, sizeof(mp4));
+    mp4.Fd = fd;
+    mp4.Info = info;
+    ProbeMp4Boxes(&mp4, 0, size, 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	MKV
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Parse ebml element header.
+**
+**	@param p	element data
+**	@param end	end of buffer
+**	@param[out] id	element id including length marker
+**	@param[out] size	element size, UINT64_MAX for unknown
+**
+**	@returns length of header, 0 on error.
+*/
+static int ProbeEbml(const uint8_t * p, const uint8_t * end, uint32_t * id,
+    uint64_t * size)
+{
+    const uint8_t *s;
+    int n;
+    int i;
+
+    s = p;
+    if (p >= end || !*p) {
+	return 0;
+    }
+    for (n = 1; !(*p & (0x80 >> (n - 1))); ++n) {
+    }
+    if (n > 4 || p + n > end) {
+	return 0;
+    }
+    *id = 0;
+    for (i = 0; i < n; ++i) {
+	*id = (*id << 8) | *p++;
+    }
+
+    if (p >= end || !*p) {
+	return 0;
+    }
+    for (n = 1; !(*p & (0x80 >> (n - 1))); ++n) {
+    }
+    if (p + n > end) {
+	return 0;
+    }
+    *size = *p & (0xFF >> n);
+    for (i = 1; i < n; ++i) {
+	*size = (*size << 8) | p[i];
+    }
+    if (*size == (1ULL << (7 * n)) - 1) {	// all ones: unknown size
+	*size = UINT64_MAX;
+    }
+    return p + n - s;
+}
+
+/**
+**	Read ebml unsigned integer.
+*/
+static uint64_t ProbeEbmlUint(const uint8_t * p, uint64_t size)
+{
+    uint64_t v;
+
+    v = 0;
+    while (size-- && size < 8) {
+	v = (v << 8) | *p++;
+    }
+    return v;
+}
+
+/**
+**	Read ebml float.
+*/
+static double ProbeEbmlFloat(const uint8_t * p, uint64_t size)
+{
+    union
+    {
+	uint32_t i;
+	float f;
+    } f32;
+    union
+    {
+	uint64_t i;
+	double f;
+    } f64;
+
+    if (size == 4) {
+	f32.i = ProbeBe32(p);
+	return f32.f;
+    }
+    if (size == 8) {
+	f64.i = ProbeBe64(p);
+	return f64.f;
+    }
+    return 0.0;
+}
+
+/**
+**	Parse the children of a mkv master element.
+**
+**	Info, Tracks and Tags are parsed, the rest is skipped.
+**
+**	@param info	probed information
+**	@param parent	id of the master element
+**	@param p	data of master element
+**	@param end	end of master element
+**	@param[in,out] scale	timecode scale
+**	@param[in,out] duration	duration in timecode scale
+**	@param depth	nesting depth of the master element
+*/
+static void ProbeMkvMaster(ProbeInfo * info, uint32_t parent,
+    const uint8_t * p, const uint8_t * end, uint64_t * scale,
+    double *duration, int depth)
+{
+    char language[8];
+    char name[16];
+    uint64_t size;
+    uint32_t id;
+    int type;
+    int n;
+
+    type = 0;
+    strcpy(language, "eng");		// default of the spec
+    name[0] = '\0';
+    while ((n = ProbeEbml(p, end, &id, &size))) {
+	p += n;
+	if (size > (uint64_t) (end - p)) {
+	    break;
+	}
+	switch (id) {
+	    case 0x1654AE6B:		// Tracks
+	    case 0xAE:			// TrackEntry
+	    case 0x1254C367:		// Tags
+	    case 0x7373:		// Tag
+	    case 0x67C8:		// SimpleTag
+		if (depth < PROBE_DEPTH) {
+		    ProbeMkvMaster(info, id, p, p + size, scale, duration,
+			depth + 1);
+		}
+		break;
+	    case 0x2AD7B1:		// TimecodeScale
+		*scale = ProbeEbmlUint(p, size);
+		break;
+	    case 0x4489:		// Duration
+		*duration = ProbeEbmlFloat(p, size);
+		break;
+	    case 0x7BA9:		// Title
+		if (!info->Title[0]) {
+		    ProbeText(info->Title, sizeof(info->Title), p, size,
+			PROBE_UTF8);
+		}
+		break;
+	    case 0x83:			// TrackType
+		type = ProbeEbmlUint(p, size);
+		break;
+	    case 0x22B59C:		// Language
+		ProbeText(language, sizeof(language), p, size, PROBE_LATIN1);
+		break;
+	    case 0x45A3:		// TagName
+		ProbeText(name, sizeof(name), p, size, PROBE_UTF8);
+		break;
+	    case 0x4487:		// TagString
+		if (!strcasecmp(name, "TITLE")) {
+		    ProbeText(info->Title, sizeof(info->Title), p, size,
+			PROBE_UTF8);
+		} else if (!strcasecmp(name, "ARTIST")) {
+		    ProbeText(info->Artist, sizeof(info->Artist), p, size,
+			PROBE_UTF8);
+		} else if (!strcasecmp(name, "ALBUM")) {
+		    ProbeText(info->Album, sizeof(info->Album), p, size,
+			PROBE_UTF8);
+		}
+		break;
+	}
+	p += size;
+    }
+    if (parent == 0xAE) {
+	if (type == 2) {
+	    ProbeTrack(info, PROBE_AUDIO, language);
+	} else if (type == 0x11) {
+	    ProbeTrack(info, PROBE_SUBTITLE, language);
+	}
+    }
+}
+
+/**
+**	Parse the positions of mkv top level elements from the seek head.
+**
+**	@param p	data of seek head
+**	@param end	end of seek head
+**	@param[out] seeks	segment positions of Info, Tracks and Tags
+*/
+static void ProbeMkvSeekHead(const uint8_t * p, const uint8_t * end,
+    uint64_t * seeks)
+{
+    const uint8_t *e;
+    uint64_t size;
+    uint32_t id;
+    int n;
+
+    for (; (n = ProbeEbml(p, end, &id, &size)); p = e) {
+	uint32_t seek_id;
+	uint64_t position;
+
+	p += n;
+	if (size > (uint64_t) (end - p)) {
+	    break;
+	}
+	e = p + size;
+	if (id != 0x4DBB) {		// Seek
+	    continue;
+	}
+	seek_id = 0;
+	position = 0;
+	while ((n = ProbeEbml(p, e, &id, &size))
+	    && size <= (uint64_t) (e - p - n)) {
+	    p += n;
+	    if (id == 0x53AB) {		// SeekID
+		seek_id = ProbeEbmlUint(p, size);
+	    } else if (id == 0x53AC) {	// SeekPosition
+		position = ProbeEbmlUint(p, size);
+	    }
+	    p += size;
+	}
+	if (seek_id == 0x1549A966) {
+	    seeks[0] = position;
+	} else if (seek_id == 0x1654AE6B) {
+	    seeks[1] = position;
+	} else if (seek_id == 0x1254C367) {
+	    seeks[2] = position;
+	}
+    }
+}
+
+/**
+**	Probe a mkv or webm file.
+**
+**	Info and Tracks are normally in the head of the segment, elements
+**	behind the head are read with the positions of the seek head.
+**
+**	@param fd	file descriptor
+**	@param buf	head of file
+**	@param len	bytes in head buffer
+**	@param info	probed information
+*/
+static void ProbeMkvFile(int fd, const uint8_t * buf, int len,
+    ProbeInfo * info)
+{
+    const uint8_t *p;
+    const uint8_t *end;
+    uint64_t seeks[3];
+    uint64_t size;
+    uint64_t scale;
+    double duration;
+    off_t segment;
+    uint32_t id;
+    int found;
+    int n;
+    int i;
+
+    p = buf;
+    end = buf + len;
+    segment = -1;
+    scale = 1000000;
+    duration = 0.0;
+    found = 0;				// bits: Info, Tracks, Tags
+    memset(seeks, 0, sizeof(seeks));
+    while ((n = ProbeEbml(p, end, &id, &size))) {
+	p += n;
+	if (id == 0x18538067) {		// Segment: enter
+	    segment = p - buf;
+	    continue;
+	}
+	if (id == 0x1F43B675 || size > (uint64_t) (end - p)) {
+	    break;			// Cluster or not in the head
+	}
+	switch (id) {
+	    case 0x1549A966:		// Info
+		found |= 1;
+		ProbeMkvMaster(info, id, p, p + size, &scale, &duration, 1);
+		break;
+	    case 0x1654AE6B:		// Tracks
+		found |= 2;
+		ProbeMkvMaster(info, id, p, p + size, &scale, &duration, 1);
+		break;
+	    case 0x1254C367:		// Tags
+		found |= 4;
+		ProbeMkvMaster(info, id, p, p + size, &scale, &duration, 1);
+		break;
+	    case 0x114D9B74:		// SeekHead
+		ProbeMkvSeekHead(p, p + size, seeks);
+		break;
+	}
+	p += size;
+    }
+
+    // elements behind the head
+    for (i = 0; segment >= 0 && i < 3; ++i) {
+	uint8_t hdr[12];
+	uint8_t *data;
+
+	if ((found & (1 << i)) || !seeks[i]
+	    || pread(fd, hdr, sizeof(hdr),
+		segment + seeks[i]) != sizeof(hdr)
+	    || !(n = ProbeEbml(hdr, hdr + sizeof(hdr), &id, &size))
+	    || size > PROBE_ELEMENT) {
+	    continue;
+	}
+	if ((data = ProbeRead(fd, segment + seeks[i] + n, size))) {
+	    ProbeMkvMaster(info, id, data, data + size, &scale, &duration,
+		1);
+	    free(data);
+	}
+    }
+    if (duration > 0.0) {
+	info->Duration = duration * scale / 1000000000.0;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Audio
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Parse ID3v2 tag frames.
+**
+**	@param info	probed information
+**	@param tag	tag without header
+**	@param len	length of tag
+**	@param version	major version 2, 3 or 4
+*/
+static void ProbeId3v2(ProbeInfo * info, const uint8_t * tag, size_t len,
+    int version)
+{
+    const uint8_t *p;
+    const uint8_t *end;
+
+    p = tag;
+    end = tag + len;
+    while (end - p >= (version == 2 ? 6 : 10) && *p) {
+	char *dst;
+	uint32_t size;
+	int hdr;
+
+	if (version == 2) {
+	    hdr = 6;
+	    size = (p[3] << 16) | (p[4] << 8) | p[5];
+	} else {
+	    hdr = 10;
+	    size = version == 4 ? ProbeSyncsafe(p + 4) : ProbeBe32(p + 4);
+	}
+	if (size > (size_t) (end - p - hdr)) {
+	    break;
+	}
+	dst = NULL;
+	if (!memcmp(p, version == 2 ? "TT2" : "TIT2", hdr == 6 ? 3 : 4)) {
+	    dst = info->Title;
+	} else if (!memcmp(p, version == 2 ? "TP1" : "TPE1",
+		hdr == 6 ? 3 : 4)) {
+	    dst = info->Artist;
+	} else if (!memcmp(p, version == 2 ? "TAL" : "TALB",
+		hdr == 6 ? 3 : 4)) {
+	    dst = info->Album;
+	}
+	if (dst && size > 1) {		// encoding byte, text
+	    ProbeText(dst, sizeof(info->Title), p + hdr + 1, size - 1,
+		p[hdr]);
+	}
+	p += hdr + size;
+    }
+}
+
+/**
+**	Calculate duration of a mp3 file.
+**
+**	Uses the frame count of a Xing/Info or VBRI header, else the
+**	bitrate of the first frame.
+**
+**	@param fd	file descriptor
+**	@param start	start of audio frames
+**	@param size	size of audio frames
+**	@param info	probed information
+*/
+static void ProbeMp3Duration(int fd, off_t start, off_t size,
+    ProbeInfo * info)
+{
+    static const uint16_t bitrates[2][3][15] = {
+	{			// MPEG 1: layer 1, 2, 3
+	    {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416,
+		448},
+	    {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320,
+		384},
+	    {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256,
+		320}},
+	{			// MPEG 2/2.5: layer 1, 2, 3
+	    {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224,
+		256},
+	    {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+	    {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}}
+    };
+    static const uint16_t rates[3] = { 44100, 48000, 32000 };
+    uint8_t buf[4096];
+    const uint8_t *p;
+    uint32_t frames;
+    int version;			// 0 MPEG 1, 1 MPEG 2, 2 MPEG 2.5
+    int layer;				// 0 layer 1 .. 2 layer 3
+    int bitrate;
+    int rate;
+    int samples;
+    int side;
+    ssize_t n;
+
+    if ((n = pread(fd, buf, sizeof(buf), start)) < 4) {
+	return;
+    }
+    // first frame sync
+    for (p = buf; p + 4 <= buf + n; ++p) {
+	if (p[0] == 0xFF && (p[1] & 0xE0) == 0xE0 && (p[1] & 0x18) != 0x08
+	    && (p[1] & 0x06) && (p[2] & 0xF0) != 0xF0
+	    && (p[2] & 0x0C) != 0x0C) {
+	    break;
+	}
+    }
+    if (p + 4 > buf + n) {
+	return;
+    }
+    version = (p[1] & 0x18) == 0x18 ? 0 : (p[1] & 0x18) == 0x10 ? 1 : 2;
+    layer = 3 - ((p[1] >> 1) & 3);
+    bitrate = bitrates[version != 0][layer][p[2] >> 4];
+    rate = rates[(p[2] >> 2) & 3] >> version;
+    samples = layer == 0 ? 384 : layer == 1 || !version ? 1152 : 576;
+    // side information before Xing header
+    if (!version) {
+	side = (p[3] & 0xC0) == 0xC0 ? 17 : 32;
+    } else {
+	side = (p[3] & 0xC0) == 0xC0 ? 9 : 17;
+    }
+
+    frames = 0;
+    if (p + 4 + side + 12 <= buf + n && (!memcmp(p + 4 + side, "Xing", 4)
+	    || !memcmp(p + 4 + side, "Info", 4))
+	&& (ProbeBe32(p + 8 + side) & 1)) {
+	frames = ProbeBe32(p + 12 + side);
+    } else if (p + 36 + 18 <= buf + n && !memcmp(p + 36, "VBRI", 4)) {
+	frames = ProbeBe32(p + 36 + 14);
+    }
+    if (frames) {
+	info->Duration = (uint64_t) frames *samples / rate;
+    } else if (bitrate) {
+	info->Duration = (size - (p - buf)) * 8 / (bitrate * 1000);
+    }
+}
+
+/**
+**	Probe a mp3 file.
+**
+**	Tags of an ID3v2 tag at the start, else of an ID3v1 tag at the end.
+**
+**	@param fd	file descriptor
+**	@param buf	head of file
+**	@param len	bytes in head buffer
+**	@param size	size of file
+**	@param info	probed information
+*/
+static void ProbeMp3File(int fd, const uint8_t * buf, int len, off_t size,
+    ProbeInfo * info)
+{
+    uint8_t v1[128];
+    off_t start;
+    off_t end;
+
+    start = 0;
+    end = size;
+    if (len >= 10 && !memcmp(buf, "ID3", 3) && buf[3] >= 2 && buf[3] <= 4) {
+	uint8_t *tag;
+	uint32_t tag_size;
+	uint32_t skip;
+	uint32_t n;
+
+	tag_size = ProbeSyncsafe(buf + 6);
+	start = 10 + tag_size + (buf[5] & 0x10 ? 10 : 0);
+	skip = 0;
+	if (buf[5] & 0x40 && buf[3] >= 3 && len >= 14) {	// extended header
+	    skip = buf[3] == 4 ? ProbeSyncsafe(buf + 10) : ProbeBe32(buf + 10)
+		+ 4;
+	}
+	// big tags (cover art): the frames in the first bytes are parsed
+	n = tag_size - skip < PROBE_ELEMENT ? tag_size - skip : PROBE_ELEMENT;
+	if (!(buf[5] & 0x80) && skip < tag_size
+	    && (tag = ProbeRead(fd, 10 + skip, n))) {
+	    ProbeId3v2(info, tag, n, buf[3]);
+	    free(tag);
+	}
+    }
+    if (size >= 128 && pread(fd, v1, sizeof(v1), size - 128) == 128
+	&& !memcmp(v1, "TAG", 3)) {
+	end -= 128;
+	if (!info->Title[0]) {
+	    ProbeText(info->Title, sizeof(info->Title), v1 + 3, 30,
+		PROBE_LATIN1);
+	    ProbeText(info->Artist, sizeof(info->Artist), v1 + 33, 30,
+		PROBE_LATIN1);
+	    ProbeText(info->Album, sizeof(info->Album), v1 + 63, 30,
+		PROBE_LATIN1);
+	}
+    }
+    if (start < end) {
+	ProbeMp3Duration(fd, start, end - start, info);
+    }
+    ProbeTrack(info, PROBE_AUDIO, NULL);
+}
+
+/**
+**	Probe a flac file.
+**
+**	@param fd	file descriptor
+**	@param info	probed information
+*/
+static void ProbeFlacFile(int fd, ProbeInfo * info)
+{
+    uint8_t hdr[4 + 18];
+    off_t pos;
+    int last;
+    int i;
+
+    pos = 4;				// "fLaC"
+    last = 0;
+    for (i = 0; i < 64 && !last; ++i) {
+	uint32_t len;
+	uint8_t *data;
+
+	if (pread(fd, hdr, sizeof(hdr), pos) < 4) {
+	    break;
+	}
+	last = hdr[0] & 0x80;
+	len = (hdr[1] << 16) | (hdr[2] << 8) | hdr[3];
+	if ((hdr[0] & 0x7F) == 0 && len >= 18) {	// STREAMINFO
+	    const uint8_t *s;
+	    uint32_t rate;
+	    uint64_t samples;
+
+	    s = hdr + 4;
+	    rate = (s[10] << 12) | (s[11] << 4) | (s[12] >> 4);
+	    samples = ((uint64_t) (s[13] & 0x0F) << 32) | ProbeBe32(s + 14);
+	    if (rate && samples) {
+		info->Duration = samples / rate;
+	    }
+	} else if ((hdr[0] & 0x7F) == 4	// VORBIS_COMMENT
+	    && (data = ProbeRead(fd, pos + 4, len))) {
+	    ProbeVorbisComment(info, data, len);
+	    free(data);
+	}
+	pos += 4 + len;
+    }
+    ProbeTrack(info, PROBE_AUDIO, NULL);
+}
+
+/**
+**	Probe an ogg vorbis or opus file.
+**
+**	The duration is the granule position of the last page.
+**
+**	@param fd	file descriptor
+**	@param buf	head of file
+**	@param len	bytes in head buffer
+**	@param size	size of file
+**	@param info	probed information
+*/
+static void ProbeOggFile(int fd, const uint8_t * buf, int len, off_t size,
+    ProbeInfo * info)
+{
+    const uint8_t *p;
+    uint8_t *tail;
+    uint64_t skip;
+    uint32_t rate;
+    off_t pos;
+    ssize_t n;
+
+    rate = 0;
+    skip = 0;
+    for (p = buf; p + 16 <= buf + len; ++p) {
+	if (!memcmp(p, "\001vorbis", 7)) {
+	    rate = ProbeLe32(p + 12);
+	} else if (!memcmp(p, "OpusHead", 8) && p + 12 <= buf + len) {
+	    rate = 48000;		// granule is always 48 kHz
+	    skip = p[10] | (p[11] << 8);
+	} else if (!memcmp(p, "\003vorbis", 7)) {
+	    ProbeVorbisComment(info, p + 7, buf + len - p - 7);
+	    break;
+	} else if (!memcmp(p, "OpusTags", 8)) {
+	    ProbeVorbisComment(info, p + 8, buf + len - p - 8);
+	    break;
+	}
+    }
+    if (!rate) {			// no audio, maybe theora
+	return;
+    }
+    ProbeTrack(info, PROBE_AUDIO, NULL);
+
+    pos = size > PROBE_HEAD ? size - PROBE_HEAD : 0;
+    if (!(tail = ProbeRead(fd, pos, size - pos))) {
+	return;
+    }
+    n = size - pos;
+    for (p = tail + n - 27; p >= tail; --p) {	// last page
+	if (!memcmp(p, "OggS", 4)) {
+	    uint64_t granule;
+
+	    granule = ProbeLe64(p + 6);
+	    if (granule != UINT64_MAX && granule > skip) {
+		info->Duration = (granule - skip) / rate;
+	    }
+	    break;
+	}
+    }
+    free(tail);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Cache
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Find cached result of a file.  Called with #ProbeMutex locked.
+**
+**	@param st	file status
+**
+**	@returns cache entry, NULL if not cached.
+*/
+static ProbeEntry *ProbeFind(const struct stat *st)
+{
+    int i;
+
+    if (!ProbeCache) {
+	return NULL;
+    }
+    for (i = ProbeBuckets[WorkerFileHash(st) & (PROBE_CACHE - 1)]; i >= 0;
+	i = ProbeCache[i].Next) {
+	ProbeEntry *entry;
+
+	entry = ProbeCache + i;
+	if (entry->Inode == (uint64_t) st->st_ino
+	    && entry->Device == (uint64_t) st->st_dev
+	    && entry->Size == (uint64_t) st->st_size
+	    && entry->Mtime == st->st_mtime) {
+	    return entry;
+	}
+    }
+    return NULL;
+}
+
+/**
+**	Store result of a file, the oldest result is replaced.
+**
+**	@param st	file status
+**	@param info	probed information
+*/
+static void ProbeStore(const struct stat *st, const ProbeInfo * info)
+{
+    ProbeEntry *entry;
+    int *link;
+    int i;
+
+    pthread_mutex_lock(&ProbeMutex);
+    if (!ProbeCache) {
+	if (!(ProbeCache = calloc(PROBE_CACHE, sizeof(*ProbeCache)))) {
+	    pthread_mutex_unlock(&ProbeMutex);
+	    return;
+	}
+	memset(ProbeBuckets, 0xFF, sizeof(ProbeBuckets));
+    }
+    if (!(entry = ProbeFind(st))) {
+	i = ProbeVictim;
+	ProbeVictim = (ProbeVictim + 1) % PROBE_CACHE;
+	entry = ProbeCache + i;
+	if (entry->Used) {		// unlink the replaced entry
+	    struct stat old;
+
+	    old.st_ino = entry->Inode;
+	    old.st_dev = entry->Device;
+	    old.st_size = entry->Size;
+	    old.st_mtime = entry->Mtime;
+	    for (link = ProbeBuckets + (WorkerFileHash(&old)
+		    & (PROBE_CACHE - 1)); *link != i;
+		link = &ProbeCache[*link].Next) {
+	    }
+	    *link = entry->Next;
+	}
+	link = ProbeBuckets + (WorkerFileHash(st) & (PROBE_CACHE - 1));
+	entry->Next = *link;
+	*link = i;
+	entry->Used = 1;
+	entry->Inode = st->st_ino;
+	entry->Device = st->st_dev;
+	entry->Size = st->st_size;
+	entry->Mtime = st->st_mtime;
+    }
+    entry->Info = *info;
+    ++ProbeDone;
+    pthread_mutex_unlock(&ProbeMutex);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Thread
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Probe a media file and cache the result.
+**
+**	The container is detected by its content.  Files without known
+**	container are cached too, with unknown duration.
+**
+**	@param request	path and name of file
+**	@param generation	cancel generation of the request (unused)
+*/
+static void ProbeHandle(void *request, unsigned generation)
+{
+    const char *filename;
+    uint8_t buf[PROBE_HEAD];
+    ProbeInfo info;
+    struct stat st;
+    int found;
+    int fd;
+    int n;
+
+    (void)generation;
+    filename = request;
+    if ((fd = open(filename, O_RDONLY | O_CLOEXEC)) < 0) {
+	return;
+    }
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+	close(fd);
+	return;
+    }
+    pthread_mutex_lock(&ProbeMutex);
+    found = ProbeFind(&st) != NULL;
+    pthread_mutex_unlock(&ProbeMutex);
+    if (found || (n = pread(fd, buf, sizeof(buf), 0)) < 16) {
+	close(fd);
+	return;
+    }
+
+    memset(&info, 0, sizeof(info));
+    info.Duration = -1;
+    if (!memcmp(buf + 4, "ftyp", 4) || !memcmp(buf + 4, "moov", 4)
+	|| !memcmp(buf + 4, "mdat", 4) || !memcmp(buf + 4, "wide", 4)) {
+	ProbeMp4File(fd, st.st_size, &info);
+    } else if (ProbeBe32(buf) == 0x1A45DFA3) {
+	ProbeMkvFile(fd, buf, n, &info);
+    } else if (!memcmp(buf, "fLaC", 4)) {
+	ProbeFlacFile(fd, &info);
+    } else if (!memcmp(buf, "OggS", 4)) {
+	ProbeOggFile(fd, buf, n, st.st_size, &info);
+    } else if (!memcmp(buf, "ID3", 3) || (buf[0] == 0xFF
+	    && (buf[1] & 0xE0) == 0xE0)) {
+	ProbeMp3File(fd, buf, n, st.st_size, &info);
+    }
+    close(fd);
+
+    Debug(3, "probe: %d s '%s' '%s' audio %d subtitles %d '%s'\n",
+	info.Duration, info.Title, info.Artist, info.AudioN, info.SubtitleN,
+	filename);
+    ProbeStore(&st, &info);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Functions
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Queue probe of a media file.
+**
+**	If the queue is full, the oldest request is dropped.  A file
+**	already queued isn't queued again.
+**
+**	@param filename	path and name of file
+*/
+void ProbeFile(const char *filename)
+{
+    WorkerQueueFile(&ProbePool, filename);
+}
+
+/**
+**	Lookup probed information of a media file.
+**
+**	@param filename	path and name of file
+**	@param[out] info	probed information
+**
+**	@returns true if the file is probed.
+*/
+int ProbeLookup(const char *filename, ProbeInfo * info)
+{
+    const ProbeEntry *entry;
+    struct stat st;
+
+    if (stat(filename, &st) < 0) {
+	return 0;
+    }
+    pthread_mutex_lock(&ProbeMutex);
+    if ((entry = ProbeFind(&st))) {
+	*info = entry->Info;
+    }
+    pthread_mutex_unlock(&ProbeMutex);
+
+    return entry != NULL;
+}
+
+/**
+**	Get number of finished probes.
+**
+**	A change tells, that new results can be looked up.
+*/
+unsigned ProbeChanges(void)
+{
+    return ProbeDone;
+}
+
+/**
+**	Cancel all queued probes.
+*/
+void ProbeCancel(void)
+{
+    WorkerCancel(&ProbePool);
+}
+
+/**
+**	Stop probe threads and free the cache.
+*/
+void ProbeExit(void)
+{
+    WorkerExit(&ProbePool);
+
+    free(ProbeCache);
+    ProbeCache = NULL;
+    ProbeVictim = 0;
+}
@@ -0,0 +1,51 @@
+///
+///	@file probe.h		@brief media file probe module header file
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Probed media file information.
+///
+typedef struct _probe_info_
+{
+    int Duration;			///< duration in seconds, -1 unknown
+    int AudioN;				///< number of audio tracks
+    int SubtitleN;			///< number of subtitle tracks
+    char Title[64];			///< title tag, UTF-8
+    char Artist[64];			///< artist tag, UTF-8
+    char Album[64];			///< album tag, UTF-8
+    char Audio[32];			///< languages of audio tracks
+    char Subtitles[32];			///< languages of subtitle tracks
+} ProbeInfo;
+
+    /// queue probe of a media file
+extern void ProbeFile(const char *);
+
+    /// lookup probed information of a media file
+extern int ProbeLookup(const char *, ProbeInfo *);
+
+    /// number of finished probes
+extern unsigned ProbeChanges(void);
+
+    /// cancel all queued probes
+extern void ProbeCancel(void);
+
+    /// stop probe threads and free the cache
+extern void ProbeExit(void);
@@ -36,8 +36,11 @@
 #include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
+#include <fcntl.h>
 
 #include <dirent.h>
+#include <pthread.h>
 
 #include <libintl.h>
 #define _(str) gettext(str)		///< gettext shortcut
@@ -49,7 +52,7 @@
 #ifdef USE_AVFS
 #include <virtual.h>
 #else
-#define virt_stat	stat		///< universal stat
+#define virt_stat	ArchiveStat	///< universal stat, archive members too
 #define virt_fstat	fstat		///< universal fstat
 #define virt_opendir	opendir		///< universal opendir
 #define virt_readdir	readdir		///< universal readdir
@@ -58,15 +61,210 @@
 
 #include "misc.h"
 #include "readdir.h"
+#include "archive.h"
 
 //////////////////////////////////////////////////////////////////////////////
 //	Variables
 //////////////////////////////////////////////////////////////////////////////
 
 const char ConfigShowHiddenFiles = 0;	///< config show hidden files
-static const char *BaseDir;		///< current directory
-static int BaseDirLen;			///< length of current directory name
-static const NameFilter *NameFilters;	///< current name filter table
+
+//////////////////////////////////////////////////////////////////////////////
+//	Name filter matcher
+//////////////////////////////////////////////////////////////////////////////
+
+#define MATCH_CHARS	38		///< a-z, 0-9, '.' and invalid
+
+///
+///	Compiled name filter table.
+///
+///	The suffixes are stored reversed and case folded in a trie, a name
+///	is matched with one walk from its end.
+///
+typedef struct _name_matcher_
+{
+    struct _name_matcher_ *Next;	///< next compiled table
+    const NameFilter *Filter;		///< name filter table
+    unsigned short (*Child)[MATCH_CHARS];	///< child node of each char
+    unsigned char *Type;		///< media type of suffix ending in node
+} NameMatcher;
+
+static NameMatcher *NameMatchers;	///< compiled name filter tables
+static pthread_mutex_t NameMatcherMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+**	Map a suffix char to its trie index.
+**
+**	@param c	character
+**
+**	@returns index of case folded char, 0 if it can't be in a suffix.
+*/
+static int MatchChar(int c)
+{
+    if (c >= 'a' && c <= 'z') {
+	return c - 'a' + 1;
+    }
+    if (c >= 'A' && c <= 'Z') {
+	return c - 'A' + 1;
+    }
+    if (c >= '0' && c <= '9') {
+	return c - '0' + 27;
+    }
+    if (c == '.') {
+	return 37;
+    }
+    return 0;
+}
+
+/**
+**	Compile a name filter table into a reversed suffix trie.
+**
+**	@param filter	list of name suffix filters
+**
+**	@returns compiled table, NULL if out of memory.
+*/
+static NameMatcher *NameMatcherCompile(const NameFilter * filter)
+{
+    NameMatcher *matcher;
+    int nodes;
+    int used;
+    int i;
+    int j;
+
+    nodes = 1;
+    for (i = 0; filter[i].String; ++i) {
+	nodes += filter[i].Length;
+    }
+    if (nodes > 65535) {
+	Error("play/readdir: name filter table too big\n");
+	return NULL;
+    }
+    // one allocation: matcher, child table, types
+    if (!(matcher = calloc(1, sizeof(*matcher)
+		+ nodes * sizeof(*matcher->Child) + nodes))) {
+	return NULL;
+    }
+    matcher->Filter = filter;
+    matcher->Child = (unsigned short (*)[MATCH_CHARS])(matcher + 1);
+    matcher->Type = (unsigned char *)(matcher->Child + nodes);
+
+    used = 1;				// node 0 is the root
+    for (i = 0; filter[i].String; ++i) {
+	int node;
+
+	node = 0;
+	for (j = filter[i].Length - 1; j >= 0; --j) {
+	    int c;
+
+	    if (!(c = MatchChar(filter[i].String[j]))) {
+		Error("play/readdir: unsupported name filter '%s'\n",
+		    filter[i].String);
+		break;
+	    }
+	    if (!matcher->Child[node][c]) {
+		matcher->Child[node][c] = used++;
+	    }
+	    node = matcher->Child[node][c];
+	}
+	if (j < 0 && node) {
+	    matcher->Type[node] =
+		filter[i].Type ? filter[i].Type : MEDIA_OTHER;
+	}
+    }
+
+    return matcher;
+}
+
+/**
+**	Get the compiled name filter table, compile it on first use.
+**
+**	@param filter	list of name suffix filters
+**
+**	@returns compiled table, NULL if out of memory.
+*/
+static const NameMatcher *NameMatcherGet(const NameFilter * filter)
+{
+    NameMatcher *matcher;
+
+    pthread_mutex_lock(&NameMatcherMutex);
+    for (matcher = NameMatchers; matcher; matcher = matcher->Next) {
+	if (matcher->Filter == filter) {
+	    break;
+	}
+    }
+    if (!matcher && (matcher = NameMatcherCompile(filter))) {
+	matcher->Next = NameMatchers;
+	NameMatchers = matcher;
+    }
+    pthread_mutex_unlock(&NameMatcherMutex);
+
+    return matcher;
+}
+
+/**
+**	Match a name with a compiled name filter table.
+**
+**	The longest matching suffix wins, ".tar.gz" before ".gz".
+**
+**	@param matcher	compiled name filter table
+**	@param name	file name
+**	@param len	length of file name
+**
+**	@returns media type of matching suffix, 0 if none matches.
+*/
+static int NameMatcherMatch(const NameMatcher * matcher, const char *name,
+    int len)
+{
+    int node;
+    int type;
+    int c;
+
+    node = 0;
+    type = 0;
+    while (len-- > 0) {
+	if (!(c = MatchChar(name[len]))
+	    || !(node = matcher->Child[node][c])) {
+	    break;
+	}
+	if (matcher->Type[node]) {
+	    type = matcher->Type[node];
+	}
+    }
+    return type;
+}
+
+/**
+**	Match a name with a name filter table.
+**
+**	@param filter	list of name suffix filters
+**	@param name	path and file name
+**
+**	@returns media type of matching suffix, 0 if none matches.
+*/
+int NameFilterMatch(const NameFilter * filter, const char *name)
+{
+    const NameMatcher *matcher;
+
+    if (!(matcher = NameMatcherGet(filter))) {
+	return 0;
+    }
+    return NameMatcherMatch(matcher, name, strlen(name));
+}
+
+/**
+**	Free the compiled name filter tables.
+*/
+void NameFilterExit(void)
+{
+    NameMatcher *matcher;
+
+    pthread_mutex_lock(&NameMatcherMutex);
+    while ((matcher = NameMatchers)) {
+	NameMatchers = matcher->Next;
+	free(matcher);
+    }
+    pthread_mutex_unlock(&NameMatcherMutex);
+}
 
 //////////////////////////////////////////////////////////////////////////////
 //	Functions
@@ -102,13 +300,11 @@ int IsDirectory(const char *filename)
 */
 int IsArchive(const char *filename)
 {
-#ifdef USE_AVFS
-
     /**
     **	Table of supported archive suffixes.
     */
     static const NameFilter ArchiveFilters[] = {
-#define FILTER(x) { sizeof(x) - 1, x }
+#define FILTER(x) { sizeof(x) - 1, x, MEDIA_ARCHIVE }
 	FILTER(".cbz"),
 	FILTER(".cbr"),
 	FILTER(".zip"),
@@ -117,37 +313,153 @@ int IsArchive(const char *filename)
 	FILTER(".tar.gz"),
 	FILTER(".tgz"),
 #undef FILTER
-	{0, NULL}
+	{0, NULL, 0}
     };
-    int i;
-    int len;
 
-    len = strlen(filename);
-    for (i = 0; ArchiveFilters[i].String; ++i) {
-	if (len >= ArchiveFilters[i].Length
-	    && !strcasecmp(filename + len - ArchiveFilters[i].Length,
-		ArchiveFilters[i].String)) {
-	    return 1;
-	}
+    return NameFilterMatch(ArchiveFilters, filename) == MEDIA_ARCHIVE;
+}
+
+#define SCAN_DIRS	1		///< scan for directories
+#define SCAN_FILES	2		///< scan for matching files
+#define SCAN_RESOLVE	4		///< entry type needs a stat
+
+#define RESOLVE_THREADS	8		///< max threads resolving entry types
+#define RESOLVE_BATCH	16		///< entries per resolve thread
+#define RESOLVE_CHUNK	256		///< entries resolved and published at once
+
+#define SORT_INSERTION	16		///< insertion sort of smaller buckets
+#define SORT_PARALLEL	32768		///< threads sort bigger lists
+#define SORT_THREADS	4		///< max additional sort threads
+
+///
+///	Directory entry, whose type must be resolved.
+///
+typedef struct _resolve_entry_
+{
+    int Match;				///< name matches the name filter
+    int Dir;				///< result: <0 error, 0 no dir, 1 dir
+} ResolveEntry;
+
+///
+///	Batch of entries resolved by a thread pool.
+///
+typedef struct _resolve_batch_
+{
+    int Fd;				///< directory file descriptor
+    const struct _name_list_ *Names;	///< names of entries
+    ResolveEntry *Entries;		///< entries to resolve
+    int Count;				///< number of entries
+    int Next;				///< next entry to resolve
+} ResolveBatch;
+
+///
+///	Growing list of names.
+///
+///	The names are stored one after another in a single string block,
+///	addressed by offsets, which stay valid when the block grows.
+///
+typedef struct _name_list_
+{
+    char *Block;			///< string block of all names
+    int Used;				///< used bytes of string block
+    int BlockSize;			///< allocated bytes of string block
+    int *Offsets;			///< offset of each name in block
+    int Count;				///< number of names in list
+    int Size;				///< allocated size of offsets
+} NameList;
+
+///
+///	Name with its precomputed sort key.
+///
+typedef struct _sort_item_
+{
+    const unsigned char *Key;		///< natural sort key
+    int Offset;				///< name offset in string block
+} SortItem;
+
+///
+///	Buckets of the first key byte, sorted by a thread pool.
+///
+typedef struct _sort_job_
+{
+    SortItem *Items;			///< items, distributed in buckets
+    SortItem *Tmp;			///< temporary space of items
+    const char *Block;			///< string block of the names
+    int Bucket[257];			///< start of each bucket, end last
+    int Next;				///< next bucket to sort
+} SortJob;
+
+///
+///	Directory scan context.
+///
+///	Holds all state of one scan, any number of scans can run at once.
+///	Names are published under the mutex, while the scan runs.
+///
+struct _scan_context_
+{
+    char *Name;				///< directory path and name
+    const NameFilter *Filter;		///< name filter of files
+    const NameMatcher *Matcher;		///< compiled name filter of files
+    int Flags;				///< wanted kinds
+    struct timespec Mtime;		///< directory mtime at scan start
+
+    NameList ResolveNames;		///< names of entries to resolve
+    ResolveEntry *Resolve;		///< entries to resolve
+    int ResolveN;			///< number of entries to resolve
+    int ResolveSize;			///< allocated entries to resolve
+
+    pthread_mutex_t Mutex;		///< protects names and state below
+    pthread_cond_t Cond;		///< signals scan done
+    NameList Dirs;			///< directory names
+    NameList Files;			///< matching file names
+    int DirsFetched;			///< directories fetched by reader
+    int FilesFetched;			///< files fetched by reader
+    int Done;				///< scan finished, names are sorted
+    int Error;				///< errno of failed scan
+
+    volatile int Cancel;		///< stop the scan
+    int Threaded;			///< scan runs in its own thread
+    pthread_t Thread;			///< background scan thread
+};
+
+/**
+**	Check if name matches the name filter table.
+**
+**	@param matcher	compiled name filter table
+**	@param name	file name
+**	@param len	length of file name
+**
+**	@returns true if the name matches, or there is no filter.
+*/
+static int FilterMatch(const NameMatcher * matcher, const char *name,
+    int len)
+{
+    if (!matcher) {
+	return 1;
     }
-#else
-    (void)filename;
-#endif
-    return 0;
+    return NameMatcherMatch(matcher, name, len) != 0;
 }
 
 /**
-**	Filter for scandir, only directories.
+**	Classify directory entry.
 **
+**	Symbolic links and entries of filesystems without d_type must be
+**	resolved by a stat, which is done later for all of them in a batch.
+**
+**	@param matcher	compiled name filter table
 **	@param dirent	current directory entry
+**	@param flags	wanted kinds #SCAN_DIRS, #SCAN_FILES
 **
-**	@returns true if the @p dirent is a directories.
+**	@returns #SCAN_DIRS for a directory, #SCAN_FILES for a matching file,
+**	#SCAN_RESOLVE (or'ed with #SCAN_FILES, if the name matches) for an
+**	entry to resolve, 0 to skip the @p dirent.
 */
-static int FilterIsDirectory(const struct dirent *dirent)
+static int FilterEntry(const NameMatcher * matcher,
+    const struct dirent *dirent, int flags)
 {
-    char *tmp;
-    int dir;
-    size_t len;
+    int match;
+    int len;
+    int type;
 
     len = _D_EXACT_NAMLEN(dirent);
     if (len && dirent->d_name[0] == '.') {
@@ -160,242 +472,1379 @@ static int FilterIsDirectory(const struct dirent *dirent)
 	    return 0;
 	}
     }
+    // look through name filter table, before any stat
+    match = (flags & SCAN_FILES) && FilterMatch(matcher, dirent->d_name, len);
+    if (!match && !(flags & SCAN_DIRS)) {
+	return 0;
+    }
 #ifdef _DIRENT_HAVE_D_TYPE
-    if (dirent->d_type == DT_DIR) {	// only directories files
-	return 1;
-#ifdef DT_LNK
-    } else if (dirent->d_type == DT_LNK) {	// symbolic link
+    type = dirent->d_type;
+#else
+    type = DT_UNKNOWN;
 #endif
-    } else if (dirent->d_type != DT_UNKNOWN) {	// no looser filesystem
-	return 0;
+    if (type == DT_DIR) {
+	return flags & SCAN_DIRS;
     }
+    if (type == DT_REG) {
+	return match ? SCAN_FILES : 0;
+    }
+#ifdef DT_LNK
+    if (type != DT_LNK && type != DT_UNKNOWN) {
+#else
+    if (type != DT_UNKNOWN) {
 #endif
-
+	return 0;			// no looser filesystem
+    }
     // DT_UNKOWN or DT_LNK
-    tmp = malloc(BaseDirLen + len + 1);
-    stpcpy(stpcpy(tmp, BaseDir), dirent->d_name);
-    dir = IsDirectory(tmp);
-    free(tmp);
-    return dir;
+    return SCAN_RESOLVE | (match ? SCAN_FILES : 0);
 }
 
 /**
-**	Filter for scandir, only files.
+**	Check if directory entry is a directory.
 **
-**	@param dirent	current directory entry
+**	Only the type is requested, relative to the directory, without
+**	building a path.
 **
-**	@returns true if the @p dirent is a video.
+**	@param fd	directory file descriptor
+**	@param name	entry name
+**
+**	@retval <0	error, dangling link
+**	@retval	true	directory
+**	@retval false	no directory
 */
-static int FilterIsFile(const struct dirent *dirent)
+static int ResolveIsDirectory(int fd, const char *name)
 {
-    char *tmp;
-    int dir;
-    int len;
-    int i;
+    struct stat stat_buf;
 
-    len = _D_EXACT_NAMLEN(dirent);
-    if (len && dirent->d_name[0] == '.') {
-	if (!ConfigShowHiddenFiles) {	// hide hidden files
-	    return 0;
-	}
+#ifdef STATX_TYPE
+    struct statx statx_buf;
+
+    if (!statx(fd, name, AT_STATX_SYNC_AS_STAT, STATX_TYPE, &statx_buf)) {
+	return S_ISDIR(statx_buf.stx_mode);
     }
-    // look through name filter table
-    if (NameFilters) {
-	for (i = 0; NameFilters[i].String; ++i) {
-	    if (len >= NameFilters[i].Length
-		&& !strcasecmp(dirent->d_name + len - NameFilters[i].Length,
-		    NameFilters[i].String)) {
-		goto found;
-	    }
-	}
-	// no file name matched
-	return 0;
+    if (errno != ENOSYS) {
+	return -1;
     }
-  found:
-
-#ifdef _DIRENT_HAVE_D_TYPE
-    if (dirent->d_type == DT_REG) {	// only regular files
-	return 1;
-#ifdef DT_LNK
-    } else if (dirent->d_type == DT_LNK) {	// symbolic link
 #endif
-    } else if (dirent->d_type != DT_UNKNOWN) {	// no looser filesystem
-	return 0;
+    if (fstatat(fd, name, &stat_buf, 0) < 0) {
+	return -1;
     }
-#endif
-
-    // DT_UNKOWN or DT_LNK
-    tmp = malloc(BaseDirLen + len + 1);
-    stpcpy(stpcpy(tmp, BaseDir), dirent->d_name);
-    dir = IsDirectory(tmp);
-    free(tmp);
-    return !dir;
+    return S_ISDIR(stat_buf.st_mode);
 }
 
 /**
-**	ScanDirectory qsort compare function.
-**
-**	@param s1	table index 1
-**	@param s2	table index 2
+**	Resolve thread, takes entries until the batch is done.
 **
-**	@returns an integer less than, equal to, or greater than zero if s1
-**	is found, respectively, to be less than, to match, or be greater
-**	than s2.
+**	@param opaque	resolve batch
 */
-static int q_cmp(const void *s1, const void *s2)
+static void *ResolveThread(void *opaque)
 {
-    return strcmp(*(char *const *)s1, *(char *const *)s2);
+    ResolveBatch *batch;
+    int i;
+
+    batch = opaque;
+    while ((i = __atomic_fetch_add(&batch->Next, 1, __ATOMIC_RELAXED))
+	< batch->Count) {
+	batch->Entries[i].Dir = ResolveIsDirectory(batch->Fd,
+	    batch->Names->Block + batch->Names->Offsets[i]);
+    }
+    return NULL;
 }
 
 /**
-**	Scan a directory for matching entries.
-**
-**	@param name		directory path and name
-**	@param flag_dir		only directories or files
-**	@param filter		list of name suffix filters
-**	@param[out] namelist	list of matching names in directory
+**	Resolve types of directory entries.
 **
-**	@retval <0	if any error occurs
-**	@retval 0	empty directory, no errors occurs
-**	@retval n	number of files
+**	Network filesystems answer many requests in flight much faster,
+**	bigger batches are resolved by a small thread pool.  The caller
+**	works too, without threads this is the sequential fallback.
 **
-**	@todo support reading and sorting files and directories
-**	@todo flag disable sort
+**	@param fd	directory file descriptor
+**	@param names	names of entries
+**	@param entries	entries to resolve
+**	@param n	number of entries
 */
-int ScanDirectory(const char *name, int flag_dir, const NameFilter * filter,
-    char ***namelist)
+static void ResolveEntries(int fd, const NameList * names,
+    ResolveEntry * entries, int n)
 {
-    DIR *dir;
-    struct dirent *entry;
-    struct stat stat_buf;
-    int n;
-    char **names;
-    int arraysz;
-    int save;
+    pthread_t threads[RESOLVE_THREADS];
+    ResolveBatch batch;
+    int started;
 
-    Debug(3, "play/scandir: scan directory '%s'\n", name);
+    batch.Fd = fd;
+    batch.Names = names;
+    batch.Entries = entries;
+    batch.Count = n;
+    batch.Next = 0;
 
-    // FIXME: threads remove global variables
-    BaseDir = name;
-    BaseDirLen = strlen(BaseDir);
-    NameFilters = filter;
-
-    if (!(dir = virt_opendir(name))) {
-	Error("play/scandir: can't open dir '%s': %s\n", name,
-	    strerror(errno));
-	return -1;
-    }
-    if (virt_fstat(dirfd(dir), &stat_buf) < 0) {
-	Error("play/scandir: can't stat dir '%s': %s\n", name,
-	    strerror(errno));
-	return -1;
-    }
-    // approximate size of name array
-    if (stat_buf.st_size) {
-	arraysz = stat_buf.st_size / (3 * 8);
-    } else {
-	arraysz = 16;
+    for (started = 0; started < RESOLVE_THREADS
+	&& (started + 1) * RESOLVE_BATCH < n; ++started) {
+	if (pthread_create(&threads[started], NULL, ResolveThread, &batch)) {
+	    break;
+	}
     }
-    if (!(names = malloc(arraysz * sizeof(*names)))) {
-	Error("play/scandir: dir '%s': out of memory\n", name);
-	return -1;
+    ResolveThread(&batch);
+    while (started > 0) {
+	pthread_join(threads[--started], NULL);
     }
+}
 
-    n = 0;
-    errno = 0;
-    while ((entry = virt_readdir(dir))) {
-	int len;
-	char *tmp;
+/**
+**	Add a copy of a name to a name list.
+**
+**	@param list	name list
+**	@param name	name to add
+**	@param len	length of name, without terminating '\0'
+**
+**	@returns true if added, false if out of memory.
+*/
+static int NameListAdd(NameList * list, const char *name, int len)
+{
+    if (list->Count >= list->Size) {	// offsets full
+	int *new;
+	int size;
 
-	// skip hidden files, wrong kind, wrong suffix
-	save = errno;
-	if (flag_dir ? !FilterIsDirectory(entry) : !FilterIsFile(entry)) {
-	    errno = save;
-	    continue;
+	size = list->Size ? list->Size * 2 : 64;
+	if (!(new = realloc(list->Offsets, size * sizeof(*new)))) {
+	    return 0;
 	}
-	errno = save;
+	list->Offsets = new;
+	list->Size = size;
+    }
+    if (list->Used + len + 1 > list->BlockSize) {	// block full
+	char *new;
+	int size;
 
-	len = _D_ALLOC_NAMLEN(entry);
-	if (!(tmp = malloc(len))) {
-	    Error("play/scandir: dir '%s': out of memory\n", name);
-	    break;
+	size = list->BlockSize ? list->BlockSize * 2 : 4096;
+	while (size < list->Used + len + 1) {
+	    size *= 2;
 	}
-	memcpy(tmp, entry->d_name, len);
-
-	if (++n >= arraysz) {		// array full
-	    char **new;
-
-	    if (virt_fstat(dirfd(dir), &stat_buf) < 0) {
-		Error("play/scandir: can't stat dir '%s': %s\n", name,
-		    strerror(errno));
-		--n;
-		break;
-	    }
-	    // dir size grown and valid
-	    if (stat_buf.st_size / (3 * 4) > arraysz) {
-		arraysz = stat_buf.st_size / (3 * 4);
-	    } else {
-		arraysz *= 2;
-	    }
-	    if (!(new = realloc(names, arraysz * sizeof(*names)))) {
-		Error("play/scandir: dir '%s': out of memory\n", name);
-		--n;
-		break;
-	    }
-	    names = new;
+	if (!(new = realloc(list->Block, size))) {
+	    return 0;
 	}
-	names[n - 1] = tmp;
+	list->Block = new;
+	list->BlockSize = size;
     }
+    memcpy(list->Block + list->Used, name, len);
+    list->Block[list->Used + len] = '\0';
+    list->Offsets[list->Count++] = list->Used;
+    list->Used += len + 1;
 
-    save = errno;
-    virt_closedir(dir);
-
-    if (save) {				// error happened
-	while (n > 0) {			// free used memory
-	    free(names[--n]);
-	}
-	free(names);
-	errno = save;
-	*namelist = NULL;
-	return -1;
-    }
-    // sort names
-    qsort(names, n, sizeof(*names), (int (*)(const void *,
-		const void *))q_cmp);
-    *namelist = names;
+    return 1;
+}
 
-    return n;
+/**
+**	Free a name list.
+**
+**	@param list	name list
+*/
+static void NameListFree(NameList * list)
+{
+    free(list->Block);
+    free(list->Offsets);
+    memset(list, 0, sizeof(*list));
 }
 
 /**
-**	Read directory for menu.
+**	Pack a name list into a name arena.
 **
-**	@param name	directory path and name
-**	@param flag_dir	only directories or files
-**	@param filter	list of name suffix filters
-**	@param cb_add	call back to handle directory entries
-**	@param opaque	privat parameter for the call back
+**	The offsets are moved behind the names, the whole arena is a single
+**	allocation.  The name list is empty afterwards.
 **
-**	@retval <0	if any error occurs
-**	@retval false	if no errors occurs
+**	@param list		name list
+**	@param[out] arena	name arena, free with free(arena->Block)
+**
+**	@returns true if packed, false if out of memory.
 */
-int ReadDirectory(const char *name, int flag_dir, const NameFilter * filter,
-    void (*cb_add) (void *, const char *), void *opaque)
+static int NameListPack(NameList * list, NameArena * arena)
 {
-    int i;
-    int n;
-    char **names;
+    char *block;
+    int offs;
 
-    n = ScanDirectory(name, flag_dir, filter, &names);
-    if (n >= 0) {
-
-	for (i = 0; i < n; ++i) {	// add names to menu
-	    cb_add(opaque, names[i]);
-	    free(names[i]);
+    memset(arena, 0, sizeof(*arena));
+    if (!list->Count) {
+	NameListFree(list);
+	return 1;
+    }
+    // align offsets behind the names
+    offs = (list->Used + sizeof(int) - 1) & ~(sizeof(int) - 1);
+    if (!(block = realloc(list->Block, offs + list->Count * sizeof(int)))) {
+	NameListFree(list);
+	return 0;
+    }
+    memcpy(block + offs, list->Offsets, list->Count * sizeof(int));
+    arena->Block = block;
+    arena->Offsets = (int *)(block + offs);
+    arena->Count = list->Count;
+
+    list->Block = NULL;
+    NameListFree(list);
+    return 1;
+}
+
+/**
+**	Build the natural sort key of a name.
+**
+**	ASCII letters are folded to lower case.  Each run of digits is
+**	replaced by a '0' marker, the number of significant digits and the
+**	digits, so "Episode 2" sorts before "Episode 10".  Comparing keys
+**	bytewise gives the natural order, the key contains no '\0' and is at
+**	most 3 times longer than the name.
+**
+**	@param name	file name
+**	@param[out] key	natural sort key, '\0' terminated
+**
+**	@returns bytes written to key, including the '\0'.
+*/
+static int SortKey(const char *name, unsigned char *key)
+{
+    const unsigned char *s;
+    const unsigned char *e;
+    unsigned char *k;
+    int n;
+
+    s = (const unsigned char *)name;
+    k = key;
+    while (*s) {
+	if (*s < '0' || *s > '9') {
+	    *k++ = *s >= 'A' && *s <= 'Z' ? *s + 'a' - 'A' : *s;
+	    ++s;
+	    continue;
+	}
+	// skip leading zeros, but keep the last digit
+	while (*s == '0' && s[1] >= '0' && s[1] <= '9') {
+	    ++s;
+	}
+	e = s;
+	while (*e >= '0' && *e <= '9') {
+	    ++e;
+	}
+	n = e - s;
+	*k++ = '0';
+	*k++ = n < 255 ? n : 255;
+	memcpy(k, s, n);
+	k += n;
+	s = e;
+    }
+    *k++ = '\0';
+
+    return k - key;
+}
+
+/**
+**	Compare two sort items.
+**
+**	Equal keys ("a" and "A", "1" and "01") are ordered by their names.
+**
+**	@param a	sort item 1
+**	@param b	sort item 2
+**	@param block	string block of the names
+**	@param depth	bytes of the keys known to be equal
+*/
+static int SortCompare(const SortItem * a, const SortItem * b,
+    const char *block, int depth)
+{
+    int cmp;
+
+    if ((cmp = strcmp((const char *)a->Key + depth,
+		(const char *)b->Key + depth))) {
+	return cmp;
+    }
+    return strcmp(block + a->Offset, block + b->Offset);
+}
+
+/**
+**	Insertion sort for small buckets.
+**
+**	@param items	items to sort
+**	@param block	string block of the names
+**	@param n	number of items
+**	@param depth	bytes of the keys known to be equal
+*/
+static void SortInsertion(SortItem * items, const char *block, int n,
+    int depth)
+{
+    SortItem item;
+    int i;
+    int j;
+
+    for (i = 1; i < n; ++i) {
+	item = items[i];
+	for (j = i; j > 0 && SortCompare(&items[j - 1], &item, block,
+		depth) > 0; --j) {
+	    items[j] = items[j - 1];
 	}
+	items[j] = item;
+    }
+}
+
+/**
+**	Distribute items into buckets by the key byte at depth.
+**
+**	@param items		items to distribute
+**	@param tmp		temporary space for n items
+**	@param n		number of items
+**	@param depth		key byte to distribute by
+**	@param[out] bucket	start of each bucket, bucket[256] is n
+*/
+static void SortPartition(SortItem * items, SortItem * tmp, int n,
+    int depth, int *bucket)
+{
+    int i;
+    int c;
+    int pos;
 
-	free(names);
+    memset(bucket, 0, 257 * sizeof(*bucket));
+    for (i = 0; i < n; ++i) {
+	bucket[items[i].Key[depth]]++;
+    }
+    pos = 0;
+    for (c = 0; c < 257; ++c) {
+	i = bucket[c];
+	bucket[c] = pos;
+	pos += i;
+    }
+    for (i = 0; i < n; ++i) {		// stable distribution
+	tmp[bucket[items[i].Key[depth]]++] = items[i];
+    }
+    // restore bucket starts
+    memmove(bucket + 1, bucket, 256 * sizeof(*bucket));
+    bucket[0] = 0;
+    memcpy(items, tmp, n * sizeof(*items));
+}
+
+/**
+**	MSD radix sort of sort items.
+**
+**	@param items	items to sort
+**	@param tmp	temporary space for n items
+**	@param block	string block of the names
+**	@param n	number of items
+**	@param depth	bytes of the keys known to be equal
+*/
+static void SortRadix(SortItem * items, SortItem * tmp, const char *block,
+    int n, int depth)
+{
+    int bucket[257];
+    int c;
+
+    for (;;) {
+	if (n <= SORT_INSERTION) {
+	    SortInsertion(items, block, n, depth);
+	    return;
+	}
+	SortPartition(items, tmp, n, depth, bucket);
+	// all keys have the same byte: common prefix, no recursion
+	c = items[0].Key[depth];
+	if (c && bucket[c + 1] - bucket[c] == n) {
+	    ++depth;
+	    continue;
+	}
+	break;
+    }
+    // bucket 0: keys are equal, only the names differ
+    SortInsertion(items, block, bucket[1], depth);
+    for (c = 1; c < 256; ++c) {
+	if (bucket[c + 1] - bucket[c] > 1) {
+	    SortRadix(items + bucket[c], tmp + bucket[c], block,
+		bucket[c + 1] - bucket[c], depth + 1);
+	}
+    }
+}
+
+/**
+**	Sort thread, takes buckets of the first key byte until all are done.
+**
+**	@param opaque	sort job
+*/
+static void *SortThread(void *opaque)
+{
+    SortJob *job;
+    int c;
+    int n;
+
+    job = opaque;
+    while ((c = __atomic_fetch_add(&job->Next, 1, __ATOMIC_RELAXED)) < 256) {
+	n = job->Bucket[c + 1] - job->Bucket[c];
+	if (!c) {
+	    SortInsertion(job->Items, job->Block, n, 0);
+	} else if (n > 1) {
+	    SortRadix(job->Items + job->Bucket[c], job->Tmp + job->Bucket[c],
+		job->Block, n, 1);
+	}
+    }
+    return NULL;
+}
+
+/**
+**	Sort items, big lists are sorted by a small thread pool.
+**
+**	The items are distributed by their first key byte, the buckets are
+**	independent and sorted in parallel.  The caller works too.
+**
+**	@param items	items to sort
+**	@param tmp	temporary space for n items
+**	@param block	string block of the names
+**	@param n	number of items
+*/
+static void SortItems(SortItem * items, SortItem * tmp, const char *block,
+    int n)
+{
+    pthread_t threads[SORT_THREADS];
+    SortJob job;
+    int started;
+
+    if (n < SORT_PARALLEL) {
+	SortRadix(items, tmp, block, n, 0);
+	return;
+    }
+    SortPartition(items, tmp, n, 0, job.Bucket);
+    job.Items = items;
+    job.Tmp = tmp;
+    job.Block = block;
+    job.Next = 0;
+
+    for (started = 0; started < SORT_THREADS; ++started) {
+	if (pthread_create(&threads[started], NULL, SortThread, &job)) {
+	    break;
+	}
+    }
+    SortThread(&job);
+    while (started > 0) {
+	pthread_join(threads[--started], NULL);
+    }
+}
+
+/**
+**	Sort a name list in natural, case folded order.
+**
+**	The keys are build once, sorting needs no compare callback.  Only
+**	the final reorder of the offsets is done under the lock, readers
+**	of the list aren't blocked while sorting.
+**
+**	@param list	name list, only read by others
+**	@param mutex	lock of the name list
+**
+**	@returns true if sorted, false if out of memory.
+*/
+static int NameListSort(NameList * list, pthread_mutex_t * mutex)
+{
+    unsigned char *keys;
+    SortItem *items;
+    int pos;
+    int i;
+
+    if (list->Count < 2) {
+	return 1;
+    }
+    keys = malloc(3 * list->Used);
+    items = malloc(2 * list->Count * sizeof(*items));
+    if (!keys || !items) {
+	free(keys);
+	free(items);
+	return 0;
+    }
+    pos = 0;
+    for (i = 0; i < list->Count; ++i) {
+	items[i].Key = keys + pos;
+	items[i].Offset = list->Offsets[i];
+	pos += SortKey(list->Block + list->Offsets[i], keys + pos);
+    }
+
+    SortItems(items, items + list->Count, list->Block, list->Count);
+
+    pthread_mutex_lock(mutex);
+    for (i = 0; i < list->Count; ++i) {
+	list->Offsets[i] = items[i].Offset;
+    }
+    pthread_mutex_unlock(mutex);
+
+    free(keys);
+    free(items);
+    return 1;
+}
+
+/**
+**	Allocate a scan context.
+**
+**	@param name	directory path and name
+**	@param flags	wanted kinds #SCAN_DIRS, #SCAN_FILES
+**	@param filter	list of name suffix filters
+**
+**	@returns scan context, NULL if out of memory.
+*/
+static ScanContext *ScanNew(const char *name, int flags,
+    const NameFilter * filter)
+{
+    ScanContext *ctx;
+
+    if (!(ctx = calloc(1, sizeof(*ctx)))) {
+	return NULL;
+    }
+    if (!(ctx->Name = strdup(name))) {
+	free(ctx);
+	return NULL;
+    }
+    ctx->Flags = flags;
+    ctx->Filter = filter;
+    if (filter && !(ctx->Matcher = NameMatcherGet(filter))) {
+	free(ctx->Name);
+	free(ctx);
+	return NULL;
+    }
+    pthread_mutex_init(&ctx->Mutex, NULL);
+    pthread_cond_init(&ctx->Cond, NULL);
+
+    return ctx;
+}
+
+/**
+**	Free a scan context.
+**
+**	@param ctx	scan context, scan must be finished
+*/
+static void ScanFree(ScanContext * ctx)
+{
+    NameListFree(&ctx->ResolveNames);
+    free(ctx->Resolve);
+    NameListFree(&ctx->Dirs);
+    NameListFree(&ctx->Files);
+    pthread_cond_destroy(&ctx->Cond);
+    pthread_mutex_destroy(&ctx->Mutex);
+    free(ctx->Name);
+    free(ctx);
+}
+
+/**
+**	Resolve the collected entries and publish them.
+**
+**	@param ctx	scan context
+**	@param fd	directory file descriptor
+*/
+static void ScanResolve(ScanContext * ctx, int fd)
+{
+    int i;
+
+    if (!ctx->ResolveN) {
+	return;
+    }
+    Debug(3, "play/scandir: resolve %d entries\n", ctx->ResolveN);
+    ResolveEntries(fd, &ctx->ResolveNames, ctx->Resolve, ctx->ResolveN);
+
+    pthread_mutex_lock(&ctx->Mutex);
+    for (i = 0; i < ctx->ResolveN; ++i) {
+	const char *name;
+	NameList *list;
+
+	list = NULL;
+	if (ctx->Resolve[i].Dir >= 0) {	// skip dangling links
+	    if (ctx->Resolve[i].Dir) {
+		list = ctx->Flags & SCAN_DIRS ? &ctx->Dirs : NULL;
+	    } else {
+		list = ctx->Resolve[i].Match ? &ctx->Files : NULL;
+	    }
+	}
+	if (list) {
+	    name = ctx->ResolveNames.Block + ctx->ResolveNames.Offsets[i];
+	    NameListAdd(list, name, strlen(name));
+	}
+    }
+    pthread_mutex_unlock(&ctx->Mutex);
+    // reuse the memory for the next chunk
+    ctx->ResolveNames.Used = 0;
+    ctx->ResolveNames.Count = 0;
+    ctx->ResolveN = 0;
+}
+
+/**
+**	Add a member of an archive directory.  Called from archive reader.
+**
+**	@param opaque	scan context
+**	@param name	member name
+**	@param len	length of member name
+**	@param is_dir	member is a directory
+**
+**	@returns true to continue, false if out of memory.
+*/
+static int ScanArchiveAdd(void *opaque, const char *name, int len,
+    int is_dir)
+{
+    ScanContext *ctx;
+    NameList *list;
+    int ok;
+
+    ctx = opaque;
+    if (ctx->Cancel) {
+	errno = ECANCELED;
+	return 0;
+    }
+    if (name[0] == '.' && !ConfigShowHiddenFiles) {
+	return 1;
+    }
+    if (is_dir) {
+	list = ctx->Flags & SCAN_DIRS ? &ctx->Dirs : NULL;
+    } else {
+	list = (ctx->Flags & SCAN_FILES)
+	    && FilterMatch(ctx->Matcher, name, len) ? &ctx->Files : NULL;
+    }
+    if (!list) {
+	return 1;
+    }
+    pthread_mutex_lock(&ctx->Mutex);
+    ok = NameListAdd(list, name, len);
+    pthread_mutex_unlock(&ctx->Mutex);
+    if (!ok) {
+	Error("play/scandir: dir '%s': out of memory\n", ctx->Name);
+	errno = ENOMEM;
+    }
+    return ok;
+}
+
+/**
+**	Scan a directory once for directories and matching files.
+**
+**	Names are published in arrival order, while the scan runs.  When
+**	done, the names are sorted and the waiting readers are woken.
+**
+**	@param ctx	scan context
+*/
+static void ScanRun(ScanContext * ctx)
+{
+    DIR *dir;
+    struct dirent *entry;
+    struct stat stat_buf;
+    int save;
+    int kind;
+
+    Debug(3, "play/scandir: scan directory '%s'\n", ctx->Name);
+
+    save = 0;
+    dir = NULL;
+    if (ArchiveSplit(ctx->Name)) {	// listed from the archive index
+	if (ArchiveStat(ctx->Name, &stat_buf) < 0
+	    || ArchiveReadDirectory(ctx->Name, ScanArchiveAdd, ctx) < 0) {
+	    save = errno;
+	    if (save != ECANCELED) {
+		Error("play/scandir: can't read archive dir '%s': %s\n",
+		    ctx->Name, strerror(errno));
+	    }
+	} else {
+	    ctx->Mtime = stat_buf.st_mtim;
+	}
+    } else if (!(dir = virt_opendir(ctx->Name))) {
+	save = errno;
+	Error("play/scandir: can't open dir '%s': %s\n", ctx->Name,
+	    strerror(errno));
+    } else if (virt_fstat(dirfd(dir), &stat_buf) < 0) {
+	save = errno;
+	Error("play/scandir: can't stat dir '%s': %s\n", ctx->Name,
+	    strerror(errno));
+	virt_closedir(dir);
+	dir = NULL;
+    }
+
+    if (dir) {
+	// mtime taken before scan, changes while scanning cause a rescan
+	ctx->Mtime = stat_buf.st_mtim;
+
+	errno = 0;
+	while (!ctx->Cancel && (entry = virt_readdir(dir))) {
+	    NameList *list;
+	    int ok;
+
+	    // skip hidden files, wrong kind, wrong suffix
+	    kind = FilterEntry(ctx->Matcher, entry, ctx->Flags);
+	    if (kind & SCAN_RESOLVE) {	// resolved later in a batch
+		if (ctx->ResolveN >= ctx->ResolveSize) {
+		    ResolveEntry *new;
+		    int size;
+
+		    size = ctx->ResolveSize ? ctx->ResolveSize * 2 : 64;
+		    if (!(new = realloc(ctx->Resolve,
+				size * sizeof(*ctx->Resolve)))) {
+			Error("play/scandir: dir '%s': out of memory\n",
+			    ctx->Name);
+			errno = ENOMEM;
+			break;
+		    }
+		    ctx->Resolve = new;
+		    ctx->ResolveSize = size;
+		}
+		if (!NameListAdd(&ctx->ResolveNames, entry->d_name,
+			_D_EXACT_NAMLEN(entry))) {
+		    Error("play/scandir: dir '%s': out of memory\n",
+			ctx->Name);
+		    errno = ENOMEM;
+		    break;
+		}
+		ctx->Resolve[ctx->ResolveN++].Match = kind & SCAN_FILES;
+		// publish big directories piecewise
+		if (ctx->ResolveN >= RESOLVE_CHUNK) {
+		    ScanResolve(ctx, dirfd(dir));
+		    errno = 0;
+		}
+		continue;
+	    }
+	    switch (kind) {
+		case SCAN_DIRS:
+		    list = &ctx->Dirs;
+		    break;
+		case SCAN_FILES:
+		    list = &ctx->Files;
+		    break;
+		default:
+		    list = NULL;
+		    break;
+	    }
+	    if (!list) {
+		continue;
+	    }
+	    pthread_mutex_lock(&ctx->Mutex);
+	    ok = NameListAdd(list, entry->d_name, _D_EXACT_NAMLEN(entry));
+	    pthread_mutex_unlock(&ctx->Mutex);
+	    if (!ok) {
+		Error("play/scandir: dir '%s': out of memory\n", ctx->Name);
+		errno = ENOMEM;
+		break;
+	    }
+	}
+
+	save = errno;
+	if (!save && !ctx->Cancel) {
+	    ScanResolve(ctx, dirfd(dir));
+	}
+	virt_closedir(dir);
+    }
+    if (!save && ctx->Cancel) {
+	save = ECANCELED;
+    }
+
+    // sort names, the scan is the only writer of the lists
+    if (!save && (!NameListSort(&ctx->Dirs, &ctx->Mutex)
+	    || !NameListSort(&ctx->Files, &ctx->Mutex))) {
+	Error("play/scandir: dir '%s': out of memory\n", ctx->Name);
+	save = ENOMEM;
+    }
+
+    pthread_mutex_lock(&ctx->Mutex);
+    if (save) {				// error happened
+	NameListFree(&ctx->Dirs);
+	NameListFree(&ctx->Files);
+    }
+    ctx->Error = save;
+    ctx->Done = 1;
+    pthread_cond_broadcast(&ctx->Cond);
+    pthread_mutex_unlock(&ctx->Mutex);
+}
+
+/**
+**	Background scan thread.
+**
+**	@param opaque	scan context
+*/
+static void *ScanThread(void *opaque)
+{
+    ScanRun(opaque);
+    return NULL;
+}
+
+/**
+**	Take the result of a scan and free the scan context.
+**
+**	@param ctx		scan context
+**	@param[out] dirs	sorted directory names
+**	@param[out] files	sorted matching file names
+**
+**	@retval <0	if any error occurs
+**	@retval 0	no errors occurs
+*/
+static int ScanTake(ScanContext * ctx, NameArena * dirs, NameArena * files)
+{
+    int err;
+
+    if (ctx->Threaded) {
+	pthread_join(ctx->Thread, NULL);
+    }
+    err = ctx->Error;
+    if (!NameListPack(&ctx->Dirs, dirs) && !err) {
+	err = ENOMEM;
+    }
+    if (!NameListPack(&ctx->Files, files) && !err) {
+	err = ENOMEM;
+    }
+    ScanFree(ctx);
+
+    if (err) {
+	free(dirs->Block);
+	free(files->Block);
+	memset(dirs, 0, sizeof(*dirs));
+	memset(files, 0, sizeof(*files));
+	errno = err;
+	return -1;
+    }
+    return 0;
+}
+
+/**
+**	Scan a directory for matching entries.
+**
+**	@param name		directory path and name
+**	@param flag_dir		only directories or files
+**	@param filter		list of name suffix filters
+**	@param[out] names	arena of matching names in directory
+**
+**	@retval <0	if any error occurs
+**	@retval 0	empty directory, no errors occurs
+**	@retval n	number of files
+**
+**	@todo flag disable sort
+*/
+int ScanDirectory(const char *name, int flag_dir, const NameFilter * filter,
+    NameArena * names)
+{
+    ScanContext *ctx;
+    NameArena dirs;
+    NameArena files;
+
+    memset(names, 0, sizeof(*names));
+    if (!(ctx = ScanNew(name, flag_dir ? SCAN_DIRS : SCAN_FILES, filter))) {
+	return -1;
+    }
+    ScanRun(ctx);
+    if (ScanTake(ctx, &dirs, &files) < 0) {
+	return -1;
+    }
+    // the unwanted kind is empty
+    if (flag_dir) {
+	free(files.Block);
+	*names = dirs;
+    } else {
+	free(dirs.Block);
+	*names = files;
+    }
+    return names->Count;
+}
+
+/**
+**	Scan a directory once for directories and matching files.
+**
+**	Each entry is read and classified only once.
+**
+**	@param name		directory path and name
+**	@param filter		list of name suffix filters for files
+**	@param[out] dirs	sorted directory names
+**	@param[out] files	sorted matching file names
+**
+**	@retval <0	if any error occurs
+**	@retval 0	no errors occurs
+*/
+int ScanDirectoryAll(const char *name, const NameFilter * filter,
+    NameArena * dirs, NameArena * files)
+{
+    ScanContext *ctx;
+
+    if (!(ctx = ScanNew(name, SCAN_DIRS | SCAN_FILES, filter))) {
+	memset(dirs, 0, sizeof(*dirs));
+	memset(files, 0, sizeof(*files));
+	return -1;
+    }
+    ScanRun(ctx);
+
+    return ScanDirectoryFinish(ctx, dirs, files);
+}
+
+/**
+**	Start a background scan for directories and matching files.
+**
+**	Without threads the directory is scanned, before this returns.
+**
+**	@param name	directory path and name
+**	@param filter	list of name suffix filters for files
+**
+**	@returns scan context, NULL if out of memory.
+*/
+ScanContext *ScanDirectoryStart(const char *name, const NameFilter * filter)
+{
+    ScanContext *ctx;
+
+    if (!(ctx = ScanNew(name, SCAN_DIRS | SCAN_FILES, filter))) {
+	return NULL;
+    }
+    if (!pthread_create(&ctx->Thread, NULL, ScanThread, ctx)) {
+	ctx->Threaded = 1;
+    } else {
+	Error("play/scandir: can't create thread: %s\n", strerror(errno));
+	ScanRun(ctx);
+    }
+    return ctx;
+}
+
+/**
+**	Wait for a background scan.
+**
+**	@param ctx	scan context
+**	@param timeout	max time to wait in ms, <0 forever, 0 poll only
+**
+**	@returns true if the scan is done.
+*/
+int ScanDirectoryWait(ScanContext * ctx, int timeout)
+{
+    struct timespec abstime;
+    int done;
+
+    pthread_mutex_lock(&ctx->Mutex);
+    if (timeout > 0 && !ctx->Done) {
+	clock_gettime(CLOCK_REALTIME, &abstime);
+	abstime.tv_sec += timeout / 1000;
+	abstime.tv_nsec += (timeout % 1000) * 1000000;
+	if (abstime.tv_nsec >= 1000000000) {
+	    abstime.tv_sec++;
+	    abstime.tv_nsec -= 1000000000;
+	}
+	while (!ctx->Done) {
+	    if (pthread_cond_timedwait(&ctx->Cond, &ctx->Mutex, &abstime)) {
+		break;			// timeout
+	    }
+	}
+    } else if (timeout < 0) {
+	while (!ctx->Done) {
+	    pthread_cond_wait(&ctx->Cond, &ctx->Mutex);
+	}
+    }
+    done = ctx->Done;
+    pthread_mutex_unlock(&ctx->Mutex);
+
+    return done;
+}
+
+/**
+**	Fetch names found by a running scan since the last fetch.
+**
+**	The names are unsorted, directories before files of each fetch.
+**	Once the scan is done, nothing is fetched, the sorted result must be
+**	taken with ScanDirectoryFinish().
+**
+**	@param ctx	scan context
+**	@param cb_add	call back to handle directory entries
+**	@param opaque	privat parameter for the call back
+**
+**	@returns number of new names.
+*/
+int ScanDirectoryFetch(ScanContext * ctx, void (*cb_add) (void *,
+	const char *), void *opaque)
+{
+    int n;
+
+    n = 0;
+    pthread_mutex_lock(&ctx->Mutex);
+    if (!ctx->Done) {
+	while (ctx->DirsFetched < ctx->Dirs.Count) {
+	    cb_add(opaque,
+		ctx->Dirs.Block + ctx->Dirs.Offsets[ctx->DirsFetched++]);
+	    ++n;
+	}
+	while (ctx->FilesFetched < ctx->Files.Count) {
+	    cb_add(opaque,
+		ctx->Files.Block + ctx->Files.Offsets[ctx->FilesFetched++]);
+	    ++n;
+	}
+    }
+    pthread_mutex_unlock(&ctx->Mutex);
+
+    return n;
+}
+
+/**
+**	Cancel a background scan and free its scan context.
+**
+**	@param ctx	scan context
+*/
+void ScanDirectoryCancel(ScanContext * ctx)
+{
+    NameArena dirs;
+    NameArena files;
+
+    ctx->Cancel = 1;
+    ScanTake(ctx, &dirs, &files);	// canceled scan returns nothing
+}
+
+/**
+**	Wait for a scan to finish, take its result and free its context.
+**
+**	@param ctx		scan context
+**	@param[out] dirs	sorted directory names
+**	@param[out] files	sorted matching file names
+**
+**	@retval <0	if any error occurs
+**	@retval 0	no errors occurs
+*/
+int ScanDirectoryFinish(ScanContext * ctx, NameArena * dirs,
+    NameArena * files)
+{
+    return ScanTake(ctx, dirs, files);
+}
+
+/**
+**	Read directory for menu.
+**
+**	@param name	directory path and name
+**	@param flag_dir	only directories or files
+**	@param filter	list of name suffix filters
+**	@param cb_add	call back to handle directory entries
+**	@param opaque	privat parameter for the call back
+**
+**	@retval <0	if any error occurs
+**	@retval false	if no errors occurs
+*/
+int ReadDirectory(const char *name, int flag_dir, const NameFilter * filter,
+    void (*cb_add) (void *, const char *), void *opaque)
+{
+    int i;
+    int n;
+    NameArena names;
+
+    n = ScanDirectory(name, flag_dir, filter, &names);
+    if (n >= 0) {
+
+	for (i = 0; i < n; ++i) {	// add names to menu
+	    cb_add(opaque, NameArenaGet(&names, i));
+	}
+
+	free(names.Block);
     }
 
     return n;
 }
+
+//////////////////////////////////////////////////////////////////////////////
+//	Directory cache
+//////////////////////////////////////////////////////////////////////////////
+
+#define DIR_CACHE_SIZE	32		///< max cached directories
+#define DIR_CACHE_NAMES	200000		///< max cached names
+
+///
+///	Cached directory listing.
+///
+struct _dir_cache_
+{
+    struct _dir_cache_ *Next;		///< next less recently used entry
+    char *Path;				///< directory path and name
+    const NameFilter *Filter;		///< name filter of files
+    struct timespec Mtime;		///< directory mtime at scan
+    NameArena Dirs;			///< sorted directory names
+    NameArena Files;			///< sorted file names
+    int Current;			///< last cursor position, -1 none
+    int Users;				///< menus using the entry
+    int Dropped;			///< outdated, not in cache list
+};
+
+static DirCache *DirCacheList;		///< cache, most recently used first
+
+/**
+**	Free the names of a directory cache entry.
+**
+**	@param cache	directory cache entry
+*/
+static void DirCacheFreeNames(DirCache * cache)
+{
+    free(cache->Dirs.Block);
+    free(cache->Files.Block);
+}
+
+/**
+**	Free a directory cache entry.
+**
+**	@param cache	directory cache entry
+*/
+static void DirCacheFree(DirCache * cache)
+{
+    DirCacheFreeNames(cache);
+    free(cache->Path);
+    free(cache);
+}
+
+/**
+**	Find directory cache entry and make it the most recently used.
+**
+**	@param name	directory path and name
+**	@param filter	list of name suffix filters
+**
+**	@returns cache entry, NULL if not cached.
+*/
+static DirCache *DirCacheFind(const char *name, const NameFilter * filter)
+{
+    DirCache **prev;
+    DirCache *cache;
+
+    for (prev = &DirCacheList; (cache = *prev); prev = &cache->Next) {
+	if (cache->Filter == filter && !strcmp(cache->Path, name)) {
+	    *prev = cache->Next;	// move to front
+	    cache->Next = DirCacheList;
+	    DirCacheList = cache;
+	    return cache;
+	}
+    }
+    return NULL;
+}
+
+/**
+**	Drop least recently used entries, to keep the cache bounded.
+**
+**	Entries in use by a menu are kept.
+*/
+static void DirCacheTrim(void)
+{
+    DirCache **prev;
+    DirCache *cache;
+    int entries;
+    int names;
+
+    entries = 0;
+    names = 0;
+    prev = &DirCacheList;
+    while ((cache = *prev)) {
+	names += cache->Dirs.Count + cache->Files.Count;
+	// keep at least the most recently used
+	if (entries++ && !cache->Users && (entries > DIR_CACHE_SIZE
+		|| names > DIR_CACHE_NAMES)) {
+	    *prev = cache->Next;
+	    names -= cache->Dirs.Count + cache->Files.Count;
+	    --entries;
+	    DirCacheFree(cache);
+	    continue;
+	}
+	prev = &cache->Next;
+    }
+}
+
+/**
+**	Open a cached directory listing.
+**
+**	A cached listing is used, if the modification time of the directory
+**	is unchanged.  Creating, deleting or renaming entries changes it.
+**	inotify isn't used, it doesn't see changes on network mounts.
+**	An outdated entry is kept, until the rescan replaces it.
+**
+**	@param name	directory path and name
+**	@param filter	list of name suffix filters for files
+**
+**	@returns cache entry, kept until DirCacheClose(), NULL if not cached
+**	or outdated, the directory must be scanned.
+*/
+DirCache *DirCacheOpen(const char *name, const NameFilter * filter)
+{
+    DirCache *cache;
+    struct stat stat_buf;
+
+    if (!(cache = DirCacheFind(name, filter))) {
+	return NULL;
+    }
+    if (virt_stat(name, &stat_buf) < 0) {
+	Error("play/readdir: can't stat dir '%s': %s\n", name,
+	    strerror(errno));
+	return NULL;
+    }
+    if (cache->Mtime.tv_sec != stat_buf.st_mtim.tv_sec
+	|| cache->Mtime.tv_nsec != stat_buf.st_mtim.tv_nsec) {
+	Debug(3, "play/readdir: cache of '%s' outdated\n", name);
+	return NULL;
+    }
+    cache->Users++;
+
+    return cache;
+}
+
+/**
+**	Insert a new directory cache entry, replacing the outdated entry.
+**
+**	@param cache	new cache entry
+**
+**	@returns cache entry, kept until DirCacheClose().
+*/
+static DirCache *DirCacheInsert(DirCache * cache)
+{
+    DirCache *old;
+
+    if ((old = DirCacheFind(cache->Path, cache->Filter))) {
+	cache->Current = old->Current;
+	DirCacheList = old->Next;	// found entry is first
+	if (old->Users) {		// freed by its last user
+	    old->Dropped = 1;
+	} else {
+	    DirCacheFree(old);
+	}
+    }
+    cache->Next = DirCacheList;
+    DirCacheList = cache;
+    cache->Users++;
+    DirCacheTrim();
+
+    return cache;
+}
+
+/**
+**	Cache a directory listing from another source.
+**
+**	@param name	directory path and name
+**	@param filter	list of name suffix filters for files
+**	@param mtime	directory mtime, the listing belongs to
+**	@param dirs	sorted directory names, owned by the cache
+**	@param files	sorted file names, owned by the cache
+**
+**	@returns cache entry, kept until DirCacheClose(), NULL if out of
+**	memory.
+*/
+DirCache *DirCacheStore(const char *name, const NameFilter * filter,
+    const struct timespec * mtime, NameArena * dirs, NameArena * files)
+{
+    DirCache *cache;
+
+    if (!(cache = calloc(1, sizeof(*cache)))
+	|| !(cache->Path = strdup(name))) {
+	free(cache);
+	free(dirs->Block);
+	free(files->Block);
+	return NULL;
+    }
+    cache->Filter = filter;
+    cache->Mtime = *mtime;
+    cache->Current = -1;
+    cache->Dirs = *dirs;
+    cache->Files = *files;
+
+    return DirCacheInsert(cache);
+}
+
+/**
+**	Finish a directory scan and cache its sorted result.
+**
+**	@param ctx	scan context of ScanDirectoryStart(), freed
+**
+**	@returns cache entry, kept until DirCacheClose(), NULL if any error
+**	occurs.
+*/
+DirCache *DirCacheFinish(ScanContext * ctx)
+{
+    DirCache *cache;
+    char *path;
+    const NameFilter *filter;
+    struct timespec mtime;
+
+    ScanDirectoryWait(ctx, -1);
+    path = ctx->Name;
+    ctx->Name = NULL;
+    filter = ctx->Filter;
+    mtime = ctx->Mtime;
+
+    if (!(cache = calloc(1, sizeof(*cache)))) {
+	free(path);
+	ScanDirectoryCancel(ctx);
+	return NULL;
+    }
+    cache->Path = path;
+    cache->Filter = filter;
+    cache->Mtime = mtime;
+    cache->Current = -1;
+    if (ScanDirectoryFinish(ctx, &cache->Dirs, &cache->Files) < 0) {
+	DirCacheFree(cache);
+	return NULL;
+    }
+
+    return DirCacheInsert(cache);
+}
+
+/**
+**	Close a cached directory listing.
+**
+**	@param cache	cache entry of DirCacheOpen() or DirCacheFinish()
+*/
+void DirCacheClose(DirCache * cache)
+{
+    if (!--cache->Users) {
+	if (cache->Dropped) {
+	    DirCacheFree(cache);
+	} else {
+	    DirCacheTrim();
+	}
+    }
+}
+
+/**
+**	Get number of entries of a cached directory listing.
+**
+**	@param cache	cache entry
+**
+**	@returns number of directories and files.
+*/
+int DirCacheCount(const DirCache * cache)
+{
+    return cache->Dirs.Count + cache->Files.Count;
+}
+
+/**
+**	Get number of directories of a cached directory listing.
+**
+**	@param cache	cache entry
+**
+**	@returns number of directories, they are the first entries.
+*/
+int DirCacheDirs(const DirCache * cache)
+{
+    return cache->Dirs.Count;
+}
+
+/**
+**	Get an entry of a cached directory listing.
+**
+**	@param cache	cache entry
+**	@param i	index, the directories are before the files
+**
+**	@returns name of the entry, valid until DirCacheClose().
+*/
+const char *DirCacheName(const DirCache * cache, int i)
+{
+    if (i < cache->Dirs.Count) {
+	return NameArenaGet(&cache->Dirs, i);
+    }
+    return NameArenaGet(&cache->Files, i - cache->Dirs.Count);
+}
+
+/**
+**	Remember cursor position of a cached directory.
+**
+**	@param cache	cache entry
+**	@param current	menu entry index of the cursor
+*/
+void DirCacheSetCurrent(DirCache * cache, int current)
+{
+    cache->Current = current;
+}
+
+/**
+**	Get cursor position of a cached directory.
+**
+**	@param cache	cache entry
+**
+**	@returns menu entry index of the cursor, -1 if unknown.
+*/
+int DirCacheGetCurrent(const DirCache * cache)
+{
+    return cache->Current;
+}
+
+/**
+**	Free the directory cache.
+*/
+void DirCacheExit(void)
+{
+    DirCache *cache;
+
+    while ((cache = DirCacheList)) {
+	DirCacheList = cache->Next;
+	if (cache->Users) {		// freed by its last user
+	    cache->Dropped = 1;
+	    continue;
+	}
+	DirCacheFree(cache);
+    }
+}
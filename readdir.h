@@ -27,8 +27,48 @@ typedef struct __name_filter_
 {
     int Length;				///< filter string length
     const char *String;			///< filter string
+    int Type;				///< media type of suffix
 } NameFilter;
 
+#define MEDIA_OTHER	1		///< suffix without media type
+#define MEDIA_VIDEO	2		///< video file
+#define MEDIA_AUDIO	3		///< audio file
+#define MEDIA_IMAGE	4		///< image file
+#define MEDIA_ARCHIVE	5		///< archive of images
+#define MEDIA_ISO	6		///< dvd iso image
+
+///
+///	Readdir name arena typedef
+///
+///	All names and their offsets are in one allocation, which is freed
+///	with a single free(Block).
+///
+typedef struct __name_arena_
+{
+    char *Block;			///< names and offsets
+    int *Offsets;			///< offset of each name in block
+    int Count;				///< number of names
+} NameArena;
+
+    /// get name of a name arena
+#define NameArenaGet(arena, i)	((arena)->Block + (arena)->Offsets[i])
+
+///
+///	Directory scan context typedef
+///
+typedef struct _scan_context_ ScanContext;
+
+///
+///	Cached directory listing typedef
+///
+typedef struct _dir_cache_ DirCache;
+
+    /// match name with name filter table, returns media type
+extern int NameFilterMatch(const NameFilter *, const char *);
+
+    /// free compiled name filter tables
+extern void NameFilterExit(void);
+
     /// check if filename is a directory
 extern int IsDirectory(const char *);
 
@@ -36,8 +76,59 @@ extern int IsDirectory(const char *);
 extern int IsArchive(const char *);
 
     /// scan a directory
-extern int ScanDirectory(const char *, int, const NameFilter *, char ***);
+extern int ScanDirectory(const char *, int, const NameFilter *, NameArena *);
+
+    /// scan a directory once for directories and files
+extern int ScanDirectoryAll(const char *, const NameFilter *, NameArena *,
+    NameArena *);
 
     /// read a directory
 extern int ReadDirectory(const char *, int, const NameFilter *,
     void (*cb_add) (void *, const char *), void *);
+
+    /// start a background scan for directories and files
+extern ScanContext *ScanDirectoryStart(const char *, const NameFilter *);
+
+    /// wait for a background scan
+extern int ScanDirectoryWait(ScanContext *, int);
+
+    /// fetch names found since the last fetch
+extern int ScanDirectoryFetch(ScanContext *, void (*cb_add) (void *,
+	const char *), void *);
+
+    /// cancel a background scan
+extern void ScanDirectoryCancel(ScanContext *);
+
+    /// finish a scan and take its sorted result
+extern int ScanDirectoryFinish(ScanContext *, NameArena *, NameArena *);
+
+    /// open a cached directory listing
+extern DirCache *DirCacheOpen(const char *, const NameFilter *);
+
+    /// finish a scan and cache its result
+extern DirCache *DirCacheFinish(ScanContext *);
+
+    /// cache a directory listing from another source
+extern DirCache *DirCacheStore(const char *, const NameFilter *,
+    const struct timespec *, NameArena *, NameArena *);
+
+    /// close a cached directory listing
+extern void DirCacheClose(DirCache *);
+
+    /// get number of entries of a cached directory listing
+extern int DirCacheCount(const DirCache *);
+
+    /// get number of directories of a cached directory listing
+extern int DirCacheDirs(const DirCache *);
+
+    /// get an entry of a cached directory listing
+extern const char *DirCacheName(const DirCache *, int);
+
+    /// remember cursor position of a cached directory
+extern void DirCacheSetCurrent(DirCache *, int);
+
+    /// get cursor position of a cached directory
+extern int DirCacheGetCurrent(const DirCache *);
+
+    /// free the directory listing cache
+extern void DirCacheExit(void);
@@ -0,0 +1,575 @@
+///
+///	@file resume.c		@brief resume position module
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup Resume The resume position module.
+///
+///	The resume positions are stored in a memory mapped open addressing
+///	hash file, keyed by the file identity (device, inode, size, mtime).
+///	Each 64 byte slot carries its own checksum, a slot torn by a crash
+///	is ignored.  Stores are queued and written by a background thread,
+///	the lookup is a stat and a probe of the mapped table.
+///
+///	File layout: header slot, followed by a power of 2 number of slots.
+///
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#include <pthread.h>
+
+#include <libintl.h>
+#define _(str) gettext(str)		///< gettext shortcut
+#define _N(str) str			///< gettext_noop shortcut
+
+#include "misc.h"
+#include "worker.h"
+#include "resume.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//	Defines
+//////////////////////////////////////////////////////////////////////////////
+
+#define RESUME_MAGIC	0x53455250U	///< file magic 'PRES'
+#define RESUME_VERSION	1		///< file format version
+#define RESUME_SLOTS	4096		///< minimal number of hash slots
+#define RESUME_QUEUE	32		///< size of the store queue
+
+//////////////////////////////////////////////////////////////////////////////
+//	Typedefs
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Resume database file header, occupies the first slot.
+///
+typedef struct _resume_header_
+{
+    uint32_t Magic;			///< file magic #RESUME_MAGIC
+    uint32_t Version;			///< file format #RESUME_VERSION
+    uint32_t Slots;			///< number of hash slots (power of 2)
+    uint32_t Reserved[13];		///< pad to slot size
+} ResumeHeader;
+
+///
+///	Resume database hash slot.
+///
+typedef struct _resume_entry_
+{
+    uint64_t Device;			///< device of file
+    uint64_t Inode;			///< inode of file
+    uint64_t Size;			///< size of file
+    int64_t Mtime;			///< modification time of file
+    int64_t Written;			///< time of last store
+    uint32_t Position;			///< resume position in seconds
+    uint32_t Reserved[4];		///< pad to slot size
+    uint32_t Check;			///< checksum of slot, 0 unused
+} ResumeEntry;
+
+///
+///	Queued store request.
+///
+typedef struct _resume_request_
+{
+    char *Filename;			///< path and name of file
+    int Position;			///< resume position in seconds
+} ResumeRequest;
+
+//////////////////////////////////////////////////////////////////////////////
+//	Variables
+//////////////////////////////////////////////////////////////////////////////
+
+static char *ResumeFilename;		///< resume database file name
+static int ResumeFd = -1;		///< resume database file descriptor
+static ResumeEntry *ResumeMap;		///< mapped database, [0] is header
+static uint32_t ResumeSlots;		///< number of hash slots in map
+static uint32_t ResumeUsed;		///< number of used hash slots
+
+static pthread_t ResumeThread;		///< writer thread
+static pthread_mutex_t ResumeMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ResumeCond = PTHREAD_COND_INITIALIZER;
+static ResumeRequest ResumeQueue[RESUME_QUEUE];	///< store queue
+static int ResumeQueueRead;		///< queue read index
+static int ResumeQueueWrite;		///< queue write index
+static int ResumeExiting;		///< writer should exit
+
+//////////////////////////////////////////////////////////////////////////////
+//	Hash table
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Calculate checksum of a slot (FNV-1a).
+**
+**	@param entry	hash slot
+**
+**	@returns checksum, never 0.
+*/
+static uint32_t ResumeChecksum(const ResumeEntry * entry)
+{
+    const uint8_t *p;
+    uint32_t hash;
+    size_t i;
+
+    p = (const uint8_t *)entry;
+    hash = 2166136261U;
+    for (i = 0; i < offsetof(ResumeEntry, Check); ++i) {
+	hash ^= p[i];
+	hash *= 16777619U;
+    }
+    return hash ? hash : 1;
+}
+
+/**
+**	Calculate hash of the file identity.
+**
+**	The stored identity is hashed like the file status of the other
+**	caches.
+**
+**	@param key	slot with file identity
+*/
+static uint32_t ResumeHash(const ResumeEntry * key)
+{
+    struct stat st;
+
+    memset(&st, 0, sizeof(st));
+    st.st_dev = key->Device;
+    st.st_ino = key->Inode;
+    st.st_size = key->Size;
+    st.st_mtime = key->Mtime;
+
+    return WorkerFileHash(&st);
+}
+
+/**
+**	Fill slot with file identity.
+**
+**	@param st	file status
+**	@param[out] key	slot with file identity
+*/
+static void ResumeKey(const struct stat *st, ResumeEntry * key)
+{
+    memset(key, 0, sizeof(*key));
+    key->Device = st->st_dev;
+    key->Inode = st->st_ino;
+    key->Size = st->st_size;
+    key->Mtime = st->st_mtime;
+}
+
+/**
+**	Find slot of file identity.
+**
+**	@param map	mapped database
+**	@param slots	number of hash slots in map
+**	@param key	slot with file identity
+**	@param insert	true return free slot, if the key isn't found
+**
+**	@returns slot of key or free slot, NULL if not found or full.
+*/
+static ResumeEntry *ResumeFind(ResumeEntry * map, uint32_t slots,
+    const ResumeEntry * key, int insert)
+{
+    ResumeEntry *entry;
+    ResumeEntry *torn;
+    uint32_t i;
+    uint32_t n;
+
+    torn = NULL;
+    i = ResumeHash(key) & (slots - 1);
+    for (n = 0; n < slots; ++n) {
+	entry = map + 1 + i;
+	if (!entry->Check) {		// end of chain
+	    if (insert) {
+		return torn ? torn : entry;
+	    }
+	    return NULL;
+	}
+	if (entry->Check != ResumeChecksum(entry)) {
+	    if (!torn) {		// reuse slots torn by a crash
+		torn = entry;
+	    }
+	} else if (entry->Inode == key->Inode && entry->Device == key->Device
+	    && entry->Size == key->Size && entry->Mtime == key->Mtime) {
+	    return entry;
+	}
+	i = (i + 1) & (slots - 1);
+    }
+    return insert ? torn : NULL;
+}
+
+/**
+**	Create an empty database file.
+**
+**	@param filename	database file name
+**	@param slots	number of hash slots (power of 2)
+**	@param[out] map	mapped database
+**
+**	@returns file descriptor, -1 on failure.
+*/
+static int ResumeCreate(const char *filename, uint32_t slots,
+    ResumeEntry ** map)
+{
+    ResumeHeader *header;
+    size_t size;
+    int fd;
+
+    if ((fd = open(filename, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+		0644)) < 0) {
+	Error(_("resume: can't create '%s'\n"), filename);
+	return -1;
+    }
+    size = (slots + 1) * sizeof(ResumeEntry);
+    if (ftruncate(fd, size) < 0
+	|| (*map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+		0)) == MAP_FAILED) {
+	Error(_("resume: can't map '%s'\n"), filename);
+	close(fd);
+	return -1;
+    }
+    header = (ResumeHeader *) * map;
+    header->Magic = RESUME_MAGIC;
+    header->Version = RESUME_VERSION;
+    header->Slots = slots;
+
+    return fd;
+}
+
+/**
+**	Rebuild database into a new file.
+**
+**	Cleared and torn slots are dropped, the table is grown to keep the
+**	load below 1/2.  The new file is renamed over the old one.
+**
+**	@note called from the writer thread only, which is the only writer
+*/
+static void ResumeRebuild(void)
+{
+    ResumeEntry *map;
+    ResumeEntry *entry;
+    ResumeEntry *slot;
+    char *tmpname;
+    uint32_t slots;
+    uint32_t live;
+    uint32_t i;
+    int fd;
+
+    live = 0;
+    for (i = 0; i < ResumeSlots; ++i) {
+	entry = ResumeMap + 1 + i;
+	if (entry->Check && entry->Position
+	    && entry->Check == ResumeChecksum(entry)) {
+	    ++live;
+	}
+    }
+    slots = RESUME_SLOTS;
+    while (slots < (live + 1) * 2) {
+	slots *= 2;
+    }
+
+    tmpname = malloc(strlen(ResumeFilename) + sizeof(".new"));
+    stpcpy(stpcpy(tmpname, ResumeFilename), ".new");
+    if ((fd = ResumeCreate(tmpname, slots, &map)) < 0) {
+	free(tmpname);
+	return;
+    }
+    live = 0;
+    for (i = 0; i < ResumeSlots; ++i) {
+	entry = ResumeMap + 1 + i;
+	if (!entry->Check || !entry->Position
+	    || entry->Check != ResumeChecksum(entry)) {
+	    continue;
+	}
+	slot = ResumeFind(map, slots, entry, 1);
+	if (!slot->Check) {
+	    ++live;
+	} else if (slot->Written >= entry->Written) {
+	    continue;			// keep newer duplicate
+	}
+	*slot = *entry;
+    }
+    if (fdatasync(fd) < 0 || rename(tmpname, ResumeFilename) < 0) {
+	Error(_("resume: can't replace '%s'\n"), ResumeFilename);
+	munmap(map, (slots + 1) * sizeof(ResumeEntry));
+	close(fd);
+	unlink(tmpname);
+	free(tmpname);
+	return;
+    }
+    free(tmpname);
+
+    pthread_mutex_lock(&ResumeMutex);
+    munmap(ResumeMap, (ResumeSlots + 1) * sizeof(ResumeEntry));
+    close(ResumeFd);
+    ResumeMap = map;
+    ResumeSlots = slots;
+    ResumeFd = fd;
+    ResumeUsed = live;
+    pthread_mutex_unlock(&ResumeMutex);
+
+    Debug(3, "resume: rebuild %u/%u slots\n", live, slots);
+}
+
+/**
+**	Write resume position of a file into the database.
+**
+**	@param filename	path and name of file
+**	@param position	resume position in seconds, 0 clears it
+**
+**	@note called from the writer thread only
+*/
+static void ResumeWrite(const char *filename, int position)
+{
+    struct stat st;
+    ResumeEntry key;
+    ResumeEntry *entry;
+
+    if (stat(filename, &st) < 0) {
+	return;
+    }
+    ResumeKey(&st, &key);
+    key.Position = position;
+    key.Written = time(NULL);
+    key.Check = ResumeChecksum(&key);
+
+    if ((ResumeUsed + 1) * 4 > ResumeSlots * 3) {
+	ResumeRebuild();
+    }
+
+    pthread_mutex_lock(&ResumeMutex);
+    entry = ResumeFind(ResumeMap, ResumeSlots, &key, 1);
+    if (entry && (entry->Check || position)) {	// clear needs no new slot
+	if (!entry->Check) {
+	    ++ResumeUsed;
+	}
+	*entry = key;
+    }
+    pthread_mutex_unlock(&ResumeMutex);
+
+    // make it crash-safe, outside the lock
+    if (fdatasync(ResumeFd) < 0) {
+	Error(_("resume: can't sync '%s'\n"), ResumeFilename);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Thread
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Resume writer thread.
+**
+**	@param dummy	dummy pointer
+*/
+static void *ResumeHandlerThread(void *dummy)
+{
+    char *filename;
+    int position;
+
+    pthread_mutex_lock(&ResumeMutex);
+    for (;;) {
+	while (ResumeQueueRead == ResumeQueueWrite && !ResumeExiting) {
+	    pthread_cond_wait(&ResumeCond, &ResumeMutex);
+	}
+	if (ResumeQueueRead == ResumeQueueWrite) {	// flushed, exit
+	    break;
+	}
+	filename = ResumeQueue[ResumeQueueRead].Filename;
+	position = ResumeQueue[ResumeQueueRead].Position;
+	ResumeQueueRead = (ResumeQueueRead + 1) % RESUME_QUEUE;
+	pthread_mutex_unlock(&ResumeMutex);
+
+	Debug(3, "resume: store %d '%s'\n", position, filename);
+	ResumeWrite(filename, position);
+	free(filename);
+
+	pthread_mutex_lock(&ResumeMutex);
+    }
+    pthread_mutex_unlock(&ResumeMutex);
+
+    return dummy;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Functions
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Lookup resume position of a file.
+**
+**	@param filename	path and name of file
+**
+**	@returns resume position in seconds, 0 if none.
+*/
+int ResumeLookup(const char *filename)
+{
+    struct stat st;
+    ResumeEntry key;
+    ResumeEntry *entry;
+    int position;
+
+    if (!ResumeMap || stat(filename, &st) < 0) {
+	return 0;
+    }
+    ResumeKey(&st, &key);
+
+    position = 0;
+    pthread_mutex_lock(&ResumeMutex);
+    if ((entry = ResumeFind(ResumeMap, ResumeSlots, &key, 0))) {
+	position = entry->Position;
+    }
+    pthread_mutex_unlock(&ResumeMutex);
+
+    Debug(3, "resume: lookup %d '%s'\n", position, filename);
+    return position;
+}
+
+/**
+**	Queue store of resume position of a file.
+**
+**	The file identity is taken, when the writer thread handles it.
+**
+**	@param filename	path and name of file
+**	@param position	resume position in seconds, 0 clears it
+*/
+void ResumeStore(const char *filename, int position)
+{
+    int next;
+
+    if (!ResumeMap) {
+	return;
+    }
+    pthread_mutex_lock(&ResumeMutex);
+    next = (ResumeQueueWrite + 1) % RESUME_QUEUE;
+    if (next == ResumeQueueRead) {
+	Error(_("resume: store queue full\n"));
+    } else {
+	ResumeQueue[ResumeQueueWrite].Filename = strdup(filename);
+	ResumeQueue[ResumeQueueWrite].Position = position;
+	ResumeQueueWrite = next;
+	pthread_cond_signal(&ResumeCond);
+    }
+    pthread_mutex_unlock(&ResumeMutex);
+}
+
+/**
+**	Open resume database and start its writer thread.
+**
+**	A missing or invalid database is created new.
+**
+**	@param filename	database file name
+**
+**	@returns true if the database is usable.
+*/
+int ResumeInit(const char *filename)
+{
+    const ResumeHeader *header;
+    ResumeEntry *map;
+    struct stat st;
+    uint32_t slots;
+    uint32_t i;
+    int fd;
+
+    map = MAP_FAILED;
+    slots = 0;
+    if ((fd = open(filename, O_RDWR | O_CLOEXEC)) >= 0) {
+	if (!fstat(fd, &st) && st.st_size >= (off_t) sizeof(ResumeEntry)) {
+	    map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		fd, 0);
+	}
+	if (map != MAP_FAILED) {
+	    header = (const ResumeHeader *)map;
+	    slots = header->Slots;
+	    if (header->Magic != RESUME_MAGIC
+		|| header->Version != RESUME_VERSION || !slots
+		|| (slots & (slots - 1))
+		|| st.st_size != (off_t) ((slots + 1) * sizeof(ResumeEntry))) {
+		Error(_("resume: invalid database '%s', recreated\n"),
+		    filename);
+		munmap(map, st.st_size);
+		map = MAP_FAILED;
+	    }
+	}
+	if (map == MAP_FAILED) {
+	    close(fd);
+	}
+    }
+    if (map == MAP_FAILED) {
+	slots = RESUME_SLOTS;
+	if ((fd = ResumeCreate(filename, slots, &map)) < 0) {
+	    return 0;
+	}
+    }
+
+    ResumeUsed = 0;
+    for (i = 0; i < slots; ++i) {
+	if (map[1 + i].Check) {
+	    ++ResumeUsed;
+	}
+    }
+    ResumeFilename = strdup(filename);
+    ResumeFd = fd;
+    ResumeSlots = slots;
+    ResumeMap = map;
+    ResumeExiting = 0;
+
+    if (pthread_create(&ResumeThread, NULL, ResumeHandlerThread, NULL)) {
+	Error(_("resume: can't start writer thread\n"));
+	ResumeExit();
+	return 0;
+    }
+    Debug(3, "resume: %u/%u slots used\n", ResumeUsed, ResumeSlots);
+
+    return 1;
+}
+
+/**
+**	Flush queued stores and close resume database.
+*/
+void ResumeExit(void)
+{
+    if (ResumeThread) {
+	pthread_mutex_lock(&ResumeMutex);
+	ResumeExiting = 1;
+	pthread_cond_signal(&ResumeCond);
+	pthread_mutex_unlock(&ResumeMutex);
+	pthread_join(ResumeThread, NULL);
+	ResumeThread = 0;
+    }
+    if (ResumeMap) {
+	pthread_mutex_lock(&ResumeMutex);
+	munmap(ResumeMap, (ResumeSlots + 1) * sizeof(ResumeEntry));
+	ResumeMap = NULL;
+	pthread_mutex_unlock(&ResumeMutex);
+	close(ResumeFd);
+	ResumeFd = -1;
+    }
+    free(ResumeFilename);
+    ResumeFilename = NULL;
+}
@@ -0,0 +1,33 @@
+///
+///	@file resume.h		@brief resume position module header file
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+    /// open resume database and start its writer
+extern int ResumeInit(const char *);
+
+    /// flush and close resume database
+extern void ResumeExit(void);
+
+    /// lookup resume position of a file
+extern int ResumeLookup(const char *);
+
+    /// queue store of resume position of a file
+extern void ResumeStore(const char *, int);
@@ -0,0 +1,1392 @@
+///
+///	@file thumb.c		@brief thumbnail module
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup Thumb The thumbnail module.
+///
+///	Creates small preview images of the files the browser shows.
+///	Images are decoded and scaled down while reading (jpeg with the DCT
+///	scaling of libjpeg, png row by row), camera jpeg files use their
+///	embedded exif thumbnail, of videos the player backend
+///	grabs a frame at 10% of the duration.
+///
+///	The thumbnails are stored as ppm files in a content addressed disk
+///	cache (-t dir): the name is a hash of size, head and tail of the
+///	file, copies and renamed files share their thumbnail.  Files
+///	without thumbnail are stored as empty file, they aren't tried again.
+///
+///	Archive members are read with the archive module, an archive gets
+///	the thumbnail of its first image.  The player can't read archives,
+///	their members have no frame grab.
+///
+///	A pool with a single worker with nice 19 and idle i/o priority
+///	handles a small queue, vdr may record at the same time.  The browser queues the
+///	files of its menu items and cancels them, when it moves on.
+///
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <stdint.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <signal.h>
+
+#include <pthread.h>
+
+#ifdef USE_JPG
+#include <setjmp.h>
+#include <jpeglib.h>
+#endif
+#ifdef USE_PNG
+#include <png.h>
+#endif
+
+#include <libintl.h>
+#define _(str) gettext(str)		///< gettext shortcut
+#define _N(str) str			///< gettext_noop shortcut
+
+#include "player.h"
+#include "probe.h"
+#include "exif.h"
+#include "readdir.h"
+#include "archive.h"
+#include "worker.h"
+#include "thumb.h"
+#include "misc.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//	Defines
+//////////////////////////////////////////////////////////////////////////////
+
+#define THUMB_THREADS	1		///< number of thumbnail workers
+#define THUMB_QUEUE	64		///< size of the request queue
+#define THUMB_MEMO	2048		///< remembered file keys (power of 2)
+#define THUMB_WIDTH	256		///< max width of thumbnails
+#define THUMB_HEIGHT	192		///< max height of thumbnails
+#define THUMB_SAMPLE	(64 * 1024)	///< bytes of head and tail hashed
+#define THUMB_PIXELS	(32 * 1024 * 1024)	///< max pixels of full decode
+#define THUMB_POSITION	30		///< frame position, unknown duration
+#define THUMB_TIMEOUT	30		///< seconds for a frame grab
+#define THUMB_DIRECTORY	128		///< size of frame directory name
+#define THUMB_FRAME	(THUMB_DIRECTORY + NAME_MAX + 1)	///< frame name size
+#define THUMB_DEPTH	4		///< directories searched in archives
+
+//////////////////////////////////////////////////////////////////////////////
+//	Typedefs
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Remembered content key of a file.
+///
+typedef struct _thumb_memo_
+{
+    int Next;				///< next entry of hash chain, -1 end
+    int Used;				///< entry is used
+    uint64_t Device;			///< device of file
+    uint64_t Inode;			///< inode of file
+    uint64_t Size;			///< size of file
+    int64_t Mtime;			///< modification time of file
+    uint64_t Member;			///< hash of archive member name, 0 none
+    uint64_t Key;			///< content key of file
+} ThumbMemo;
+
+///
+///	First image and directory of an archive directory.
+///
+typedef struct _thumb_first_
+{
+    char *Image;			///< name of first image
+    char *Directory;			///< name of first directory
+} ThumbFirst;
+
+///
+///	Box filter, scales RGB rows down while they are decoded.
+///
+typedef struct _thumb_scaler_
+{
+    int Width;				///< source width
+    int Height;				///< source height
+    int OutWidth;			///< thumbnail width
+    int OutHeight;			///< thumbnail height
+    int Transpose;			///< fit the box turned by 90 degrees
+    int Row;				///< source rows added
+    int OutRow;				///< thumbnail row accumulated
+    int Rows;				///< source rows of thumbnail row
+    int *Columns;			///< thumbnail column of source column
+    int *ColumnN;			///< source columns of thumbnail column
+    uint32_t *Sum;			///< sums of thumbnail row
+    uint8_t *Pixels;			///< RGB pixels of thumbnail
+} ThumbScaler;
+
+//////////////////////////////////////////////////////////////////////////////
+//	Variables
+//////////////////////////////////////////////////////////////////////////////
+
+static void ThumbHandle(void *, unsigned);
+
+    /// thumbnail workers, the frame grabbers inherit their priority
+static WorkerPool ThumbPool = {
+    .Name = "thumb",
+    .Threads = THUMB_THREADS,
+    .Size = THUMB_QUEUE,
+    .Idle = 1,
+    .Handle = ThumbHandle,
+    .Same = WorkerSameFile,
+    .Mutex = PTHREAD_MUTEX_INITIALIZER,
+    .Cond = PTHREAD_COND_INITIALIZER,
+};
+
+    /// protects the remembered file keys
+static pthread_mutex_t ThumbMutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile unsigned ThumbDone;	///< number of finished thumbnails
+
+static ThumbMemo *ThumbMemos;		///< remembered file keys
+static int ThumbBuckets[THUMB_MEMO];	///< hash chains, -1 empty
+static int ThumbVictim;			///< next entry to replace
+
+/**
+**	Table of image suffixes searched in archives.
+*/
+static const NameFilter ThumbImageFilters[] = {
+#define FILTER(x) { sizeof(x) - 1, x, MEDIA_IMAGE }
+    FILTER(".jpg"), FILTER(".png"),
+#undef FILTER
+    {0, NULL, 0}
+};
+
+//////////////////////////////////////////////////////////////////////////////
+//	Scaler
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Calculate thumbnail size, keeps the aspect and doesn't scale up.
+**
+**	An image turned by 90 degrees after the scale, must fit the turned
+**	box.
+**
+**	@param width	source width
+**	@param height	source height
+**	@param transpose	true: fit the box turned by 90 degrees
+**	@param[out] out_width	thumbnail width
+**	@param[out] out_height	thumbnail height
+*/
+static void ThumbSize(int width, int height, int transpose, int *out_width,
+    int *out_height)
+{
+    int max_width;
+    int max_height;
+
+    max_width = transpose ? THUMB_HEIGHT : THUMB_WIDTH;
+    max_height = transpose ? THUMB_WIDTH : THUMB_HEIGHT;
+    *out_width = width;
+    *out_height = height;
+    if (width <= max_width && height <= max_height) {
+	return;
+    }
+    if ((int64_t) width * max_height > (int64_t) height * max_width) {
+	*out_width = max_width;
+	*out_height = (int64_t) height * max_width / width;
+    } else {
+	*out_height = max_height;
+	*out_width = (int64_t) width * max_height / height;
+    }
+    if (*out_width < 1) {
+	*out_width = 1;
+    }
+    if (*out_height < 1) {
+	*out_height = 1;
+    }
+}
+
+/**
+**	Prepare scaler for a source image.
+**
+**	@param scaler	box filter
+**	@param width	source width
+**	@param height	source height
+**
+**	@returns true if prepared, false on bad size or out of memory.
+*/
+static int ThumbScalerInit(ThumbScaler * scaler, int width, int height)
+{
+    int x;
+
+    if (width <= 0 || height <= 0 || width > 65535 || height > 65535) {
+	return 0;
+    }
+    scaler->Width = width;
+    scaler->Height = height;
+    ThumbSize(width, height, scaler->Transpose, &scaler->OutWidth,
+	&scaler->OutHeight);
+    scaler->Row = 0;
+    scaler->OutRow = 0;
+    scaler->Rows = 0;
+    scaler->Columns = malloc(width * sizeof(*scaler->Columns));
+    scaler->ColumnN = calloc(scaler->OutWidth, sizeof(*scaler->ColumnN));
+    scaler->Sum = calloc(scaler->OutWidth * 3, sizeof(*scaler->Sum));
+    scaler->Pixels = malloc(scaler->OutWidth * scaler->OutHeight * 3);
+    if (!scaler->Columns || !scaler->ColumnN || !scaler->Sum
+	|| !scaler->Pixels) {
+	return 0;
+    }
+    for (x = 0; x < width; ++x) {
+	scaler->Columns[x] = (int64_t) x * scaler->OutWidth / width;
+	scaler->ColumnN[scaler->Columns[x]]++;
+    }
+    return 1;
+}
+
+/**
+**	Free the buffers of the scaler.
+**
+**	The box is kept for the next decode.
+**
+**	@param scaler	box filter
+*/
+static void ThumbScalerFree(ThumbScaler * scaler)
+{
+    int transpose;
+
+    free(scaler->Columns);
+    free(scaler->ColumnN);
+    free(scaler->Sum);
+    free(scaler->Pixels);
+    transpose = scaler->Transpose;
+    memset(scaler, 0, sizeof(*scaler));
+    scaler->Transpose = transpose;
+}
+
+/**
+**	Store the accumulated thumbnail row.
+**
+**	@param scaler	box filter
+*/
+static void ThumbScalerFlush(ThumbScaler * scaler)
+{
+    uint8_t *out;
+    uint32_t *sum;
+    int x;
+
+    out = scaler->Pixels + scaler->OutRow * scaler->OutWidth * 3;
+    sum = scaler->Sum;
+    for (x = 0; x < scaler->OutWidth; ++x) {
+	uint32_t n;
+
+	n = scaler->ColumnN[x] * scaler->Rows;
+	out[0] = sum[0] / n;
+	out[1] = sum[1] / n;
+	out[2] = sum[2] / n;
+	out += 3;
+	sum += 3;
+    }
+    memset(scaler->Sum, 0, scaler->OutWidth * 3 * sizeof(*scaler->Sum));
+    scaler->Rows = 0;
+}
+
+/**
+**	Add the next source row.
+**
+**	@param scaler	box filter
+**	@param rgb	RGB pixels of source row
+*/
+static void ThumbScalerRow(ThumbScaler * scaler, const uint8_t * rgb)
+{
+    int out_row;
+    int x;
+
+    if (scaler->Row >= scaler->Height) {
+	return;
+    }
+    out_row = (int64_t) scaler->Row * scaler->OutHeight / scaler->Height;
+    if (out_row != scaler->OutRow) {
+	ThumbScalerFlush(scaler);
+	scaler->OutRow = out_row;
+    }
+    for (x = 0; x < scaler->Width; ++x) {
+	uint32_t *sum;
+
+	sum = scaler->Sum + scaler->Columns[x] * 3;
+	sum[0] += rgb[0];
+	sum[1] += rgb[1];
+	sum[2] += rgb[2];
+	rgb += 3;
+    }
+    scaler->Rows++;
+    if (++scaler->Row == scaler->Height) {
+	ThumbScalerFlush(scaler);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Decoder
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Decode a binary ppm image.
+**
+**	@param file	image file
+**	@param scaler	box filter
+**
+**	@returns true if decoded.
+*/
+static int ThumbDecodePpm(FILE * file, ThumbScaler * scaler)
+{
+    uint8_t *row;
+    int width;
+    int height;
+    int max;
+    int y;
+
+    if (fscanf(file, "P6 %d %d %d", &width, &height, &max) != 3
+	|| max != 255 || fgetc(file) == EOF
+	|| !ThumbScalerInit(scaler, width, height)) {
+	return 0;
+    }
+    if (!(row = malloc(width * 3))) {
+	return 0;
+    }
+    for (y = 0; y < height; ++y) {
+	if (fread(row, 3, width, file) != (size_t) width) {
+	    break;
+	}
+	ThumbScalerRow(scaler, row);
+    }
+    free(row);
+
+    return y == height;
+}
+
+#ifdef USE_JPG
+
+///
+///	libjpeg error manager, errors jump back to the decoder.
+///
+typedef struct _thumb_jpeg_error_
+{
+    struct jpeg_error_mgr Manager;	///< libjpeg error manager
+    jmp_buf Jump;			///< return point of decoder
+} ThumbJpegError;
+
+/**
+**	libjpeg fatal error handler.
+*/
+static void ThumbJpegExit(j_common_ptr cinfo)
+{
+    longjmp(((ThumbJpegError *) cinfo->err)->Jump, 1);
+}
+
+/**
+**	libjpeg message handler, the messages are dropped.
+*/
+static void ThumbJpegMessage(j_common_ptr cinfo)
+{
+    (void)cinfo;
+}
+
+/**
+**	Decode a jpeg image.
+**
+**	The DCT scaling of libjpeg decodes big images directly at 1/2, 1/4
+**	or 1/8 of their size.
+**
+**	@param file	image file
+**	@param scaler	box filter
+**
+**	@returns true if decoded.
+*/
+static int ThumbDecodeJpeg(FILE * file, ThumbScaler * scaler)
+{
+    struct jpeg_decompress_struct cinfo;
+    ThumbJpegError jerr;
+    JSAMPROW volatile row;
+    int width;
+    int height;
+    int ok;
+
+    row = NULL;
+    cinfo.err = jpeg_std_error(&jerr.Manager);
+    jerr.Manager.error_exit = ThumbJpegExit;
+    jerr.Manager.output_message = ThumbJpegMessage;
+    if (setjmp(jerr.Jump)) {
+	jpeg_destroy_decompress(&cinfo);
+	free(row);
+	return 0;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, file);
+    jpeg_read_header(&cinfo, TRUE);
+
+    ThumbSize(cinfo.image_width, cinfo.image_height, scaler->Transpose,
+	&width, &height);
+    cinfo.scale_num = 1;
+    cinfo.scale_denom = 8;
+    while (cinfo.scale_denom > 1
+	&& (cinfo.image_width / cinfo.scale_denom < (unsigned)width
+	    || cinfo.image_height / cinfo.scale_denom < (unsigned)height)) {
+	cinfo.scale_denom /= 2;
+    }
+    cinfo.out_color_space = JCS_RGB;
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+    jpeg_start_decompress(&cinfo);
+
+    ok = 0;
+    if (cinfo.output_components == 3
+	&& ThumbScalerInit(scaler, cinfo.output_width, cinfo.output_height)
+	&& (row = malloc(cinfo.output_width * 3))) {
+	while (cinfo.output_scanline < cinfo.output_height) {
+	    JSAMPROW rows[1];
+
+	    rows[0] = row;
+	    jpeg_read_scanlines(&cinfo, rows, 1);
+	    ThumbScalerRow(scaler, row);
+	}
+	jpeg_finish_decompress(&cinfo);
+	ok = 1;
+    }
+    jpeg_destroy_decompress(&cinfo);
+    free(row);
+
+    return ok;
+}
+
+#endif
+
+#ifdef USE_PNG
+
+/**
+**	libpng error handler, errors jump back to the decoder.
+*/
+static void ThumbPngError(png_structp png, png_const_charp message)
+{
+    (void)message;
+    png_longjmp(png, 1);
+}
+
+/**
+**	libpng warning handler, the warnings are dropped.
+*/
+static void ThumbPngWarning(png_structp png, png_const_charp message)
+{
+    (void)png;
+    (void)message;
+}
+
+/**
+**	Decode a png image.
+**
+**	Progressive images are decoded row by row, interlaced images need
+**	the full image.
+**
+**	@param file	image file
+**	@param scaler	box filter
+**
+**	@returns true if decoded.
+*/
+static int ThumbDecodePng(FILE * file, ThumbScaler * scaler)
+{
+    png_structp png;
+    png_infop info;
+    uint8_t *volatile image;
+    png_bytep *volatile rows;
+    png_uint_32 width;
+    png_uint_32 height;
+    png_uint_32 y;
+    int passes;
+
+    if (!(png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL,
+		ThumbPngError, ThumbPngWarning))) {
+	return 0;
+    }
+    if (!(info = png_create_info_struct(png))) {
+	png_destroy_read_struct(&png, NULL, NULL);
+	return 0;
+    }
+    image = NULL;
+    rows = NULL;
+    if (setjmp(png_jmpbuf(png))) {
+	png_destroy_read_struct(&png, &info, NULL);
+	free(image);
+	free(rows);
+	return 0;
+    }
+    png_init_io(png, file);
+    png_read_info(png, info);
+    png_set_expand(png);
+    png_set_strip_16(png);
+    png_set_strip_alpha(png);
+    png_set_gray_to_rgb(png);
+    passes = png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+
+    width = png_get_image_width(png, info);
+    height = png_get_image_height(png, info);
+    if (png_get_rowbytes(png, info) != width * 3
+	|| (passes > 1 && (uint64_t) width * height > THUMB_PIXELS)
+	|| !ThumbScalerInit(scaler, width, height)) {
+	png_destroy_read_struct(&png, &info, NULL);
+	return 0;
+    }
+
+    if (passes > 1) {			// interlaced: all rows in each pass
+	if ((image = malloc((size_t) width * height * 3))
+	    && (rows = malloc(height * sizeof(*rows)))) {
+	    for (y = 0; y < height; ++y) {
+		rows[y] = image + (size_t) y * width * 3;
+	    }
+	    png_read_image(png, rows);
+	    for (y = 0; y < height; ++y) {
+		ThumbScalerRow(scaler, rows[y]);
+	    }
+	}
+    } else if ((image = malloc(width * 3))) {
+	for (y = 0; y < height; ++y) {
+	    png_read_row(png, image, NULL);
+	    ThumbScalerRow(scaler, image);
+	}
+    }
+    png_destroy_read_struct(&png, &info, NULL);
+    free(rows);
+    free(image);
+
+    return scaler->Row == scaler->Height;
+}
+
+#endif
+
+/**
+**	Decode an image stream, the format is detected by its content.
+**
+**	@param file	image stream, read from its start
+**	@param scaler	box filter
+**
+**	@returns true if decoded.
+*/
+static int ThumbDecodeStream(FILE * file, ThumbScaler * scaler)
+{
+    uint8_t magic[8];
+    int ok;
+
+    ok = 0;
+    rewind(file);
+    if (fread(magic, 1, sizeof(magic), file) == sizeof(magic)) {
+	rewind(file);
+	if (magic[0] == 'P' && magic[1] == '6') {
+	    ok = ThumbDecodePpm(file, scaler);
+#ifdef USE_JPG
+	} else if (magic[0] == 0xFF && magic[1] == 0xD8) {
+	    ok = ThumbDecodeJpeg(file, scaler);
+#endif
+#ifdef USE_PNG
+	} else if (!png_sig_cmp(magic, 0, sizeof(magic))) {
+	    ok = ThumbDecodePng(file, scaler);
+#endif
+	}
+    }
+
+    return ok;
+}
+
+/**
+**	Decode an image file.
+**
+**	@param filename	path and name of image
+**	@param scaler	box filter
+**
+**	@returns true if decoded.
+*/
+static int ThumbDecode(const char *filename, ThumbScaler * scaler)
+{
+    FILE *file;
+    int ok;
+
+    if (!(file = fopen(filename, "rbe"))) {
+	return 0;
+    }
+    ok = ThumbDecodeStream(file, scaler);
+    fclose(file);
+
+    return ok;
+}
+
+/**
+**	Decode an image file with exif orientation.
+**
+**	A camera jpeg decodes only the exif thumbnail of its head.
+**
+**	@param file	image file or archive member
+**	@param head	first bytes of file, #EXIF_HEAD for exif
+**	@param n	number of bytes
+**	@param scaler	box filter
+**
+**	@returns true if decoded.
+*/
+static int ThumbDecodePhoto(FILE * file, const uint8_t * head, ssize_t n,
+    ThumbScaler * scaler)
+{
+    uint8_t *pixels;
+    int orientation;
+    int ok;
+
+#ifdef USE_JPG
+    Exif exif;
+    FILE *thumbnail;
+#endif
+
+    ok = 0;
+    orientation = 1;
+#ifdef USE_JPG
+    if (ExifParse(head, n, &exif)) {
+	orientation = exif.Orientation;
+	// turned after the scale, 5-8 swap width and height
+	scaler->Transpose = orientation >= 5;
+	if (exif.Thumbnail
+	    && (thumbnail =
+		fmemopen((void *)exif.Thumbnail, exif.ThumbnailSize, "rb"))) {
+	    if (!(ok = ThumbDecodeJpeg(thumbnail, scaler))) {
+		ThumbScalerFree(scaler);
+	    }
+	    fclose(thumbnail);
+	}
+    }
+#else
+    (void)head;
+    (void)n;
+#endif
+    if (!ok) {
+	ok = ThumbDecodeStream(file, scaler);
+    }
+    if (ok && orientation > 1
+	&& (pixels =
+	    ExifOrient(scaler->Pixels, 3, &scaler->OutWidth,
+		&scaler->OutHeight, orientation))) {
+	free(scaler->Pixels);
+	scaler->Pixels = pixels;
+    }
+
+    return ok;
+}
+
+/**
+**	Test if a file is a decodable image.
+**
+**	@param head	first bytes of file
+**	@param n	number of bytes
+*/
+static int ThumbIsImage(const uint8_t * head, ssize_t n)
+{
+    if (n < 8) {
+	return 0;
+    }
+    if (head[0] == 'P' && head[1] == '6') {
+	return 1;
+    }
+#ifdef USE_JPG
+    if (head[0] == 0xFF && head[1] == 0xD8) {
+	return 1;
+    }
+#endif
+#ifdef USE_PNG
+    if (!png_sig_cmp((png_const_bytep) head, 0, 8)) {
+	return 1;
+    }
+#endif
+    return 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Archive
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Remember the first image and directory of an archive directory.
+**
+**	Hidden names are skipped.
+**
+**	@param opaque	first image and directory
+**	@param name	name of member or directory
+**	@param len	length of name
+**	@param dir	true if name is a directory
+**
+**	@returns false to stop at the first image.
+*/
+static int ThumbFirstAdd(void *opaque, const char *name, int len, int dir)
+{
+    ThumbFirst *first;
+    char *s;
+
+    first = opaque;
+    if (name[0] == '.') {		// hidden, like mac resource forks
+	return 1;
+    }
+    if (!(s = strndup(name, len))) {
+	return 0;
+    }
+    if (dir && !first->Directory) {
+	first->Directory = s;
+	return 1;
+    }
+    if (!dir && NameFilterMatch(ThumbImageFilters, s) == MEDIA_IMAGE) {
+	first->Image = s;
+	return 0;
+    }
+    free(s);
+    return 1;
+}
+
+/**
+**	Find the first image of an archive.
+**
+**	If a directory has no image, its first sub directory is searched.
+**
+**	@param filename	path and name of archive
+**
+**	@returns malloced archive path of image, NULL if there is none.
+*/
+static char *ThumbArchiveImage(const char *filename)
+{
+    ThumbFirst first;
+    const char *name;
+    char *path;
+    char *next;
+    int found;
+    int depth;
+
+    if (!(path = malloc(strlen(filename) + 2))) {
+	return NULL;
+    }
+    stpcpy(stpcpy(path, filename), "#");
+    for (depth = 0; path && depth < THUMB_DEPTH; ++depth) {
+	first.Image = NULL;
+	first.Directory = NULL;
+	ArchiveReadDirectory(path, ThumbFirstAdd, &first);
+	found = first.Image != NULL;
+	if (!(name = found ? first.Image : first.Directory)) {
+	    break;
+	}
+	// the image or the next directory to search
+	if ((next = malloc(strlen(path) + strlen(name) + 2))) {
+	    strcpy(stpcpy(stpcpy(next, path), name), found ? "" : "/");
+	}
+	free(first.Image);
+	free(first.Directory);
+	free(path);
+	path = next;
+	if (found) {
+	    return path;
+	}
+    }
+    free(path);
+    return NULL;
+}
+
+/**
+**	Decode the first image of an archive.
+**
+**	@param filename	path and name of archive
+**	@param scaler	box filter
+**
+**	@returns true if decoded.
+*/
+static int ThumbDecodeArchive(const char *filename, ThumbScaler * scaler)
+{
+    char *image;
+    uint8_t *head;
+    FILE *file;
+    ssize_t n;
+    int ok;
+
+    if (!(image = ThumbArchiveImage(filename))) {
+	return 0;
+    }
+    ok = 0;
+    if ((head = malloc(EXIF_HEAD)) && (file = ArchiveFopen(image))) {
+	n = fread(head, 1, EXIF_HEAD, file);
+	ok = ThumbIsImage(head, n) && ThumbDecodePhoto(file, head, n, scaler);
+	fclose(file);
+    }
+    Debug(3, "thumb: archive image '%s'\n", image);
+    free(head);
+    free(image);
+
+    return ok;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Frame grab
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Wait for the frame grabber.
+**
+**	A cancel or the timeout kills the frame grabber.
+**
+**	@param pid	pid of frame grabber process group
+**	@param generation	cancel generation of the request
+**
+**	@returns 1 if the frame grabber has finished, 0 if it timed out,
+**	-1 if cancelled.
+*/
+static int ThumbWait(int pid, unsigned generation)
+{
+    int status;
+    int ok;
+    int i;
+
+    ok = 0;
+    for (i = 0; i < THUMB_TIMEOUT * 50; ++i) {
+	if (waitpid(pid, &status, WNOHANG) == pid) {
+	    return 1;
+	}
+	if (WorkerCancelled(&ThumbPool, generation)) {
+	    ok = -1;
+	    break;
+	}
+	usleep(20 * 1000);
+    }
+    Debug(3, "thumb: kill frame grabber %d\n", pid);
+    kill(-pid, SIGKILL);
+    waitpid(pid, &status, 0);
+
+    return ok;
+}
+
+/**
+**	Find the frame written by the frame grabber.
+**
+**	@param directory	temporary directory
+**	@param[out] frame	path and name of frame
+**	@param size	size of frame name buffer
+**
+**	@returns true if found.
+*/
+static int ThumbFrame(const char *directory, char *frame, size_t size)
+{
+    DIR *dir;
+    struct dirent *dirent;
+
+    frame[0] = '\0';
+    if ((dir = opendir(directory))) {
+	while ((dirent = readdir(dir))) {
+	    if (dirent->d_name[0] != '.') {
+		if ((size_t) snprintf(frame, size, "%s/%s", directory,
+			dirent->d_name) >= size) {
+		    frame[0] = '\0';	// truncated name is useless
+		}
+		break;
+	    }
+	}
+	closedir(dir);
+    }
+    return frame[0] != '\0';
+}
+
+/**
+**	Remove the frames and the temporary directory.
+**
+**	@param directory	temporary directory
+*/
+static void ThumbClean(const char *directory)
+{
+    char frame[THUMB_FRAME];
+
+    while (ThumbFrame(directory, frame, sizeof(frame)) && !unlink(frame)) {
+    }
+    rmdir(directory);
+}
+
+/**
+**	Grab a frame of a video file.
+**
+**	The frame at 10% of the probed duration is used, if the duration is
+**	unknown or the video is too short, the first frame.
+**
+**	@param filename	path and name of video
+**	@param generation	cancel generation of the request
+**	@param scaler	box filter
+**
+**	@returns 1 if grabbed, 0 if the video has no frame or the grabber
+**	timed out, -1 if cancelled or the grabber can't be started.
+*/
+static int ThumbGrab(const char *filename, unsigned generation,
+    ThumbScaler * scaler)
+{
+    ProbeInfo info;
+    char directory[THUMB_DIRECTORY];
+    char frame[THUMB_FRAME];
+    const char *tmp;
+    int position;
+    int pid;
+    int ok;
+
+    if (!(tmp = getenv("TMPDIR"))) {
+	tmp = "/tmp";
+    }
+    snprintf(directory, sizeof(directory), "%s/vdr-play-thumb-XXXXXX", tmp);
+    if (!mkdtemp(directory)) {
+	Error(_("thumb: can't create '%s': %s\n"), directory,
+	    strerror(errno));
+	return -1;
+    }
+
+    position = THUMB_POSITION;
+    if (ProbeLookup(filename, &info) && info.Duration >= 0) {
+	position = info.Duration / 10;
+    }
+    ok = 0;
+    for (;;) {
+	if ((pid = PlayerGrabFrame(filename, position, directory)) < 0) {
+	    ok = -1;
+	    break;
+	}
+	// a timeout is remembered as no frame, it would block every visit
+	if ((ok = ThumbWait(pid, generation)) <= 0) {
+	    break;
+	}
+	ok = 0;
+	if (ThumbFrame(directory, frame, sizeof(frame))) {
+	    ok = ThumbDecode(frame, scaler);
+	    break;
+	}
+	if (!position) {
+	    break;
+	}
+	position = 0;			// behind the end: try first frame
+    }
+    ThumbClean(directory);
+
+    return ok;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Cache
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Calculate hash of the member name of an archive path.
+**
+**	The members of an archive share the status of the archive, the
+**	name hash tells them apart.
+**
+**	@param filename	path and name of file or archive member
+**
+**	@returns FNV-1a hash of member name, 0 if it isn't a member.
+*/
+static uint64_t ThumbMember(const char *filename)
+{
+    const char *s;
+    uint64_t hash;
+
+    if (!(s = ArchiveSplit(filename))) {
+	return 0;
+    }
+    hash = 0xCBF29CE484222325ULL;
+    for (++s; *s; ++s) {
+	hash = (hash ^ ((const uint8_t *)s)[0]) * 0x100000001B3ULL;
+    }
+    return hash ? hash : 1;
+}
+
+/**
+**	Find remembered content key of a file.
+**
+**	@param st	file status
+**	@param member	hash of archive member name
+**	@param[out] key	content key of file
+**
+**	@returns true if found.
+*/
+static int ThumbMemoFind(const struct stat *st, uint64_t member,
+    uint64_t * key)
+{
+    int i;
+
+    pthread_mutex_lock(&ThumbMutex);
+    for (i = ThumbMemos ? ThumbBuckets[(WorkerFileHash(st) ^ member)
+	    & (THUMB_MEMO - 1)] : -1; i >= 0;
+	i = ThumbMemos[i].Next) {
+	const ThumbMemo *memo;
+
+	memo = ThumbMemos + i;
+	if (memo->Inode == (uint64_t) st->st_ino
+	    && memo->Device == (uint64_t) st->st_dev
+	    && memo->Size == (uint64_t) st->st_size
+	    && memo->Mtime == st->st_mtime && memo->Member == member) {
+	    *key = memo->Key;
+	    break;
+	}
+    }
+    pthread_mutex_unlock(&ThumbMutex);
+
+    return i >= 0;
+}
+
+/**
+**	Remember content key of a file, the oldest key is replaced.
+**
+**	@param st	file status
+**	@param member	hash of archive member name
+**	@param key	content key of file
+*/
+static void ThumbMemoStore(const struct stat *st, uint64_t member,
+    uint64_t key)
+{
+    ThumbMemo *memo;
+    int *link;
+    int i;
+
+    pthread_mutex_lock(&ThumbMutex);
+    if (!ThumbMemos) {
+	if (!(ThumbMemos = calloc(THUMB_MEMO, sizeof(*ThumbMemos)))) {
+	    pthread_mutex_unlock(&ThumbMutex);
+	    return;
+	}
+	memset(ThumbBuckets, 0xFF, sizeof(ThumbBuckets));
+    }
+    i = ThumbVictim;
+    ThumbVictim = (ThumbVictim + 1) % THUMB_MEMO;
+    memo = ThumbMemos + i;
+    if (memo->Used) {			// unlink the replaced entry
+	struct stat old;
+
+	old.st_ino = memo->Inode;
+	old.st_dev = memo->Device;
+	old.st_size = memo->Size;
+	old.st_mtime = memo->Mtime;
+	for (link = ThumbBuckets + ((WorkerFileHash(&old) ^ memo->Member)
+		& (THUMB_MEMO - 1)); *link != i;
+	    link = &ThumbMemos[*link].Next) {
+	}
+	*link = memo->Next;
+    }
+    link = ThumbBuckets + ((WorkerFileHash(st) ^ member) & (THUMB_MEMO - 1));
+    memo->Next = *link;
+    *link = i;
+    memo->Used = 1;
+    memo->Inode = st->st_ino;
+    memo->Device = st->st_dev;
+    memo->Size = st->st_size;
+    memo->Mtime = st->st_mtime;
+    memo->Member = member;
+    memo->Key = key;
+    pthread_mutex_unlock(&ThumbMutex);
+}
+
+/**
+**	Calculate content key of a file.
+**
+**	FNV-1a hash of size, head and tail of the file.
+**
+**	@param file	file or archive member
+**	@param size	size of file
+**
+**	@returns content key, 0 on errors.
+*/
+static uint64_t ThumbKey(FILE * file, off_t size)
+{
+    uint8_t *buf;
+    uint64_t hash;
+    size_t n;
+    size_t i;
+    int err;
+
+    if (!(buf = malloc(THUMB_SAMPLE))) {
+	return 0;
+    }
+    hash = 0xCBF29CE484222325ULL;
+    for (i = 0; i < 8; ++i) {
+	hash = (hash ^ (((uint64_t) size >> (i * 8)) & 0xFF))
+	    * 0x100000001B3ULL;
+    }
+    err = fseeko(file, 0, SEEK_SET);
+    n = err ? 0 : fread(buf, 1, THUMB_SAMPLE, file);
+    for (i = 0; i < n; ++i) {
+	hash = (hash ^ buf[i]) * 0x100000001B3ULL;
+    }
+    if (!err && size > THUMB_SAMPLE) {	// else head is whole file
+	err = fseeko(file, size - THUMB_SAMPLE, SEEK_SET);
+	n = err ? 0 : fread(buf, 1, THUMB_SAMPLE, file);
+	for (i = 0; i < n; ++i) {
+	    hash = (hash ^ buf[i]) * 0x100000001B3ULL;
+	}
+    }
+    free(buf);
+    if (err || ferror(file)) {
+	return 0;
+    }
+    return hash ? hash : 1;
+}
+
+/**
+**	Build cache file name of a content key.
+**
+**	@param[out] path	cache file name
+**	@param size	size of cache file name buffer
+**	@param key	content key of file
+**	@param directory	true: only the sub directory
+*/
+static void ThumbPath(char *path, size_t size, uint64_t key, int directory)
+{
+    if (directory) {
+	snprintf(path, size, "%s/%02x", ConfigThumbDirectory,
+	    (unsigned)(key >> 56));
+	return;
+    }
+    snprintf(path, size, "%s/%02x/%014llx.ppm", ConfigThumbDirectory,
+	(unsigned)(key >> 56),
+	(unsigned long long)(key & 0x00FFFFFFFFFFFFFFULL));
+}
+
+/**
+**	Write thumbnail to the cache.
+**
+**	The file is written under a temporary name and renamed, a reader
+**	never sees a partial thumbnail.
+**
+**	@param key	content key of file
+**	@param scaler	box filter with thumbnail, NULL for no thumbnail
+*/
+static void ThumbWrite(uint64_t key, const ThumbScaler * scaler)
+{
+    char path[512];
+    char tmp[512 + 16];
+    FILE *file;
+    int ok;
+
+    ThumbPath(path, sizeof(path), key, 1);
+    if (mkdir(ConfigThumbDirectory, 0755) && errno != EEXIST) {
+	Error(_("thumb: can't create '%s': %s\n"), ConfigThumbDirectory,
+	    strerror(errno));
+	return;
+    }
+    if (mkdir(path, 0755) && errno != EEXIST) {
+	Error(_("thumb: can't create '%s': %s\n"), path, strerror(errno));
+	return;
+    }
+    ThumbPath(path, sizeof(path), key, 0);
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)getpid());
+    if (!(file = fopen(tmp, "wbe"))) {
+	Error(_("thumb: can't create '%s': %s\n"), tmp, strerror(errno));
+	return;
+    }
+    ok = 1;
+    if (scaler) {
+	fprintf(file, "P6\n%d %d\n255\n", scaler->OutWidth,
+	    scaler->OutHeight);
+	ok = fwrite(scaler->Pixels, scaler->OutWidth * 3, scaler->OutHeight,
+	    file) == (size_t) scaler->OutHeight;
+    }
+    if (fclose(file) || !ok || rename(tmp, path)) {
+	Error(_("thumb: can't write '%s': %s\n"), tmp, strerror(errno));
+	unlink(tmp);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Thread
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Create thumbnail of a file and cache it.
+**
+**	@param request	path and name of image, video, archive or member
+**	@param generation	cancel generation of the request
+*/
+static void ThumbHandle(void *request, unsigned generation)
+{
+    const char *filename;
+    ThumbScaler scaler;
+    struct stat st;
+    char path[512];
+    uint8_t *head;
+    uint64_t member;
+    uint64_t key;
+    FILE *file;
+    ssize_t n;
+    int ok;
+
+    filename = request;
+    member = ThumbMember(filename);
+    if (ArchiveStat(filename, &st) < 0 || !S_ISREG(st.st_mode)
+	|| ThumbMemoFind(&st, member, &key)) {	// already done
+	return;
+    }
+    // exif data with thumbnail is in the head of camera files
+    if (!(head = malloc(EXIF_HEAD))) {
+	return;
+    }
+    if (!(file = ArchiveFopen(filename))) {
+	free(head);
+	return;
+    }
+    n = fread(head, 1, EXIF_HEAD, file);
+    key = ThumbKey(file, st.st_size);
+    if (!key || WorkerCancelled(&ThumbPool, generation)) {
+	fclose(file);
+	free(head);
+	return;
+    }
+
+    ThumbPath(path, sizeof(path), key, 0);
+    if (!access(path, F_OK)) {		// same content cached
+	ThumbMemoStore(&st, member, key);
+	++ThumbDone;
+	fclose(file);
+	free(head);
+	return;
+    }
+
+    memset(&scaler, 0, sizeof(scaler));
+    if (!member && IsArchive(filename)) {
+	ok = ThumbDecodeArchive(filename, &scaler);
+    } else if (ThumbIsImage(head, n)) {
+	ok = ThumbDecodePhoto(file, head, n, &scaler);
+    } else if (member) {		// the player can't read members
+	ok = 0;
+    } else {
+	ok = ThumbGrab(filename, generation, &scaler);
+    }
+    fclose(file);
+    Debug(3, "thumb: %d %dx%d '%s'\n", ok, scaler.OutWidth,
+	scaler.OutHeight, filename);
+    if (ok >= 0) {			// not cancelled
+	ThumbWrite(key, ok ? &scaler : NULL);
+	ThumbMemoStore(&st, member, key);
+	++ThumbDone;
+    }
+    ThumbScalerFree(&scaler);
+    free(head);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Functions
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Queue thumbnail of an image or video file.
+**
+**	If the queue is full, the oldest request is dropped.  A file
+**	already queued isn't queued again.
+**
+**	@param filename	path and name of file
+*/
+void ThumbFile(const char *filename)
+{
+    if (ConfigThumbDirectory) {
+	WorkerQueueFile(&ThumbPool, filename);
+    }
+}
+
+/**
+**	Lookup the cached thumbnail of a file.
+**
+**	Only files handled by the workers are known, the cache file is read
+**	without hashing the file again.
+**
+**	@param filename	path and name of file or archive member
+**	@param[out] width	width of thumbnail
+**	@param[out] height	height of thumbnail
+**
+**	@returns malloced ARGB pixels, NULL if there is no thumbnail.
+*/
+uint32_t *ThumbLookup(const char *filename, int *width, int *height)
+{
+    struct stat st;
+    char path[512];
+    uint64_t key;
+    uint32_t *argb;
+    uint8_t *rgb;
+    FILE *file;
+    int max;
+    int i;
+
+    if (!ConfigThumbDirectory || ArchiveStat(filename, &st) < 0
+	|| !ThumbMemoFind(&st, ThumbMember(filename), &key)) {
+	return NULL;
+    }
+    ThumbPath(path, sizeof(path), key, 0);
+    if (!(file = fopen(path, "rbe"))) {
+	return NULL;
+    }
+    argb = NULL;
+    // empty file: no thumbnail
+    if (fscanf(file, "P6 %d %d %d", width, height, &max) == 3
+	&& max == 255 && fgetc(file) != EOF && *width > 0
+	&& *width <= THUMB_WIDTH && *height > 0 && *height <= THUMB_HEIGHT
+	&& (argb = malloc(*width * *height * sizeof(*argb)))) {
+	rgb = (uint8_t *) argb + *width * *height;
+	if (fread(rgb, 3, *width * *height, file) == (size_t) (*width *
+		*height)) {
+	    // expand in place, the RGB pixels are behind the ARGB pixels
+	    for (i = 0; i < *width * *height; ++i) {
+		argb[i] = 0xFF000000U | (rgb[i * 3] << 16)
+		    | (rgb[i * 3 + 1] << 8) | rgb[i * 3 + 2];
+	    }
+	} else {
+	    free(argb);
+	    argb = NULL;
+	}
+    }
+    fclose(file);
+
+    return argb;
+}
+
+/**
+**	Get number of finished thumbnails.
+**
+**	A change tells, that new thumbnails can be looked up.
+*/
+unsigned ThumbChanges(void)
+{
+    return ThumbDone;
+}
+
+/**
+**	Cancel all queued and running thumbnails.
+**
+**	A running frame grabber is killed.
+*/
+void ThumbCancel(void)
+{
+    WorkerCancel(&ThumbPool);
+}
+
+/**
+**	Stop thumbnail threads.
+*/
+void ThumbExit(void)
+{
+    WorkerExit(&ThumbPool);
+
+    free(ThumbMemos);
+    ThumbMemos = NULL;
+    ThumbVictim = 0;
+}
@@ -0,0 +1,36 @@
+///
+///	@file thumb.h		@brief thumbnail module header file
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+    /// queue thumbnail of an image or video file
+extern void ThumbFile(const char *);
+
+    /// lookup cached thumbnail as ARGB pixels
+extern uint32_t *ThumbLookup(const char *, int *, int *);
+
+    /// number of finished thumbnails
+extern unsigned ThumbChanges(void);
+
+    /// cancel all queued and running thumbnails
+extern void ThumbCancel(void);
+
+    /// stop thumbnail threads
+extern void ThumbExit(void);
@@ -335,6 +335,32 @@ void VideoWindowHide(void)
     xcb_unmap_window(Connection, VideoOsdWindow);
 }
 
+///
+///	Show player window.
+///
+void VideoPlayWindowShow(void)
+{
+    if (!Connection) {
+	return;
+    }
+    xcb_map_window(Connection, VideoPlayWindow);
+    xcb_flush(Connection);
+}
+
+///
+///	Hide player window.
+///
+///	Used to keep the window of an idle player around.
+///
+void VideoPlayWindowHide(void)
+{
+    if (!Connection) {
+	return;
+    }
+    xcb_unmap_window(Connection, VideoPlayWindow);
+    xcb_flush(Connection);
+}
+
 ///
 ///	Clear window.
 ///
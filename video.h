@@ -35,6 +35,12 @@ extern void VideoWindowHide(void);
     /// Clear window.
 extern void VideoWindowClear(void);
 
+    /// Show player window.
+extern void VideoPlayWindowShow(void);
+
+    /// Hide player window.
+extern void VideoPlayWindowHide(void);
+
     /// Poll video events.
 extern void VideoPollEvents(int);
 
@@ -0,0 +1,319 @@
+///
+///	@file worker.c	@brief worker thread module
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	@defgroup Worker The worker thread module.
+///
+///	The background modules (prefetch, probe, thumbnail and image) share
+///	a pool of worker threads with a small ring queue.  The workers are
+///	started with the first request, if the queue is full the oldest
+///	request is dropped.  A cancel drops the queued requests and bumps
+///	the generation, running requests check it with WorkerCancelled().
+///
+///	The caches of the modules are keyed by the file identity, the hash
+///	of it is here too.
+///
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <pthread.h>
+
+#include <libintl.h>
+#define _(str) gettext(str)		///< gettext shortcut
+#define _N(str) str			///< gettext_noop shortcut
+
+#include "misc.h"
+#include "worker.h"
+
+//////////////////////////////////////////////////////////////////////////////
+//	Thread
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Worker thread.
+**
+**	@param arg	worker pool
+*/
+static void *WorkerThread(void *arg)
+{
+    WorkerPool *pool;
+    void *request;
+    unsigned generation;
+
+    pool = arg;
+    if (pool->Idle) {
+	// child processes (frame grabbers) inherit the priority
+	setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19);
+#ifdef SYS_ioprio_set
+	// IOPRIO_WHO_PROCESS of this thread, IOPRIO_CLASS_IDLE
+	syscall(SYS_ioprio_set, 1, 0, 3 << 13);
+#endif
+    }
+
+    pthread_mutex_lock(&pool->Mutex);
+    for (;;) {
+	while (pool->QueueRead == pool->QueueWrite && !pool->Exiting) {
+	    pthread_cond_wait(&pool->Cond, &pool->Mutex);
+	}
+	if (pool->Exiting) {
+	    break;
+	}
+	request = pool->Queue[pool->QueueRead];
+	pool->Queue[pool->QueueRead] = NULL;
+	pool->QueueRead = (pool->QueueRead + 1) % pool->Size;
+	generation = pool->Generation;
+	pthread_mutex_unlock(&pool->Mutex);
+
+	pool->Handle(request, generation);
+	free(request);
+
+	pthread_mutex_lock(&pool->Mutex);
+    }
+    pthread_mutex_unlock(&pool->Mutex);
+
+    return NULL;
+}
+
+/**
+**	Start the worker threads.
+**
+**	A failure isn't retried with the next request.  Must be called with
+**	the pool mutex locked.
+**
+**	@param pool	worker pool
+**
+**	@returns true if the queue can be used, false if no worker runs.
+*/
+static int WorkerStart(WorkerPool * pool)
+{
+    int running;
+    int failed;
+    int i;
+
+    if (!pool->Queue) {
+	if (!(pool->Queue = calloc(pool->Size, sizeof(*pool->Queue)))
+	    || !(pool->ThreadIds =
+		calloc(pool->Threads, sizeof(*pool->ThreadIds)))) {
+	    free(pool->Queue);
+	    pool->Queue = NULL;
+	    return 0;
+	}
+    }
+    failed = pool->Failed;
+    for (i = 0; i < pool->Threads && !pool->Failed; ++i) {
+	if (!pool->ThreadIds[i]
+	    && pthread_create(&pool->ThreadIds[i], NULL, WorkerThread,
+		pool)) {
+	    Error(_("%s: can't start worker thread\n"), pool->Name);
+	    pool->ThreadIds[i] = 0;
+	    pool->Failed = 1;
+	}
+    }
+    running = 0;
+    for (i = 0; i < pool->Threads; ++i) {
+	running += pool->ThreadIds[i] != 0;
+    }
+    if (!running) {
+	if (!failed) {			// only once
+	    Error(_("%s: no worker thread, requests are dropped\n"),
+		pool->Name);
+	}
+	return 0;
+    }
+    return 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////
+//	Functions
+//////////////////////////////////////////////////////////////////////////////
+
+/**
+**	Queue a request.
+**
+**	If the queue is full, the oldest request is dropped.  A request
+**	already queued isn't queued again.
+**
+**	@param pool	worker pool
+**	@param request	malloced request, freed by the pool
+**
+**	@returns false if the request is dropped, because no worker runs.
+*/
+int WorkerQueue(WorkerPool * pool, void *request)
+{
+    int next;
+    int i;
+
+    if (!request) {
+	return 0;
+    }
+    pthread_mutex_lock(&pool->Mutex);
+    // workers are started with the first request
+    if (!WorkerStart(pool)) {
+	pthread_mutex_unlock(&pool->Mutex);
+	free(request);
+	return 0;
+    }
+    if (pool->Same) {
+	for (i = pool->QueueRead; i != pool->QueueWrite;
+	    i = (i + 1) % pool->Size) {
+	    if (pool->Same(pool->Queue[i], request)) {
+		pthread_mutex_unlock(&pool->Mutex);
+		free(request);
+		return 1;		// already queued
+	    }
+	}
+    }
+    next = (pool->QueueWrite + 1) % pool->Size;
+    if (next == pool->QueueRead) {	// full, drop oldest
+	free(pool->Queue[pool->QueueRead]);
+	pool->Queue[pool->QueueRead] = NULL;
+	pool->QueueRead = (pool->QueueRead + 1) % pool->Size;
+    }
+    pool->Queue[pool->QueueWrite] = request;
+    pool->QueueWrite = next;
+    pthread_cond_signal(&pool->Cond);
+    pthread_mutex_unlock(&pool->Mutex);
+    return 1;
+}
+
+/**
+**	Queue a file name.
+**
+**	@param pool	worker pool
+**	@param filename	path and name of file, copied
+**
+**	@returns false if the file isn't queued, because no worker runs.
+*/
+int WorkerQueueFile(WorkerPool * pool, const char *filename)
+{
+    return WorkerQueue(pool, strdup(filename));
+}
+
+/**
+**	Compare two file name requests.
+**
+**	@param a	first file name
+**	@param b	second file name
+**
+**	@returns true, if both are the same file name.
+*/
+int WorkerSameFile(const void *a, const void *b)
+{
+    return !strcmp(a, b);
+}
+
+/**
+**	Check if a request is cancelled.
+**
+**	@param pool	worker pool
+**	@param generation	cancel generation of the request
+**
+**	@returns true if cancelled or the workers are stopped.
+*/
+int WorkerCancelled(const WorkerPool * pool, unsigned generation)
+{
+    return generation != pool->Generation || pool->Exiting;
+}
+
+/**
+**	Cancel all queued and running requests.
+**
+**	Running requests are only stopped, if they check WorkerCancelled().
+**
+**	@param pool	worker pool
+*/
+void WorkerCancel(WorkerPool * pool)
+{
+    pthread_mutex_lock(&pool->Mutex);
+    ++pool->Generation;
+    while (pool->QueueRead != pool->QueueWrite) {
+	free(pool->Queue[pool->QueueRead]);
+	pool->Queue[pool->QueueRead] = NULL;
+	pool->QueueRead = (pool->QueueRead + 1) % pool->Size;
+    }
+    pthread_mutex_unlock(&pool->Mutex);
+}
+
+/**
+**	Stop worker threads.
+**
+**	The pool can be used again after it.
+**
+**	@param pool	worker pool
+*/
+void WorkerExit(WorkerPool * pool)
+{
+    int i;
+
+    WorkerCancel(pool);
+    pthread_mutex_lock(&pool->Mutex);
+    pool->Exiting = 1;
+    pthread_cond_broadcast(&pool->Cond);
+    pthread_mutex_unlock(&pool->Mutex);
+
+    for (i = 0; pool->ThreadIds && i < pool->Threads; ++i) {
+	if (pool->ThreadIds[i]) {
+	    pthread_join(pool->ThreadIds[i], NULL);
+	    pool->ThreadIds[i] = 0;
+	}
+    }
+
+    pthread_mutex_lock(&pool->Mutex);
+    free(pool->ThreadIds);
+    pool->ThreadIds = NULL;
+    free(pool->Queue);
+    pool->Queue = NULL;
+    pool->QueueRead = 0;
+    pool->QueueWrite = 0;
+    pool->Failed = 0;
+    pool->Exiting = 0;
+    pthread_mutex_unlock(&pool->Mutex);
+}
+
+/**
+**	Calculate hash of the file identity.
+**
+**	The caches mask the hash to their number of hash chains.
+**
+**	@param st	file status
+*/
+uint32_t WorkerFileHash(const struct stat *st)
+{
+    uint64_t hash;
+
+    hash = (uint64_t) st->st_ino * 0x9E3779B97F4A7C15ULL;
+    hash ^= (uint64_t) st->st_dev * 0xC2B2AE3D27D4EB4FULL;
+    hash ^= (uint64_t) st->st_size * 0x165667B19E3779F9ULL;
+    hash ^= (uint64_t) st->st_mtime * 0x27D4EB2F165667C5ULL;
+    hash ^= hash >> 29;
+
+    return hash ^ (hash >> 32);
+}
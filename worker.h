@@ -0,0 +1,70 @@
+///
+///	@file worker.h		@brief worker thread module header file
+///
+///	Copyright (c) 2026 by Johns.  All Rights Reserved.
+///
+///	Contributor(s):
+///
+///	License: AGPLv3
+///
+///	This program is free software: you can redistribute it and/or modify
+///	it under the terms of the GNU Affero General Public License as
+///	published by the Free Software Foundation, either version 3 of the
+///	License.
+///
+///	This program is distributed in the hope that it will be useful,
+///	but WITHOUT ANY WARRANTY; without even the implied warranty of
+///	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///	GNU Affero General Public License for more details.
+///
+///	$Id$
+//////////////////////////////////////////////////////////////////////////////
+
+///
+///	Pool of worker threads with a request queue.
+///
+///	The configuration is initialized static by the module, together
+///	with #Mutex and #Cond, the other members are zero.
+///
+typedef struct _worker_pool_
+{
+    const char *Name;			///< module name for messages
+    int Threads;			///< number of worker threads
+    int Size;				///< size of request queue
+    char Idle;				///< nice 19 and idle i/o priority
+    /// handle a request with its cancel generation, runs in a worker
+    void (*Handle) (void *, unsigned);
+    /// compare two requests, NULL if duplicates are queued
+    int (*Same) (const void *, const void *);
+
+    pthread_mutex_t Mutex;		///< protects queue and threads
+    pthread_cond_t Cond;		///< signals new requests
+    pthread_t *ThreadIds;		///< worker threads
+    void **Queue;			///< queued malloced requests
+    int QueueRead;			///< queue read index
+    int QueueWrite;			///< queue write index
+    char Failed;			///< a worker couldn't be started
+    volatile char Exiting;		///< workers should exit
+    volatile unsigned Generation;	///< bumped by cancel
+} WorkerPool;
+
+    /// queue a malloced request, the pool takes it over
+extern int WorkerQueue(WorkerPool *, void *);
+
+    /// queue a copy of a file name
+extern int WorkerQueueFile(WorkerPool *, const char *);
+
+    /// compare two file name requests
+extern int WorkerSameFile(const void *, const void *);
+
+    /// check if a request of a generation is cancelled
+extern int WorkerCancelled(const WorkerPool *, unsigned);
+
+    /// cancel all queued and running requests
+extern void WorkerCancel(WorkerPool *);
+
+    /// stop worker threads
+extern void WorkerExit(WorkerPool *);
+
+    /// hash of the file identity (device, inode, size, mtime)
+extern uint32_t WorkerFileHash(const struct stat *);